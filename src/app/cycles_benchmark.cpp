@@ -0,0 +1,760 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Benchmark
+ *
+ * Renders a fixed set of procedurally generated scenes on the CPU device and
+ * reports timings of the stages of the scene update and render as JSON, for
+ * tracking performance across builds. Stage timings are derived from the
+ * status messages the session and scene report to Progress. */
+
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "device/device.h"
+
+#include "render/buffers.h"
+#include "render/camera.h"
+#include "render/film.h"
+#include "render/graph.h"
+#include "render/integrator.h"
+#include "render/light.h"
+#include "render/mesh.h"
+#include "render/nodes.h"
+#include "render/object.h"
+#include "render/scene.h"
+#include "render/session.h"
+#include "render/shader.h"
+
+#include "subd/subd_split.h"
+
+#include "util/util_args.h"
+#include "util/util_foreach.h"
+#include "util/util_function.h"
+#include "util/util_guarded_allocator.h"
+#include "util/util_hash.h"
+#include "util/util_logging.h"
+#include "util/util_map.h"
+#include "util/util_path.h"
+#include "util/util_progress.h"
+#include "util/util_string.h"
+#include "util/util_thread.h"
+#include "util/util_time.h"
+#include "util/util_transform.h"
+#include "util/util_version.h"
+
+CCL_NAMESPACE_BEGIN
+
+struct BenchmarkOptions {
+  int width, height;
+  int samples;
+  int threads;
+  bool cpu_split_kernel;
+  string scenes;
+  string output_path;
+} options;
+
+/* Scene Construction */
+
+static Shader *benchmark_add_shader(Scene *scene, const char *name, ShaderGraph *graph)
+{
+  Shader *shader = new Shader();
+  shader->name = name;
+  shader->set_graph(graph);
+  scene->shaders.push_back(shader);
+  return shader;
+}
+
+static Shader *benchmark_add_diffuse_shader(Scene *scene, const float3 color)
+{
+  ShaderGraph *graph = new ShaderGraph();
+
+  DiffuseBsdfNode *diffuse = new DiffuseBsdfNode();
+  diffuse->color = color;
+  graph->add(diffuse);
+
+  graph->connect(diffuse->output("BSDF"), graph->output()->input("Surface"));
+
+  return benchmark_add_shader(scene, "diffuse", graph);
+}
+
+static Shader *benchmark_add_emission_shader(Scene *scene)
+{
+  ShaderGraph *graph = new ShaderGraph();
+
+  EmissionNode *emission = new EmissionNode();
+  emission->color = make_float3(1.0f, 1.0f, 1.0f);
+  emission->strength = 1.0f;
+  graph->add(emission);
+
+  graph->connect(emission->output("Emission"), graph->output()->input("Surface"));
+
+  return benchmark_add_shader(scene, "emission", graph);
+}
+
+static Object *benchmark_add_object(Scene *scene, Mesh *mesh, const Transform &tfm)
+{
+  Object *object = new Object();
+  object->mesh = mesh;
+  object->shader = mesh->used_shaders[0];
+  object->tfm = tfm;
+  scene->objects.push_back(object);
+  return object;
+}
+
+static Mesh *benchmark_add_mesh(Scene *scene, Shader *shader)
+{
+  Mesh *mesh = new Mesh();
+  mesh->used_shaders.push_back(shader);
+  scene->meshes.push_back(mesh);
+  return mesh;
+}
+
+/* Square grid of quads in the XZ plane, centered at the origin. */
+static Mesh *benchmark_add_grid(Scene *scene, Shader *shader, int resolution, float size)
+{
+  Mesh *mesh = benchmark_add_mesh(scene, shader);
+
+  const int num_verts = (resolution + 1) * (resolution + 1);
+  mesh->reserve_mesh(num_verts, resolution * resolution * 2);
+
+  for (int j = 0; j <= resolution; j++) {
+    for (int i = 0; i <= resolution; i++) {
+      const float u = (float)i / resolution - 0.5f;
+      const float v = (float)j / resolution - 0.5f;
+      mesh->add_vertex(make_float3(u * size, 0.0f, v * size));
+    }
+  }
+
+  for (int j = 0; j < resolution; j++) {
+    for (int i = 0; i < resolution; i++) {
+      const int v0 = j * (resolution + 1) + i;
+      const int v1 = v0 + 1;
+      const int v2 = v0 + resolution + 1;
+      const int v3 = v2 + 1;
+      mesh->add_triangle(v0, v1, v3, 0, false);
+      mesh->add_triangle(v0, v3, v2, 0, false);
+    }
+  }
+
+  return mesh;
+}
+
+/* Unit cube centered at the origin. */
+static Mesh *benchmark_add_cube(Scene *scene, Shader *shader)
+{
+  Mesh *mesh = benchmark_add_mesh(scene, shader);
+  mesh->reserve_mesh(8, 12);
+
+  for (int i = 0; i < 8; i++) {
+    mesh->add_vertex(make_float3((i & 1) ? 0.5f : -0.5f,
+                                 (i & 2) ? 0.5f : -0.5f,
+                                 (i & 4) ? 0.5f : -0.5f));
+  }
+
+  static const int faces[6][4] = {
+      {0, 2, 3, 1}, {4, 5, 7, 6}, {0, 1, 5, 4}, {2, 6, 7, 3}, {0, 4, 6, 2}, {1, 3, 7, 5}};
+  for (int i = 0; i < 6; i++) {
+    mesh->add_triangle(faces[i][0], faces[i][1], faces[i][2], 0, false);
+    mesh->add_triangle(faces[i][0], faces[i][2], faces[i][3], 0, false);
+  }
+
+  return mesh;
+}
+
+static void benchmark_add_ground(Scene *scene)
+{
+  Shader *shader = benchmark_add_diffuse_shader(scene, make_float3(0.8f, 0.8f, 0.8f));
+  Mesh *mesh = benchmark_add_grid(scene, shader, 1, 100.0f);
+  benchmark_add_object(scene, mesh, transform_translate(0.0f, -1.0f, 0.0f));
+}
+
+static void benchmark_add_sun(Scene *scene)
+{
+  Light *light = new Light();
+  light->type = LIGHT_DISTANT;
+  light->dir = normalize(make_float3(-0.3f, -1.0f, 0.5f));
+  light->angle = 0.05f;
+  light->strength = make_float3(3.0f, 3.0f, 3.0f);
+  light->shader = benchmark_add_emission_shader(scene);
+  scene->lights.push_back(light);
+}
+
+/* Many instances of a single mesh. */
+static void benchmark_scene_instances(Scene *scene)
+{
+  benchmark_add_ground(scene);
+  benchmark_add_sun(scene);
+
+  Shader *shader = benchmark_add_diffuse_shader(scene, make_float3(0.8f, 0.3f, 0.2f));
+  Mesh *mesh = benchmark_add_grid(scene, shader, 32, 1.0f);
+
+  const int resolution = 100;
+  for (int j = 0; j < resolution; j++) {
+    for (int i = 0; i < resolution; i++) {
+      const float x = (i - resolution * 0.5f) * 0.4f;
+      const float z = 2.0f + j * 0.4f;
+      const Transform tfm = transform_translate(x, -0.5f, z) *
+                            transform_rotate((i * 7 + j * 13) * 0.1f, make_float3(1, 1, 0)) *
+                            transform_scale(0.3f, 0.3f, 0.3f);
+      benchmark_add_object(scene, mesh, tfm);
+    }
+  }
+}
+
+/* Subdivided plane with true displacement from a noise texture. */
+static void benchmark_scene_displacement(Scene *scene)
+{
+  benchmark_add_sun(scene);
+
+  ShaderGraph *graph = new ShaderGraph();
+
+  DiffuseBsdfNode *diffuse = new DiffuseBsdfNode();
+  diffuse->color = make_float3(0.6f, 0.6f, 0.6f);
+  graph->add(diffuse);
+
+  NoiseTextureNode *noise = new NoiseTextureNode();
+  noise->scale = 4.0f;
+  noise->detail = 8.0f;
+  graph->add(noise);
+
+  DisplacementNode *displacement = new DisplacementNode();
+  displacement->scale = 0.5f;
+  graph->add(displacement);
+
+  graph->connect(diffuse->output("BSDF"), graph->output()->input("Surface"));
+  graph->connect(noise->output("Fac"), displacement->input("Height"));
+  graph->connect(displacement->output("Displacement"), graph->output()->input("Displacement"));
+
+  Shader *shader = benchmark_add_shader(scene, "displacement", graph);
+  shader->displacement_method = DISPLACE_TRUE;
+
+  Mesh *mesh = benchmark_add_mesh(scene, shader);
+  mesh->subdivision_type = Mesh::SUBDIVISION_LINEAR;
+
+  const int resolution = 16;
+  const float size = 20.0f;
+  mesh->verts.reserve((resolution + 1) * (resolution + 1));
+  for (int j = 0; j <= resolution; j++) {
+    for (int i = 0; i <= resolution; i++) {
+      const float u = (float)i / resolution - 0.5f;
+      const float v = (float)j / resolution - 0.5f;
+      mesh->add_vertex(make_float3(u * size, 0.0f, v * size));
+    }
+  }
+
+  mesh->reserve_subd_faces(resolution * resolution, 0, resolution * resolution * 4);
+  for (int j = 0; j < resolution; j++) {
+    for (int i = 0; i < resolution; i++) {
+      const int v0 = j * (resolution + 1) + i;
+      int corners[4] = {v0, v0 + resolution + 1, v0 + resolution + 2, v0 + 1};
+      mesh->add_subd_face(corners, 4, 0, true);
+    }
+  }
+
+  const Transform tfm = transform_translate(0.0f, -1.0f, 10.0f);
+  mesh->subd_params = new SubdParams(mesh);
+  mesh->subd_params->dicing_rate = 1.0f;
+  mesh->subd_params->objecttoworld = tfm;
+
+  benchmark_add_object(scene, mesh, tfm);
+}
+
+/* Grid of small point lights over a ground plane. */
+static void benchmark_scene_many_lights(Scene *scene)
+{
+  benchmark_add_ground(scene);
+
+  Shader *shader = benchmark_add_emission_shader(scene);
+
+  const int resolution = 32;
+  for (int j = 0; j < resolution; j++) {
+    for (int i = 0; i < resolution; i++) {
+      Light *light = new Light();
+      light->type = LIGHT_POINT;
+      light->co = make_float3((i - resolution * 0.5f) * 1.0f, -0.5f, 2.0f + j * 1.0f);
+      light->size = 0.05f;
+      light->strength = make_float3(
+          (i % 3 == 0) ? 4.0f : 1.0f, (i % 3 == 1) ? 4.0f : 1.0f, (i % 3 == 2) ? 4.0f : 1.0f);
+      light->shader = shader;
+      scene->lights.push_back(light);
+    }
+  }
+}
+
+/* Homogeneous volume in a cube. */
+static void benchmark_scene_volume(Scene *scene)
+{
+  benchmark_add_ground(scene);
+  benchmark_add_sun(scene);
+
+  ShaderGraph *graph = new ShaderGraph();
+
+  PrincipledVolumeNode *volume = new PrincipledVolumeNode();
+  volume->color = make_float3(0.8f, 0.8f, 0.8f);
+  volume->density = 0.5f;
+  graph->add(volume);
+
+  graph->connect(volume->output("Volume"), graph->output()->input("Volume"));
+
+  Shader *shader = benchmark_add_shader(scene, "volume", graph);
+  Mesh *mesh = benchmark_add_cube(scene, shader);
+
+  benchmark_add_object(
+      scene, mesh, transform_translate(0.0f, 0.0f, 6.0f) * transform_scale(4.0f, 2.0f, 4.0f));
+}
+
+/* Field of hair strands. */
+static void benchmark_scene_hair(Scene *scene)
+{
+  benchmark_add_ground(scene);
+  benchmark_add_sun(scene);
+
+  ShaderGraph *graph = new ShaderGraph();
+
+  PrincipledHairBsdfNode *hair = new PrincipledHairBsdfNode();
+  graph->add(hair);
+
+  graph->connect(hair->output("BSDF"), graph->output()->input("Surface"));
+
+  Shader *shader = benchmark_add_shader(scene, "hair", graph);
+  Mesh *mesh = benchmark_add_mesh(scene, shader);
+
+  const int resolution = 300;
+  const int num_keys = 5;
+  mesh->reserve_curves(resolution * resolution, resolution * resolution * num_keys);
+
+  for (int j = 0; j < resolution; j++) {
+    for (int i = 0; i < resolution; i++) {
+      /* Deterministic jitter, so every run renders the same scene. */
+      const uint hash = hash_uint2(i, j);
+      const float jitter_x = (hash & 0xffff) / 65535.0f - 0.5f;
+      const float jitter_z = (hash >> 16) / 65535.0f - 0.5f;
+      const float3 root = make_float3((i + jitter_x - resolution * 0.5f) * 0.03f,
+                                      -1.0f,
+                                      2.0f + (j + jitter_z) * 0.03f);
+
+      mesh->add_curve(mesh->curve_keys.size(), 0);
+      for (int k = 0; k < num_keys; k++) {
+        const float t = (float)k / (num_keys - 1);
+        const float3 P = root + make_float3(0.1f * t * t * jitter_x, 0.5f * t, 0.1f * t * t);
+        mesh->add_curve_key(P, 0.004f * (1.0f - 0.8f * t));
+      }
+    }
+  }
+
+  benchmark_add_object(scene, mesh, transform_identity());
+}
+
+/* Instances of meshes with many different shaders, each mixing a diffuse and
+ * a glossy closure by a noise texture. */
+static void benchmark_scene_materials(Scene *scene)
+{
+  benchmark_add_ground(scene);
+  benchmark_add_sun(scene);
+
+  const int num_shaders = 64;
+  vector<Mesh *> meshes;
+  for (int i = 0; i < num_shaders; i++) {
+    ShaderGraph *graph = new ShaderGraph();
+
+    NoiseTextureNode *noise = new NoiseTextureNode();
+    noise->scale = 2.0f + (i % 8);
+    noise->detail = 2.0f + (i / 8);
+    graph->add(noise);
+
+    DiffuseBsdfNode *diffuse = new DiffuseBsdfNode();
+    diffuse->color = make_float3(
+        0.2f + 0.1f * (i % 7), 0.2f + 0.1f * (i % 5), 0.2f + 0.1f * (i % 3));
+    graph->add(diffuse);
+
+    GlossyBsdfNode *glossy = new GlossyBsdfNode();
+    glossy->roughness = 0.05f + 0.01f * i;
+    graph->add(glossy);
+
+    MixClosureNode *mix = new MixClosureNode();
+    graph->add(mix);
+
+    graph->connect(noise->output("Fac"), mix->input("Fac"));
+    graph->connect(diffuse->output("BSDF"), mix->input("Closure1"));
+    graph->connect(glossy->output("BSDF"), mix->input("Closure2"));
+    graph->connect(mix->output("Closure"), graph->output()->input("Surface"));
+
+    Shader *shader = benchmark_add_shader(scene, "material", graph);
+    meshes.push_back(benchmark_add_grid(scene, shader, 4, 1.0f));
+  }
+
+  const int resolution = 40;
+  for (int j = 0; j < resolution; j++) {
+    for (int i = 0; i < resolution; i++) {
+      const float x = (i - resolution * 0.5f) * 0.5f;
+      const float z = 2.0f + j * 0.5f;
+      const Transform tfm = transform_translate(x, -0.5f, z) *
+                            transform_rotate((i * 7 + j * 13) * 0.1f, make_float3(1, 1, 0)) *
+                            transform_scale(0.4f, 0.4f, 0.4f);
+      benchmark_add_object(scene, meshes[hash_uint2(i, j) % num_shaders], tfm);
+    }
+  }
+}
+
+struct BenchmarkScene {
+  const char *name;
+  void (*create)(Scene *scene);
+};
+
+static const BenchmarkScene benchmark_scenes[] = {
+    {"instances", benchmark_scene_instances},
+    {"displacement", benchmark_scene_displacement},
+    {"many_lights", benchmark_scene_many_lights},
+    {"volume", benchmark_scene_volume},
+    {"hair", benchmark_scene_hair},
+    {"materials", benchmark_scene_materials},
+};
+
+static const BenchmarkScene *benchmark_find_scene(const string &name)
+{
+  for (size_t i = 0; i < sizeof(benchmark_scenes) / sizeof(*benchmark_scenes); i++) {
+    if (name == benchmark_scenes[i].name) {
+      return &benchmark_scenes[i];
+    }
+  }
+  return NULL;
+}
+
+/* Stage Timing */
+
+class BenchmarkStageTimer {
+ public:
+  explicit BenchmarkStageTimer(Progress &progress) : progress(progress)
+  {
+    last_time = time_dt();
+  }
+
+  /* Called on every progress update, attributes the time since the last
+   * update to the stage reported before it. */
+  void update()
+  {
+    string status, substatus;
+    progress.get_status(status, substatus);
+
+    thread_scoped_lock lock(mutex);
+    const double time = time_dt();
+    if (last_stage != "") {
+      stage_times[last_stage] += time - last_time;
+    }
+    last_stage = stage_from_status(status);
+    last_time = time;
+  }
+
+  void finish()
+  {
+    update();
+  }
+
+  map<string, double> stage_times;
+
+ protected:
+  static string stage_from_status(const string &status)
+  {
+    if (status == "Updating Shaders") {
+      return "shader_compile";
+    }
+    else if (status == "Updating Images") {
+      return "image_load";
+    }
+    else if (string_startswith(status, "Updating Mesh BVH") ||
+             string_startswith(status, "Updating Scene BVH")) {
+      return "bvh_build";
+    }
+    else if (string_startswith(status, "Updating")) {
+      return "scene_sync";
+    }
+    else if (string_startswith(status, "Loading render kernels")) {
+      return "kernel_load";
+    }
+    else if (string_startswith(status, "Path Tracing") || string_startswith(status, "Rendered") ||
+             string_startswith(status, "Rendering")) {
+      return "render";
+    }
+    return "";
+  }
+
+  Progress &progress;
+  thread_mutex mutex;
+  string last_stage;
+  double last_time;
+};
+
+/* Benchmark */
+
+static bool benchmark_write_render(const uchar * /*pixels*/, int /*w*/, int /*h*/, int /*channels*/)
+{
+  /* Only requested so the session keeps full frame render buffers. */
+  return true;
+}
+
+static string benchmark_run_scene(const BenchmarkScene &benchmark_scene)
+{
+  SessionParams session_params;
+  session_params.background = true;
+  session_params.progressive = true;
+  session_params.samples = options.samples;
+  session_params.threads = options.threads;
+  session_params.write_render_cb = benchmark_write_render;
+
+  vector<DeviceInfo> devices = Device::available_devices(DEVICE_MASK_CPU);
+  session_params.device = devices.front();
+  session_params.device.use_split_kernel = options.cpu_split_kernel;
+
+  Session *session = new Session(session_params);
+
+  /* Create scene. */
+  double start_time = time_dt();
+
+  SceneParams scene_params;
+  scene_params.shadingsystem = SHADINGSYSTEM_SVM;
+  Scene *scene = new Scene(scene_params, session->device);
+  benchmark_scene.create(scene);
+
+  Camera *cam = scene->camera;
+  cam->width = options.width;
+  cam->height = options.height;
+  cam->full_width = options.width;
+  cam->full_height = options.height;
+  cam->matrix = transform_translate(0.0f, 1.0f, -4.0f) *
+                transform_rotate(M_PI_F / 12.0f, make_float3(1.0f, 0.0f, 0.0f));
+  cam->compute_auto_viewplane();
+  cam->need_update = true;
+
+  const double scene_create_time = time_dt() - start_time;
+
+  /* Render. */
+  BenchmarkStageTimer timer(session->progress);
+  session->progress.set_update_callback(function_bind(&BenchmarkStageTimer::update, &timer));
+
+  BufferParams buffer_params;
+  buffer_params.width = options.width;
+  buffer_params.height = options.height;
+  buffer_params.full_width = options.width;
+  buffer_params.full_height = options.height;
+
+  session->scene = scene;
+  session->reset(buffer_params, options.samples);
+
+  start_time = time_dt();
+  session->start();
+  session->wait();
+  timer.finish();
+  const double total_time = time_dt() - start_time;
+
+  /* Film conversion of the combined pass on the device, like the session
+   * does for display. */
+  double film_convert_time = 0.0;
+  if (session->buffers) {
+    BufferParams &params = session->buffers->params;
+    device_vector<float> pixels(session->device, "benchmark_film_convert", MEM_READ_WRITE);
+    pixels.alloc(params.width * params.height * 4);
+    pixels.zero_to_device();
+
+    DeviceTask task(DeviceTask::FILM_CONVERT);
+    task.x = 0;
+    task.y = 0;
+    task.w = params.width;
+    task.h = task.fh = params.height;
+    task.full_w = params.width;
+    task.full_h = params.height;
+    task.pixel_size = 1;
+    task.buffer = session->buffers->buffer.device_pointer;
+    task.sample = options.samples - 1;
+    params.get_offset_stride(task.offset, task.stride);
+    task.offset = 0;
+    task.film_passes.push_back(DeviceFilmPass(PASS_COMBINED, pixels.device_pointer));
+
+    const double film_start_time = time_dt();
+    session->device->task_add(task);
+    session->device->task_wait();
+    film_convert_time = time_dt() - film_start_time;
+
+    pixels.free();
+  }
+
+  const double render_time = timer.stage_times["render"];
+  const double samples_per_second = (render_time > 0.0) ? (double)options.width *
+                                                               options.height * options.samples /
+                                                               render_time :
+                                                           0.0;
+  const size_t device_peak_memory = session->stats.mem_peak;
+
+  delete session;
+
+  /* Report. */
+  string json = string_printf("    {\n      \"name\": \"%s\",\n", benchmark_scene.name);
+  json += string_printf("      \"total_time\": %f,\n", total_time);
+  json += "      \"stages\": {\n";
+  json += string_printf("        \"scene_create\": %f,\n", scene_create_time);
+
+  const char *stages[] = {
+      "scene_sync", "bvh_build", "shader_compile", "image_load", "kernel_load", "render"};
+  for (size_t i = 0; i < sizeof(stages) / sizeof(*stages); i++) {
+    json += string_printf("        \"%s\": %f,\n", stages[i], timer.stage_times[stages[i]]);
+  }
+
+  json += string_printf("        \"film_convert\": %f\n", film_convert_time);
+  json += "      },\n";
+  json += string_printf("      \"samples_per_second\": %f,\n", samples_per_second);
+  json += string_printf("      \"device_peak_memory\": %zu\n", device_peak_memory);
+  json += "    }";
+
+  return json;
+}
+
+static void options_parse(int argc, const char **argv)
+{
+  options.width = 512;
+  options.height = 512;
+  options.samples = 16;
+  options.threads = 0;
+  options.cpu_split_kernel = false;
+  options.scenes = "";
+  options.output_path = "";
+
+  ArgParse ap;
+  bool help = false, debug = false;
+  int verbosity = 1;
+
+  ap.options("Usage: cycles_benchmark [options]",
+             "--samples %d",
+             &options.samples,
+             "Number of samples to render",
+             "--threads %d",
+             &options.threads,
+             "CPU Rendering Threads",
+             "--cpu-split-kernel",
+             &options.cpu_split_kernel,
+             "Render with the wavefront split kernel and shader sorting",
+             "--width %d",
+             &options.width,
+             "Image width in pixels",
+             "--height %d",
+             &options.height,
+             "Image height in pixels",
+             "--scenes %s",
+             &options.scenes,
+             "Comma separated names of scenes to render, all by default",
+             "--output %s",
+             &options.output_path,
+             "File path to write JSON report to, standard output by default",
+#ifdef WITH_CYCLES_LOGGING
+             "--debug",
+             &debug,
+             "Enable debug logging",
+             "--verbose %d",
+             &verbosity,
+             "Set verbosity of the logger",
+#endif
+             "--help",
+             &help,
+             "Print help message",
+             NULL);
+
+  if (ap.parse(argc, argv) < 0) {
+    fprintf(stderr, "%s\n", ap.geterror().c_str());
+    ap.usage();
+    exit(EXIT_FAILURE);
+  }
+
+  if (debug) {
+    util_logging_start();
+    util_logging_verbosity_set(verbosity);
+  }
+
+  if (help) {
+    printf("Scenes:");
+    for (size_t i = 0; i < sizeof(benchmark_scenes) / sizeof(*benchmark_scenes); i++) {
+      printf(" %s", benchmark_scenes[i].name);
+    }
+    printf("\n");
+    ap.usage();
+    exit(EXIT_SUCCESS);
+  }
+
+  if (options.samples <= 0 || options.width <= 0 || options.height <= 0) {
+    fprintf(stderr, "Invalid image size or number of samples\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+CCL_NAMESPACE_END
+
+using namespace ccl;
+
+int main(int argc, const char **argv)
+{
+  util_logging_init(argv[0]);
+  path_init();
+  options_parse(argc, argv);
+
+  vector<string> scene_names;
+  string_split(scene_names, options.scenes, ",");
+
+  foreach (const string &scene_name, scene_names) {
+    if (!benchmark_find_scene(scene_name)) {
+      fprintf(stderr, "Unknown scene: %s\n", scene_name.c_str());
+      return EXIT_FAILURE;
+    }
+  }
+
+  string json = "{\n";
+  json += string_printf("  \"version\": \"%s\",\n", CYCLES_VERSION_STRING);
+  json += string_printf("  \"width\": %d,\n", options.width);
+  json += string_printf("  \"height\": %d,\n", options.height);
+  json += string_printf("  \"samples\": %d,\n", options.samples);
+  json += "  \"scenes\": [\n";
+
+  bool first = true;
+  for (size_t i = 0; i < sizeof(benchmark_scenes) / sizeof(*benchmark_scenes); i++) {
+    const BenchmarkScene &benchmark_scene = benchmark_scenes[i];
+    if (!scene_names.empty() && std::find(scene_names.begin(),
+                                          scene_names.end(),
+                                          string(benchmark_scene.name)) == scene_names.end()) {
+      continue;
+    }
+
+    fprintf(stderr, "Rendering %s\n", benchmark_scene.name);
+    if (!first) {
+      json += ",\n";
+    }
+    json += benchmark_run_scene(benchmark_scene);
+    first = false;
+  }
+
+  json += "\n  ],\n";
+  json += string_printf("  \"host_peak_memory\": %zu\n", util_guarded_get_mem_peak());
+  json += "}\n";
+
+  if (options.output_path != "") {
+    if (!path_write_text(options.output_path, json)) {
+      fprintf(stderr, "Failed to write %s\n", options.output_path.c_str());
+      return EXIT_FAILURE;
+    }
+  }
+  else {
+    printf("%s", json.c_str());
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -18,12 +18,14 @@
 
 #include "render/buffers.h"
 #include "render/camera.h"
+#include "render/film.h"
 #include "device/device.h"
 #include "render/scene.h"
 #include "render/session.h"
 #include "render/integrator.h"
 
 #include "util/util_args.h"
+#include "util/util_debug.h"
 #include "util/util_foreach.h"
 #include "util/util_function.h"
 #include "util/util_logging.h"
@@ -53,6 +55,7 @@ struct Options {
   bool quiet;
   bool show_help, interactive, pause;
   string output_path;
+  string convert_path;
 } options;
 
 static void session_print(const string &str)
@@ -120,6 +123,18 @@ static BufferParams &session_buffer_params()
   buffer_params.full_width = options.width;
   buffer_params.full_height = options.height;
 
+  /* Adaptive sampling needs its auxiliary passes in the render buffers. */
+  if (options.scene && options.scene->integrator->use_adaptive_sampling) {
+    Pass::add(PASS_ADAPTIVE_AUX_BUFFER, buffer_params.passes);
+    Pass::add(PASS_SAMPLE_COUNT, buffer_params.passes);
+
+    Film *film = options.scene->film;
+    if (!Pass::equals(film->passes, buffer_params.passes)) {
+      film->tag_passes_update(options.scene, buffer_params.passes);
+      film->tag_update(options.scene);
+    }
+  }
+
   return buffer_params;
 }
 
@@ -374,6 +389,7 @@ static void options_parse(int argc, const char **argv)
   string device_names = "";
   string devicename = "CPU";
   bool list = false;
+  bool cpu_split_kernel = false;
 
   /* List devices for which support is compiled in. */
   vector<DeviceType> types = Device::available_types();
@@ -431,6 +447,28 @@ static void options_parse(int argc, const char **argv)
              "--tile-height %d",
              &options.session_params.tile_size.y,
              "Tile height in pixels",
+             "--texture-cache-size %d",
+             &options.scene_params.texture_cache_size,
+             "Memory in MB for tiles of large images read on demand, CPU only (0 to disable)",
+             "--tile-output %s",
+             &options.session_params.tile_output_path,
+             "Stream finished tiles to this tiled OpenEXR file in background mode, "
+             "renders tiles to the end one at a time instead of progressively",
+             "--bvh-cache %s",
+             &options.scene_params.bvh_cache_path,
+             "Directory to load and store mesh BVHs, so unchanged meshes are not rebuilt",
+             "--convert-meshes %s",
+             &options.convert_path,
+             "Write a copy of the XML file to this path with meshes in binary mesh caches",
+             "--cpu-split-kernel",
+             &cpu_split_kernel,
+             "Render on the CPU with the wavefront split kernel and shader sorting",
+             "--cpu-split-kernel-size %d",
+             &DebugFlags().cpu.split_kernel_size,
+             "Number of paths each CPU thread keeps in flight with the split kernel (default 64)",
+             "--profile-trace %s",
+             &options.session_params.profiling_trace_path,
+             "Profile CPU rendering and write a Chrome trace of the session to this file",
              "--list-devices",
              &list,
              "List information about all available devices",
@@ -492,8 +530,14 @@ static void options_parse(int argc, const char **argv)
   options.session_params.background = true;
 #endif
 
-  /* Use progressive rendering */
-  options.session_params.progressive = true;
+  /* Use progressive rendering, except when streaming finished tiles to a file
+   * which needs every tile to be rendered to the end at once. */
+  options.session_params.progressive = options.session_params.tile_output_path.empty();
+
+  /* Trace includes the kernel profiling samples */
+  if (!options.session_params.profiling_trace_path.empty()) {
+    options.session_params.use_profiling = true;
+  }
 
   /* find matching device */
   DeviceType device_type = Device::type_from_string(devicename.c_str());
@@ -521,6 +565,14 @@ static void options_parse(int argc, const char **argv)
     exit(EXIT_FAILURE);
   }
 #endif
+  else if (cpu_split_kernel && options.session_params.device.type != DEVICE_CPU) {
+    fprintf(stderr, "CPU split kernel only works with CPU device\n");
+    exit(EXIT_FAILURE);
+  }
+  else if (DebugFlags().cpu.split_kernel_size < 1) {
+    fprintf(stderr, "Invalid split kernel size: %d\n", DebugFlags().cpu.split_kernel_size);
+    exit(EXIT_FAILURE);
+  }
   else if (options.session_params.samples < 0) {
     fprintf(stderr, "Invalid number of samples: %d\n", options.session_params.samples);
     exit(EXIT_FAILURE);
@@ -530,6 +582,10 @@ static void options_parse(int argc, const char **argv)
     exit(EXIT_FAILURE);
   }
 
+  if (cpu_split_kernel) {
+    options.session_params.device.use_split_kernel = true;
+  }
+
   /* For smoother Viewport */
   options.session_params.start_resolution = 64;
 }
@@ -544,6 +600,12 @@ int main(int argc, const char **argv)
   path_init();
   options_parse(argc, argv);
 
+  if (options.convert_path != "") {
+    return xml_convert_file(options.filepath.c_str(), options.convert_path.c_str()) ?
+               EXIT_SUCCESS :
+               EXIT_FAILURE;
+  }
+
 #ifdef WITH_CYCLES_STANDALONE_GUI
   if (options.session_params.background) {
 #endif
@@ -39,8 +39,10 @@
 #include "subd/subd_split.h"
 
 #include "util/util_foreach.h"
+#include "util/util_logging.h"
 #include "util/util_path.h"
 #include "util/util_projection.h"
+#include "util/util_string.h"
 #include "util/util_transform.h"
 #include "util/util_xml.h"
 
@@ -387,6 +389,27 @@ static Mesh *xml_add_mesh(Scene *scene, const Transform &tfm)
   return mesh;
 }
 
+static void xml_setup_subd_params(const XMLReadState &state, Mesh *mesh, float dicing_rate)
+{
+  if (!mesh->subd_params) {
+    mesh->subd_params = new SubdParams(mesh);
+  }
+  SubdParams &sdparams = *mesh->subd_params;
+
+  sdparams.dicing_rate = std::max(0.1f, dicing_rate);
+  sdparams.objecttoworld = state.tfm;
+}
+
+static void xml_add_generated_attribute(const XMLReadState &state, Mesh *mesh)
+{
+  /* we don't yet support arbitrary attributes, for now add vertex
+   * coordinates as generated coordinates if requested */
+  if (mesh->need_attribute(state.scene, ATTR_STD_GENERATED)) {
+    Attribute *attr = mesh->attributes.add(ATTR_STD_GENERATED);
+    memcpy(attr->data_float3(), mesh->verts.data(), sizeof(float3) * mesh->verts.size());
+  }
+}
+
 static void xml_read_mesh(const XMLReadState &state, xml_node node)
 {
   /* add mesh */
@@ -509,24 +532,303 @@ static void xml_read_mesh(const XMLReadState &state, xml_node node)
     }
 
     /* setup subd params */
-    if (!mesh->subd_params) {
-      mesh->subd_params = new SubdParams(mesh);
+    float dicing_rate = state.dicing_rate;
+    xml_read_float(&dicing_rate, node, "dicing_rate");
+    xml_setup_subd_params(state, mesh, dicing_rate);
+  }
+
+  xml_add_generated_attribute(state, mesh);
+}
+
+/* Binary Mesh Cache
+ *
+ * Large meshes can be stored in a binary file and loaded with
+ * <include src="mesh.cmesh"/>, which avoids parsing long arrays of numbers
+ * from XML text. Triangle meshes are stored already triangulated and in the
+ * same memory layout as the Mesh arrays, so they are read straight into the
+ * mesh storage. Subdivision meshes are stored as polygons.
+ *
+ * The file is a header followed by the arrays, all in native byte order:
+ * - triangle meshes: verts (float3), triangles (3 ints), UV (3 float2 per
+ *   triangle, optional).
+ * - subdivision meshes: verts (float3), nverts (int per face), face corners
+ *   (int), UV (float per corner, optional).
+ *
+ * Counts are checked against the file size and indices against the number of
+ * vertices on load, a truncated or corrupt file is reported as a read error. */
+
+#define XML_MESH_CACHE_VERSION 1
+
+struct XMLMeshCacheHeader {
+  char magic[8];
+  int version;
+  int subdivision_type;
+  /* Dicing rate of the mesh, or 0 to use the dicing rate of the state. */
+  float dicing_rate;
+  int num_verts;
+  int num_triangles;
+  int num_faces;
+  int num_corners;
+  int has_uv;
+};
+
+static const char xml_mesh_cache_magic[8] = {'C', 'Y', 'C', 'M', 'E', 'S', 'H', '\0'};
+
+static bool xml_mesh_cache_read(FILE *f, void *data, size_t size)
+{
+  return size == 0 || fread(data, size, 1, f) == 1;
+}
+
+static bool xml_mesh_cache_write(FILE *f, const void *data, size_t size)
+{
+  return size == 0 || fwrite(data, size, 1, f) == 1;
+}
+
+/* Size in bytes of a file with the given header, or 0 if the header is invalid. */
+static size_t xml_mesh_cache_file_size(const XMLMeshCacheHeader &header)
+{
+  if (header.num_verts < 0 || header.num_triangles < 0 || header.num_faces < 0 ||
+      header.num_corners < 0 || (header.has_uv != 0 && header.has_uv != 1)) {
+    return 0;
+  }
+
+  size_t size = sizeof(header) + sizeof(float3) * (size_t)header.num_verts;
+
+  switch (header.subdivision_type) {
+    case Mesh::SUBDIVISION_NONE:
+      size += sizeof(int) * 3 * (size_t)header.num_triangles;
+      if (header.has_uv) {
+        size += sizeof(float2) * 3 * (size_t)header.num_triangles;
+      }
+      return size;
+    case Mesh::SUBDIVISION_LINEAR:
+    case Mesh::SUBDIVISION_CATMULL_CLARK:
+      size += sizeof(int) * ((size_t)header.num_faces + (size_t)header.num_corners);
+      if (header.has_uv) {
+        size += sizeof(float) * (size_t)header.num_corners;
+      }
+      return size;
+    default:
+      return 0;
+  }
+}
+
+static bool xml_mesh_cache_valid_indices(const int *indices, size_t num, int num_verts)
+{
+  for (size_t i = 0; i < num; i++) {
+    if (indices[i] < 0 || indices[i] >= num_verts) {
+      return false;
     }
-    SubdParams &sdparams = *mesh->subd_params;
+  }
+  return true;
+}
 
-    sdparams.dicing_rate = state.dicing_rate;
-    xml_read_float(&sdparams.dicing_rate, node, "dicing_rate");
-    sdparams.dicing_rate = std::max(0.1f, sdparams.dicing_rate);
+static bool xml_mesh_cache_valid_faces(const vector<int> &nverts, size_t num_corners)
+{
+  size_t total = 0;
+  for (size_t i = 0; i < nverts.size(); i++) {
+    if (nverts[i] < 3) {
+      return false;
+    }
+    total += nverts[i];
+  }
+  return total == num_corners;
+}
 
-    sdparams.objecttoworld = state.tfm;
+static void xml_read_mesh_cache(const XMLReadState &state, const string &filepath)
+{
+  FILE *f = path_fopen(filepath, "rb");
+  if (!f) {
+    fprintf(stderr, "%s read error: could not open file\n", filepath.c_str());
+    exit(EXIT_FAILURE);
   }
 
-  /* we don't yet support arbitrary attributes, for now add vertex
-   * coordinates as generated coordinates if requested */
-  if (mesh->need_attribute(state.scene, ATTR_STD_GENERATED)) {
-    Attribute *attr = mesh->attributes.add(ATTR_STD_GENERATED);
-    memcpy(attr->data_float3(), mesh->verts.data(), sizeof(float3) * mesh->verts.size());
+  XMLMeshCacheHeader header;
+  if (!xml_mesh_cache_read(f, &header, sizeof(header)) ||
+      memcmp(header.magic, xml_mesh_cache_magic, sizeof(header.magic)) != 0 ||
+      header.version != XML_MESH_CACHE_VERSION) {
+    fprintf(stderr, "%s read error: not a mesh cache file\n", filepath.c_str());
+    fclose(f);
+    exit(EXIT_FAILURE);
+  }
+
+  /* Check counts against the file size before allocating any arrays. */
+  const size_t file_size = xml_mesh_cache_file_size(header);
+  if (file_size == 0 || file_size != path_file_size(filepath)) {
+    fprintf(stderr, "%s read error: file is truncated or corrupt\n", filepath.c_str());
+    fclose(f);
+    exit(EXIT_FAILURE);
+  }
+
+  /* add mesh */
+  Mesh *mesh = xml_add_mesh(state.scene, state.tfm);
+  mesh->used_shaders.push_back(state.shader);
+  mesh->subdivision_type = (Mesh::SubdivisionType)header.subdivision_type;
+
+  /* read state */
+  int shader = 0;
+  bool smooth = state.smooth;
+  bool ok = true;
+
+  if (mesh->subdivision_type == Mesh::SUBDIVISION_NONE) {
+    /* read vertices and triangles directly into the mesh */
+    mesh->resize_mesh(header.num_verts, header.num_triangles);
+    ok = ok && xml_mesh_cache_read(f, mesh->verts.data(), sizeof(float3) * header.num_verts);
+    ok = ok &&
+         xml_mesh_cache_read(f, mesh->triangles.data(), sizeof(int) * 3 * header.num_triangles);
+    ok = ok && xml_mesh_cache_valid_indices(
+                   mesh->triangles.data(), mesh->triangles.size(), header.num_verts);
+
+    for (int i = 0; i < header.num_triangles; i++) {
+      mesh->shader[i] = shader;
+      mesh->smooth[i] = smooth;
+    }
+
+    if (ok && header.has_uv) {
+      ustring name = ustring("uvmap1");
+      Attribute *attr = mesh->attributes.add(ATTR_STD_UV, name);
+      ok = xml_mesh_cache_read(
+          f, attr->data_float2(), sizeof(float2) * 3 * header.num_triangles);
+    }
   }
+  else {
+    vector<int> verts(header.num_corners), nverts(header.num_faces);
+    vector<float> UV;
+
+    mesh->verts.resize(header.num_verts);
+    ok = ok && xml_mesh_cache_read(f, mesh->verts.data(), sizeof(float3) * header.num_verts);
+    ok = ok && xml_mesh_cache_read(f, nverts.data(), sizeof(int) * header.num_faces);
+    ok = ok && xml_mesh_cache_read(f, verts.data(), sizeof(int) * header.num_corners);
+    ok = ok && xml_mesh_cache_valid_faces(nverts, verts.size());
+    ok = ok && xml_mesh_cache_valid_indices(verts.data(), verts.size(), header.num_verts);
+    if (ok && header.has_uv) {
+      UV.resize(header.num_corners);
+      ok = xml_mesh_cache_read(f, UV.data(), sizeof(float) * header.num_corners);
+    }
+
+    if (ok) {
+      size_t num_ngons = 0;
+      for (size_t i = 0; i < nverts.size(); i++) {
+        num_ngons += (nverts[i] == 4) ? 0 : 1;
+      }
+      mesh->reserve_subd_faces(nverts.size(), num_ngons, verts.size());
+
+      /* create subd_faces */
+      int index_offset = 0;
+
+      for (size_t i = 0; i < nverts.size(); i++) {
+        mesh->add_subd_face(&verts[index_offset], nverts[i], shader, smooth);
+        index_offset += nverts[i];
+      }
+
+      /* uv map */
+      if (header.has_uv) {
+        ustring name = ustring("uvmap1");
+        Attribute *attr = mesh->subd_attributes.add(ATTR_STD_UV, name);
+        float3 *fdata = attr->data_float3();
+
+        for (size_t i = 0; i < UV.size(); i++) {
+          fdata[i] = make_float3(UV[i]);
+        }
+      }
+    }
+
+    /* setup subd params */
+    xml_setup_subd_params(
+        state, mesh, (header.dicing_rate > 0.0f) ? header.dicing_rate : state.dicing_rate);
+  }
+
+  fclose(f);
+
+  if (!ok) {
+    fprintf(stderr, "%s read error: file is truncated or corrupt\n", filepath.c_str());
+    exit(EXIT_FAILURE);
+  }
+
+  xml_add_generated_attribute(state, mesh);
+}
+
+static bool xml_write_mesh_cache(xml_node node, const string &filepath)
+{
+  /* read vertices and polygons */
+  vector<float3> P;
+  vector<float> UV;
+  vector<int> verts, nverts;
+
+  xml_read_float3_array(P, node, "P");
+  xml_read_int_array(verts, node, "verts");
+  xml_read_int_array(nverts, node, "nverts");
+  const bool has_uv = xml_read_float_array(UV, node, "UV");
+
+  XMLMeshCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, xml_mesh_cache_magic, sizeof(header.magic));
+  header.version = XML_MESH_CACHE_VERSION;
+  header.subdivision_type = Mesh::SUBDIVISION_NONE;
+  if (xml_equal_string(node, "subdivision", "catmull-clark")) {
+    header.subdivision_type = Mesh::SUBDIVISION_CATMULL_CLARK;
+  }
+  else if (xml_equal_string(node, "subdivision", "linear")) {
+    header.subdivision_type = Mesh::SUBDIVISION_LINEAR;
+  }
+  xml_read_float(&header.dicing_rate, node, "dicing_rate");
+  header.num_verts = P.size();
+  header.num_faces = nverts.size();
+  header.num_corners = verts.size();
+  header.has_uv = has_uv;
+
+  /* triangulate */
+  vector<int> triangles;
+  vector<float2> triangles_uv;
+
+  if (header.subdivision_type == Mesh::SUBDIVISION_NONE) {
+    int index_offset = 0;
+
+    for (size_t i = 0; i < nverts.size(); i++) {
+      for (int j = 0; j < nverts[i] - 2; j++) {
+        int c[3] = {index_offset, index_offset + j + 1, index_offset + j + 2};
+
+        for (int k = 0; k < 3; k++) {
+          assert(c[k] < (int)verts.size());
+          triangles.push_back(verts[c[k]]);
+
+          if (has_uv) {
+            assert(c[k] * 2 + 1 < (int)UV.size());
+            triangles_uv.push_back(make_float2(UV[c[k] * 2], UV[c[k] * 2 + 1]));
+          }
+        }
+      }
+
+      index_offset += nverts[i];
+    }
+
+    header.num_triangles = triangles.size() / 3;
+  }
+
+  FILE *f = path_fopen(filepath, "wb");
+  if (!f) {
+    return false;
+  }
+
+  bool ok = xml_mesh_cache_write(f, &header, sizeof(header)) &&
+            xml_mesh_cache_write(f, P.data(), sizeof(float3) * P.size());
+
+  if (header.subdivision_type == Mesh::SUBDIVISION_NONE) {
+    ok = ok && xml_mesh_cache_write(f, triangles.data(), sizeof(int) * triangles.size());
+    ok = ok &&
+         xml_mesh_cache_write(f, triangles_uv.data(), sizeof(float2) * triangles_uv.size());
+  }
+  else {
+    ok = ok && xml_mesh_cache_write(f, nverts.data(), sizeof(int) * nverts.size());
+    ok = ok && xml_mesh_cache_write(f, verts.data(), sizeof(int) * verts.size());
+    if (has_uv) {
+      UV.resize(verts.size(), 0.0f);
+      ok = ok && xml_mesh_cache_write(f, UV.data(), sizeof(float) * UV.size());
+    }
+  }
+
+  fclose(f);
+  return ok;
 }
 
 /* Light */
@@ -658,11 +960,18 @@ static void xml_read_scene(XMLReadState &state, xml_node scene_node)
 
 static void xml_read_include(XMLReadState &state, const string &src)
 {
+  string path = path_join(state.base, src);
+
+  /* binary mesh */
+  if (string_endswith(src, ".cmesh")) {
+    xml_read_mesh_cache(state, path);
+    return;
+  }
+
   /* open XML document */
   xml_document doc;
   xml_parse_result parse_result;
 
-  string path = path_join(state.base, src);
   parse_result = doc.load_file(path.c_str());
 
   if (parse_result) {
@@ -696,4 +1005,65 @@ void xml_read_file(Scene *scene, const char *filepath)
   scene->params.bvh_type = SceneParams::BVH_STATIC;
 }
 
+/* Conversion */
+
+static bool xml_convert_meshes(xml_node scene_node, const string &base, int &num_meshes)
+{
+  for (xml_node node = scene_node.first_child(); node;) {
+    xml_node next = node.next_sibling();
+
+    if (string_iequals(node.name(), "mesh")) {
+      const string filename = string_printf("%s_%d.cmesh", base.c_str(), num_meshes++);
+
+      if (!xml_write_mesh_cache(node, filename)) {
+        fprintf(stderr, "%s write error\n", filename.c_str());
+        return false;
+      }
+
+      xml_node include = scene_node.insert_child_before("include", node);
+      include.append_attribute("src") = path_filename(filename).c_str();
+      scene_node.remove_child(node);
+    }
+    else if (string_iequals(node.name(), "transform") || string_iequals(node.name(), "state")) {
+      if (!xml_convert_meshes(node, base, num_meshes)) {
+        return false;
+      }
+    }
+
+    node = next;
+  }
+
+  return true;
+}
+
+bool xml_convert_file(const char *filepath, const char *output_filepath)
+{
+  xml_document doc;
+  xml_parse_result parse_result = doc.load_file(filepath);
+
+  if (!parse_result) {
+    fprintf(stderr, "%s read error: %s\n", filepath, parse_result.description());
+    return false;
+  }
+
+  /* Mesh caches are written next to the output file, named after it. */
+  string base = output_filepath;
+  if (string_endswith(base, ".xml")) {
+    base = base.substr(0, base.size() - 4);
+  }
+
+  int num_meshes = 0;
+  if (!xml_convert_meshes(doc.child("cycles"), base, num_meshes)) {
+    return false;
+  }
+
+  if (!doc.save_file(output_filepath)) {
+    fprintf(stderr, "%s write error\n", output_filepath);
+    return false;
+  }
+
+  VLOG(1) << "Converted " << num_meshes << " meshes to binary mesh caches.";
+  return true;
+}
+
 CCL_NAMESPACE_END
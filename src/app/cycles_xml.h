@@ -23,6 +23,9 @@ class Scene;
 
 void xml_read_file(Scene *scene, const char *filepath);
 
+/* Write a copy of the XML file with meshes stored in binary mesh caches. */
+bool xml_convert_file(const char *filepath, const char *output_filepath);
+
 /* macros for importing */
 #define RAD2DEGF(_rad) ((_rad) * (float)(180.0 / M_PI))
 #define DEG2RADF(_deg) ((_deg) * (float)(M_PI / 180.0))
@@ -36,9 +36,15 @@
 #include "util/util_foreach.h"
 #include "util/util_logging.h"
 #include "util/util_progress.h"
+#include "util/util_task.h"
+#include "util/util_time.h"
 
 CCL_NAMESPACE_BEGIN
 
+/* Number of primitives handed to a packing task at a time, smaller BVHs are
+ * packed in a single chunk without the task pool. */
+#define BVH_PACK_PRIMITIVES_CHUNK_SIZE 65536
+
 /* BVH Parameters. */
 
 const char *bvh_layout_name(BVHLayout layout)
@@ -100,7 +106,7 @@ int BVHStackEntry::encodeIdx() const
 /* BVH */
 
 BVH::BVH(const BVHParams &params_, const vector<Mesh *> &meshes_, const vector<Object *> &objects_)
-    : params(params_), meshes(meshes_), objects(objects_)
+    : params(params_), meshes(meshes_), objects(objects_), pack_time(0.0), refit_time(0.0)
 {
 }
 
@@ -174,6 +180,7 @@ void BVH::build(Progress &progress, Stats *)
 
   /* pack triangles */
   progress.set_substatus("Packing BVH triangles and strands");
+  const double pack_start_time = time_dt();
   pack_primitives();
 
   if (progress.get_cancel()) {
@@ -184,6 +191,7 @@ void BVH::build(Progress &progress, Stats *)
   /* pack nodes */
   progress.set_substatus("Packing BVH nodes");
   pack_nodes(root);
+  pack_time = time_dt() - pack_start_time;
 
   /* free build nodes */
   root->deleteSubtree();
@@ -194,6 +202,7 @@ void BVH::build(Progress &progress, Stats *)
 void BVH::refit(Progress &progress)
 {
   progress.set_substatus("Packing BVH primitives");
+  const double refit_start_time = time_dt();
   pack_primitives();
 
   if (progress.get_cancel())
@@ -201,6 +210,7 @@ void BVH::refit(Progress &progress)
 
   progress.set_substatus("Refitting BVH nodes");
   refit_nodes();
+  refit_time = time_dt() - refit_start_time;
 }
 
 void BVH::refit_primitives(int start, int end, BoundBox &bbox, uint &visibility)
@@ -293,15 +303,33 @@ void BVH::pack_triangle(int idx, float4 tri_verts[3])
 void BVH::pack_primitives()
 {
   const size_t tidx_size = pack.prim_index.size();
-  size_t num_prim_triangles = 0;
-  /* Count number of triangles primitives in BVH. */
-  for (unsigned int i = 0; i < tidx_size; i++) {
-    if ((pack.prim_index[i] != -1)) {
-      if ((pack.prim_type[i] & PRIMITIVE_ALL_TRIANGLE) != 0) {
-        ++num_prim_triangles;
-      }
+  const size_t num_chunks = divide_up(tidx_size, BVH_PACK_PRIMITIVES_CHUNK_SIZE);
+  const bool use_pool = (num_chunks > 1);
+
+  /* Count number of triangles primitives in BVH, per chunk. */
+  vector<size_t> chunk_triangles(num_chunks, 0);
+  TaskPool pool;
+  for (size_t chunk = 0; chunk < num_chunks; chunk++) {
+    const size_t start = chunk * BVH_PACK_PRIMITIVES_CHUNK_SIZE;
+    const size_t end = min(start + BVH_PACK_PRIMITIVES_CHUNK_SIZE, tidx_size);
+    if (use_pool) {
+      pool.push(
+          function_bind(&BVH::pack_primitives_count, this, start, end, &chunk_triangles[chunk]));
+    }
+    else {
+      pack_primitives_count(start, end, &chunk_triangles[chunk]);
     }
   }
+  pool.wait_work();
+
+  /* Turn counts into the offset of the first triangle of each chunk. */
+  size_t num_prim_triangles = 0;
+  for (size_t chunk = 0; chunk < num_chunks; chunk++) {
+    const size_t num_triangles = chunk_triangles[chunk];
+    chunk_triangles[chunk] = num_prim_triangles;
+    num_prim_triangles += num_triangles;
+  }
+
   /* Reserve size for arrays. */
   pack.prim_tri_index.clear();
   pack.prim_tri_index.resize(tidx_size);
@@ -309,9 +337,39 @@ void BVH::pack_primitives()
   pack.prim_tri_verts.resize(num_prim_triangles * 3);
   pack.prim_visibility.clear();
   pack.prim_visibility.resize(tidx_size);
+
   /* Fill in all the arrays. */
-  size_t prim_triangle_index = 0;
-  for (unsigned int i = 0; i < tidx_size; i++) {
+  for (size_t chunk = 0; chunk < num_chunks; chunk++) {
+    const size_t start = chunk * BVH_PACK_PRIMITIVES_CHUNK_SIZE;
+    const size_t end = min(start + BVH_PACK_PRIMITIVES_CHUNK_SIZE, tidx_size);
+    if (use_pool) {
+      pool.push(
+          function_bind(&BVH::pack_primitives_range, this, start, end, chunk_triangles[chunk]));
+    }
+    else {
+      pack_primitives_range(start, end, chunk_triangles[chunk]);
+    }
+  }
+  pool.wait_work();
+}
+
+void BVH::pack_primitives_count(size_t start, size_t end, size_t *num_triangles)
+{
+  size_t num_prim_triangles = 0;
+  for (size_t i = start; i < end; i++) {
+    if ((pack.prim_index[i] != -1)) {
+      if ((pack.prim_type[i] & PRIMITIVE_ALL_TRIANGLE) != 0) {
+        ++num_prim_triangles;
+      }
+    }
+  }
+  *num_triangles = num_prim_triangles;
+}
+
+void BVH::pack_primitives_range(size_t start, size_t end, size_t triangle_index)
+{
+  size_t prim_triangle_index = triangle_index;
+  for (size_t i = start; i < end; i++) {
     if (pack.prim_index[i] != -1) {
       int tob = pack.prim_object[i];
       Object *ob = objects[tob];
@@ -343,8 +401,6 @@ void BVH::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
    * BVH's are stored in global arrays. This function merges them into the
    * top level BVH, adjusting indexes and offsets where appropriate.
    */
-  const bool use_qbvh = (params.bvh_layout == BVH_LAYOUT_BVH4);
-  const bool use_obvh = (params.bvh_layout == BVH_LAYOUT_BVH8);
 
   /* Adjust primitive index to point to the triangle in the global array, for
    * meshes with transform applied and already in the top level BVH.
@@ -359,8 +415,10 @@ void BVH::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
 
   /* track offsets of instanced BVH data in global array */
   size_t prim_offset = pack.prim_index.size();
+  size_t prim_tri_verts_offset = pack.prim_tri_verts.size();
   size_t nodes_offset = nodes_size;
   size_t nodes_leaf_offset = leaf_nodes_size;
+  size_t object_offset = 0;
 
   /* clear array that gives the node indexes for instanced objects */
   pack.object_node.clear();
@@ -369,12 +427,6 @@ void BVH::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
   size_t prim_index_size = pack.prim_index.size();
   size_t prim_tri_verts_size = pack.prim_tri_verts.size();
 
-  size_t pack_prim_index_offset = prim_index_size;
-  size_t pack_prim_tri_verts_offset = prim_tri_verts_size;
-  size_t pack_nodes_offset = nodes_size;
-  size_t pack_leaf_nodes_offset = leaf_nodes_size;
-  size_t object_offset = 0;
-
   foreach (Mesh *mesh, meshes) {
     BVH *bvh = mesh->bvh;
 
@@ -400,19 +452,13 @@ void BVH::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
     pack.prim_time.resize(prim_index_size);
   }
 
-  int *pack_prim_index = (pack.prim_index.size()) ? &pack.prim_index[0] : NULL;
-  int *pack_prim_type = (pack.prim_type.size()) ? &pack.prim_type[0] : NULL;
-  int *pack_prim_object = (pack.prim_object.size()) ? &pack.prim_object[0] : NULL;
-  uint *pack_prim_visibility = (pack.prim_visibility.size()) ? &pack.prim_visibility[0] : NULL;
-  float4 *pack_prim_tri_verts = (pack.prim_tri_verts.size()) ? &pack.prim_tri_verts[0] : NULL;
-  uint *pack_prim_tri_index = (pack.prim_tri_index.size()) ? &pack.prim_tri_index[0] : NULL;
-  int4 *pack_nodes = (pack.nodes.size()) ? &pack.nodes[0] : NULL;
-  int4 *pack_leaf_nodes = (pack.leaf_nodes.size()) ? &pack.leaf_nodes[0] : NULL;
-  float2 *pack_prim_time = (pack.prim_time.size()) ? &pack.prim_time[0] : NULL;
-
   map<Mesh *, int> mesh_map;
 
-  /* merge */
+  /* Assign offsets in the global arrays to every mesh first, so that meshes
+   * can be merged in parallel. Few instanced primitives are merged directly. */
+  const bool use_pool = (prim_index_size - prim_offset >= BVH_PACK_PRIMITIVES_CHUNK_SIZE);
+  TaskPool pool;
+
   foreach (Object *ob, objects) {
     Mesh *mesh = ob->mesh;
 
@@ -438,8 +484,6 @@ void BVH::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
 
     int noffset = nodes_offset;
     int noffset_leaf = nodes_leaf_offset;
-    int mesh_tri_offset = mesh->tri_offset;
-    int mesh_curve_offset = mesh->curve_offset;
 
     /* fill in node indexes for instances */
     if (bvh->pack.root_index == -1)
@@ -449,132 +493,178 @@ void BVH::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
 
     mesh_map[mesh] = pack.object_node[object_offset - 1];
 
-    /* merge primitive, object and triangle indexes */
-    if (bvh->pack.prim_index.size()) {
-      size_t bvh_prim_index_size = bvh->pack.prim_index.size();
-      int *bvh_prim_index = &bvh->pack.prim_index[0];
-      int *bvh_prim_type = &bvh->pack.prim_type[0];
-      uint *bvh_prim_visibility = &bvh->pack.prim_visibility[0];
-      uint *bvh_prim_tri_index = &bvh->pack.prim_tri_index[0];
-      float2 *bvh_prim_time = bvh->pack.prim_time.size() ? &bvh->pack.prim_time[0] : NULL;
-
-      for (size_t i = 0; i < bvh_prim_index_size; i++) {
-        if (bvh->pack.prim_type[i] & PRIMITIVE_ALL_CURVE) {
-          pack_prim_index[pack_prim_index_offset] = bvh_prim_index[i] + mesh_curve_offset;
-          pack_prim_tri_index[pack_prim_index_offset] = -1;
-        }
-        else {
-          pack_prim_index[pack_prim_index_offset] = bvh_prim_index[i] + mesh_tri_offset;
-          pack_prim_tri_index[pack_prim_index_offset] = bvh_prim_tri_index[i] +
-                                                        pack_prim_tri_verts_offset;
-        }
+    if (use_pool) {
+      pool.push(function_bind(&BVH::pack_instance,
+                              this,
+                              mesh,
+                              prim_offset,
+                              prim_tri_verts_offset,
+                              nodes_offset,
+                              nodes_leaf_offset));
+    }
+    else {
+      pack_instance(mesh, prim_offset, prim_tri_verts_offset, nodes_offset, nodes_leaf_offset);
+    }
 
-        pack_prim_type[pack_prim_index_offset] = bvh_prim_type[i];
-        pack_prim_visibility[pack_prim_index_offset] = bvh_prim_visibility[i];
-        pack_prim_object[pack_prim_index_offset] = 0;  // unused for instances
-        if (bvh_prim_time != NULL) {
-          pack_prim_time[pack_prim_index_offset] = bvh_prim_time[i];
-        }
-        pack_prim_index_offset++;
+    nodes_offset += bvh->pack.nodes.size();
+    nodes_leaf_offset += bvh->pack.leaf_nodes.size();
+    prim_offset += bvh->pack.prim_index.size();
+    prim_tri_verts_offset += bvh->pack.prim_tri_verts.size();
+  }
+
+  pool.wait_work();
+}
+
+void BVH::pack_instance(const Mesh *mesh,
+                        size_t prim_offset,
+                        size_t prim_tri_verts_offset,
+                        size_t nodes_offset,
+                        size_t leaf_nodes_offset)
+{
+  const bool use_qbvh = (params.bvh_layout == BVH_LAYOUT_BVH4);
+  const bool use_obvh = (params.bvh_layout == BVH_LAYOUT_BVH8);
+
+  const BVH *bvh = mesh->bvh;
+
+  int noffset = nodes_offset;
+  int noffset_leaf = leaf_nodes_offset;
+  int mesh_tri_offset = mesh->tri_offset;
+  int mesh_curve_offset = mesh->curve_offset;
+
+  size_t pack_prim_index_offset = prim_offset;
+  size_t pack_nodes_offset = nodes_offset;
+  size_t pack_leaf_nodes_offset = leaf_nodes_offset;
+
+  int *pack_prim_index = (pack.prim_index.size()) ? &pack.prim_index[0] : NULL;
+  int *pack_prim_type = (pack.prim_type.size()) ? &pack.prim_type[0] : NULL;
+  int *pack_prim_object = (pack.prim_object.size()) ? &pack.prim_object[0] : NULL;
+  uint *pack_prim_visibility = (pack.prim_visibility.size()) ? &pack.prim_visibility[0] : NULL;
+  float4 *pack_prim_tri_verts = (pack.prim_tri_verts.size()) ? &pack.prim_tri_verts[0] : NULL;
+  uint *pack_prim_tri_index = (pack.prim_tri_index.size()) ? &pack.prim_tri_index[0] : NULL;
+  int4 *pack_nodes = (pack.nodes.size()) ? &pack.nodes[0] : NULL;
+  int4 *pack_leaf_nodes = (pack.leaf_nodes.size()) ? &pack.leaf_nodes[0] : NULL;
+  float2 *pack_prim_time = (pack.prim_time.size()) ? &pack.prim_time[0] : NULL;
+
+  /* merge primitive, object and triangle indexes */
+  if (bvh->pack.prim_index.size()) {
+    size_t bvh_prim_index_size = bvh->pack.prim_index.size();
+    const int *bvh_prim_index = &bvh->pack.prim_index[0];
+    const int *bvh_prim_type = &bvh->pack.prim_type[0];
+    const uint *bvh_prim_visibility = &bvh->pack.prim_visibility[0];
+    const uint *bvh_prim_tri_index = &bvh->pack.prim_tri_index[0];
+    const float2 *bvh_prim_time = bvh->pack.prim_time.size() ? &bvh->pack.prim_time[0] : NULL;
+
+    for (size_t i = 0; i < bvh_prim_index_size; i++) {
+      if (bvh->pack.prim_type[i] & PRIMITIVE_ALL_CURVE) {
+        pack_prim_index[pack_prim_index_offset] = bvh_prim_index[i] + mesh_curve_offset;
+        pack_prim_tri_index[pack_prim_index_offset] = -1;
+      }
+      else {
+        pack_prim_index[pack_prim_index_offset] = bvh_prim_index[i] + mesh_tri_offset;
+        pack_prim_tri_index[pack_prim_index_offset] = bvh_prim_tri_index[i] +
+                                                      prim_tri_verts_offset;
       }
-    }
 
-    /* Merge triangle vertices data. */
-    if (bvh->pack.prim_tri_verts.size()) {
-      const size_t prim_tri_size = bvh->pack.prim_tri_verts.size();
-      memcpy(pack_prim_tri_verts + pack_prim_tri_verts_offset,
-             &bvh->pack.prim_tri_verts[0],
-             prim_tri_size * sizeof(float4));
-      pack_prim_tri_verts_offset += prim_tri_size;
+      pack_prim_type[pack_prim_index_offset] = bvh_prim_type[i];
+      pack_prim_visibility[pack_prim_index_offset] = bvh_prim_visibility[i];
+      pack_prim_object[pack_prim_index_offset] = 0;  // unused for instances
+      if (bvh_prim_time != NULL) {
+        pack_prim_time[pack_prim_index_offset] = bvh_prim_time[i];
+      }
+      pack_prim_index_offset++;
     }
+  }
 
-    /* merge nodes */
-    if (bvh->pack.leaf_nodes.size()) {
-      int4 *leaf_nodes_offset = &bvh->pack.leaf_nodes[0];
-      size_t leaf_nodes_offset_size = bvh->pack.leaf_nodes.size();
-      for (size_t i = 0, j = 0; i < leaf_nodes_offset_size; i += BVH_NODE_LEAF_SIZE, j++) {
-        int4 data = leaf_nodes_offset[i];
-        data.x += prim_offset;
-        data.y += prim_offset;
-        pack_leaf_nodes[pack_leaf_nodes_offset] = data;
-        for (int j = 1; j < BVH_NODE_LEAF_SIZE; ++j) {
-          pack_leaf_nodes[pack_leaf_nodes_offset + j] = leaf_nodes_offset[i + j];
-        }
-        pack_leaf_nodes_offset += BVH_NODE_LEAF_SIZE;
+  /* Merge triangle vertices data. */
+  if (bvh->pack.prim_tri_verts.size()) {
+    const size_t prim_tri_size = bvh->pack.prim_tri_verts.size();
+    memcpy(pack_prim_tri_verts + prim_tri_verts_offset,
+           &bvh->pack.prim_tri_verts[0],
+           prim_tri_size * sizeof(float4));
+  }
+
+  /* merge nodes */
+  if (bvh->pack.leaf_nodes.size()) {
+    const int4 *leaf_nodes_offset = &bvh->pack.leaf_nodes[0];
+    size_t leaf_nodes_offset_size = bvh->pack.leaf_nodes.size();
+    for (size_t i = 0; i < leaf_nodes_offset_size; i += BVH_NODE_LEAF_SIZE) {
+      int4 data = leaf_nodes_offset[i];
+      data.x += prim_offset;
+      data.y += prim_offset;
+      pack_leaf_nodes[pack_leaf_nodes_offset] = data;
+      for (int j = 1; j < BVH_NODE_LEAF_SIZE; ++j) {
+        pack_leaf_nodes[pack_leaf_nodes_offset + j] = leaf_nodes_offset[i + j];
       }
+      pack_leaf_nodes_offset += BVH_NODE_LEAF_SIZE;
     }
+  }
 
-    if (bvh->pack.nodes.size()) {
-      int4 *bvh_nodes = &bvh->pack.nodes[0];
-      size_t bvh_nodes_size = bvh->pack.nodes.size();
+  if (bvh->pack.nodes.size()) {
+    const int4 *bvh_nodes = &bvh->pack.nodes[0];
+    size_t bvh_nodes_size = bvh->pack.nodes.size();
 
-      for (size_t i = 0, j = 0; i < bvh_nodes_size; j++) {
-        size_t nsize, nsize_bbox;
-        if (bvh_nodes[i].x & PATH_RAY_NODE_UNALIGNED) {
-          if (use_obvh) {
-            nsize = BVH_UNALIGNED_ONODE_SIZE;
-            nsize_bbox = BVH_UNALIGNED_ONODE_SIZE - 1;
-          }
-          else {
-            nsize = use_qbvh ? BVH_UNALIGNED_QNODE_SIZE : BVH_UNALIGNED_NODE_SIZE;
-            nsize_bbox = (use_qbvh) ? BVH_UNALIGNED_QNODE_SIZE - 1 : 0;
-          }
+    for (size_t i = 0; i < bvh_nodes_size;) {
+      size_t nsize, nsize_bbox;
+      if (bvh_nodes[i].x & PATH_RAY_NODE_UNALIGNED) {
+        if (use_obvh) {
+          nsize = BVH_UNALIGNED_ONODE_SIZE;
+          nsize_bbox = BVH_UNALIGNED_ONODE_SIZE - 1;
         }
         else {
-          if (use_obvh) {
-            nsize = BVH_ONODE_SIZE;
-            nsize_bbox = BVH_ONODE_SIZE - 1;
-          }
-          else {
-            nsize = (use_qbvh) ? BVH_QNODE_SIZE : BVH_NODE_SIZE;
-            nsize_bbox = (use_qbvh) ? BVH_QNODE_SIZE - 1 : 0;
-          }
+          nsize = use_qbvh ? BVH_UNALIGNED_QNODE_SIZE : BVH_UNALIGNED_NODE_SIZE;
+          nsize_bbox = (use_qbvh) ? BVH_UNALIGNED_QNODE_SIZE - 1 : 0;
         }
-
-        memcpy(pack_nodes + pack_nodes_offset, bvh_nodes + i, nsize_bbox * sizeof(int4));
-
-        /* Modify offsets into arrays */
-        int idx = i + nsize_bbox;
-        int4 data = bvh_nodes[idx];
-        int4 data1 = (idx > 0) ? bvh_nodes[i + nsize_bbox - 1] : data;
+      }
+      else {
         if (use_obvh) {
-          data.z += (data.z < 0) ? -noffset_leaf : noffset;
-          data.w += (data.w < 0) ? -noffset_leaf : noffset;
-          data.x += (data.x < 0) ? -noffset_leaf : noffset;
-          data.y += (data.y < 0) ? -noffset_leaf : noffset;
-          data1.z += (data1.z < 0) ? -noffset_leaf : noffset;
-          data1.w += (data1.w < 0) ? -noffset_leaf : noffset;
-          data1.x += (data1.x < 0) ? -noffset_leaf : noffset;
-          data1.y += (data1.y < 0) ? -noffset_leaf : noffset;
+          nsize = BVH_ONODE_SIZE;
+          nsize_bbox = BVH_ONODE_SIZE - 1;
         }
         else {
-          data.z += (data.z < 0) ? -noffset_leaf : noffset;
-          data.w += (data.w < 0) ? -noffset_leaf : noffset;
-          if (use_qbvh) {
-            data.x += (data.x < 0) ? -noffset_leaf : noffset;
-            data.y += (data.y < 0) ? -noffset_leaf : noffset;
-          }
+          nsize = (use_qbvh) ? BVH_QNODE_SIZE : BVH_NODE_SIZE;
+          nsize_bbox = (use_qbvh) ? BVH_QNODE_SIZE - 1 : 0;
         }
-        pack_nodes[pack_nodes_offset + nsize_bbox] = data;
-        if (use_obvh) {
-          pack_nodes[pack_nodes_offset + nsize_bbox - 1] = data1;
+      }
+
+      memcpy(pack_nodes + pack_nodes_offset, bvh_nodes + i, nsize_bbox * sizeof(int4));
+
+      /* Modify offsets into arrays */
+      int idx = i + nsize_bbox;
+      int4 data = bvh_nodes[idx];
+      int4 data1 = (idx > 0) ? bvh_nodes[i + nsize_bbox - 1] : data;
+      if (use_obvh) {
+        data.z += (data.z < 0) ? -noffset_leaf : noffset;
+        data.w += (data.w < 0) ? -noffset_leaf : noffset;
+        data.x += (data.x < 0) ? -noffset_leaf : noffset;
+        data.y += (data.y < 0) ? -noffset_leaf : noffset;
+        data1.z += (data1.z < 0) ? -noffset_leaf : noffset;
+        data1.w += (data1.w < 0) ? -noffset_leaf : noffset;
+        data1.x += (data1.x < 0) ? -noffset_leaf : noffset;
+        data1.y += (data1.y < 0) ? -noffset_leaf : noffset;
+      }
+      else {
+        data.z += (data.z < 0) ? -noffset_leaf : noffset;
+        data.w += (data.w < 0) ? -noffset_leaf : noffset;
+        if (use_qbvh) {
+          data.x += (data.x < 0) ? -noffset_leaf : noffset;
+          data.y += (data.y < 0) ? -noffset_leaf : noffset;
         }
+      }
+      pack_nodes[pack_nodes_offset + nsize_bbox] = data;
+      if (use_obvh) {
+        pack_nodes[pack_nodes_offset + nsize_bbox - 1] = data1;
+      }
 
-        /* Usually this copies nothing, but we better
-         * be prepared for possible node size extension.
-         */
-        memcpy(&pack_nodes[pack_nodes_offset + nsize_bbox + 1],
-               &bvh_nodes[i + nsize_bbox + 1],
-               sizeof(int4) * (nsize - (nsize_bbox + 1)));
+      /* Usually this copies nothing, but we better
+       * be prepared for possible node size extension.
+       */
+      memcpy(&pack_nodes[pack_nodes_offset + nsize_bbox + 1],
+             &bvh_nodes[i + nsize_bbox + 1],
+             sizeof(int4) * (nsize - (nsize_bbox + 1)));
 
-        pack_nodes_offset += nsize;
-        i += nsize;
-      }
+      pack_nodes_offset += nsize;
+      i += nsize;
     }
-
-    nodes_offset += bvh->pack.nodes.size();
-    nodes_leaf_offset += bvh->pack.leaf_nodes.size();
-    prim_offset += bvh->pack.prim_index.size();
   }
 }
 
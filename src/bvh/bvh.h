@@ -87,6 +87,11 @@ class BVH {
   vector<Mesh *> meshes;
   vector<Object *> objects;
 
+  /* Seconds spent packing primitives and nodes in the last build, and
+   * refitting in the last refit, for the render statistics. */
+  double pack_time;
+  double refit_time;
+
   static BVH *create(const BVHParams &params,
                      const vector<Mesh *> &meshes,
                      const vector<Object *> &objects);
@@ -109,10 +114,17 @@ class BVH {
 
   /* triangles and strands */
   void pack_primitives();
+  void pack_primitives_count(size_t start, size_t end, size_t *num_triangles);
+  void pack_primitives_range(size_t start, size_t end, size_t triangle_index);
   void pack_triangle(int idx, float4 storage[3]);
 
   /* merge instance BVH's */
   void pack_instances(size_t nodes_size, size_t leaf_nodes_size);
+  void pack_instance(const Mesh *mesh,
+                     size_t prim_offset,
+                     size_t prim_tri_verts_offset,
+                     size_t nodes_offset,
+                     size_t leaf_nodes_offset);
 
   /* for subclasses to implement */
   virtual void pack_nodes(const BVHNode *root) = 0;
@@ -23,8 +23,17 @@
 #include "bvh/bvh_node.h"
 #include "bvh/bvh_unaligned.h"
 
+#include "util/util_task.h"
+
 CCL_NAMESPACE_BEGIN
 
+/* Number of nodes handed to a packing task at a time. */
+#define BVH2_PACK_BATCH_SIZE 4096
+/* Subtrees below this depth are refit in parallel, for trees with at least
+ * the given number of nodes. */
+#define BVH2_REFIT_PARALLEL_DEPTH 6
+#define BVH2_REFIT_PARALLEL_MIN_NODES 4096
+
 BVH2::BVH2(const BVHParams &params_,
            const vector<Mesh *> &meshes_,
            const vector<Object *> &objects_)
@@ -191,6 +200,14 @@ void BVH2::pack_nodes(const BVHNode *root)
 
   int nextNodeIdx = 0, nextLeafNodeIdx = 0;
 
+  /* The traversal below only assigns the output index of every node, nodes
+   * are packed in parallel in batches. A batch holds a leaf as a single
+   * entry and an inner node as its entry followed by the entries of its two
+   * children. */
+  TaskPool pool;
+  vector<BVHStackEntry> batch;
+  batch.reserve(BVH2_PACK_BATCH_SIZE * 3);
+
   vector<BVHStackEntry> stack;
   stack.reserve(BVHParams::MAX_DEPTH * 2);
   if (root->is_leaf()) {
@@ -207,8 +224,7 @@ void BVH2::pack_nodes(const BVHNode *root)
 
     if (e.node->is_leaf()) {
       /* leaf node */
-      const LeafNode *leaf = reinterpret_cast<const LeafNode *>(e.node);
-      pack_leaf(e, leaf);
+      batch.push_back(e);
     }
     else {
       /* inner node */
@@ -227,21 +243,184 @@ void BVH2::pack_nodes(const BVHNode *root)
       stack.push_back(BVHStackEntry(e.node->get_child(0), idx[0]));
       stack.push_back(BVHStackEntry(e.node->get_child(1), idx[1]));
 
-      pack_inner(e, stack[stack.size() - 2], stack[stack.size() - 1]);
+      batch.push_back(e);
+      batch.push_back(stack[stack.size() - 2]);
+      batch.push_back(stack[stack.size() - 1]);
+    }
+
+    if (batch.size() >= BVH2_PACK_BATCH_SIZE * 3) {
+      pool.push(function_bind(&BVH2::pack_node_batch, this, batch));
+      batch.clear();
     }
   }
+  /* Last batch is packed here, so small trees do not use the task pool. */
+  pack_node_batch(batch);
+  pool.wait_work();
   assert(node_size == nextNodeIdx);
   /* root index to start traversal at, to handle case of single leaf node */
   pack.root_index = (root->is_leaf()) ? -1 : 0;
 }
 
+void BVH2::pack_node_batch(const vector<BVHStackEntry> &entries)
+{
+  for (size_t i = 0; i < entries.size();) {
+    const BVHStackEntry &e = entries[i];
+    if (e.node->is_leaf()) {
+      pack_leaf(e, reinterpret_cast<const LeafNode *>(e.node));
+      i += 1;
+    }
+    else {
+      pack_inner(e, entries[i + 1], entries[i + 2]);
+      i += 3;
+    }
+  }
+}
+
 void BVH2::refit_nodes()
 {
   assert(!params.top_level);
 
+  const bool root_leaf = (pack.root_index == -1);
+
+  if (pack.nodes.size() < BVH2_REFIT_PARALLEL_MIN_NODES * BVH_NODE_SIZE) {
+    BoundBox bbox = BoundBox::empty;
+    uint visibility = 0;
+    refit_node(0, root_leaf, bbox, visibility);
+    return;
+  }
+
+  /* Find the subtrees below the top levels of the tree, in the same order the
+   * top levels are traversed in refit_top_node(). */
+  vector<int> subtree_nodes;
+  vector<bool> subtree_leaf;
+  vector<int> stack_idx;
+  vector<int> stack_depth;
+  vector<bool> stack_leaf;
+  stack_idx.push_back(0);
+  stack_depth.push_back(0);
+  stack_leaf.push_back(root_leaf);
+
+  while (stack_idx.size()) {
+    const int idx = stack_idx.back();
+    const int depth = stack_depth.back();
+    const bool leaf = stack_leaf.back();
+    stack_idx.pop_back();
+    stack_depth.pop_back();
+    stack_leaf.pop_back();
+
+    if (leaf || depth == BVH2_REFIT_PARALLEL_DEPTH) {
+      subtree_nodes.push_back(idx);
+      subtree_leaf.push_back(leaf);
+      continue;
+    }
+
+    /* Push second child first, so the first child is visited first. */
+    const int4 *data = &pack.nodes[idx];
+    const int c0 = data[0].z;
+    const int c1 = data[0].w;
+    stack_idx.push_back((c1 < 0) ? -c1 - 1 : c1);
+    stack_depth.push_back(depth + 1);
+    stack_leaf.push_back(c1 < 0);
+    stack_idx.push_back((c0 < 0) ? -c0 - 1 : c0);
+    stack_depth.push_back(depth + 1);
+    stack_leaf.push_back(c0 < 0);
+  }
+
+  /* Refit subtrees in parallel. */
+  const size_t num_subtrees = subtree_nodes.size();
+  vector<BoundBox> subtree_bbox(num_subtrees, BoundBox::empty);
+  vector<uint> subtree_visibility(num_subtrees, 0);
+
+  TaskPool pool;
+  for (size_t i = 0; i < num_subtrees; i++) {
+    pool.push(function_bind(&BVH2::refit_subtree,
+                            this,
+                            subtree_nodes[i],
+                            subtree_leaf[i],
+                            &subtree_bbox[i],
+                            &subtree_visibility[i]));
+  }
+  pool.wait_work();
+
+  /* Refit top levels from the subtree bounds. */
   BoundBox bbox = BoundBox::empty;
   uint visibility = 0;
-  refit_node(0, (pack.root_index == -1) ? true : false, bbox, visibility);
+  int subtree_index = 0;
+  refit_top_node(
+      0, root_leaf, 0, subtree_bbox, subtree_visibility, &subtree_index, bbox, visibility);
+}
+
+void BVH2::refit_subtree(int idx, bool leaf, BoundBox *bbox, uint *visibility)
+{
+  refit_node(idx, leaf, *bbox, *visibility);
+}
+
+void BVH2::refit_top_node(int idx,
+                          bool leaf,
+                          int depth,
+                          const vector<BoundBox> &subtree_bbox,
+                          const vector<uint> &subtree_visibility,
+                          int *subtree_index,
+                          BoundBox &bbox,
+                          uint &visibility)
+{
+  if (leaf || depth == BVH2_REFIT_PARALLEL_DEPTH) {
+    bbox = subtree_bbox[*subtree_index];
+    visibility = subtree_visibility[*subtree_index];
+    (*subtree_index)++;
+    return;
+  }
+
+  const int4 *data = &pack.nodes[idx];
+  const int c0 = data[0].z;
+  const int c1 = data[0].w;
+
+  BoundBox bbox0 = BoundBox::empty, bbox1 = BoundBox::empty;
+  uint visibility0 = 0, visibility1 = 0;
+
+  refit_top_node((c0 < 0) ? -c0 - 1 : c0,
+                 (c0 < 0),
+                 depth + 1,
+                 subtree_bbox,
+                 subtree_visibility,
+                 subtree_index,
+                 bbox0,
+                 visibility0);
+  refit_top_node((c1 < 0) ? -c1 - 1 : c1,
+                 (c1 < 0),
+                 depth + 1,
+                 subtree_bbox,
+                 subtree_visibility,
+                 subtree_index,
+                 bbox1,
+                 visibility1);
+
+  refit_inner(idx, bbox0, bbox1, visibility0, visibility1);
+
+  bbox.grow(bbox0);
+  bbox.grow(bbox1);
+  visibility = visibility0 | visibility1;
+}
+
+void BVH2::refit_inner(int idx,
+                       const BoundBox &bbox0,
+                       const BoundBox &bbox1,
+                       uint visibility0,
+                       uint visibility1)
+{
+  const int4 *data = &pack.nodes[idx];
+  const bool is_unaligned = (data[0].x & PATH_RAY_NODE_UNALIGNED) != 0;
+  const int c0 = data[0].z;
+  const int c1 = data[0].w;
+
+  if (is_unaligned) {
+    Transform aligned_space = transform_identity();
+    pack_unaligned_node(
+        idx, aligned_space, aligned_space, bbox0, bbox1, c0, c1, visibility0, visibility1);
+  }
+  else {
+    pack_aligned_node(idx, bbox0, bbox1, c0, c1, visibility0, visibility1);
+  }
 }
 
 void BVH2::refit_node(int idx, bool leaf, BoundBox &bbox, uint &visibility)
@@ -267,7 +446,6 @@ void BVH2::refit_node(int idx, bool leaf, BoundBox &bbox, uint &visibility)
     assert(idx + BVH_NODE_SIZE <= pack.nodes.size());
 
     const int4 *data = &pack.nodes[idx];
-    const bool is_unaligned = (data[0].x & PATH_RAY_NODE_UNALIGNED) != 0;
     const int c0 = data[0].z;
     const int c1 = data[0].w;
     /* refit inner node, set bbox from children */
@@ -277,14 +455,7 @@ void BVH2::refit_node(int idx, bool leaf, BoundBox &bbox, uint &visibility)
     refit_node((c0 < 0) ? -c0 - 1 : c0, (c0 < 0), bbox0, visibility0);
     refit_node((c1 < 0) ? -c1 - 1 : c1, (c1 < 0), bbox1, visibility1);
 
-    if (is_unaligned) {
-      Transform aligned_space = transform_identity();
-      pack_unaligned_node(
-          idx, aligned_space, aligned_space, bbox0, bbox1, c0, c1, visibility0, visibility1);
-    }
-    else {
-      pack_aligned_node(idx, bbox0, bbox1, c0, c1, visibility0, visibility1);
-    }
+    refit_inner(idx, bbox0, bbox1, visibility0, visibility1);
 
     bbox.grow(bbox0);
     bbox.grow(bbox1);
@@ -53,6 +53,7 @@ class BVH2 : public BVH {
 
   /* pack */
   void pack_nodes(const BVHNode *root) override;
+  void pack_node_batch(const vector<BVHStackEntry> &entries);
 
   void pack_leaf(const BVHStackEntry &e, const LeafNode *leaf);
   void pack_inner(const BVHStackEntry &e, const BVHStackEntry &e0, const BVHStackEntry &e1);
@@ -84,6 +85,20 @@ class BVH2 : public BVH {
   /* refit */
   void refit_nodes() override;
   void refit_node(int idx, bool leaf, BoundBox &bbox, uint &visibility);
+  void refit_subtree(int idx, bool leaf, BoundBox *bbox, uint *visibility);
+  void refit_top_node(int idx,
+                      bool leaf,
+                      int depth,
+                      const vector<BoundBox> &subtree_bbox,
+                      const vector<uint> &subtree_visibility,
+                      int *subtree_index,
+                      BoundBox &bbox,
+                      uint &visibility);
+  void refit_inner(int idx,
+                   const BoundBox &bbox0,
+                   const BoundBox &bbox1,
+                   uint visibility0,
+                   uint visibility1);
 };
 
 CCL_NAMESPACE_END
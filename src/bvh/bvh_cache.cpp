@@ -0,0 +1,293 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <random>
+#include <stdio.h>
+
+#include "bvh/bvh_cache.h"
+
+#include "bvh/bvh.h"
+
+#include "render/mesh.h"
+
+#include "util/util_logging.h"
+#include "util/util_md5.h"
+#include "util/util_path.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Increase when the packed layout or the builder output changes. */
+#define BVH_CACHE_VERSION 1
+
+struct BVHCacheHeader {
+  char magic[8];
+  int version;
+  int bvh_layout;
+  int root_index;
+};
+
+static void bvh_cache_hash_append(MD5Hash &md5, const void *data, size_t size)
+{
+  const uint8_t *bytes = (const uint8_t *)data;
+  while (size > 0) {
+    const int chunk = (size > (1 << 30)) ? (1 << 30) : (int)size;
+    md5.append(bytes, chunk);
+    bytes += chunk;
+    size -= chunk;
+  }
+}
+
+template<typename T> static void bvh_cache_hash_append(MD5Hash &md5, const T &value)
+{
+  bvh_cache_hash_append(md5, &value, sizeof(value));
+}
+
+template<typename T> static void bvh_cache_hash_append(MD5Hash &md5, const array<T> &data)
+{
+  bvh_cache_hash_append(md5, data.size());
+  if (data.size()) {
+    bvh_cache_hash_append(md5, data.data(), sizeof(T) * data.size());
+  }
+}
+
+static void bvh_cache_hash_attribute(MD5Hash &md5, const Attribute *attr)
+{
+  if (attr) {
+    bvh_cache_hash_append(md5, attr->buffer.size());
+    bvh_cache_hash_append(md5, attr->buffer.data(), attr->buffer.size());
+  }
+  else {
+    bvh_cache_hash_append(md5, (size_t)0);
+  }
+}
+
+bool bvh_cache_supported(const BVHParams &params)
+{
+  /* Embree and OptiX build their own acceleration structures. */
+  return params.bvh_layout == BVH_LAYOUT_BVH2 || params.bvh_layout == BVH_LAYOUT_BVH4 ||
+         params.bvh_layout == BVH_LAYOUT_BVH8;
+}
+
+string bvh_cache_filepath(const string &dirpath, const BVHParams &params, const Mesh *mesh)
+{
+  MD5Hash md5;
+
+  /* Parameters. */
+  bvh_cache_hash_append(md5, (int)BVH_CACHE_VERSION);
+  bvh_cache_hash_append(md5, params.use_spatial_split);
+  bvh_cache_hash_append(md5, params.spatial_split_alpha);
+  bvh_cache_hash_append(md5, params.unaligned_split_threshold);
+  bvh_cache_hash_append(md5, params.sah_node_cost);
+  bvh_cache_hash_append(md5, params.sah_primitive_cost);
+  bvh_cache_hash_append(md5, params.min_leaf_size);
+  bvh_cache_hash_append(md5, params.max_triangle_leaf_size);
+  bvh_cache_hash_append(md5, params.max_motion_triangle_leaf_size);
+  bvh_cache_hash_append(md5, params.max_curve_leaf_size);
+  bvh_cache_hash_append(md5, params.max_motion_curve_leaf_size);
+  bvh_cache_hash_append(md5, params.top_level);
+  bvh_cache_hash_append(md5, (int)params.bvh_layout);
+  bvh_cache_hash_append(md5, params.primitive_mask);
+  bvh_cache_hash_append(md5, params.use_unaligned_nodes);
+  bvh_cache_hash_append(md5, params.num_motion_curve_steps);
+  bvh_cache_hash_append(md5, params.num_motion_triangle_steps);
+  bvh_cache_hash_append(md5, params.bvh_type);
+  bvh_cache_hash_append(md5, params.curve_flags);
+  bvh_cache_hash_append(md5, params.curve_subdivisions);
+
+  /* Geometry. */
+  bvh_cache_hash_append(md5, mesh->verts);
+  bvh_cache_hash_append(md5, mesh->triangles);
+  bvh_cache_hash_append(md5, mesh->curve_keys);
+  bvh_cache_hash_append(md5, mesh->curve_radius);
+  bvh_cache_hash_append(md5, mesh->curve_first_key);
+  bvh_cache_hash_append(md5, mesh->motion_steps);
+  bvh_cache_hash_append(md5, mesh->use_motion_blur);
+  bvh_cache_hash_attribute(md5, mesh->attributes.find(ATTR_STD_MOTION_VERTEX_POSITION));
+  bvh_cache_hash_attribute(md5, mesh->curve_attributes.find(ATTR_STD_MOTION_VERTEX_POSITION));
+
+  return path_join(dirpath, md5.get_hex() + ".bvh");
+}
+
+/* Read an array, its size must fit in the remaining bytes of the file. */
+template<typename T>
+static bool bvh_cache_read_array(FILE *f, size_t &remaining, array<T> &data)
+{
+  uint64_t size;
+  if (remaining < sizeof(size) || fread(&size, sizeof(size), 1, f) != 1) {
+    return false;
+  }
+  remaining -= sizeof(size);
+
+  if (size > remaining / sizeof(T)) {
+    return false;
+  }
+  remaining -= size * sizeof(T);
+
+  data.resize(size);
+  return size == 0 || fread(data.data(), sizeof(T), size, f) == size;
+}
+
+template<typename T> static bool bvh_cache_write_array(FILE *f, const array<T> &data)
+{
+  const uint64_t size = data.size();
+  if (fwrite(&size, sizeof(size), 1, f) != 1) {
+    return false;
+  }
+  return size == 0 || fwrite(data.data(), sizeof(T), size, f) == size;
+}
+
+/* Check that the packed BVH is consistent and refers to primitives of the
+ * mesh, so a damaged file or one written for other geometry is not used. */
+static bool bvh_cache_validate(const PackedBVH &pack, const Mesh *mesh)
+{
+  const size_t num_prims = pack.prim_index.size();
+
+  if (pack.prim_type.size() != num_prims || pack.prim_visibility.size() != num_prims ||
+      pack.prim_object.size() != num_prims || pack.prim_tri_index.size() != num_prims ||
+      (pack.prim_time.size() != 0 && pack.prim_time.size() != num_prims)) {
+    return false;
+  }
+
+  if (pack.root_index == -1) {
+    if (num_prims != 0 && pack.leaf_nodes.size() == 0) {
+      return false;
+    }
+  }
+  else if (pack.root_index != 0 || pack.nodes.size() == 0) {
+    return false;
+  }
+
+  const size_t num_triangles = mesh->num_triangles();
+  const size_t num_curves = mesh->num_curves();
+
+  for (size_t i = 0; i < num_prims; i++) {
+    const int type = pack.prim_type[i];
+    const int prim = pack.prim_index[i];
+
+    if (type & PRIMITIVE_ALL_TRIANGLE) {
+      if (prim < 0 || (size_t)prim >= num_triangles ||
+          (size_t)pack.prim_tri_index[i] + 3 > pack.prim_tri_verts.size()) {
+        return false;
+      }
+    }
+    else if (type & PRIMITIVE_ALL_CURVE) {
+      if (prim < 0 || (size_t)prim >= num_curves ||
+          PRIMITIVE_UNPACK_SEGMENT(type) >= mesh->get_curve(prim).num_segments()) {
+        return false;
+      }
+    }
+    else {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool bvh_cache_read(const string &filepath,
+                    const BVHParams &params,
+                    const Mesh *mesh,
+                    PackedBVH &pack)
+{
+  FILE *f = path_fopen(filepath, "rb");
+  if (!f) {
+    return false;
+  }
+
+  size_t remaining = path_file_size(filepath);
+
+  BVHCacheHeader header;
+  bool ok = remaining >= sizeof(header) && fread(&header, sizeof(header), 1, f) == 1 &&
+            strncmp(header.magic, "CYCBVH", 8) == 0 && header.version == BVH_CACHE_VERSION &&
+            header.bvh_layout == params.bvh_layout;
+  if (ok) {
+    remaining -= sizeof(header);
+  }
+
+  ok = ok && bvh_cache_read_array(f, remaining, pack.nodes) &&
+       bvh_cache_read_array(f, remaining, pack.leaf_nodes) &&
+       bvh_cache_read_array(f, remaining, pack.object_node) &&
+       bvh_cache_read_array(f, remaining, pack.prim_tri_index) &&
+       bvh_cache_read_array(f, remaining, pack.prim_tri_verts) &&
+       bvh_cache_read_array(f, remaining, pack.prim_type) &&
+       bvh_cache_read_array(f, remaining, pack.prim_visibility) &&
+       bvh_cache_read_array(f, remaining, pack.prim_index) &&
+       bvh_cache_read_array(f, remaining, pack.prim_object) &&
+       bvh_cache_read_array(f, remaining, pack.prim_time) && remaining == 0;
+
+  fclose(f);
+
+  if (ok) {
+    pack.root_index = header.root_index;
+    ok = bvh_cache_validate(pack, mesh);
+  }
+
+  if (!ok) {
+    VLOG(1) << "Failed to read BVH cache file " << filepath;
+    pack = PackedBVH();
+    return false;
+  }
+
+  return true;
+}
+
+bool bvh_cache_write(const string &filepath, const BVHParams &params, const PackedBVH &pack)
+{
+  /* Write to a temporary file first, so that meshes with the same content
+   * built at the same time, by another process or on another host sharing the
+   * cache directory never read a partial file. The name must be unique across
+   * all of them. */
+  std::random_device random;
+  const string tmp_filepath = string_printf(
+      "%s.%08x%08x.tmp", filepath.c_str(), (uint)random(), (uint)random());
+
+  path_create_directories(filepath);
+  FILE *f = path_fopen(tmp_filepath, "wb");
+  if (!f) {
+    VLOG(1) << "Failed to write BVH cache file " << filepath;
+    return false;
+  }
+
+  BVHCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  strcpy(header.magic, "CYCBVH");
+  header.version = BVH_CACHE_VERSION;
+  header.bvh_layout = params.bvh_layout;
+  header.root_index = pack.root_index;
+
+  bool ok = fwrite(&header, sizeof(header), 1, f) == 1 && bvh_cache_write_array(f, pack.nodes) &&
+            bvh_cache_write_array(f, pack.leaf_nodes) &&
+            bvh_cache_write_array(f, pack.object_node) &&
+            bvh_cache_write_array(f, pack.prim_tri_index) &&
+            bvh_cache_write_array(f, pack.prim_tri_verts) &&
+            bvh_cache_write_array(f, pack.prim_type) &&
+            bvh_cache_write_array(f, pack.prim_visibility) &&
+            bvh_cache_write_array(f, pack.prim_index) &&
+            bvh_cache_write_array(f, pack.prim_object) &&
+            bvh_cache_write_array(f, pack.prim_time);
+
+  ok = (fclose(f) == 0) && ok;
+
+  if (!ok || rename(tmp_filepath.c_str(), filepath.c_str()) != 0) {
+    VLOG(1) << "Failed to write BVH cache file " << filepath;
+    path_remove(tmp_filepath);
+    return false;
+  }
+
+  return true;
+}
+
+CCL_NAMESPACE_END
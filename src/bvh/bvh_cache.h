@@ -0,0 +1,48 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BVH_CACHE_H__
+#define __BVH_CACHE_H__
+
+#include "bvh/bvh_params.h"
+
+#include "util/util_string.h"
+
+CCL_NAMESPACE_BEGIN
+
+class Mesh;
+struct PackedBVH;
+
+/* BVH Cache
+ *
+ * Optional directory of packed per-mesh BVHs, so that meshes which did not
+ * change don't need to be built again when the scene is rendered again. Files
+ * are named by a hash of the mesh geometry and the BVH parameters. */
+
+bool bvh_cache_supported(const BVHParams &params);
+string bvh_cache_filepath(const string &dirpath, const BVHParams &params, const Mesh *mesh);
+
+/* Read a packed BVH, returns false if the file is missing, damaged or does
+ * not match the mesh primitives. */
+bool bvh_cache_read(const string &filepath,
+                    const BVHParams &params,
+                    const Mesh *mesh,
+                    PackedBVH &pack);
+bool bvh_cache_write(const string &filepath, const BVHParams &params, const PackedBVH &pack);
+
+CCL_NAMESPACE_END
+
+#endif /* __BVH_CACHE_H__ */
@@ -61,6 +61,22 @@ class CPUDevice;
 /* Has to be outside of the class to be shared across template instantiations. */
 static const char *logged_architecture = "";
 
+/* Size in pixels and number of samples of the blocks rendered at a time when
+ * interleaving samples. */
+static const int path_trace_block_size = 8;
+static const int path_trace_block_samples = 16;
+
+/* Extract the even bits of a Morton code. */
+static inline uint morton_compact_bits(uint x)
+{
+  x &= 0x55555555;
+  x = (x ^ (x >> 1)) & 0x33333333;
+  x = (x ^ (x >> 2)) & 0x0f0f0f0f;
+  x = (x ^ (x >> 4)) & 0x00ff00ff;
+  x = (x ^ (x >> 8)) & 0x0000ffff;
+  return x;
+}
+
 template<typename F> class KernelFunctions {
  public:
   KernelFunctions()
@@ -181,10 +197,21 @@ class CPUDevice : public Device {
   KernelFunctions<void (*)(KernelGlobals *, float *, int, int, int, int, int)> path_trace_kernel;
   KernelFunctions<void (*)(KernelGlobals *, float *, float *, float, int, int, int, int, int, int, int, int, int)>
       convert_to_float_kernel;
+  KernelFunctions<void (*)(
+      KernelGlobals *, float *, float *, float, int, int, int, int, int, int, int, int, int, int)>
+      convert_row_to_float_kernel;
   //KernelFunctions<void (*)(KernelGlobals *, uchar4 *, float *, float, int, int, int, int, int)>
   //    convert_to_byte_kernel;
   KernelFunctions<void (*)(KernelGlobals *, uint4 *, float4 *, int, int, int, int, int)>
       shader_kernel;
+  KernelFunctions<void (*)(KernelGlobals *, float *, int, int, int, int, int)>
+      adaptive_stopping_kernel;
+  KernelFunctions<bool (*)(KernelGlobals *, float *, int, int, int, int, int, int)>
+      adaptive_filter_x_kernel;
+  KernelFunctions<bool (*)(KernelGlobals *, float *, int, int, int, int, int, int)>
+      adaptive_filter_y_kernel;
+  KernelFunctions<void (*)(KernelGlobals *, float *, int, int, int, int, int)>
+      adaptive_adjust_samples_kernel;
 
   KernelFunctions<void (*)(
       int, TileInfo *, int, int, float *, float *, float *, float *, float *, int *, int, int)>
@@ -265,8 +292,13 @@ class CPUDevice : public Device {
 #define REGISTER_KERNEL(name) name##_kernel(KERNEL_FUNCTIONS(name))
         REGISTER_KERNEL(path_trace),
         REGISTER_KERNEL(convert_to_float),
+        REGISTER_KERNEL(convert_row_to_float),
         //REGISTER_KERNEL(convert_to_byte),
         REGISTER_KERNEL(shader),
+        REGISTER_KERNEL(adaptive_stopping),
+        REGISTER_KERNEL(adaptive_filter_x),
+        REGISTER_KERNEL(adaptive_filter_y),
+        REGISTER_KERNEL(adaptive_adjust_samples),
         REGISTER_KERNEL(filter_divide_shadow),
         REGISTER_KERNEL(filter_get_feature),
         REGISTER_KERNEL(filter_write_feature),
@@ -290,7 +322,7 @@ class CPUDevice : public Device {
 #ifdef WITH_OSL
     kernel_globals.osl = &osl_globals;
 #endif
-    use_split_kernel = DebugFlags().cpu.split_kernel;
+    use_split_kernel = info.use_split_kernel || DebugFlags().cpu.split_kernel;
     if (use_split_kernel) {
       VLOG(1) << "Will be using split kernel.";
     }
@@ -478,6 +510,7 @@ class CPUDevice : public Device {
       info.width = mem.data_width;
       info.height = mem.data_height;
       info.depth = mem.data_depth;
+      info.cache = (uint64_t)mem.cache_image;
 
       need_texture_info = true;
     }
@@ -819,6 +852,41 @@ class CPUDevice : public Device {
     return true;
   }
 
+  bool adaptive_sampling_filter(KernelGlobals *kg, RenderTile &tile, int sample)
+  {
+    float *render_buffer = (float *)tile.buffer;
+
+    for (int y = tile.y; y < tile.y + tile.h; ++y) {
+      for (int x = tile.x; x < tile.x + tile.w; ++x) {
+        adaptive_stopping_kernel()(kg, render_buffer, sample, x, y, tile.offset, tile.stride);
+      }
+    }
+
+    bool any = false;
+    for (int y = tile.y; y < tile.y + tile.h; ++y) {
+      any |= adaptive_filter_x_kernel()(
+          kg, render_buffer, sample, y, tile.x, tile.w, tile.offset, tile.stride);
+    }
+    for (int x = tile.x; x < tile.x + tile.w; ++x) {
+      any |= adaptive_filter_y_kernel()(
+          kg, render_buffer, sample, x, tile.y, tile.h, tile.offset, tile.stride);
+    }
+
+    return !any;
+  }
+
+  void adaptive_sampling_post(KernelGlobals *kg, RenderTile &tile)
+  {
+    float *render_buffer = (float *)tile.buffer;
+
+    for (int y = tile.y; y < tile.y + tile.h; ++y) {
+      for (int x = tile.x; x < tile.x + tile.w; ++x) {
+        adaptive_adjust_samples_kernel()(
+            kg, render_buffer, tile.sample, x, y, tile.offset, tile.stride);
+      }
+    }
+  }
+
   void path_trace(DeviceTask &task, RenderTile &tile, KernelGlobals *kg)
   {
     const bool use_coverage = kernel_data.film.cryptomatte_passes & CRYPT_ACCURATE;
@@ -834,31 +902,93 @@ class CPUDevice : public Device {
     int start_sample = tile.start_sample;
     int end_sample = tile.start_sample + tile.num_samples;
 
+    /* When interleaving samples, the tile is split into small blocks visited in
+     * Morton order, and each block is rendered for multiple samples before
+     * moving on so its memory stays in cache. Otherwise the whole tile is a
+     * single block rendered one sample at a time. */
+    const bool interleave = DebugFlags().cpu.interleave_samples;
+    const int block_size = interleave ? path_trace_block_size : max(tile.w, tile.h);
+    const int block_samples = interleave ? path_trace_block_samples : 1;
+
+    const int num_blocks_x = divide_up(tile.w, block_size);
+    const int num_blocks_y = divide_up(tile.h, block_size);
+    int morton_size = 1;
+    while (morton_size < max(num_blocks_x, num_blocks_y)) {
+      morton_size *= 2;
+    }
+
+    vector<int2> blocks;
+    blocks.reserve(num_blocks_x * num_blocks_y);
+    for (int i = 0; i < morton_size * morton_size; i++) {
+      const int block_x = morton_compact_bits(i);
+      const int block_y = morton_compact_bits(i >> 1);
+      if (block_x < num_blocks_x && block_y < num_blocks_y) {
+        blocks.push_back(make_int2(tile.x + block_x * block_size, tile.y + block_y * block_size));
+      }
+    }
+
     /* Needed for Embree. */
     SIMD_SET_FLUSH_TO_ZERO;
 
-    for (int sample = start_sample; sample < end_sample; sample++) {
+    for (int sample = start_sample; sample < end_sample;) {
       if (task.get_cancel() || task_pool.canceled()) {
         if (task.need_finish_queue == false)
           break;
       }
 
-      for (int y = tile.y; y < tile.y + tile.h; y++) {
-        for (int x = tile.x; x < tile.x + tile.w; x++) {
-          if (use_coverage) {
-            coverage.init_pixel(x, y);
+      /* Batch of samples rendered per block, ending at the next adaptive
+       * sampling filter step. */
+      int batch_end = min(sample + block_samples, end_sample);
+      if (task.adaptive_sampling.use) {
+        for (int s = sample; s < batch_end; s++) {
+          if (task.adaptive_sampling.need_filter(s)) {
+            batch_end = s + 1;
+            break;
           }
-          path_trace_kernel()(kg, render_buffer, sample, x, y, tile.offset, tile.stride);
         }
       }
 
-      tile.sample = sample + 1;
+      foreach (const int2 &block, blocks) {
+        const int block_end_x = min(block.x + block_size, tile.x + tile.w);
+        const int block_end_y = min(block.y + block_size, tile.y + tile.h);
+
+        for (int s = sample; s < batch_end; s++) {
+          for (int y = block.y; y < block_end_y; y++) {
+            for (int x = block.x; x < block_end_x; x++) {
+              if (use_coverage) {
+                coverage.init_pixel(x, y);
+              }
+              path_trace_kernel()(kg, render_buffer, s, x, y, tile.offset, tile.stride);
+            }
+          }
+        }
+      }
+
+      tile.sample = batch_end;
+
+      task.update_progress(&tile, tile.w * tile.h * (batch_end - sample));
+
+      if (task.adaptive_sampling.use && task.adaptive_sampling.need_filter(batch_end - 1)) {
+        if (adaptive_sampling_filter(kg, tile, batch_end)) {
+          /* All pixels of the tile have converged, skip the remaining samples. */
+          tile.converged = true;
+          if (batch_end < end_sample) {
+            tile.sample = end_sample;
+            task.update_progress(&tile, tile.w * tile.h * (end_sample - batch_end));
+          }
+          break;
+        }
+      }
 
-      task.update_progress(&tile, tile.w * tile.h);
+      sample = batch_end;
     }
     if (use_coverage) {
       coverage.finalize();
     }
+
+    if (task.adaptive_sampling.use) {
+      adaptive_sampling_post(kg, tile);
+    }
   }
 
   void denoise(DenoisingTask &denoising, RenderTile &tile)
@@ -924,6 +1054,8 @@ class CPUDevice : public Device {
     denoising.profiler = &kg->profiler;
 
     while (task.acquire_tile(this, tile)) {
+      const double tile_start_time = time_dt();
+
       if (tile.task == RenderTile::PATH_TRACE) {
         if (use_split_kernel) {
           device_only_memory<uchar> void_buffer(this, "void_buffer");
@@ -938,6 +1070,13 @@ class CPUDevice : public Device {
         task.update_progress(&tile, tile.w * tile.h);
       }
 
+      if (profiler.use_timeline()) {
+        profiler.add_interval(string_printf("Tile %d, %d", tile.x, tile.y),
+                              (tile.task == RenderTile::DENOISE) ? "denoise" : "path_trace",
+                              tile_start_time,
+                              time_dt());
+      }
+
       task.release_tile(tile);
 
       if (task_pool.canceled()) {
@@ -958,22 +1097,49 @@ class CPUDevice : public Device {
   {
     float sample_scale = 1.0f / (task.sample + 1);
 
+    if (!task.film_passes.empty()) {
+      /* Convert all passes of a row at once, so every row of the render
+       * buffer is only fetched from memory once. */
+      const int num_passes = task.film_passes.size();
+      const DeviceFilmPass *passes = &task.film_passes[0];
+
+      for (int y = task.y; y < task.y + task.h; y++) {
+        for (int i = 0; i < num_passes; i++) {
+          convert_row_to_float_kernel()(&kernel_globals,
+                                        (float *)passes[i].rgba_float,
+                                        (float *)task.buffer,
+                                        sample_scale,
+                                        passes[i].type,
+                                        task.x,
+                                        y,
+                                        task.w,
+                                        task.fh,
+                                        task.offset,
+                                        task.stride,
+                                        task.full_w,
+                                        task.full_h,
+                                        task.pixel_size);
+        }
+      }
+      return;
+    }
+
     //if (task.rgba_float) {
       for (int y = task.y; y < task.y + task.h; y++)
-        for (int x = task.x; x < task.x + task.w; x++)
-          convert_to_float_kernel()(&kernel_globals,
-                                    (float *)task.rgba_float,
-                                    (float *)task.buffer,
-                                    sample_scale,
-                                    task.pass_type,
-                                    x,
-                                    y,
-                                    task.fh,
-                                    task.offset,
-                                    task.stride,
-                                    task.full_w,
-                                    task.full_h,
-                                    task.pixel_size);
+        convert_row_to_float_kernel()(&kernel_globals,
+                                      (float *)task.rgba_float,
+                                      (float *)task.buffer,
+                                      sample_scale,
+                                      task.pass_type,
+                                      task.x,
+                                      y,
+                                      task.w,
+                                      task.fh,
+                                      task.offset,
+                                      task.stride,
+                                      task.full_w,
+                                      task.full_h,
+                                      task.pixel_size);
     /*}
     else {
       for (int y = task.y; y < task.y + task.h; y++)
@@ -1061,6 +1227,13 @@ class CPUDevice : public Device {
       kg.decoupled_volume_steps[i] = NULL;
     }
     kg.decoupled_volume_steps_index = 0;
+    const int shader_data_count = sizeof(kg.shader_data) / sizeof(*kg.shader_data);
+    for (int i = 0; i < shader_data_count; ++i) {
+      kg.shader_data[i] = NULL;
+      kg.shader_data_max_closures[i] = 0;
+    }
+    kg.shader_sort_buckets = NULL;
+    kg.shader_sort_num_buckets = 0;
     kg.coverage_asset = kg.coverage_object = kg.coverage_material = NULL;
 #ifdef WITH_OSL
     OSLShader::thread_init(&kg, &kernel_globals, &osl_globals);
@@ -1084,6 +1257,11 @@ class CPUDevice : public Device {
         free(kg->decoupled_volume_steps[i]);
       }
     }
+    const int shader_data_count = sizeof(kg->shader_data) / sizeof(*kg->shader_data);
+    for (int i = 0; i < shader_data_count; ++i) {
+      free(kg->shader_data[i]);
+    }
+    free(kg->shader_sort_buckets);
 #ifdef WITH_OSL
     OSLShader::thread_free(kg);
 #endif
@@ -1204,7 +1382,14 @@ int2 CPUSplitKernel::split_kernel_global_size(device_memory & /*kg*/,
                                               device_memory & /*data*/,
                                               DeviceTask * /*task*/)
 {
-  return make_int2(1, 1);
+  /* Each render thread runs its own split kernel on its own tile, so all
+   * cores are busy without synchronizing between stages. With the default of
+   * 64 states per thread, shader sorting has enough paths to group while the
+   * states still fit in cache, larger batches render slower. */
+  const int num_states = DebugFlags().cpu.split_kernel_size;
+  const int width = min(num_states, 64);
+
+  return make_int2(width, divide_up(num_states, width));
 }
 
 uint64_t CPUSplitKernel::state_buffer_size(device_memory &kernel_globals,
@@ -1285,6 +1285,7 @@ class CUDADevice : public Device {
     info.width = mem.data_width;
     info.height = mem.data_height;
     info.depth = mem.data_depth;
+    info.cache = 0;
     need_texture_info = true;
   }
 
@@ -2315,7 +2316,11 @@ class CUDADevice : public Device {
 
     if (task.type == DeviceTask::FILM_CONVERT) {
       /* must be done in main thread due to opengl access */
-      film_convert(task, task.buffer, task.rgba_float);
+      list<DeviceTask> pass_tasks;
+      task.split_film_passes(pass_tasks);
+      foreach (DeviceTask &pass_task, pass_tasks) {
+        film_convert(pass_task, pass_task.buffer, pass_task.rgba_float);
+      }
     }
     else {
       task_pool.push(new CUDADeviceTask(this, task));
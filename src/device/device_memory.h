@@ -30,6 +30,7 @@
 CCL_NAMESPACE_BEGIN
 
 class Device;
+class TextureCacheImage;
 
 enum MemoryType { MEM_READ_ONLY, MEM_READ_WRITE, MEM_DEVICE_ONLY, MEM_TEXTURE, MEM_PIXELS };
 
@@ -210,6 +211,8 @@ class device_memory {
   const char *name;
   InterpolationType interpolation;
   ExtensionType extension;
+  /* Image read on demand through the CPU texture cache. */
+  TextureCacheImage *cache_image;
 
   /* Pointers. */
   Device *device;
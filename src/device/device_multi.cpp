@@ -415,6 +415,8 @@ class MultiDevice : public Device {
           subtask.rgba_byte = sub.ptr_map[task.rgba_byte];*/
         if (task.rgba_float)
           subtask.rgba_float = sub.ptr_map[task.rgba_float];
+        foreach (DeviceFilmPass &pass, subtask.film_passes)
+          pass.rgba_float = sub.ptr_map[pass.rgba_float];
         if (task.shader_input)
           subtask.shader_input = sub.ptr_map[task.shader_input];
         if (task.shader_output)
@@ -20,9 +20,12 @@
 
 #include "util/util_foreach.h"
 #include "util/util_logging.h"
+#include "util/util_md5.h"
 
 #if defined(WITH_NETWORK)
 
+#  include <zlib.h>
+
 CCL_NAMESPACE_BEGIN
 
 typedef map<device_ptr, device_ptr> PtrMap;
@@ -41,14 +44,43 @@ static TileList::iterator tile_list_find(TileList &tile_list, RenderTile &tile)
   return tile_list.end();
 }
 
+/* Hash of the buffer contents, used to avoid sending the same content twice. */
+static string network_content_hash(const void *data, size_t size)
+{
+  MD5Hash md5;
+  const uint8_t *bytes = (const uint8_t *)data;
+  while (size > 0) {
+    const int chunk = (size > (1 << 30)) ? (1 << 30) : (int)size;
+    md5.append(bytes, chunk);
+    bytes += chunk;
+    size -= chunk;
+  }
+  return md5.get_hex();
+}
+
+/* Only memory that is not written by the device keeps the content that was
+ * copied to it, other memory can't be deduplicated. */
+static bool network_content_use_hash(device_memory &mem)
+{
+  return (mem.type == MEM_READ_ONLY || mem.type == MEM_TEXTURE) && mem.memory_size() > 0;
+}
+
 class NetworkDevice : public Device {
  public:
   boost::asio::io_service io_service;
   tcp::socket socket;
   device_ptr mem_counter;
-  DeviceTask the_task; /* todo: handle multiple tasks */
 
+  /* Protects reading from the socket and the state below, calls are written
+   * in order through the send queue. */
   thread_mutex rpc_lock;
+  uint64_t rpc_counter;
+  NetworkContentTracker content;
+
+  /* Tasks added since the last wait, tile requests from the server refer to
+   * the task they are made for by ID. */
+  map<int, DeviceTask> tasks;
+  int task_counter;
 
   virtual bool show_samples() const
   {
@@ -56,7 +88,7 @@ class NetworkDevice : public Device {
   }
 
   NetworkDevice(DeviceInfo &info, Stats &stats, Profiler &profiler, const char *address)
-      : Device(info, stats, profiler, true), socket(io_service)
+      : Device(info, stats, profiler, true), socket(io_service), rpc_counter(0), task_counter(0)
   {
     error_func = NetworkError();
     stringstream portstr;
@@ -77,12 +109,17 @@ class NetworkDevice : public Device {
       error_func.network_error(error.message());
 
     mem_counter = 0;
+
+    send_queue = new RPCSendQueue(socket, &error_func);
   }
 
   ~NetworkDevice()
   {
-    RPCSend snd(socket, &error_func, "stop");
-    snd.write();
+    RPCSend snd(socket, &error_func, "stop", ++rpc_counter);
+    snd.write(*send_queue);
+
+    /* Wait for all calls to be sent. */
+    delete send_queue;
   }
 
   virtual BVHLayoutMask get_bvh_layout_mask() const
@@ -102,20 +139,77 @@ class NetworkDevice : public Device {
 
     mem.device_pointer = ++mem_counter;
 
-    RPCSend snd(socket, &error_func, "mem_alloc");
+    RPCSend snd(socket, &error_func, "mem_alloc", ++rpc_counter);
     snd.add(mem);
-    snd.write();
+    snd.write(*send_queue);
   }
 
   void mem_copy_to(device_memory &mem)
   {
+    if (!mem.device_pointer) {
+      mem_alloc(mem);
+    }
+
     thread_scoped_lock lock(rpc_lock);
 
-    RPCSend snd(socket, &error_func, "mem_copy_to");
+    const size_t data_size = mem.memory_size();
+
+    /* Skip the copy if the server already has the content. */
+    string hash;
+    if (network_content_use_hash(mem)) {
+      hash = network_content_hash(mem.host_pointer, data_size);
+
+      if (hash == content.hash(mem.device_pointer)) {
+        VLOG(3) << "Buffer " << mem.name << " unchanged, skipping copy.";
+        return;
+      }
+
+      if (content.find_buffer(hash, mem.device_pointer) || content.cached(hash)) {
+        VLOG(3) << "Buffer " << mem.name << " content found on server, skipping copy.";
 
+        content.set_hash(mem.device_pointer, hash);
+        if (!content.find_buffer(hash, mem.device_pointer)) {
+          content.cache_take(hash, NULL, 0);
+        }
+
+        RPCSend snd(socket, &error_func, "mem_copy_to_content", ++rpc_counter);
+        snd.add(mem);
+        snd.add(hash);
+        snd.write(*send_queue);
+        return;
+      }
+    }
+
+    content.set_hash(mem.device_pointer, hash);
+
+    /* Compress larger buffers, if it reduces their size. */
+    vector<uint8_t> compressed;
+    if (data_size >= COMPRESS_MIN_SIZE) {
+      uLongf compressed_size = compressBound(data_size);
+      compressed.resize(compressed_size);
+      if (compress2(&compressed[0],
+                    &compressed_size,
+                    (const Bytef *)mem.host_pointer,
+                    data_size,
+                    Z_BEST_SPEED) == Z_OK &&
+          compressed_size < data_size - data_size / 8) {
+        compressed.resize(compressed_size);
+      }
+      else {
+        compressed.clear();
+      }
+    }
+
+    RPCSend snd(socket, &error_func, "mem_copy_to", ++rpc_counter);
     snd.add(mem);
-    snd.write();
-    snd.write_buffer(mem.host_pointer, mem.memory_size());
+    snd.add(hash);
+    snd.add(compressed.size());
+    if (compressed.size()) {
+      snd.write(*send_queue, &compressed[0], compressed.size());
+    }
+    else {
+      snd.write(*send_queue, mem.host_pointer, data_size);
+    }
   }
 
   void mem_copy_from(device_memory &mem, int y, int w, int h, int elem)
@@ -124,27 +218,37 @@ class NetworkDevice : public Device {
 
     size_t data_size = mem.memory_size();
 
-    RPCSend snd(socket, &error_func, "mem_copy_from");
+    const uint64_t id = ++rpc_counter;
+    RPCSend snd(socket, &error_func, "mem_copy_from", id);
 
     snd.add(mem);
     snd.add(y);
     snd.add(w);
     snd.add(h);
     snd.add(elem);
-    snd.write();
+    snd.write(*send_queue);
 
     RPCReceive rcv(socket, &error_func);
+    if (rcv.id != id) {
+      error_func.network_error("Network receive error: unexpected reply to mem_copy_from");
+    }
     rcv.read_buffer(mem.host_pointer, data_size);
   }
 
   void mem_zero(device_memory &mem)
   {
+    if (!mem.device_pointer) {
+      mem_alloc(mem);
+    }
+
     thread_scoped_lock lock(rpc_lock);
 
-    RPCSend snd(socket, &error_func, "mem_zero");
+    content.clear_hash(mem.device_pointer);
+
+    RPCSend snd(socket, &error_func, "mem_zero", ++rpc_counter);
 
     snd.add(mem);
-    snd.write();
+    snd.write(*send_queue);
   }
 
   void mem_free(device_memory &mem)
@@ -152,10 +256,17 @@ class NetworkDevice : public Device {
     if (mem.device_pointer) {
       thread_scoped_lock lock(rpc_lock);
 
-      RPCSend snd(socket, &error_func, "mem_free");
+      /* Server keeps the content for reuse, unless another buffer has it. */
+      const string hash = content.hash(mem.device_pointer);
+      content.clear_hash(mem.device_pointer);
+      if (!hash.empty() && !content.find_buffer(hash, 0)) {
+        content.cache_insert(hash, mem.memory_size(), NULL);
+      }
+
+      RPCSend snd(socket, &error_func, "mem_free", ++rpc_counter);
 
       snd.add(mem);
-      snd.write();
+      snd.write(*send_queue);
 
       mem.device_pointer = 0;
     }
@@ -165,14 +276,13 @@ class NetworkDevice : public Device {
   {
     thread_scoped_lock lock(rpc_lock);
 
-    RPCSend snd(socket, &error_func, "const_copy_to");
+    RPCSend snd(socket, &error_func, "const_copy_to", ++rpc_counter);
 
     string name_string(name);
 
     snd.add(name_string);
     snd.add(size);
-    snd.write();
-    snd.write_buffer(host, size);
+    snd.write(*send_queue, host, size);
   }
 
   bool load_kernels(const DeviceRequestedFeatures &requested_features)
@@ -182,15 +292,17 @@ class NetworkDevice : public Device {
 
     thread_scoped_lock lock(rpc_lock);
 
-    RPCSend snd(socket, &error_func, "load_kernels");
-    snd.add(requested_features.experimental);
-    snd.add(requested_features.max_closure);
-    snd.add(requested_features.max_nodes_group);
-    snd.add(requested_features.nodes_features);
-    snd.write();
+    const uint64_t id = ++rpc_counter;
+    RPCSend snd(socket, &error_func, "load_kernels", id);
+    snd.add(requested_features);
+    snd.write(*send_queue);
 
-    bool result;
+    bool result = false;
     RPCReceive rcv(socket, &error_func);
+    if (rcv.id != id) {
+      error_func.network_error("Network receive error: unexpected reply to load_kernels");
+      return false;
+    }
     rcv.read(result);
 
     return result;
@@ -200,25 +312,28 @@ class NetworkDevice : public Device {
   {
     thread_scoped_lock lock(rpc_lock);
 
-    the_task = task;
+    const int task_id = ++task_counter;
+    tasks[task_id] = task;
 
-    RPCSend snd(socket, &error_func, "task_add");
+    RPCSend snd(socket, &error_func, "task_add", ++rpc_counter);
+    snd.add(task_id);
     snd.add(task);
-    snd.write();
+    snd.write(*send_queue);
   }
 
   void task_wait()
   {
     thread_scoped_lock lock(rpc_lock);
 
-    RPCSend snd(socket, &error_func, "task_wait");
-    snd.write();
+    RPCSend snd(socket, &error_func, "task_wait", ++rpc_counter);
+    snd.write(*send_queue);
 
     lock.unlock();
 
     TileList the_tiles;
 
-    /* todo: run this threaded for connecting to multiple clients */
+    /* The server can have multiple tile requests in flight, each is answered
+     * with the ID of the request. */
     for (;;) {
       if (error_func.have_error())
         break;
@@ -229,26 +344,27 @@ class NetworkDevice : public Device {
       RPCReceive rcv(socket, &error_func);
 
       if (rcv.name == "acquire_tile") {
+        DeviceTask *task = find_task(rcv);
         lock.unlock();
 
-        /* todo: watch out for recursive calls! */
-        if (the_task.acquire_tile(this, tile)) { /* write return as bool */
+        if (task && task->acquire_tile(this, tile)) {
           the_tiles.push_back(tile);
 
           lock.lock();
-          RPCSend snd(socket, &error_func, "acquire_tile");
+          RPCSend snd(socket, &error_func, "acquire_tile", rcv.id);
           snd.add(tile);
-          snd.write();
+          snd.write(*send_queue);
           lock.unlock();
         }
         else {
           lock.lock();
-          RPCSend snd(socket, &error_func, "acquire_tile_none");
-          snd.write();
+          RPCSend snd(socket, &error_func, "acquire_tile_none", rcv.id);
+          snd.write(*send_queue);
           lock.unlock();
         }
       }
       else if (rcv.name == "release_tile") {
+        DeviceTask *task = find_task(rcv);
         rcv.read(tile);
         lock.unlock();
 
@@ -260,11 +376,13 @@ class NetworkDevice : public Device {
 
         assert(tile.buffers != NULL);
 
-        the_task.release_tile(tile);
+        if (task) {
+          task->release_tile(tile);
+        }
 
         lock.lock();
-        RPCSend snd(socket, &error_func, "release_tile");
-        snd.write();
+        RPCSend snd(socket, &error_func, "release_tile", rcv.id);
+        snd.write(*send_queue);
         lock.unlock();
       }
       else if (rcv.name == "task_wait_done") {
@@ -274,13 +392,17 @@ class NetworkDevice : public Device {
       else
         lock.unlock();
     }
+
+    /* All tasks are done, tasks added from here on belong to the next wait. */
+    lock.lock();
+    tasks.clear();
   }
 
   void task_cancel()
   {
     thread_scoped_lock lock(rpc_lock);
-    RPCSend snd(socket, &error_func, "task_cancel");
-    snd.write();
+    RPCSend snd(socket, &error_func, "task_cancel", ++rpc_counter);
+    snd.write(*send_queue);
   }
 
   int get_split_task_count(DeviceTask &)
@@ -289,7 +411,23 @@ class NetworkDevice : public Device {
   }
 
  private:
+  /* Read the task ID of a tile request, the RPC lock must be held. */
+  DeviceTask *find_task(RPCReceive &rcv)
+  {
+    int task_id;
+    rcv.read(task_id);
+
+    map<int, DeviceTask>::iterator it = tasks.find(task_id);
+    if (it == tasks.end()) {
+      error_func.network_error("Network receive error: tile request for unknown task");
+      return NULL;
+    }
+
+    return &it->second;
+  }
+
   NetworkError error_func;
+  RPCSendQueue *send_queue;
 };
 
 Device *device_network_create(DeviceInfo &info,
@@ -318,7 +456,11 @@ void device_network_info(vector<DeviceInfo> &devices)
 
 class DeviceServer {
  public:
+  /* Protects reading from the socket and the state below. */
   thread_mutex rpc_lock;
+  /* Protects writing to the socket, so worker threads can send requests
+   * while another thread waits for incoming calls. */
+  thread_mutex send_lock;
 
   void network_error(const string &message)
   {
@@ -331,7 +473,7 @@ class DeviceServer {
   }
 
   DeviceServer(Device *device_, tcp::socket &socket_)
-      : device(device_), socket(socket_), stop(false), blocked_waiting(false)
+      : device(device_), socket(socket_), rpc_counter(0), stop(false), blocked_waiting(false)
   {
     error_func = NetworkError();
   }
@@ -348,13 +490,27 @@ class DeviceServer {
   }
 
  protected:
+  struct AcquireEntry {
+    string name;
+    RenderTile tile;
+  };
+
   void listen_step()
   {
     thread_scoped_lock lock(rpc_lock);
+    receive(lock);
+  }
+
+  /* Receive and process one call, the lock must be acquired on entry and is
+   * unlocked before returning. */
+  void receive(thread_scoped_lock &lock)
+  {
     RPCReceive rcv(socket, &error_func);
 
-    if (rcv.name == "stop")
+    if (rcv.name == "stop") {
       stop = true;
+      lock.unlock();
+    }
     else
       process(rcv, lock);
   }
@@ -456,13 +612,17 @@ class DeviceServer {
       pointer_mapping_insert(client_pointer, mem.device_pointer);
     }
     else if (rcv.name == "mem_copy_to") {
-      string name;
+      string name, hash;
+      size_t compressed_size;
       network_device_memory mem(device);
       rcv.read(mem, name);
+      rcv.read(hash);
+      rcv.read(compressed_size);
       lock.unlock();
 
       size_t data_size = mem.memory_size();
       device_ptr client_pointer = mem.device_pointer;
+      content.set_hash(client_pointer, hash);
 
       if (client_pointer) {
         /* Lookup existing host side data buffer. */
@@ -479,7 +639,22 @@ class DeviceServer {
       }
 
       /* Copy data from network into memory buffer. */
-      rcv.read_buffer((uint8_t *)mem.host_pointer, data_size);
+      if (compressed_size) {
+        vector<uint8_t> compressed(compressed_size);
+        rcv.read_buffer(&compressed[0], compressed_size);
+
+        uLongf uncompressed_size = data_size;
+        if (uncompress((Bytef *)mem.host_pointer,
+                       &uncompressed_size,
+                       &compressed[0],
+                       compressed_size) != Z_OK ||
+            uncompressed_size != data_size) {
+          network_error("Network receive error: failed to uncompress buffer");
+        }
+      }
+      else {
+        rcv.read_buffer((uint8_t *)mem.host_pointer, data_size);
+      }
 
       /* Copy the data from the memory buffer to the device buffer. */
       device->mem_copy_to(mem);
@@ -489,6 +664,43 @@ class DeviceServer {
         pointer_mapping_insert(client_pointer, mem.device_pointer);
       }
     }
+    else if (rcv.name == "mem_copy_to_content") {
+      string name, hash;
+      network_device_memory mem(device);
+      rcv.read(mem, name);
+      rcv.read(hash);
+      lock.unlock();
+
+      size_t data_size = mem.memory_size();
+      device_ptr client_pointer = mem.device_pointer;
+
+      /* Copy content from another buffer, or from freed buffers. The host
+       * buffer is not reallocated, the device may be using it directly. */
+      DataVector &data_v = data_vector_find(client_pointer);
+      void *data = (data_size) ? (void *)&data_v[0] : NULL;
+      bool found = (data_v.size() == data_size);
+      device_ptr source_pointer = content.find_buffer(hash, client_pointer);
+      if (found && source_pointer) {
+        const DataVector &source_v = data_vector_find(source_pointer);
+        found = (source_v.size() == data_size);
+        if (found && data_size) {
+          memcpy(data, &source_v[0], data_size);
+        }
+      }
+      else if (found) {
+        found = content.cache_take(hash, data, data_size);
+      }
+      content.set_hash(client_pointer, hash);
+
+      if (!found) {
+        network_error("Network receive error: buffer content not found");
+      }
+
+      mem.host_pointer = data;
+      mem.device_pointer = device_ptr_from_client_pointer(client_pointer);
+
+      device->mem_copy_to(mem);
+    }
     else if (rcv.name == "mem_copy_from") {
       string name;
       network_device_memory mem(device);
@@ -505,15 +717,17 @@ class DeviceServer {
 
       DataVector &data_v = data_vector_find(client_pointer);
 
-      mem.host_pointer = (device_ptr) & (data_v[0]);
+      mem.host_pointer = (void *)&(data_v[0]);
 
       device->mem_copy_from(mem, y, w, h, elem);
 
       size_t data_size = mem.memory_size();
 
-      RPCSend snd(socket, &error_func, "mem_copy_from");
+      thread_scoped_lock write_lock(send_lock);
+      RPCSend snd(socket, &error_func, "mem_copy_from", rcv.id);
       snd.write();
       snd.write_buffer((uint8_t *)mem.host_pointer, data_size);
+      write_lock.unlock();
       lock.unlock();
     }
     else if (rcv.name == "mem_zero") {
@@ -524,6 +738,7 @@ class DeviceServer {
 
       size_t data_size = mem.memory_size();
       device_ptr client_pointer = mem.device_pointer;
+      content.clear_hash(client_pointer);
 
       if (client_pointer) {
         /* Lookup existing host side data buffer. */
@@ -536,7 +751,7 @@ class DeviceServer {
       else {
         /* Allocate host side data buffer. */
         DataVector &data_v = data_vector_insert(client_pointer, data_size);
-        mem.host_pointer = (void *) ? (device_ptr) & (data_v[0]) : 0;
+        mem.host_pointer = (data_size) ? (void *)&(data_v[0]) : 0;
       }
 
       /* Zero memory. */
@@ -556,6 +771,13 @@ class DeviceServer {
 
       device_ptr client_pointer = mem.device_pointer;
 
+      /* Keep the content for reuse, unless another buffer has it. */
+      const string hash = content.hash(client_pointer);
+      content.clear_hash(client_pointer);
+      if (!hash.empty() && !content.find_buffer(hash, 0)) {
+        content.cache_insert(hash, mem.memory_size(), &data_vector_find(client_pointer));
+      }
+
       mem.device_pointer = device_ptr_from_client_pointer_erase(client_pointer);
 
       device->mem_free(mem);
@@ -575,32 +797,35 @@ class DeviceServer {
     }
     else if (rcv.name == "load_kernels") {
       DeviceRequestedFeatures requested_features;
-      rcv.read(requested_features.experimental);
-      rcv.read(requested_features.max_closure);
-      rcv.read(requested_features.max_nodes_group);
-      rcv.read(requested_features.nodes_features);
+      rcv.read(requested_features);
 
       bool result;
       result = device->load_kernels(requested_features);
-      RPCSend snd(socket, &error_func, "load_kernels");
+      thread_scoped_lock write_lock(send_lock);
+      RPCSend snd(socket, &error_func, "load_kernels", rcv.id);
       snd.add(result);
       snd.write();
+      write_lock.unlock();
       lock.unlock();
     }
     else if (rcv.name == "task_add") {
+      int task_id;
       DeviceTask task;
 
+      rcv.read(task_id);
       rcv.read(task);
       lock.unlock();
 
       if (task.buffer)
         task.buffer = device_ptr_from_client_pointer(task.buffer);
 
-      if (task.rgba_half)
-        task.rgba_half = device_ptr_from_client_pointer(task.rgba_half);
+      if (task.rgba_float)
+        task.rgba_float = device_ptr_from_client_pointer(task.rgba_float);
 
-      if (task.rgba_byte)
-        task.rgba_byte = device_ptr_from_client_pointer(task.rgba_byte);
+      foreach (DeviceFilmPass &pass, task.film_passes) {
+        if (pass.rgba_float)
+          pass.rgba_float = device_ptr_from_client_pointer(pass.rgba_float);
+      }
 
       if (task.shader_input)
         task.shader_input = device_ptr_from_client_pointer(task.shader_input);
@@ -608,8 +833,9 @@ class DeviceServer {
       if (task.shader_output)
         task.shader_output = device_ptr_from_client_pointer(task.shader_output);
 
-      task.acquire_tile = function_bind(&DeviceServer::task_acquire_tile, this, _1, _2);
-      task.release_tile = function_bind(&DeviceServer::task_release_tile, this, _1);
+      task.acquire_tile = function_bind(
+          &DeviceServer::task_acquire_tile, this, _1, _2, task_id);
+      task.release_tile = function_bind(&DeviceServer::task_release_tile, this, _1, task_id);
       task.update_progress_sample = function_bind(&DeviceServer::task_update_progress_sample,
                                                   this);
       task.update_tile_sample = function_bind(&DeviceServer::task_update_tile_sample, this, _1);
@@ -624,32 +850,23 @@ class DeviceServer {
       device->task_wait();
       blocked_waiting = false;
 
-      lock.lock();
-      RPCSend snd(socket, &error_func, "task_wait_done");
+      thread_scoped_lock write_lock(send_lock);
+      RPCSend snd(socket, &error_func, "task_wait_done", rcv.id);
       snd.write();
-      lock.unlock();
     }
     else if (rcv.name == "task_cancel") {
       lock.unlock();
       device->task_cancel();
     }
     else if (rcv.name == "acquire_tile") {
-      AcquireEntry entry;
+      AcquireEntry &entry = acquire_replies[rcv.id];
       entry.name = rcv.name;
       rcv.read(entry.tile);
-      acquire_queue.push_back(entry);
-      lock.unlock();
-    }
-    else if (rcv.name == "acquire_tile_none") {
-      AcquireEntry entry;
-      entry.name = rcv.name;
-      acquire_queue.push_back(entry);
       lock.unlock();
     }
-    else if (rcv.name == "release_tile") {
-      AcquireEntry entry;
+    else if (rcv.name == "acquire_tile_none" || rcv.name == "release_tile") {
+      AcquireEntry &entry = acquire_replies[rcv.id];
       entry.name = rcv.name;
-      acquire_queue.push_back(entry);
       lock.unlock();
     }
     else {
@@ -658,45 +875,78 @@ class DeviceServer {
     }
   }
 
-  bool task_acquire_tile(Device *, RenderTile &tile)
+  /* Send a request for a task to the client, returns its ID. */
+  uint64_t send_request(const string &name, int task_id, RenderTile *tile = NULL)
   {
-    thread_scoped_lock acquire_lock(acquire_mutex);
-
-    bool result = false;
+    thread_scoped_lock write_lock(send_lock);
 
-    RPCSend snd(socket, &error_func, "acquire_tile");
+    const uint64_t id = ++rpc_counter;
+    RPCSend snd(socket, &error_func, name, id);
+    snd.add(task_id);
+    if (tile) {
+      snd.add(*tile);
+    }
     snd.write();
 
-    do {
-      if (blocked_waiting)
-        listen_step();
+    return id;
+  }
 
-      /* todo: avoid busy wait loop */
+  /* Wait for the reply to a request. Multiple threads can have requests in
+   * flight, whichever thread receives a reply stores it for the thread that
+   * waits for it. */
+  bool wait_reply(uint64_t id, AcquireEntry &entry)
+  {
+    for (;;) {
       thread_scoped_lock lock(rpc_lock);
 
-      if (!acquire_queue.empty()) {
-        AcquireEntry entry = acquire_queue.front();
-        acquire_queue.pop_front();
-
-        if (entry.name == "acquire_tile") {
-          tile = entry.tile;
+      map<uint64_t, AcquireEntry>::iterator it = acquire_replies.find(id);
+      if (it != acquire_replies.end()) {
+        entry = it->second;
+        acquire_replies.erase(it);
+        return true;
+      }
 
-          if (tile.buffer)
-            tile.buffer = ptr_map[tile.buffer];
+      if (stop || have_error()) {
+        return false;
+      }
 
-          result = true;
-          break;
-        }
-        else if (entry.name == "acquire_tile_none") {
-          break;
-        }
-        else {
-          cout << "Error: unexpected acquire RPC receive call \"" + entry.name + "\"\n";
-        }
+      if (blocked_waiting) {
+        /* Check for the reply and receive while holding the lock, so a reply
+         * can't arrive in between and leave this thread waiting. */
+        receive(lock);
       }
-    } while (acquire_queue.empty() && !stop && !have_error());
+      else {
+        /* todo: avoid busy wait loop */
+        lock.unlock();
+        std::this_thread::yield();
+      }
+    }
+  }
 
-    return result;
+  bool task_acquire_tile(Device *, RenderTile &tile, int task_id)
+  {
+    const uint64_t id = send_request("acquire_tile", task_id);
+
+    AcquireEntry entry;
+    if (!wait_reply(id, entry)) {
+      return false;
+    }
+
+    if (entry.name == "acquire_tile") {
+      thread_scoped_lock lock(rpc_lock);
+
+      tile = entry.tile;
+
+      if (tile.buffer)
+        tile.buffer = ptr_map[tile.buffer];
+
+      return true;
+    }
+    else if (entry.name != "acquire_tile_none") {
+      cout << "Error: unexpected acquire RPC receive call \"" + entry.name + "\"\n";
+    }
+
+    return false;
   }
 
   void task_update_progress_sample()
@@ -709,41 +959,20 @@ class DeviceServer {
     ; /* skip */
   }
 
-  void task_release_tile(RenderTile &tile)
+  void task_release_tile(RenderTile &tile, int task_id)
   {
-    thread_scoped_lock acquire_lock(acquire_mutex);
-
-    if (tile.buffer)
-      tile.buffer = ptr_imap[tile.buffer];
-
     {
       thread_scoped_lock lock(rpc_lock);
-      RPCSend snd(socket, &error_func, "release_tile");
-      snd.add(tile);
-      snd.write();
-      lock.unlock();
+      if (tile.buffer)
+        tile.buffer = ptr_imap[tile.buffer];
     }
 
-    do {
-      if (blocked_waiting)
-        listen_step();
+    const uint64_t id = send_request("release_tile", task_id, &tile);
 
-      /* todo: avoid busy wait loop */
-      thread_scoped_lock lock(rpc_lock);
-
-      if (!acquire_queue.empty()) {
-        AcquireEntry entry = acquire_queue.front();
-        acquire_queue.pop_front();
-
-        if (entry.name == "release_tile") {
-          lock.unlock();
-          break;
-        }
-        else {
-          cout << "Error: unexpected release RPC receive call \"" + entry.name + "\"\n";
-        }
-      }
-    } while (acquire_queue.empty() && !stop);
+    AcquireEntry entry;
+    if (wait_reply(id, entry) && entry.name != "release_tile") {
+      cout << "Error: unexpected release RPC receive call \"" + entry.name + "\"\n";
+    }
   }
 
   bool task_get_cancel()
@@ -759,14 +988,11 @@ class DeviceServer {
   PtrMap ptr_map;
   PtrMap ptr_imap;
   DataMap mem_data;
+  NetworkContentTracker content;
 
-  struct AcquireEntry {
-    string name;
-    RenderTile tile;
-  };
-
-  thread_mutex acquire_mutex;
-  list<AcquireEntry> acquire_queue;
+  /* Replies to tile requests by request ID. */
+  uint64_t rpc_counter;
+  map<uint64_t, AcquireEntry> acquire_replies;
 
   bool stop;
   bool blocked_waiting;
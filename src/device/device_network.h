@@ -40,6 +40,7 @@
 #  include "util/util_map.h"
 #  include "util/util_param.h"
 #  include "util/util_string.h"
+#  include "util/util_thread.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -56,6 +57,13 @@ static const int DISCOVER_PORT = 5121;
 static const string DISCOVER_REQUEST_MSG = "REQUEST_RENDER_SERVER_IP";
 static const string DISCOVER_REPLY_MSG = "REPLY_RENDER_SERVER_IP";
 
+/* Maximum size of RPC packets queued for sending, before callers wait. */
+static const size_t RPC_SEND_QUEUE_MAX_SIZE = 256 * 1024 * 1024;
+/* Maximum size of freed buffers the server keeps for reuse of their content. */
+static const size_t CONTENT_CACHE_MAX_SIZE = 1024 * 1024 * 1024;
+/* Buffers smaller than this are not compressed. */
+static const size_t COMPRESS_MIN_SIZE = 64 * 1024;
+
 #  if 0
 typedef boost::archive::text_oarchive o_archive;
 typedef boost::archive::text_iarchive i_archive;
@@ -109,16 +117,245 @@ class NetworkError {
   int error_count;
 };
 
-/* Remote procedure call Send */
+/* Queue of RPC packets, written to the socket by a separate thread so the
+ * caller can prepare the next call while the previous one is sent. Packets
+ * are written in the order they were pushed. */
+
+class RPCSendQueue {
+ public:
+  RPCSendQueue(tcp::socket &socket_, NetworkError *e)
+      : socket(socket_), error_func(e), queued_size(0), writing(false), do_stop(false)
+  {
+    worker = new thread(function_bind(&RPCSendQueue::run, this));
+  }
+
+  ~RPCSendQueue()
+  {
+    flush();
+
+    {
+      thread_scoped_lock lock(mutex);
+      do_stop = true;
+    }
+    cond.notify_all();
+
+    worker->join();
+    delete worker;
+  }
+
+  /* Takes ownership of the packet contents. */
+  void push(string &packet)
+  {
+    thread_scoped_lock lock(mutex);
+    while (queued_size > RPC_SEND_QUEUE_MAX_SIZE) {
+      cond.wait(lock);
+    }
+
+    queued_size += packet.size();
+    packets.push_back(string());
+    packets.back().swap(packet);
+    cond.notify_all();
+  }
+
+  /* Wait until all queued packets are written. */
+  void flush()
+  {
+    thread_scoped_lock lock(mutex);
+    while (!packets.empty() || writing) {
+      cond.wait(lock);
+    }
+  }
+
+ protected:
+  void run()
+  {
+    thread_scoped_lock lock(mutex);
+
+    for (;;) {
+      while (packets.empty() && !do_stop) {
+        cond.wait(lock);
+      }
+      if (packets.empty()) {
+        break;
+      }
+
+      string packet;
+      packet.swap(packets.front());
+      packets.pop_front();
+      writing = true;
+      lock.unlock();
+
+      boost::system::error_code error;
+      boost::asio::write(socket, boost::asio::buffer(packet), boost::asio::transfer_all(), error);
+
+      lock.lock();
+      if (error.value()) {
+        error_func->network_error(error.message());
+      }
+      queued_size -= packet.size();
+      writing = false;
+      cond.notify_all();
+    }
+  }
+
+  tcp::socket &socket;
+  NetworkError *error_func;
+
+  thread_mutex mutex;
+  thread_condition_variable cond;
+  std::deque<string> packets;
+  size_t queued_size;
+  bool writing;
+  bool do_stop;
+  thread *worker;
+};
+
+/* Tracks the content of device memory on the server by hash, so that buffers
+ * whose content the server already has are not sent again. Besides the
+ * contents of allocated buffers, the server keeps freed buffers up to a
+ * maximum size, for example to reuse geometry and textures when the scene is
+ * synchronized again for the next frame of an animation.
+ *
+ * Client and server both keep this state and apply the same operations in
+ * the same order, so they agree on which contents are available without
+ * additional round trips. Only the server stores the data itself. */
+
+class NetworkContentTracker {
+ public:
+  typedef vector<uint8_t> DataVector;
+
+  NetworkContentTracker() : cache_size(0)
+  {
+  }
+
+  /* Hash of the buffer contents, empty if unknown. */
+  string hash(device_ptr ptr) const
+  {
+    map<device_ptr, string>::const_iterator it = hashes.find(ptr);
+    return (it != hashes.end()) ? it->second : string();
+  }
+
+  void set_hash(device_ptr ptr, const string &hash)
+  {
+    clear_hash(ptr);
+    if (!hash.empty()) {
+      hashes[ptr] = hash;
+      buffers.insert(std::make_pair(hash, ptr));
+    }
+  }
+
+  void clear_hash(device_ptr ptr)
+  {
+    map<device_ptr, string>::iterator it = hashes.find(ptr);
+    if (it == hashes.end()) {
+      return;
+    }
+
+    typedef std::multimap<string, device_ptr>::iterator BufferIterator;
+    std::pair<BufferIterator, BufferIterator> range = buffers.equal_range(it->second);
+    for (BufferIterator jt = range.first; jt != range.second; ++jt) {
+      if (jt->second == ptr) {
+        buffers.erase(jt);
+        break;
+      }
+    }
+    hashes.erase(it);
+  }
+
+  /* Allocated buffer other than the given one with this content, or 0. */
+  device_ptr find_buffer(const string &hash, device_ptr except) const
+  {
+    typedef std::multimap<string, device_ptr>::const_iterator BufferIterator;
+    std::pair<BufferIterator, BufferIterator> range = buffers.equal_range(hash);
+    for (BufferIterator it = range.first; it != range.second; ++it) {
+      if (it->second != except) {
+        return it->second;
+      }
+    }
+    return 0;
+  }
+
+  bool cached(const string &hash) const
+  {
+    return cache.find(hash) != cache.end();
+  }
+
+  /* Keep content of a freed buffer, evicting the oldest entries when over
+   * the maximum size. The data is swapped out of the given vector. */
+  void cache_insert(const string &hash, size_t size, DataVector *data)
+  {
+    if (size > CONTENT_CACHE_MAX_SIZE || cached(hash)) {
+      return;
+    }
+
+    CacheEntry &entry = cache[hash];
+    entry.size = size;
+    if (data) {
+      entry.data.swap(*data);
+    }
+    cache_order.push_back(hash);
+    cache_size += size;
+
+    while (cache_size > CONTENT_CACHE_MAX_SIZE) {
+      cache_erase(cache_order.front());
+    }
+  }
+
+  /* Remove content from the cache, copying the data into the given memory.
+   * The data is copied rather than swapped in, since devices may use the
+   * existing host memory of a buffer as device memory. */
+  bool cache_take(const string &hash, void *data, size_t size)
+  {
+    map<string, CacheEntry>::iterator it = cache.find(hash);
+    if (it == cache.end()) {
+      return false;
+    }
+
+    bool found = true;
+    if (data) {
+      const DataVector &cached_data = it->second.data;
+      found = (cached_data.size() == size);
+      if (found && size) {
+        memcpy(data, &cached_data[0], size);
+      }
+    }
+    cache_erase(hash);
+    return found;
+  }
+
+ protected:
+  void cache_erase(const string &hash)
+  {
+    map<string, CacheEntry>::iterator it = cache.find(hash);
+    cache_size -= it->second.size;
+    cache.erase(it);
+    cache_order.erase(std::find(cache_order.begin(), cache_order.end(), hash));
+  }
+
+  struct CacheEntry {
+    size_t size;
+    DataVector data;
+  };
+
+  map<device_ptr, string> hashes;
+  std::multimap<string, device_ptr> buffers;
+
+  map<string, CacheEntry> cache;
+  list<string> cache_order;
+  size_t cache_size;
+};
+
+/* Remote procedure call Send
+ *
+ * Every call has an ID, replies use the ID of the call they answer. */
 
 class RPCSend {
  public:
-  RPCSend(tcp::socket &socket_, NetworkError *e, const string &name_ = "")
-      : name(name_), socket(socket_), archive(archive_stream), sent(false)
+  RPCSend(tcp::socket &socket_, NetworkError *e, const string &name_ = "", uint64_t id_ = 0)
+      : name(name_), id(id_), socket(socket_), archive(archive_stream), sent(false)
   {
-    archive &name_;
+    archive &name_ &id_;
     error_func = e;
-    fprintf(stderr, "rpc send %s\n", name.c_str());
   }
 
   ~RPCSend()
@@ -142,12 +379,36 @@ class RPCSend {
   void add(const DeviceTask &task)
   {
     int type = (int)task.type;
-    archive &type &task.x &task.y &task.w &task.h;
-    archive &task.rgba_byte &task.rgba_half &task.buffer &task.sample &task.num_samples;
+    archive &type &task.x &task.y &task.w &task.h &task.fh;
+    archive &task.full_w &task.full_h &task.pixel_size;
+    archive &task.rgba_float &task.buffer &task.sample &task.num_samples;
     archive &task.offset &task.stride;
+    archive &task.pass_type &task.pass_components;
+
+    int num_film_passes = task.film_passes.size();
+    archive &num_film_passes;
+    foreach (const DeviceFilmPass &pass, task.film_passes) {
+      archive &pass.type &pass.rgba_float;
+    }
+
     archive &task.shader_input &task.shader_output &task.shader_eval_type;
-    archive &task.shader_x &task.shader_w;
-    archive &task.need_finish_queue;
+    archive &task.shader_filter &task.shader_x &task.shader_w;
+    archive &task.passes_size &task.pass_stride;
+    archive &task.adaptive_sampling.use &task.adaptive_sampling.adaptive_step;
+    archive &task.adaptive_sampling.min_samples;
+    archive &task.need_finish_queue &task.integrator_branched;
+    archive &task.requested_tile_size.x &task.requested_tile_size.y;
+  }
+
+  void add(const DeviceRequestedFeatures &features)
+  {
+    archive &features.experimental &features.max_nodes_group &features.nodes_features;
+    archive &features.use_hair &features.use_object_motion &features.use_camera_motion;
+    archive &features.use_baking &features.use_subsurface &features.use_volume;
+    archive &features.use_integrator_branched &features.use_patch_evaluation;
+    archive &features.use_transparent &features.use_shadow_tricks &features.use_principled;
+    archive &features.use_denoising &features.use_shader_raytrace;
+    archive &features.use_true_displacement &features.use_background_light;
   }
 
   void add(const RenderTile &tile)
@@ -186,6 +447,25 @@ class RPCSend {
     sent = true;
   }
 
+  /* Queue the call for sending, followed by the buffer contents. */
+  void write(RPCSendQueue &queue, const void *buffer = NULL, size_t size = 0)
+  {
+    string archive_str = archive_stream.str();
+
+    ostringstream header_stream;
+    header_stream << setw(8) << hex << archive_str.size();
+
+    string packet = header_stream.str();
+    packet.reserve(packet.size() + archive_str.size() + size);
+    packet += archive_str;
+    if (size) {
+      packet.append((const char *)buffer, size);
+    }
+
+    queue.push(packet);
+    sent = true;
+  }
+
   void write_buffer(void *buffer, size_t size)
   {
     boost::system::error_code error;
@@ -199,6 +479,7 @@ class RPCSend {
 
  protected:
   string name;
+  uint64_t id;
   tcp::socket &socket;
   ostringstream archive_stream;
   o_archive archive;
@@ -211,7 +492,7 @@ class RPCSend {
 class RPCReceive {
  public:
   RPCReceive(tcp::socket &socket_, NetworkError *e)
-      : socket(socket_), archive_stream(NULL), archive(NULL)
+      : id(0), socket(socket_), archive_stream(NULL), archive(NULL)
   {
     error_func = e;
     /* read head with fixed size */
@@ -245,8 +526,7 @@ class RPCReceive {
           archive_stream = new istringstream(archive_str);
           archive = new i_archive(*archive_stream);
 
-          *archive &name;
-          fprintf(stderr, "rpc receive %s\n", name.c_str());
+          *archive &name &id;
         }
         else {
           error_func->network_error("Network receive error: data size doesn't match header");
@@ -306,16 +586,44 @@ class RPCReceive {
   {
     int type;
 
-    *archive &type &task.x &task.y &task.w &task.h;
-    *archive &task.rgba_byte &task.rgba_half &task.buffer &task.sample &task.num_samples;
+    *archive &type &task.x &task.y &task.w &task.h &task.fh;
+    *archive &task.full_w &task.full_h &task.pixel_size;
+    *archive &task.rgba_float &task.buffer &task.sample &task.num_samples;
     *archive &task.offset &task.stride;
+    *archive &task.pass_type &task.pass_components;
+
+    int num_film_passes;
+    *archive &num_film_passes;
+    task.film_passes.clear();
+    for (int i = 0; i < num_film_passes; i++) {
+      int pass_type;
+      device_ptr rgba_float;
+      *archive &pass_type &rgba_float;
+      task.film_passes.push_back(DeviceFilmPass(pass_type, rgba_float));
+    }
+
     *archive &task.shader_input &task.shader_output &task.shader_eval_type;
-    *archive &task.shader_x &task.shader_w;
-    *archive &task.need_finish_queue;
+    *archive &task.shader_filter &task.shader_x &task.shader_w;
+    *archive &task.passes_size &task.pass_stride;
+    *archive &task.adaptive_sampling.use &task.adaptive_sampling.adaptive_step;
+    *archive &task.adaptive_sampling.min_samples;
+    *archive &task.need_finish_queue &task.integrator_branched;
+    *archive &task.requested_tile_size.x &task.requested_tile_size.y;
 
     task.type = (DeviceTask::Type)type;
   }
 
+  void read(DeviceRequestedFeatures &features)
+  {
+    *archive &features.experimental &features.max_nodes_group &features.nodes_features;
+    *archive &features.use_hair &features.use_object_motion &features.use_camera_motion;
+    *archive &features.use_baking &features.use_subsurface &features.use_volume;
+    *archive &features.use_integrator_branched &features.use_patch_evaluation;
+    *archive &features.use_transparent &features.use_shadow_tricks &features.use_principled;
+    *archive &features.use_denoising &features.use_shader_raytrace;
+    *archive &features.use_true_displacement &features.use_background_light;
+  }
+
   void read(RenderTile &tile)
   {
     *archive &tile.x &tile.y &tile.w &tile.h;
@@ -327,6 +635,7 @@ class RPCReceive {
   }
 
   string name;
+  uint64_t id;
 
  protected:
   tcp::socket &socket;
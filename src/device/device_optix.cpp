@@ -673,7 +673,11 @@ class OptiXDevice : public Device {
       launch_shader_eval(task, thread_index);
     }
     else if (task.type == DeviceTask::FILM_CONVERT) {
-      launch_film_convert(task, thread_index);
+      list<DeviceTask> pass_tasks;
+      task.split_film_passes(pass_tasks);
+      foreach (DeviceTask &pass_task, pass_tasks) {
+        launch_film_convert(pass_task, thread_index);
+      }
     }
   }
 
@@ -1938,6 +1942,7 @@ class OptiXDevice : public Device {
     info.width = mem.data_width;
     info.height = mem.data_height;
     info.depth = mem.data_depth;
+    info.cache = 0;
     need_texture_info = true;
   }
 
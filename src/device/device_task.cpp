@@ -22,6 +22,7 @@
 #include "render/buffers.h"
 
 #include "util/util_algorithm.h"
+#include "util/util_foreach.h"
 #include "util/util_time.h"
 
 CCL_NAMESPACE_BEGIN
@@ -113,6 +114,24 @@ void DeviceTask::split(list<DeviceTask> &tasks, int num, int max_size)
   }
 }
 
+void DeviceTask::split_film_passes(list<DeviceTask> &tasks) const
+{
+  if (film_passes.empty()) {
+    tasks.push_back(*this);
+    return;
+  }
+
+  foreach (const DeviceFilmPass &pass, film_passes) {
+    DeviceTask task = *this;
+
+    task.pass_type = pass.type;
+    task.rgba_float = pass.rgba_float;
+    task.film_passes.clear();
+
+    tasks.push_back(task);
+  }
+}
+
 void DeviceTask::update_progress(RenderTile *rtile, int pixel_samples)
 {
   if ((type != RENDER) && (type != SHADER))
@@ -136,4 +155,20 @@ void DeviceTask::update_progress(RenderTile *rtile, int pixel_samples)
   }
 }
 
+/* Adaptive Sampling */
+
+AdaptiveSampling::AdaptiveSampling() : use(false), adaptive_step(0), min_samples(0)
+{
+}
+
+bool AdaptiveSampling::need_filter(int sample) const
+{
+  if (sample > min_samples) {
+    return (sample & (adaptive_step - 1)) == (adaptive_step - 1);
+  }
+  else {
+    return false;
+  }
+}
+
 CCL_NAMESPACE_END
@@ -22,6 +22,7 @@
 #include "util/util_function.h"
 #include "util/util_list.h"
 #include "util/util_task.h"
+#include "util/util_vector.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -62,6 +63,31 @@ class DenoiseParams {
   }
 };
 
+class AdaptiveSampling {
+ public:
+  AdaptiveSampling();
+
+  /* Whether the convergence filter has to run after rendering the given sample. */
+  bool need_filter(int sample) const;
+
+  bool use;
+  /* Number of samples between convergence checks, must be a power of two. */
+  int adaptive_step;
+  /* Number of samples every pixel receives before it can be considered converged. */
+  int min_samples;
+};
+
+/* Display pass written by a film conversion task. */
+class DeviceFilmPass {
+ public:
+  DeviceFilmPass(int type, device_ptr rgba_float) : type(type), rgba_float(rgba_float)
+  {
+  }
+
+  int type;
+  device_ptr rgba_float;
+};
+
 class DeviceTask : public Task {
  public:
   typedef enum { RENDER, FILM_CONVERT, SHADER } Type;
@@ -77,6 +103,10 @@ class DeviceTask : public Task {
   int pass_type;
   int pass_components;
 
+  /* Passes converted together by a FILM_CONVERT task, so the render buffer is
+   * only read once. When empty, pass_type is converted into rgba_float. */
+  vector<DeviceFilmPass> film_passes;
+
   device_ptr shader_input;
   device_ptr shader_output;
   int shader_eval_type;
@@ -89,6 +119,9 @@ class DeviceTask : public Task {
 
   int get_subtask_count(int num, int max_size = 0);
   void split(list<DeviceTask> &tasks, int num, int max_size = 0);
+  /* Split a film conversion into one task per pass, for devices that convert
+   * a single pass per kernel launch. */
+  void split_film_passes(list<DeviceTask> &tasks) const;
 
   void update_progress(RenderTile *rtile, int pixel_samples = -1);
 
@@ -114,6 +147,8 @@ class DeviceTask : public Task {
   int pass_denoising_data;
   int pass_denoising_clean;
 
+  AdaptiveSampling adaptive_sampling;
+
   bool need_finish_queue;
   bool integrator_branched;
   int2 requested_tile_size;
@@ -1313,6 +1313,7 @@ void OpenCLDevice::flush_texture_buffers()
       info.width = mem->data_width;
       info.height = mem->data_height;
       info.depth = mem->data_depth;
+      info.cache = 0;
 
       info.interpolation = mem->interpolation;
       info.extension = mem->extension;
@@ -1329,7 +1330,11 @@ void OpenCLDevice::thread_run(DeviceTask *task)
   flush_texture_buffers();
 
   if (task->type == DeviceTask::FILM_CONVERT) {
-    film_convert(*task, task->buffer, task->rgba_float);
+    list<DeviceTask> pass_tasks;
+    task->split_film_passes(pass_tasks);
+    foreach (DeviceTask &pass_task, pass_tasks) {
+      film_convert(pass_task, pass_task.buffer, pass_task.rgba_float);
+    }
   }
   else if (task->type == DeviceTask::SHADER) {
     shader(*task);
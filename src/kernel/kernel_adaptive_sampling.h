@@ -0,0 +1,276 @@
+/*
+ * Copyright 2019 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __KERNEL_ADAPTIVE_SAMPLING_H__
+#define __KERNEL_ADAPTIVE_SAMPLING_H__
+
+CCL_NAMESPACE_BEGIN
+
+/* Adaptive sampling
+ *
+ * The auxiliary pass accumulates every second sample (scaled by two) in its
+ * xyz components, so that comparing it against the combined pass gives an
+ * estimate of the per pixel error. Its w component is zero while the pixel is
+ * still being sampled, and once the pixel has converged it holds the number
+ * of samples the pixel values currently represent. */
+
+ccl_device_inline bool kernel_adaptive_pixel_is_converged(KernelGlobals *kg,
+                                                          ccl_global float *buffer)
+{
+  return buffer[kernel_data.film.pass_adaptive_aux_buffer + 3] > 0.0f;
+}
+
+/* Determine whether the pixel has converged after the given number of samples,
+ * using the error heuristic from "A hierarchical automatic stopping condition
+ * for Monte Carlo global illumination" (Dammertz et al.). */
+ccl_device void kernel_do_adaptive_stopping(KernelGlobals *kg,
+                                            ccl_global float *buffer,
+                                            int sample)
+{
+  ccl_global float4 *aux = (ccl_global float4 *)(buffer +
+                                                 kernel_data.film.pass_adaptive_aux_buffer);
+  if ((*aux).w > 0.0f) {
+    return;
+  }
+
+  float4 I = *((ccl_global float4 *)(buffer + kernel_data.film.pass_combined));
+  float4 A = *aux;
+
+  /* A small epsilon is added to the divisor to prevent division by zero. */
+  float error = (fabsf(I.x - A.x) + fabsf(I.y - A.y) + fabsf(I.z - A.z)) /
+                (sample * 0.0001f + sqrtf(max(I.x + I.y + I.z, 0.0f)));
+  if (error < kernel_data.integrator.adaptive_threshold * (float)sample) {
+    (*aux).w = (float)sample;
+  }
+}
+
+/* Pixels that converged in this round but are next to an unconverged pixel are
+ * marked as unconverged again, so that noise does not end abruptly at the
+ * border of a converged region. Pixels that converged in an earlier round keep
+ * their state, since their values may already have been adjusted. */
+ccl_device_inline void kernel_adaptive_unconverge(KernelGlobals *kg,
+                                                  ccl_global float *buffer,
+                                                  int sample)
+{
+  ccl_global float *aux_w = buffer + kernel_data.film.pass_adaptive_aux_buffer + 3;
+  if (*aux_w == (float)sample) {
+    *aux_w = 0.0f;
+  }
+}
+
+/* Dilate unconverged pixels along a row of the tile. Returns true if any pixel
+ * in the row still needs more samples. */
+ccl_device bool kernel_do_adaptive_filter_x(KernelGlobals *kg,
+                                            ccl_global float *render_buffer,
+                                            int y,
+                                            int tile_x,
+                                            int tile_w,
+                                            int offset,
+                                            int stride,
+                                            int sample)
+{
+  int pass_stride = kernel_data.film.pass_stride;
+  bool any = false;
+  bool prev = false;
+
+  for (int x = tile_x; x < tile_x + tile_w; ++x) {
+    ccl_global float *buffer = render_buffer + (offset + x + y * stride) * pass_stride;
+
+    if (!kernel_adaptive_pixel_is_converged(kg, buffer)) {
+      any = true;
+      if (x > tile_x && !prev) {
+        kernel_adaptive_unconverge(kg, buffer - pass_stride, sample);
+      }
+      prev = true;
+    }
+    else {
+      if (prev) {
+        kernel_adaptive_unconverge(kg, buffer, sample);
+      }
+      prev = false;
+    }
+  }
+
+  return any;
+}
+
+/* Dilate unconverged pixels along a column of the tile. Returns true if any
+ * pixel in the column still needs more samples. */
+ccl_device bool kernel_do_adaptive_filter_y(KernelGlobals *kg,
+                                            ccl_global float *render_buffer,
+                                            int x,
+                                            int tile_y,
+                                            int tile_h,
+                                            int offset,
+                                            int stride,
+                                            int sample)
+{
+  int pass_stride = kernel_data.film.pass_stride;
+  bool any = false;
+  bool prev = false;
+
+  for (int y = tile_y; y < tile_y + tile_h; ++y) {
+    ccl_global float *buffer = render_buffer + (offset + x + y * stride) * pass_stride;
+
+    if (!kernel_adaptive_pixel_is_converged(kg, buffer)) {
+      any = true;
+      if (y > tile_y && !prev) {
+        kernel_adaptive_unconverge(kg, buffer - stride * pass_stride, sample);
+      }
+      prev = true;
+    }
+    else {
+      if (prev) {
+        kernel_adaptive_unconverge(kg, buffer, sample);
+      }
+      prev = false;
+    }
+  }
+
+  return any;
+}
+
+ccl_device_inline void kernel_adaptive_scale_pass(ccl_global float *buffer,
+                                                  int components,
+                                                  float scale)
+{
+  for (int i = 0; i < components; i++) {
+    buffer[i] *= scale;
+  }
+}
+
+/* Scale the accumulated values of a converged pixel so that they match the
+ * number of samples taken by the rest of the tile. */
+ccl_device void kernel_adaptive_post_adjust(KernelGlobals *kg,
+                                            ccl_global float *buffer,
+                                            int sample)
+{
+  ccl_global float *aux = buffer + kernel_data.film.pass_adaptive_aux_buffer;
+  if (aux[3] <= 0.0f || aux[3] >= (float)sample) {
+    return;
+  }
+
+  const float sample_multiplier = (float)sample / aux[3];
+  aux[3] = (float)sample;
+
+  kernel_adaptive_scale_pass(buffer + kernel_data.film.pass_combined, 4, sample_multiplier);
+  /* The aux pass has to be scaled too, for progressive rendering to keep
+   * comparing against the combined pass correctly. */
+  kernel_adaptive_scale_pass(aux, 3, sample_multiplier);
+
+#ifdef __PASSES__
+  int flag = kernel_data.film.pass_flag;
+  int light_flag = kernel_data.film.light_pass_flag;
+
+  if (flag & PASSMASK(NORMAL))
+    kernel_adaptive_scale_pass(buffer + kernel_data.film.pass_normal, 3, sample_multiplier);
+  if (flag & PASSMASK(UV))
+    kernel_adaptive_scale_pass(buffer + kernel_data.film.pass_uv, 3, sample_multiplier);
+  if (flag & PASSMASK(MOTION)) {
+    kernel_adaptive_scale_pass(buffer + kernel_data.film.pass_motion, 4, sample_multiplier);
+    kernel_adaptive_scale_pass(buffer + kernel_data.film.pass_motion_weight, 1, sample_multiplier);
+  }
+
+  if (kernel_data.film.use_light_pass) {
+    if (light_flag & PASSMASK(DIFFUSE_INDIRECT))
+      kernel_adaptive_scale_pass(
+          buffer + kernel_data.film.pass_diffuse_indirect, 3, sample_multiplier);
+    if (light_flag & PASSMASK(GLOSSY_INDIRECT))
+      kernel_adaptive_scale_pass(
+          buffer + kernel_data.film.pass_glossy_indirect, 3, sample_multiplier);
+    if (light_flag & PASSMASK(TRANSMISSION_INDIRECT))
+      kernel_adaptive_scale_pass(
+          buffer + kernel_data.film.pass_transmission_indirect, 3, sample_multiplier);
+    if (light_flag & PASSMASK(SUBSURFACE_INDIRECT))
+      kernel_adaptive_scale_pass(
+          buffer + kernel_data.film.pass_subsurface_indirect, 3, sample_multiplier);
+    if (light_flag & PASSMASK(VOLUME_INDIRECT))
+      kernel_adaptive_scale_pass(
+          buffer + kernel_data.film.pass_volume_indirect, 3, sample_multiplier);
+    if (light_flag & PASSMASK(DIFFUSE_DIRECT))
+      kernel_adaptive_scale_pass(
+          buffer + kernel_data.film.pass_diffuse_direct, 3, sample_multiplier);
+    if (light_flag & PASSMASK(GLOSSY_DIRECT))
+      kernel_adaptive_scale_pass(
+          buffer + kernel_data.film.pass_glossy_direct, 3, sample_multiplier);
+    if (light_flag & PASSMASK(TRANSMISSION_DIRECT))
+      kernel_adaptive_scale_pass(
+          buffer + kernel_data.film.pass_transmission_direct, 3, sample_multiplier);
+    if (light_flag & PASSMASK(SUBSURFACE_DIRECT))
+      kernel_adaptive_scale_pass(
+          buffer + kernel_data.film.pass_subsurface_direct, 3, sample_multiplier);
+    if (light_flag & PASSMASK(VOLUME_DIRECT))
+      kernel_adaptive_scale_pass(
+          buffer + kernel_data.film.pass_volume_direct, 3, sample_multiplier);
+
+    if (light_flag & PASSMASK(EMISSION))
+      kernel_adaptive_scale_pass(buffer + kernel_data.film.pass_emission, 3, sample_multiplier);
+    if (light_flag & PASSMASK(BACKGROUND))
+      kernel_adaptive_scale_pass(
+          buffer + kernel_data.film.pass_background, 3, sample_multiplier);
+    if (light_flag & PASSMASK(AO))
+      kernel_adaptive_scale_pass(buffer + kernel_data.film.pass_ao, 3, sample_multiplier);
+
+    if (light_flag & PASSMASK(DIFFUSE_COLOR))
+      kernel_adaptive_scale_pass(
+          buffer + kernel_data.film.pass_diffuse_color, 3, sample_multiplier);
+    if (light_flag & PASSMASK(GLOSSY_COLOR))
+      kernel_adaptive_scale_pass(
+          buffer + kernel_data.film.pass_glossy_color, 3, sample_multiplier);
+    if (light_flag & PASSMASK(TRANSMISSION_COLOR))
+      kernel_adaptive_scale_pass(
+          buffer + kernel_data.film.pass_transmission_color, 3, sample_multiplier);
+    if (light_flag & PASSMASK(SUBSURFACE_COLOR))
+      kernel_adaptive_scale_pass(
+          buffer + kernel_data.film.pass_subsurface_color, 3, sample_multiplier);
+    if (light_flag & PASSMASK(SHADOW))
+      kernel_adaptive_scale_pass(buffer + kernel_data.film.pass_shadow, 4, sample_multiplier);
+    if (light_flag & PASSMASK(MIST))
+      kernel_adaptive_scale_pass(buffer + kernel_data.film.pass_mist, 1, sample_multiplier);
+  }
+
+  if (kernel_data.film.cryptomatte_passes) {
+    /* Only the coverage weights are accumulated, the IDs are left untouched. */
+    int num_slots = 0;
+    num_slots += (kernel_data.film.cryptomatte_passes & CRYPT_OBJECT) ? 1 : 0;
+    num_slots += (kernel_data.film.cryptomatte_passes & CRYPT_MATERIAL) ? 1 : 0;
+    num_slots += (kernel_data.film.cryptomatte_passes & CRYPT_ASSET) ? 1 : 0;
+    num_slots = num_slots * 2 * kernel_data.film.cryptomatte_depth;
+    ccl_global float *id_buffer = buffer + kernel_data.film.pass_cryptomatte;
+    for (int slot = 0; slot < num_slots; slot++) {
+      id_buffer[slot * 2 + 1] *= sample_multiplier;
+    }
+  }
+#endif /* __PASSES__ */
+
+#ifdef __DENOISING_FEATURES__
+  if (kernel_data.film.pass_denoising_data) {
+    /* All denoising features are plain sums of values or squared values, so
+     * they scale linearly with the number of samples. */
+    kernel_adaptive_scale_pass(buffer + kernel_data.film.pass_denoising_data,
+                               DENOISING_PASS_SIZE_BASE,
+                               sample_multiplier);
+    if (kernel_data.film.pass_denoising_clean) {
+      kernel_adaptive_scale_pass(
+          buffer + kernel_data.film.pass_denoising_clean, 3, sample_multiplier);
+    }
+  }
+#endif /* __DENOISING_FEATURES__ */
+}
+
+CCL_NAMESPACE_END
+
+#endif /* __KERNEL_ADAPTIVE_SAMPLING_H__ */
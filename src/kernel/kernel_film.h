@@ -225,4 +225,99 @@ ccl_device void kernel_film_convert_to_float(KernelGlobals *kg,
   }
 }
 
+#ifdef __KERNEL_CPU__
+ccl_device_inline void film_store_float4(float *out, const float4 f)
+{
+#  ifdef __KERNEL_SSE__
+  _mm_storeu_ps(out, f.m128);
+#  else
+  out[0] = f.x;
+  out[1] = f.y;
+  out[2] = f.z;
+  out[3] = f.w;
+#  endif
+}
+
+/* Convert a row of pixels of one pass. This restructures the loop of
+ * kernel_film_convert_to_float, it does not vectorize across pixels: for the
+ * common case of a combined pass without divide pass or pixel size, the pass
+ * layout is looked up once for the row and every pixel is still converted
+ * with its own float4 load, multiply and store. Other passes are converted
+ * pixel by pixel. */
+ccl_device void kernel_film_convert_row_to_float(KernelGlobals *kg,
+                                                 float *rgba,
+                                                 float *buffer,
+                                                 float sample_scale,
+                                                 int pass_type,
+                                                 int x,
+                                                 int y,
+                                                 int w,
+                                                 int height,
+                                                 int offset,
+                                                 int stride,
+                                                 int full_width,
+                                                 int full_height,
+                                                 int pixel_size)
+{
+  const bool use_fast_path = (pass_type == PASS_COMBINED) && (pixel_size == 1) &&
+                             (kernel_data.film.pass_flag & (1 << PASS_COMBINED)) &&
+                             (kernel_data.film.display_divide_pass_stride == -1);
+
+  if (!use_fast_path) {
+    for (int i = x; i < x + w; i++) {
+      kernel_film_convert_to_float(kg,
+                                   rgba,
+                                   buffer,
+                                   sample_scale,
+                                   pass_type,
+                                   i,
+                                   y,
+                                   height,
+                                   offset,
+                                   stride,
+                                   full_width,
+                                   full_height,
+                                   pixel_size);
+    }
+    return;
+  }
+
+  const int pass_stride = kernel_data.film.pass_stride;
+  const float *in = buffer + kernel_data.film.pass_combined + (offset + x + y * stride) * pass_stride;
+  float *out = rgba + (offset + x + y * full_width) * 4;
+
+  /* Same as film_get_pass_result, note that exposure also scales alpha by
+   * itself. */
+  const float exposure = kernel_data.film.use_display_exposure ? kernel_data.film.exposure : 1.0f;
+  const float3 color_scale = make_float3(exposure * sample_scale);
+
+  if (kernel_data.film.use_display_pass_alpha) {
+    const bool square_alpha = kernel_data.film.use_display_exposure;
+    const float4 scale = make_float4(color_scale.x, color_scale.y, color_scale.z, sample_scale);
+
+    for (int i = 0; i < w; i++, in += pass_stride, out += 4) {
+      float4 result = load_float4(in) * scale;
+      if (square_alpha) {
+        result.w *= in[3];
+      }
+      film_store_float4(out, result);
+    }
+  }
+  else {
+    float alpha = 1.0f / sample_scale;
+    if (kernel_data.film.use_display_exposure) {
+      alpha *= alpha;
+    }
+    const float4 scale = make_float4(color_scale.x, color_scale.y, color_scale.z, 1.0f);
+    alpha *= sample_scale;
+
+    for (int i = 0; i < w; i++, in += pass_stride, out += 4) {
+      float4 result = load_float4(in) * scale;
+      result.w = alpha;
+      film_store_float4(out, result);
+    }
+  }
+}
+#endif
+
 CCL_NAMESPACE_END
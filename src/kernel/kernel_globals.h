@@ -24,6 +24,7 @@
 #ifdef __KERNEL_CPU__
 #  include "util/util_vector.h"
 #  include "util/util_map.h"
+#  include "util/util_unique_ptr.h"
 #endif
 
 #ifdef __KERNEL_OPENCL__
@@ -45,7 +46,76 @@ struct OSLThreadData;
 struct OSLShadingSystem;
 #  endif
 
-typedef unordered_map<float, float> CoverageMap;
+/* Accumulated weight per cryptomatte ID of a single pixel, for accurate mode.
+ *
+ * IDs are stored in a small open addressing hash table whose slots live in an
+ * arena owned by the tile, so accumulating samples does not allocate. Only when
+ * a pixel is covered by more IDs than fit in the table, the remaining IDs go to
+ * a spill map that is allocated on demand. ID_NONE marks empty slots. */
+struct CoverageMapSlot {
+  float id;
+  float weight;
+};
+
+struct CoverageMap {
+  CoverageMapSlot *slots;
+  /* Number of slots, must be a power of two. */
+  int capacity;
+  int size;
+  unique_ptr<unordered_map<float, float>> spill;
+
+  CoverageMap() : slots(NULL), capacity(0), size(0)
+  {
+  }
+
+  void init(CoverageMapSlot *slots_, int capacity_)
+  {
+    slots = slots_;
+    capacity = capacity_;
+    size = 0;
+    spill.reset();
+    for (int i = 0; i < capacity; i++) {
+      slots[i].id = ID_NONE;
+      slots[i].weight = 0.0f;
+    }
+  }
+
+  bool empty() const
+  {
+    return size == 0 && !spill;
+  }
+
+  void add(float id, float weight)
+  {
+    /* Keep at least a quarter of the slots free so probing stays short and
+     * always terminates at an empty slot. */
+    const int max_size = capacity - capacity / 4;
+    const uint mask = capacity - 1;
+    uint i = (__float_as_uint(id) * 0x9E3779B1u) >> 16;
+
+    for (;; i++) {
+      CoverageMapSlot &slot = slots[i & mask];
+      if (slot.id == id) {
+        slot.weight += weight;
+        return;
+      }
+      if (slot.id == ID_NONE) {
+        if (size < max_size) {
+          slot.id = id;
+          slot.weight = weight;
+          size++;
+          return;
+        }
+        break;
+      }
+    }
+
+    if (!spill) {
+      spill.reset(new unordered_map<float, float>());
+    }
+    (*spill)[id] += weight;
+  }
+};
 
 struct Intersection;
 struct VolumeStep;
@@ -73,6 +143,10 @@ typedef struct KernelGlobals {
   VolumeStep *decoupled_volume_steps[2];
   int decoupled_volume_steps_index;
 
+  /* Heap-allocated shader data with only as many closures as the scene needs. */
+  ShaderData *shader_data[3];
+  int shader_data_max_closures[3];
+
   /* A buffer for storing per-pixel coverage for Cryptomatte. */
   CoverageMap *coverage_object;
   CoverageMap *coverage_material;
@@ -82,12 +156,33 @@ typedef struct KernelGlobals {
   SplitData split_data;
   SplitParams split_param_data;
 
+  /* Per shader offsets for sorting the split kernel queue. */
+  uint *shader_sort_buckets;
+  int shader_sort_num_buckets;
+
   int2 global_size;
   int2 global_id;
 
   ProfilingState profiler;
 } KernelGlobals;
 
+/* ShaderData keeps its closures at the end, so like in the split kernel only
+ * the closures up to the scene maximum need to be allocated. This keeps the
+ * per-thread working set small for scenes with simple shaders. */
+inline ShaderData *kernel_shader_data_storage(KernelGlobals *kg, int index)
+{
+  const int max_closures = clamp(kg->__data.integrator.max_closures, 1, MAX_CLOSURE);
+
+  if (kg->shader_data[index] == NULL || kg->shader_data_max_closures[index] < max_closures) {
+    free(kg->shader_data[index]);
+    kg->shader_data[index] = (ShaderData *)malloc(
+        sizeof(ShaderData) - sizeof(ShaderClosure) * (MAX_CLOSURE - max_closures));
+    kg->shader_data_max_closures[index] = max_closures;
+  }
+
+  return kg->shader_data[index];
+}
+
 #endif /* __KERNEL_CPU__ */
 
 #ifdef __KERNEL_OPTIX__
@@ -0,0 +1,242 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+CCL_NAMESPACE_BEGIN
+
+/* Light Tree
+ *
+ * Emissive triangles and lamps with a position are each organized in a
+ * bounding volume hierarchy, whose nodes also bound the emission directions
+ * and energy of the lights below them. A light is picked by descending the
+ * tree, choosing children proportional to an estimate of their contribution
+ * at the shading point, following "Importance Sampling of Many Lights with
+ * Adaptive Tree Splitting" (Estevez and Kulla).
+ *
+ * Triangles, lamps and distant lights are picked with the same probabilities
+ * as in the flat light distribution, so only the choice within each of these
+ * groups depends on the shading point. The estimate does not use the normal
+ * at the shading point, since it is not known when evaluating the PDF of
+ * lights hit by indirect rays. */
+
+ccl_device float light_tree_node_importance(KernelGlobals *kg, int index, float3 P)
+{
+  const ccl_global KernelLightTreeNode *knode = &kernel_tex_fetch(__light_tree_nodes, index);
+
+  if (knode->energy == 0.0f) {
+    return 0.0f;
+  }
+
+  const float3 bbox_min = make_float3(
+      knode->bbox_min[0], knode->bbox_min[1], knode->bbox_min[2]);
+  const float3 bbox_max = make_float3(
+      knode->bbox_max[0], knode->bbox_max[1], knode->bbox_max[2]);
+  const float3 axis = make_float3(knode->axis[0], knode->axis[1], knode->axis[2]);
+
+  const float3 centroid = 0.5f * (bbox_min + bbox_max);
+  const float radius = 0.5f * len(bbox_max - bbox_min);
+
+  float distance;
+  const float3 D = normalize_len(P - centroid, &distance);
+
+  /* Smallest angle between the emission directions and the direction to the
+   * shading point, as seen from anywhere inside the bounds. */
+  float theta_u = M_PI_F;
+  if (distance > radius) {
+    theta_u = fast_asinf(radius / distance);
+  }
+  const float theta = fast_acosf(dot(axis, D));
+  const float theta_p = max(theta - knode->theta_o - theta_u, 0.0f);
+
+  if (theta_p > knode->theta_e) {
+    return 0.0f;
+  }
+
+  /* Clamp the distance so lights close to the shading point do not dominate
+   * the estimate of the whole cluster. */
+  const float distance_squared = max(distance * distance, max(0.25f * radius * radius, 1e-8f));
+
+  return knode->energy * fast_cosf(min(theta_p, M_PI_2_F)) / distance_squared;
+}
+
+/* Pick an emitter in the tree below the given root, returns its index in the
+ * light distribution or -1 if no light contributes at P. */
+ccl_device int light_tree_sample_group(
+    KernelGlobals *kg, int root, float3 P, float *randu, float *pdf)
+{
+  int index = root;
+  const ccl_global KernelLightTreeNode *knode = &kernel_tex_fetch(__light_tree_nodes, index);
+
+  while (knode->num_emitters == 0) {
+    const int left = index + 1;
+    const int right = knode->child_index;
+    const float importance_left = light_tree_node_importance(kg, left, P);
+    const float importance_right = light_tree_node_importance(kg, right, P);
+    const float importance = importance_left + importance_right;
+
+    if (importance == 0.0f) {
+      return -1;
+    }
+
+    /* Rescale random number to reuse it in the chosen child. */
+    const float prob_left = importance_left / importance;
+    if (*randu < prob_left) {
+      *randu = *randu / prob_left;
+      *pdf *= prob_left;
+      index = left;
+    }
+    else {
+      *randu = (*randu - prob_left) / (1.0f - prob_left);
+      *pdf *= 1.0f - prob_left;
+      index = right;
+    }
+    *randu = min(*randu, 1.0f - FLT_EPSILON);
+
+    knode = &kernel_tex_fetch(__light_tree_nodes, index);
+  }
+
+  /* Pick an emitter of the leaf proportional to its energy. */
+  const int first = knode->child_index;
+  const int last = first + knode->num_emitters - 1;
+  float r = *randu * knode->energy;
+
+  for (int i = first; i <= last; i++) {
+    const int distribution_index = kernel_tex_fetch(__light_tree_leaf_emitters, i);
+    const float energy = kernel_tex_fetch(__light_tree_emitters, distribution_index).energy;
+
+    if (r < energy || i == last) {
+      if (energy == 0.0f) {
+        return -1;
+      }
+      *randu = min(r / energy, 1.0f - FLT_EPSILON);
+      *pdf *= energy / knode->energy;
+      return distribution_index;
+    }
+    r -= energy;
+  }
+
+  return -1;
+}
+
+/* Pick a light at P, returns its index in the light distribution or -1. The
+ * PDF of the light sample computed for the flat distribution has to be
+ * multiplied by pdf_scale. */
+ccl_device int light_tree_sample(KernelGlobals *kg, float3 P, float *randu, float *pdf_scale)
+{
+  float r = *randu;
+  const float pdf_triangles = kernel_data.integrator.light_tree_pdf_triangles;
+  const float pdf_lamps = kernel_data.integrator.light_tree_pdf_lamps;
+
+  int root;
+  if (r < pdf_triangles) {
+    *randu = r / pdf_triangles;
+    root = kernel_data.integrator.light_tree_triangle_root;
+  }
+  else if (r < pdf_triangles + pdf_lamps) {
+    *randu = (r - pdf_triangles) / pdf_lamps;
+    root = kernel_data.integrator.light_tree_lamp_root;
+  }
+  else {
+    /* Distant and background lights are picked uniformly like in the flat
+     * distribution. */
+    const int num_infinite = kernel_data.integrator.light_tree_num_infinite;
+    if (num_infinite == 0) {
+      return -1;
+    }
+    const float pdf_light = kernel_data.integrator.pdf_lights;
+    r = (r - pdf_triangles - pdf_lamps) / pdf_light;
+    const int i = clamp(float_to_int(r), 0, num_infinite - 1);
+    *randu = clamp(r - i, 0.0f, 1.0f - FLT_EPSILON);
+    *pdf_scale = 1.0f;
+    return kernel_tex_fetch(__light_tree_leaf_emitters,
+                            kernel_data.integrator.light_tree_infinite_offset + i);
+  }
+
+  if (root < 0) {
+    return -1;
+  }
+
+  float pdf = 1.0f;
+  const int index = light_tree_sample_group(kg, root, P, randu, &pdf);
+  if (index < 0) {
+    return -1;
+  }
+
+  *pdf_scale = pdf * kernel_tex_fetch(__light_tree_emitters, index).pdf_scale;
+  return index;
+}
+
+/* Ratio between the probability of picking the light distribution entry at P
+ * with the tree and with the flat distribution. */
+ccl_device float light_tree_pdf_scale(KernelGlobals *kg, float3 P, int distribution_index)
+{
+  const ccl_global KernelLightTreeEmitter *kemitter = &kernel_tex_fetch(__light_tree_emitters,
+                                                                         distribution_index);
+  int index = kemitter->leaf;
+  if (index < 0) {
+    return 1.0f;
+  }
+
+  const ccl_global KernelLightTreeNode *knode = &kernel_tex_fetch(__light_tree_nodes, index);
+  if (knode->energy == 0.0f) {
+    return 0.0f;
+  }
+  float pdf = kemitter->energy / knode->energy;
+
+  /* Walk up to the root, multiplying the probabilities of choosing each node
+   * over its sibling. */
+  int parent = knode->parent;
+  while (parent != -1) {
+    const ccl_global KernelLightTreeNode *kparent = &kernel_tex_fetch(__light_tree_nodes,
+                                                                      parent);
+    const int left = parent + 1;
+    const int right = kparent->child_index;
+    const float importance_left = light_tree_node_importance(kg, left, P);
+    const float importance_right = light_tree_node_importance(kg, right, P);
+    const float importance = importance_left + importance_right;
+
+    if (importance == 0.0f) {
+      return 0.0f;
+    }
+    pdf *= ((index == left) ? importance_left : importance_right) / importance;
+
+    index = parent;
+    parent = kparent->parent;
+  }
+
+  return pdf * kemitter->pdf_scale;
+}
+
+ccl_device float light_tree_triangle_pdf_scale(KernelGlobals *kg,
+                                               float3 P,
+                                               int object,
+                                               int prim)
+{
+  const uint2 kobject = kernel_tex_fetch(__light_tree_objects, object);
+  if (kobject.x == ~0u) {
+    return 0.0f;
+  }
+  return light_tree_pdf_scale(kg, P, kobject.x + (prim - kobject.y));
+}
+
+ccl_device float light_tree_lamp_pdf_scale(KernelGlobals *kg, float3 P, int lamp)
+{
+  /* Lamps follow the triangles in the light distribution. */
+  const int num_triangles = kernel_data.integrator.num_distribution -
+                            kernel_data.integrator.num_all_lights;
+  return light_tree_pdf_scale(kg, P, num_triangles + lamp);
+}
+
+CCL_NAMESPACE_END
@@ -140,7 +140,7 @@ ccl_device_inline size_t kernel_write_id_pass_cpu(
     float *buffer, size_t depth, float id, float matte_weight, CoverageMap *map)
 {
   if (map) {
-    (*map)[id] += matte_weight;
+    map->add(id, matte_weight);
     return 0;
   }
 #else /* __KERNEL_CPU__ */
@@ -348,6 +348,18 @@ ccl_device_inline void kernel_write_result(KernelGlobals *kg,
 
   kernel_write_light_passes(kg, buffer, L);
 
+#ifdef __ADAPTIVE_SAMPLING__
+  /* Every second sample also goes into the aux pass, scaled so that it can be
+   * compared against the combined pass to estimate the error. */
+  if (kernel_data.film.pass_adaptive_aux_buffer && (sample & 1)) {
+    kernel_write_pass_float4(buffer + kernel_data.film.pass_adaptive_aux_buffer,
+                             make_float4(L_sum.x * 2.0f, L_sum.y * 2.0f, L_sum.z * 2.0f, 0.0f));
+  }
+  if (kernel_data.film.pass_sample_count) {
+    kernel_write_pass_float(buffer + kernel_data.film.pass_sample_count, 1.0f);
+  }
+#endif /* __ADAPTIVE_SAMPLING__ */
+
 #ifdef __DENOISING_FEATURES__
   if (kernel_data.film.pass_denoising_data) {
 #  ifdef __SHADOW_TRICKS__
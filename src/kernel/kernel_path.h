@@ -30,8 +30,10 @@
 #include "kernel/kernel_write_passes.h"
 #include "kernel/kernel_accumulate.h"
 #include "kernel/kernel_shader.h"
+#include "kernel/kernel_light_tree.h"
 #include "kernel/kernel_light.h"
 #include "kernel/kernel_passes.h"
+#include "kernel/kernel_adaptive_sampling.h"
 
 #if defined(__VOLUME__) || defined(__SUBSURFACE__)
 #  include "kernel/kernel_volume.h"
@@ -173,7 +175,8 @@ ccl_device_forceinline VolumeIntegrateResult kernel_path_volume(KernelGlobals *k
 #    ifdef __VOLUME_DECOUPLED__
   int sampling_method = volume_stack_sampling_method(kg, state->volume_stack);
   bool direct = (state->flag & PATH_RAY_CAMERA) != 0;
-  bool decoupled = kernel_volume_use_decoupled(kg, heterogeneous, direct, sampling_method);
+  bool decoupled = kernel_volume_use_decoupled(
+      kg, state->volume_stack, heterogeneous, direct, sampling_method);
 
   if (decoupled) {
     /* cache steps along volume for repeated sampling */
@@ -526,7 +529,7 @@ ccl_device_forceinline void kernel_path_integrate(KernelGlobals *kg,
   PROFILING_INIT(kg, PROFILING_PATH_INTEGRATE);
 
   /* Shader data memory used for both volumes and surfaces, saves stack space. */
-  ShaderData sd;
+  SHADER_DATA_STORAGE(sd, kg, 0);
 
 #  ifdef __SUBSURFACE__
   SubsurfaceIndirectRays ss_indirect;
@@ -542,12 +545,12 @@ ccl_device_forceinline void kernel_path_integrate(KernelGlobals *kg,
       bool hit = kernel_path_scene_intersect(kg, state, ray, &isect, L);
 
       /* Find intersection with lamps and compute emission for MIS. */
-      kernel_path_lamp_emission(kg, state, ray, throughput, &isect, &sd, L);
+      kernel_path_lamp_emission(kg, state, ray, throughput, &isect, sd, L);
 
 #  ifdef __VOLUME__
       /* Volume integration. */
       VolumeIntegrateResult result = kernel_path_volume(
-          kg, &sd, state, ray, &throughput, &isect, hit, emission_sd, L);
+          kg, sd, state, ray, &throughput, &isect, hit, emission_sd, L);
 
       if (result == VOLUME_PATH_SCATTERED) {
         continue;
@@ -559,7 +562,7 @@ ccl_device_forceinline void kernel_path_integrate(KernelGlobals *kg,
 
       /* Shade background. */
       if (!hit) {
-        kernel_path_background(kg, state, ray, throughput, &sd, buffer, L);
+        kernel_path_background(kg, state, ray, throughput, sd, buffer, L);
         break;
       }
       else if (path_state_ao_bounce(kg, state)) {
@@ -567,23 +570,23 @@ ccl_device_forceinline void kernel_path_integrate(KernelGlobals *kg,
       }
 
       /* Setup shader data. */
-      shader_setup_from_ray(kg, &sd, &isect, ray);
+      shader_setup_from_ray(kg, sd, &isect, ray);
 
-    if (path_clip_ray(kg, state, &sd, ray)) {
+    if (path_clip_ray(kg, state, sd, ray)) {
       continue;
     }
 
       /* Skip most work for volume bounding surface. */
 #  ifdef __VOLUME__
-      if (!(sd.flag & SD_HAS_ONLY_VOLUME)) {
+      if (!(sd->flag & SD_HAS_ONLY_VOLUME)) {
 #  endif
 
         /* Evaluate shader. */
-        shader_eval_surface(kg, &sd, state, buffer, state->flag);
-        shader_prepare_closures(&sd, state);
+        shader_eval_surface(kg, sd, state, buffer, state->flag);
+        shader_prepare_closures(sd, state);
 
         /* Apply shadow catcher, holdout, emission. */
-        if (!kernel_path_shader_apply(kg, &sd, state, ray, throughput, emission_sd, L, buffer)) {
+        if (!kernel_path_shader_apply(kg, sd, state, ray, throughput, emission_sd, L, buffer)) {
           break;
         }
 
@@ -604,22 +607,22 @@ ccl_device_forceinline void kernel_path_integrate(KernelGlobals *kg,
         }
 
 #  ifdef __DENOISING_FEATURES__
-        kernel_update_denoising_features(kg, &sd, state, L);
+        kernel_update_denoising_features(kg, sd, state, L);
 #  endif
 
 #  ifdef __AO__
         /* ambient occlusion */
         if (kernel_data.integrator.use_ambient_occlusion) {
-          kernel_path_ao(kg, &sd, emission_sd, L, state, throughput, shader_bsdf_alpha(kg, &sd));
+          kernel_path_ao(kg, sd, emission_sd, L, state, throughput, shader_bsdf_alpha(kg, sd));
         }
 #  endif /* __AO__ */
 
 #  ifdef __SUBSURFACE__
         /* bssrdf scatter to a different location on the same object, replacing
          * the closures with a diffuse BSDF */
-        if (sd.flag & SD_BSSRDF) {
+        if (sd->flag & SD_BSSRDF) {
           if (kernel_path_subsurface_scatter(
-                  kg, &sd, emission_sd, L, state, ray, &throughput, &ss_indirect)) {
+                  kg, sd, emission_sd, L, state, ray, &throughput, &ss_indirect)) {
             break;
           }
         }
@@ -627,7 +630,7 @@ ccl_device_forceinline void kernel_path_integrate(KernelGlobals *kg,
 
 #  ifdef __EMISSION__
         /* direct lighting */
-        kernel_path_surface_connect_light(kg, &sd, emission_sd, throughput, state, L);
+        kernel_path_surface_connect_light(kg, sd, emission_sd, throughput, state, L);
 #  endif /* __EMISSION__ */
 
 #  ifdef __VOLUME__
@@ -635,7 +638,7 @@ ccl_device_forceinline void kernel_path_integrate(KernelGlobals *kg,
 #  endif
 
       /* compute direct lighting and next bounce */
-      if (!kernel_path_surface_bounce(kg, &sd, &throughput, state, &L->state, ray))
+      if (!kernel_path_surface_bounce(kg, sd, &throughput, state, &L->state, ray))
         break;
     }
 
@@ -664,6 +667,13 @@ ccl_device void kernel_path_trace(
 
   buffer += index * pass_stride;
 
+#  ifdef __ADAPTIVE_SAMPLING__
+  if (kernel_data.film.pass_adaptive_aux_buffer &&
+      kernel_adaptive_pixel_is_converged(kg, buffer)) {
+    return;
+  }
+#  endif
+
   /* Initialize random numbers and sample ray. */
   uint rng_hash;
   Ray ray;
@@ -94,8 +94,12 @@ ccl_device_forceinline void kernel_branched_path_volume(KernelGlobals *kg,
   bool heterogeneous = volume_stack_is_heterogeneous(kg, state->volume_stack);
 
 #      ifdef __VOLUME_DECOUPLED__
-  /* decoupled ray marching only supported on CPU */
-  if (kernel_data.integrator.volume_decoupled) {
+  /* decoupled ray marching only supported on CPU, heterogeneous volumes with
+   * a majorant grid are tracked like in kernel_volume_use_decoupled */
+  bool decoupled = kernel_data.integrator.volume_decoupled &&
+                   !(heterogeneous && kernel_volume_majorant_index(kg, state->volume_stack) >= 0);
+
+  if (decoupled) {
     /* cache steps along volume for repeated sampling */
     VolumeSegment volume_segment;
 
@@ -155,7 +159,8 @@ ccl_device_forceinline void kernel_branched_path_volume(KernelGlobals *kg,
   else
 #      endif /* __VOLUME_DECOUPLED__ */
   {
-    /* GPU: no decoupled ray marching, scatter probalistically */
+    /* GPU or majorant tracking: no decoupled ray marching, scatter
+     * probalistically */
     int num_samples = kernel_data.integrator.volume_samples;
     float num_samples_inv = 1.0f / num_samples;
 
@@ -325,17 +330,18 @@ ccl_device void kernel_branched_path_subsurface_scatter(KernelGlobals *kg,
 
       /* compute lighting with the BSDF closure */
       for (int hit = 0; hit < num_hits; hit++) {
-        ShaderData bssrdf_sd = *sd;
+        SHADER_DATA_STORAGE(bssrdf_sd, kg, 2);
+        shader_data_copy(bssrdf_sd, sd);
         Bssrdf *bssrdf = (Bssrdf *)sc;
         ClosureType bssrdf_type = sc->type;
         float bssrdf_roughness = bssrdf->roughness;
         subsurface_scatter_multi_setup(
-            kg, &ss_isect, hit, &bssrdf_sd, &hit_state, bssrdf_type, bssrdf_roughness);
+            kg, &ss_isect, hit, bssrdf_sd, &hit_state, bssrdf_type, bssrdf_roughness);
 
 #      ifdef __VOLUME__
         if (need_update_volume_stack) {
           /* Setup ray from previous surface point to the new one. */
-          float3 P = ray_offset(bssrdf_sd.P, -bssrdf_sd.Ng);
+          float3 P = ray_offset(bssrdf_sd->P, -bssrdf_sd->Ng);
           volume_ray.D = normalize_len(P - volume_ray.P, &volume_ray.t);
 
           for (int k = 0; k < VOLUME_STACK_SIZE; k++) {
@@ -353,13 +359,13 @@ ccl_device void kernel_branched_path_subsurface_scatter(KernelGlobals *kg,
           int all = (kernel_data.integrator.sample_all_lights_direct) ||
                     (hit_state.flag & PATH_RAY_SHADOW_CATCHER);
           kernel_branched_path_surface_connect_light(
-              kg, &bssrdf_sd, emission_sd, &hit_state, throughput, num_samples_inv, L, all);
+              kg, bssrdf_sd, emission_sd, &hit_state, throughput, num_samples_inv, L, all);
         }
 #      endif /* __EMISSION__ */
 
         /* indirect light */
         kernel_branched_path_surface_indirect_light(
-            kg, &bssrdf_sd, indirect_sd, emission_sd, throughput, num_samples_inv, &hit_state, L);
+            kg, bssrdf_sd, indirect_sd, emission_sd, throughput, num_samples_inv, &hit_state, L);
       }
     }
   }
@@ -379,11 +385,11 @@ ccl_device void kernel_branched_path_integrate(KernelGlobals *kg,
   path_radiance_init(kg, L);
 
   /* shader data memory used for both volumes and surfaces, saves stack space */
-  ShaderData sd;
+  SHADER_DATA_STORAGE(sd, kg, 0);
   /* shader data used by emission, shadows, volume stacks, indirect path */
   ShaderDataTinyStorage emission_sd_storage;
   ShaderData *emission_sd = AS_SHADER_DATA(&emission_sd_storage);
-  ShaderData indirect_sd;
+  SHADER_DATA_STORAGE(indirect_sd, kg, 1);
 
   PathState state;
   path_state_init(kg, emission_sd, &state, rng_hash, sample, &ray);
@@ -400,28 +406,28 @@ ccl_device void kernel_branched_path_integrate(KernelGlobals *kg,
 #    ifdef __VOLUME__
     /* Volume integration. */
     kernel_branched_path_volume(
-        kg, &sd, &state, &ray, &throughput, &isect, hit, &indirect_sd, emission_sd, L);
+        kg, sd, &state, &ray, &throughput, &isect, hit, indirect_sd, emission_sd, L);
 #    endif /* __VOLUME__ */
 
     /* Shade background. */
     if (!hit) {
-      kernel_path_background(kg, &state, &ray, throughput, &sd, buffer, L);
+      kernel_path_background(kg, &state, &ray, throughput, sd, buffer, L);
       break;
     }
 
     /* Setup and evaluate shader. */
-    shader_setup_from_ray(kg, &sd, &isect, &ray);
+    shader_setup_from_ray(kg, sd, &isect, &ray);
 
     /* Skip most work for volume bounding surface. */
 #    ifdef __VOLUME__
-    if (!(sd.flag & SD_HAS_ONLY_VOLUME)) {
+    if (!(sd->flag & SD_HAS_ONLY_VOLUME)) {
 #    endif
 
-      shader_eval_surface(kg, &sd, &state, buffer, state.flag);
-      shader_merge_closures(&sd);
+      shader_eval_surface(kg, sd, &state, buffer, state.flag);
+      shader_merge_closures(sd);
 
       /* Apply shadow catcher, holdout, emission. */
-      if (!kernel_path_shader_apply(kg, &sd, &state, &ray, throughput, emission_sd, L, buffer)) {
+      if (!kernel_path_shader_apply(kg, sd, &state, &ray, throughput, emission_sd, L, buffer)) {
         break;
       }
 
@@ -446,21 +452,21 @@ ccl_device void kernel_branched_path_integrate(KernelGlobals *kg,
       }
 
 #    ifdef __DENOISING_FEATURES__
-      kernel_update_denoising_features(kg, &sd, &state, L);
+      kernel_update_denoising_features(kg, sd, &state, L);
 #    endif
 
 #    ifdef __AO__
       /* ambient occlusion */
       if (kernel_data.integrator.use_ambient_occlusion) {
-        kernel_branched_path_ao(kg, &sd, emission_sd, L, &state, throughput);
+        kernel_branched_path_ao(kg, sd, emission_sd, L, &state, throughput);
       }
 #    endif /* __AO__ */
 
 #    ifdef __SUBSURFACE__
       /* bssrdf scatter to a different location on the same object */
-      if (sd.flag & SD_BSSRDF) {
+      if (sd->flag & SD_BSSRDF) {
         kernel_branched_path_subsurface_scatter(
-            kg, &sd, &indirect_sd, emission_sd, L, &state, &ray, throughput);
+            kg, sd, indirect_sd, emission_sd, L, &state, &ray, throughput);
       }
 #    endif /* __SUBSURFACE__ */
 
@@ -472,16 +478,16 @@ ccl_device void kernel_branched_path_integrate(KernelGlobals *kg,
         int all = (kernel_data.integrator.sample_all_lights_direct) ||
                   (state.flag & PATH_RAY_SHADOW_CATCHER);
         kernel_branched_path_surface_connect_light(
-            kg, &sd, emission_sd, &hit_state, throughput, 1.0f, L, all);
+            kg, sd, emission_sd, &hit_state, throughput, 1.0f, L, all);
       }
 #    endif /* __EMISSION__ */
 
       /* indirect light */
       kernel_branched_path_surface_indirect_light(
-          kg, &sd, &indirect_sd, emission_sd, throughput, 1.0f, &hit_state, L);
+          kg, sd, indirect_sd, emission_sd, throughput, 1.0f, &hit_state, L);
 
       /* continue in case of transparency */
-      throughput *= shader_bsdf_transparency(kg, &sd);
+      throughput *= shader_bsdf_transparency(kg, sd);
 
       if (is_zero(throughput))
         break;
@@ -498,18 +504,18 @@ ccl_device void kernel_branched_path_integrate(KernelGlobals *kg,
     }
 #    endif
 
-    ray.P = ray_offset(sd.P, -sd.Ng);
-    ray.t -= sd.ray_length; /* clipping works through transparent */
+    ray.P = ray_offset(sd->P, -sd->Ng);
+    ray.t -= sd->ray_length; /* clipping works through transparent */
 
 #    ifdef __RAY_DIFFERENTIALS__
-    ray.dP = sd.dP;
-    ray.dD.dx = -sd.dI.dx;
-    ray.dD.dy = -sd.dI.dy;
+    ray.dP = sd->dP;
+    ray.dD.dx = -sd->dI.dx;
+    ray.dD.dy = -sd->dI.dy;
 #    endif /* __RAY_DIFFERENTIALS__ */
 
 #    ifdef __VOLUME__
     /* enter/exit volume */
-    kernel_volume_stack_enter_exit(kg, &sd, state.volume_stack);
+    kernel_volume_stack_enter_exit(kg, sd, state.volume_stack);
 #    endif /* __VOLUME__ */
   }
 }
@@ -523,6 +529,13 @@ ccl_device void kernel_branched_path_trace(
 
   buffer += index * pass_stride;
 
+#    ifdef __ADAPTIVE_SAMPLING__
+  if (kernel_data.film.pass_adaptive_aux_buffer &&
+      kernel_adaptive_pixel_is_converged(kg, buffer)) {
+    return;
+  }
+#    endif
+
   /* initialize random numbers and ray */
   uint rng_hash;
   Ray ray;
@@ -40,7 +40,7 @@ CCL_NAMESPACE_BEGIN
 ccl_device uint sobol_dimension(KernelGlobals *kg, int index, int dimension)
 {
   uint result = 0;
-  uint i = index + SOBOL_SKIP;
+  uint i = index;
   for (int j = 0, x; (x = find_first_set(i)); i >>= x) {
     j += x;
     result ^= kernel_tex_fetch(__sobol_directions, 32 * dimension + j - 1);
@@ -48,8 +48,75 @@ ccl_device uint sobol_dimension(KernelGlobals *kg, int index, int dimension)
   return result;
 }
 
+/* Owen scrambling with the hash based nested uniform scramble from
+ * "Practical Hash-based Owen Scrambling", Burley 2020. Unlike a
+ * Cranley-Patterson rotation this keeps the stratification of the sequence,
+ * so the poor initial samples of some dimensions don't need to be skipped. */
+ccl_device_inline uint sobol_owen_scramble(uint x, uint seed)
+{
+  x = reverse_integer_bits(x);
+  x += seed;
+  x ^= x * 0x6c50b47cu;
+  x ^= x * 0xb82f1e52u;
+  x ^= x * 0xc7afe638u;
+  x ^= x * 0x8d22f6e6u;
+  return reverse_integer_bits(x);
+}
+
 #endif /* __SOBOL__ */
 
+/* Progressive Multi-Jittered (0,2) Sequence
+ *
+ * Precomputed 2D patterns, with the x and y of a pattern used for a pair of
+ * dimensions. Values are 32 bit fixed point, so every pixel can xor them with
+ * its own random mask. This random digital shift keeps the elementary
+ * interval stratification of the pattern. */
+
+ccl_device_inline float pmj_sample_1D(KernelGlobals *kg, int sample, uint rng_hash, int dimension)
+{
+  /* Past the end of the table the pattern starts over with another mask, so
+   * each block of samples is stratified by itself. */
+  const uint block = (uint)sample / NUM_PMJ_SAMPLES;
+  const uint index = (uint)sample % NUM_PMJ_SAMPLES;
+  const uint pattern = ((uint)dimension >> 1) % NUM_PMJ_PATTERNS;
+  const uint mask = cmj_hash_simple(dimension, cmj_hash(rng_hash, block));
+
+  const uint value = kernel_tex_fetch(__pmj_samples,
+                                      (pattern * NUM_PMJ_SAMPLES + index) * 2 + (dimension & 1));
+  return (float)((value ^ mask) >> 8) * (1.0f / (float)(1 << 24));
+}
+
+/* Blue Noise Dithering
+ *
+ * "Blue-noise Dithered Sampling", Georgiev and Fajardo 2016. All pixels use
+ * the same scrambled sequence, rotated by a value from a tiled blue noise
+ * mask that is offset differently for every dimension. Neighboring pixels get
+ * very different rotations, so at low sample counts error is distributed as
+ * blue noise. The position in the mask is kept in the lowest bits of the
+ * pixel rng_hash. */
+
+#define BLUE_NOISE_PIXEL_MASK (BLUE_NOISE_SIZE * BLUE_NOISE_SIZE - 1)
+
+ccl_device_inline uint blue_noise_pixel(uint x, uint y)
+{
+  /* Offset every tile randomly, so the mask does not visibly repeat. */
+  const uint tile_offset = hash_uint2(x / BLUE_NOISE_SIZE, y / BLUE_NOISE_SIZE);
+  const uint px = (x + tile_offset) % BLUE_NOISE_SIZE;
+  const uint py = (y + (tile_offset >> 16)) % BLUE_NOISE_SIZE;
+  return py * BLUE_NOISE_SIZE + px;
+}
+
+ccl_device_inline float blue_noise_rotate(KernelGlobals *kg, float r, uint rng_hash, int dimension)
+{
+  const uint offset = cmj_hash_simple(dimension, kernel_data.integrator.seed);
+  const uint pixel = rng_hash & BLUE_NOISE_PIXEL_MASK;
+  const uint x = (pixel % BLUE_NOISE_SIZE + offset) % BLUE_NOISE_SIZE;
+  const uint y = (pixel / BLUE_NOISE_SIZE + (offset >> 16)) % BLUE_NOISE_SIZE;
+  const float shift = kernel_tex_fetch(__blue_noise, y * BLUE_NOISE_SIZE + x);
+
+  return r + shift - floorf(r + shift);
+}
+
 ccl_device_forceinline float path_rng_1D(
     KernelGlobals *kg, uint rng_hash, int sample, int num_samples, int dimension)
 {
@@ -57,6 +124,16 @@ ccl_device_forceinline float path_rng_1D(
   return (float)drand48();
 #endif
 
+  /* With blue noise the scrambling is shared by all pixels, and the per pixel
+   * randomization comes from the rotation instead. */
+  const bool blue_noise = kernel_data.integrator.blue_noise_seed;
+  const uint scramble_hash = (blue_noise) ? kernel_data.integrator.seed : rng_hash;
+
+  if (kernel_data.integrator.sampling_pattern == SAMPLING_PATTERN_PMJ) {
+    const float r = pmj_sample_1D(kg, sample, scramble_hash, dimension);
+    return (blue_noise) ? blue_noise_rotate(kg, r, rng_hash, dimension) : r;
+  }
+
 #ifdef __CMJ__
 #  ifdef __SOBOL__
   if (kernel_data.integrator.sampling_pattern == SAMPLING_PATTERN_CMJ)
@@ -69,10 +146,22 @@ ccl_device_forceinline float path_rng_1D(
 #endif
 
 #ifdef __SOBOL__
+  if (kernel_data.integrator.sampling_pattern == SAMPLING_PATTERN_SOBOL_OWEN) {
+    /* Sobol sequence value, scrambled with a seed per dimension. */
+    uint result = sobol_dimension(kg, sample, dimension);
+    result = sobol_owen_scramble(result, cmj_hash_simple(dimension, scramble_hash));
+    const float r = (float)(result >> 8) * (1.0f / (float)(1 << 24));
+    return (blue_noise) ? blue_noise_rotate(kg, r, rng_hash, dimension) : r;
+  }
+
   /* Sobol sequence value using direction vectors. */
-  uint result = sobol_dimension(kg, sample, dimension);
+  uint result = sobol_dimension(kg, sample + SOBOL_SKIP, dimension);
   float r = (float)result * (1.0f / (float)0xFFFFFFFF);
 
+  if (blue_noise) {
+    return blue_noise_rotate(kg, r, rng_hash, dimension);
+  }
+
   /* Cranly-Patterson rotation using rng seed */
   float shift;
 
@@ -132,6 +221,10 @@ ccl_device_inline void path_rng_init(KernelGlobals *kg,
   *rng_hash = hash_uint2(x, y);
   *rng_hash ^= kernel_data.integrator.seed;
 
+  if (kernel_data.integrator.blue_noise_seed) {
+    *rng_hash = (*rng_hash & ~BLUE_NOISE_PIXEL_MASK) | blue_noise_pixel(x, y);
+  }
+
 #ifdef __DEBUG_CORRELATION__
   srand48(*rng_hash + sample);
 #endif
@@ -48,6 +48,17 @@ ccl_device void shader_setup_object_transforms(KernelGlobals *kg, ShaderData *sd
 }
 #endif
 
+/* Copy shader data with only the closures in use, so it also works for
+ * storage sized to the scene's maximum closure count. */
+ccl_device_inline void shader_data_copy(ShaderData *dst, const ShaderData *src)
+{
+#ifdef __KERNEL_CPU__
+  memcpy(dst, src, sizeof(ShaderData) - sizeof(ShaderClosure) * (MAX_CLOSURE - src->num_closure));
+#else
+  *dst = *src;
+#endif
+}
+
 #ifdef __KERNEL_OPTIX__
 ccl_device_inline
 #else
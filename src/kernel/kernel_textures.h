@@ -39,6 +39,10 @@ KERNEL_TEX(Transform, __object_motion_pass)
 KERNEL_TEX(DecomposedTransform, __object_motion)
 KERNEL_TEX(uint, __object_flag)
 
+/* volumes */
+KERNEL_TEX(KernelVolumeMajorant, __volume_majorant_grids)
+KERNEL_TEX(float, __volume_majorant)
+
 /* cameras */
 KERNEL_TEX(DecomposedTransform, __camera_motion)
 
@@ -68,6 +72,10 @@ KERNEL_TEX(KernelLightDistribution, __light_distribution)
 KERNEL_TEX(KernelLight, __lights)
 KERNEL_TEX(float2, __light_background_marginal_cdf)
 KERNEL_TEX(float2, __light_background_conditional_cdf)
+KERNEL_TEX(KernelLightTreeNode, __light_tree_nodes)
+KERNEL_TEX(KernelLightTreeEmitter, __light_tree_emitters)
+KERNEL_TEX(uint, __light_tree_leaf_emitters)
+KERNEL_TEX(uint2, __light_tree_objects)
 
 /* particles */
 KERNEL_TEX(KernelParticle, __particles)
@@ -81,6 +89,8 @@ KERNEL_TEX(float, __lookup_table)
 
 /* sobol */
 KERNEL_TEX(uint, __sobol_directions)
+KERNEL_TEX(uint, __pmj_samples)
+KERNEL_TEX(float, __blue_noise)
 
 /* image textures */
 KERNEL_TEX(TextureInfo, __texture_info)
@@ -135,6 +135,7 @@ CCL_NAMESPACE_BEGIN
 #  endif
 #  define __VOLUME_DECOUPLED__
 #  define __VOLUME_RECORD_ALL__
+#  define __ADAPTIVE_SAMPLING__
 #endif /* __KERNEL_CPU__ */
 
 #ifdef __KERNEL_CUDA__
@@ -269,10 +270,20 @@ enum PathTraceDimension {
 enum SamplingPattern {
   SAMPLING_PATTERN_SOBOL = 0,
   SAMPLING_PATTERN_CMJ = 1,
+  SAMPLING_PATTERN_SOBOL_OWEN = 2,
+  SAMPLING_PATTERN_PMJ = 3,
 
   SAMPLING_NUM_PATTERNS,
 };
 
+/* Precomputed progressive multi-jittered (0,2) tables, one 2D pattern for
+ * each pair of dimensions, reused for higher dimensions. */
+#define NUM_PMJ_SAMPLES (64 * 64)
+#define NUM_PMJ_PATTERNS 48
+
+/* Tiled blue noise mask for dithering the per pixel sample rotations. */
+#define BLUE_NOISE_SIZE 64
+
 /* these flags values correspond to raytypes in osl.cpp, so keep them in sync! */
 
 enum PathRayFlag {
@@ -375,6 +386,8 @@ typedef enum PassType {
   PASS_CRYPTOMATTE,
   PASS_AOV_COLOR,
   PASS_AOV_VALUE,
+  PASS_ADAPTIVE_AUX_BUFFER,
+  PASS_SAMPLE_COUNT,
   PASS_CATEGORY_MAIN_END = 31,
 
   PASS_MIST = 32,
@@ -896,11 +909,16 @@ enum ShaderDataFlag {
   SD_HAS_CONSTANT_EMISSION = (1 << 27),
   /* Needs to access attributes */
   SD_NEED_ATTRIBUTES = (1 << 28),
+  /* Volume extinction is bounded for majorant tracking (values stored in __shaders) */
+  SD_VOLUME_MAJORANT = (1 << 29),
+  /* Volume with majorant tracking bound may emit light */
+  SD_VOLUME_MAJORANT_EMISSION = (1 << 30),
 
   SD_SHADER_FLAGS = (SD_USE_MIS | SD_HAS_TRANSPARENT_SHADOW | SD_HAS_VOLUME | SD_HAS_ONLY_VOLUME |
                      SD_HETEROGENEOUS_VOLUME | SD_HAS_BSSRDF_BUMP | SD_VOLUME_EQUIANGULAR |
                      SD_VOLUME_MIS | SD_VOLUME_CUBIC | SD_HAS_BUMP | SD_HAS_DISPLACEMENT |
-                     SD_HAS_CONSTANT_EMISSION | SD_NEED_ATTRIBUTES)
+                     SD_HAS_CONSTANT_EMISSION | SD_NEED_ATTRIBUTES | SD_VOLUME_MAJORANT |
+                     SD_VOLUME_MAJORANT_EMISSION)
 };
 
 /* Object flags. */
@@ -1030,6 +1048,17 @@ typedef ccl_addr_space struct ccl_align(16) ShaderDataTinyStorage
 ShaderDataTinyStorage;
 #define AS_SHADER_DATA(shader_data_tiny_storage) ((ShaderData *)shader_data_tiny_storage)
 
+/* Full shader data for the path integrators. On the CPU it is sized to the
+ * scene's maximum closure count, see kernel_shader_data_storage(). */
+#ifdef __KERNEL_CPU__
+#  define SHADER_DATA_STORAGE(name, kg, index) \
+    ShaderData *name = kernel_shader_data_storage(kg, index)
+#else
+#  define SHADER_DATA_STORAGE(name, kg, index) \
+    ShaderData name##_storage; \
+    ShaderData *name = &name##_storage
+#endif
+
 /* Path State */
 
 #ifdef __VOLUME__
@@ -1258,8 +1287,8 @@ typedef struct KernelFilm {
 
   int pass_aov_color;
   int pass_aov_value;
-  int pad1;
-  int pad2;
+  int pass_adaptive_aux_buffer;
+  int pass_sample_count;
 
   /* XYZ to rendering color space transform. float4 instead of float3 to
    * ensure consistent padding/alignment across devices. */
@@ -1375,6 +1404,26 @@ typedef struct KernelIntegrator {
   int max_closures;
 
   int num_clipping_planes;
+
+  /* adaptive sampling */
+  int adaptive_min_samples;
+  int adaptive_step;
+  float adaptive_threshold;
+
+  /* light tree */
+  int use_light_tree;
+  int light_tree_triangle_root;
+  int light_tree_lamp_root;
+  int light_tree_infinite_offset;
+  int light_tree_num_infinite;
+  float light_tree_pdf_triangles;
+  float light_tree_pdf_lamps;
+
+  /* volume majorant tracking */
+  int volume_majorant_tracking;
+
+  /* blue noise dithered pixel seeds */
+  int blue_noise_seed;
 } KernelIntegrator;
 static_assert_align(KernelIntegrator, 16);
 
@@ -1482,9 +1531,24 @@ typedef struct KernelObject {
 
   float cryptomatte_object;
   float cryptomatte_asset;
+
+  /* Index into __volume_majorant_grids, -1 if none. */
+  int volume_majorant;
 } KernelObject;
 static_assert_align(KernelObject, 16);
 
+/* Coarse grid with the largest density in each cell of a volume object, used
+ * as majorant for delta and ratio tracking. */
+typedef struct KernelVolumeMajorant {
+  /* Object space to grid cell coordinates. */
+  Transform tfm;
+  int offset;
+  int resolution_x;
+  int resolution_y;
+  int resolution_z;
+} KernelVolumeMajorant;
+static_assert_align(KernelVolumeMajorant, 16);
+
 typedef struct KernelSpotLight {
   float radius;
   float invarea;
@@ -1547,6 +1611,41 @@ typedef struct KernelLightDistribution {
 } KernelLightDistribution;
 static_assert_align(KernelLightDistribution, 16);
 
+/* Light tree node, bounding the position, emission directions and energy of
+ * the lights below it. Interior nodes always have two children, the first
+ * one directly follows the node. */
+typedef struct KernelLightTreeNode {
+  float bbox_min[3];
+  float energy;
+  float bbox_max[3];
+  /* Spread of the normals around the axis. */
+  float theta_o;
+  float axis[3];
+  /* Spread of the emission around each normal. */
+  float theta_e;
+  /* Index of the second child for interior nodes, or of the first entry in
+   * the leaf emitter array for leaves. */
+  int child_index;
+  /* Zero for interior nodes. */
+  int num_emitters;
+  int parent;
+  int pad;
+} KernelLightTreeNode;
+static_assert_align(KernelLightTreeNode, 16);
+
+/* Light tree data per light distribution entry. */
+typedef struct KernelLightTreeEmitter {
+  float energy;
+  /* Factor turning the selection probability of the emitter within its
+   * tree into the ratio with its probability in the flat distribution. */
+  float pdf_scale;
+  /* Leaf node containing the emitter, -1 for lights sampled outside of the
+   * tree. */
+  int leaf;
+  int pad;
+} KernelLightTreeEmitter;
+static_assert_align(KernelLightTreeEmitter, 16);
+
 typedef struct KernelParticle {
   int index;
   float age;
@@ -1566,7 +1665,10 @@ typedef struct KernelShader {
   float cryptomatte_id;
   int flags;
   int pass_id;
-  int pad2, pad3;
+  /* Volume extinction bound for majorant tracking, as scale of the density
+   * attribute plus a constant. */
+  float volume_majorant_density;
+  float volume_majorant_constant;
 } KernelShader;
 static_assert_align(KernelShader, 16);
 
@@ -174,6 +174,191 @@ ccl_device_inline void kernel_volume_step_init(KernelGlobals *kg,
   *step_offset = path_state_rng_1D_hash(kg, state, 0x1e31d8a4) * step;
 }
 
+/* Majorant Tracking
+ *
+ * Volume objects with voxel data have a coarse grid with the largest density
+ * in each cell. Together with the extinction bound of the shader this gives a
+ * majorant, and instead of evaluating the shader at fixed steps, tentative
+ * collisions are sampled proportional to it, skipping empty cells entirely.
+ * Shadows use ratio tracking, scattering uses delta tracking. Volumes without
+ * a known bound keep using ray marching. */
+
+typedef struct VolumeMajorantRay {
+  KernelVolumeMajorant grid;
+  /* Ray in grid cell coordinates, with the same parametrization as the world
+   * space ray since the transform is affine. */
+  float3 P;
+  float3 D;
+  /* Extinction bound of the shader for the cell density, and the smallest
+   * majorant in non-empty cells so emission is sampled where density is low. */
+  float density_scale;
+  float density_constant;
+  float emission_sigma;
+} VolumeMajorantRay;
+
+/* Majorant grid index for rays inside the volume stack, or -1. Tracking is
+ * used when inside exactly one volume object that has a majorant grid and a
+ * shader with a known extinction bound. Overlapping volumes, world volume,
+ * procedural volumes and other shaders keep using ray marching. */
+ccl_device_inline int kernel_volume_majorant_index(KernelGlobals *kg,
+                                                   ccl_addr_space VolumeStack *stack)
+{
+  if (!kernel_data.integrator.volume_majorant_tracking) {
+    return -1;
+  }
+
+  if (stack[0].shader == SHADER_NONE || stack[1].shader != SHADER_NONE) {
+    return -1;
+  }
+
+  const int object = stack[0].object;
+  if (object == OBJECT_NONE || (kernel_tex_fetch(__object_flag, object) & SD_OBJECT_MOTION)) {
+    return -1;
+  }
+
+  const int shader_flag = kernel_tex_fetch(__shaders, (stack[0].shader & SHADER_MASK)).flags;
+  if (!(shader_flag & SD_VOLUME_MAJORANT)) {
+    return -1;
+  }
+
+  return kernel_tex_fetch(__objects, object).volume_majorant;
+}
+
+/* Avoid infinite and NaN distances when walking cells for axis aligned rays. */
+ccl_device_inline float kernel_volume_majorant_direction(float d)
+{
+  return (fabsf(d) > 1e-20f) ? d : ((d >= 0.0f) ? 1e-20f : -1e-20f);
+}
+
+ccl_device_inline bool kernel_volume_majorant_setup(KernelGlobals *kg,
+                                                    ccl_addr_space VolumeStack *stack,
+                                                    Ray *ray,
+                                                    bool emission,
+                                                    VolumeMajorantRay *mray)
+{
+  const int index = kernel_volume_majorant_index(kg, stack);
+  if (index < 0) {
+    return false;
+  }
+
+  const int object = stack[0].object;
+  const KernelShader kshader = kernel_tex_fetch(__shaders, (stack[0].shader & SHADER_MASK));
+
+  mray->grid = kernel_tex_fetch(__volume_majorant_grids, index);
+  mray->density_scale = kshader.volume_majorant_density;
+  mray->density_constant = kshader.volume_majorant_constant;
+
+  /* Emission needs collisions wherever the shader is evaluated, about as
+   * often as ray marching would evaluate it. */
+  mray->emission_sigma = (emission && (kshader.flags & SD_VOLUME_MAJORANT_EMISSION)) ?
+                             1.0f / max(kernel_data.integrator.volume_step_size, 1e-5f) :
+                             0.0f;
+
+  Transform itfm = object_fetch_transform(kg, object, OBJECT_INVERSE_TRANSFORM);
+  Transform tfm = mray->grid.tfm * itfm;
+  mray->P = transform_point(&tfm, ray->P);
+
+  const float3 D = transform_direction(&tfm, ray->D);
+  mray->D = make_float3(kernel_volume_majorant_direction(D.x),
+                        kernel_volume_majorant_direction(D.y),
+                        kernel_volume_majorant_direction(D.z));
+
+  return true;
+}
+
+/* Advance *t to the next tentative collision, found by walking grid cells
+ * until the majorant optical depth tau is used up. Returns false if the ray
+ * leaves the grid or reaches t_max first. */
+ccl_device bool kernel_volume_majorant_next(KernelGlobals *kg,
+                                            const VolumeMajorantRay *mray,
+                                            float *t,
+                                            float t_max,
+                                            float tau,
+                                            float *sigma_bar)
+{
+  const int3 res = make_int3(
+      mray->grid.resolution_x, mray->grid.resolution_y, mray->grid.resolution_z);
+  const float3 bounds = make_float3(res.x, res.y, res.z);
+
+  /* Clip to grid bounds. */
+  const float3 idir = rcp(mray->D);
+  const float3 t0 = (make_float3(0.0f, 0.0f, 0.0f) - mray->P) * idir;
+  const float3 t1 = (bounds - mray->P) * idir;
+  float t_enter = max(*t, max3(min(t0, t1)));
+  float t_exit = min(t_max, min3(max(t0, t1)));
+
+  if (!(t_enter < t_exit)) {
+    return false;
+  }
+
+  /* Walk cells with a 3D DDA. */
+  const float3 P = mray->P + mray->D * t_enter;
+  int3 cell = make_int3(clamp((int)floorf(P.x), 0, res.x - 1),
+                        clamp((int)floorf(P.y), 0, res.y - 1),
+                        clamp((int)floorf(P.z), 0, res.z - 1));
+  const int3 step = make_int3(
+      (mray->D.x >= 0.0f) ? 1 : -1, (mray->D.y >= 0.0f) ? 1 : -1, (mray->D.z >= 0.0f) ? 1 : -1);
+  const float3 t_delta = fabs(idir);
+  float3 t_next = make_float3(
+      (cell.x + ((step.x > 0) ? 1 : 0) - mray->P.x) * idir.x,
+      (cell.y + ((step.y > 0) ? 1 : 0) - mray->P.y) * idir.y,
+      (cell.z + ((step.z > 0) ? 1 : 0) - mray->P.z) * idir.z);
+
+  float t_cell = t_enter;
+  const int max_cells = res.x + res.y + res.z;
+
+  for (int i = 0; i < max_cells; i++) {
+    const float t_cell_end = min(t_exit, min3(t_next));
+    const float density = kernel_tex_fetch(
+        __volume_majorant, mray->grid.offset + cell.x + res.x * (cell.y + res.y * cell.z));
+    const float sigma = (density >= 0.0f) ?
+                            max(density * mray->density_scale + mray->density_constant,
+                                mray->emission_sigma) :
+                            0.0f;
+    const float optical_depth = sigma * (t_cell_end - t_cell);
+
+    if (optical_depth >= tau && sigma > 0.0f) {
+      *t = t_cell + tau / sigma;
+      *sigma_bar = sigma;
+      return true;
+    }
+
+    tau -= optical_depth;
+    t_cell = t_cell_end;
+
+    if (t_cell >= t_exit) {
+      break;
+    }
+
+    /* Step to the neighboring cell along the nearest boundary. */
+    if (t_next.x <= t_next.y && t_next.x <= t_next.z) {
+      cell.x += step.x;
+      t_next.x += t_delta.x;
+      if (cell.x < 0 || cell.x >= res.x)
+        break;
+    }
+    else if (t_next.y <= t_next.z) {
+      cell.y += step.y;
+      t_next.y += t_delta.y;
+      if (cell.y < 0 || cell.y >= res.y)
+        break;
+    }
+    else {
+      cell.z += step.z;
+      t_next.z += t_delta.z;
+      if (cell.z < 0 || cell.z >= res.z)
+        break;
+    }
+  }
+
+  return false;
+}
+
+ccl_device_inline float kernel_volume_majorant_tau(uint *lcg_state)
+{
+  return -logf(max(1.0f - lcg_step_float(lcg_state), 1e-20f));
+}
+
 /* Volume Shadows
  *
  * These functions are used to attenuate shadow rays to lights. Both absorption
@@ -254,6 +439,50 @@ ccl_device void kernel_volume_shadow_heterogeneous(KernelGlobals *kg,
   *throughput = tp;
 }
 
+/* heterogeneous volume with majorant grid: ratio tracking, multiplying the
+ * throughput with the null collision probability at every tentative collision */
+ccl_device bool kernel_volume_shadow_majorant(KernelGlobals *kg,
+                                              ccl_addr_space PathState *state,
+                                              Ray *ray,
+                                              ShaderData *sd,
+                                              float3 *throughput)
+{
+  VolumeMajorantRay mray;
+  if (!kernel_volume_majorant_setup(kg, state->volume_stack, ray, false, &mray)) {
+    return false;
+  }
+
+  float3 tp = *throughput;
+  const float tp_eps = 1e-6f;
+  const int max_steps = kernel_data.integrator.volume_max_steps;
+  uint lcg_state = lcg_state_init_addrspace(state, 0x3b1f2c7d);
+  float t = 0.0f;
+
+  for (int i = 0; i < max_steps; i++) {
+    float sigma_bar;
+    if (!kernel_volume_majorant_next(
+            kg, &mray, &t, ray->t, kernel_volume_majorant_tau(&lcg_state), &sigma_bar)) {
+      break;
+    }
+
+    float3 sigma_t;
+    if (volume_shader_extinction_sample(kg, sd, state, ray->P + ray->D * t, &sigma_t)) {
+      /* sigma_t is bounded by the majorant, up to round-off */
+      tp *= max(make_float3(1.0f, 1.0f, 1.0f) - sigma_t / sigma_bar,
+                make_float3(0.0f, 0.0f, 0.0f));
+
+      /* stop if nearly all light is blocked */
+      if (max3(fabs(tp)) < tp_eps) {
+        tp = make_float3(0.0f, 0.0f, 0.0f);
+        break;
+      }
+    }
+  }
+
+  *throughput = tp;
+  return true;
+}
+
 /* get the volume attenuation over line segment defined by ray, with the
  * assumption that there are no surfaces blocking light between the endpoints */
 ccl_device_noinline void kernel_volume_shadow(KernelGlobals *kg,
@@ -264,8 +493,10 @@ ccl_device_noinline void kernel_volume_shadow(KernelGlobals *kg,
 {
   shader_setup_from_volume(kg, shadow_sd, ray);
 
-  if (volume_stack_is_heterogeneous(kg, state->volume_stack))
-    kernel_volume_shadow_heterogeneous(kg, state, ray, shadow_sd, throughput);
+  if (volume_stack_is_heterogeneous(kg, state->volume_stack)) {
+    if (!kernel_volume_shadow_majorant(kg, state, ray, shadow_sd, throughput))
+      kernel_volume_shadow_heterogeneous(kg, state, ray, shadow_sd, throughput);
+  }
   else
     kernel_volume_shadow_homogeneous(kg, state, ray, shadow_sd, throughput);
 }
@@ -668,6 +899,96 @@ kernel_volume_integrate_heterogeneous_distance(KernelGlobals *kg,
   return VOLUME_PATH_ATTENUATED;
 }
 
+/* heterogeneous volume with majorant grid: delta tracking. At every tentative
+ * collision emission is accumulated, and we either scatter or continue with
+ * the throughput weighted by the null collision coefficient. The decision is
+ * made proportional to the weighted scattering and null coefficients, which
+ * keeps it valid for chromatic extinction. */
+ccl_device bool kernel_volume_integrate_majorant(KernelGlobals *kg,
+                                                 ccl_addr_space PathState *state,
+                                                 Ray *ray,
+                                                 ShaderData *sd,
+                                                 PathRadiance *L,
+                                                 ccl_addr_space float3 *throughput,
+                                                 VolumeIntegrateResult *result)
+{
+  VolumeMajorantRay mray;
+  if (!kernel_volume_majorant_setup(kg, state->volume_stack, ray, L != NULL, &mray)) {
+    return false;
+  }
+
+  float3 tp = *throughput;
+  const float tp_eps = 1e-6f;
+  const int max_steps = kernel_data.integrator.volume_max_steps;
+  uint lcg_state = lcg_state_init_addrspace(state, 0x5c8e41a3);
+  float t = 0.0f;
+
+  *result = VOLUME_PATH_ATTENUATED;
+
+  for (int i = 0; i < max_steps; i++) {
+    float sigma_bar;
+    if (!kernel_volume_majorant_next(
+            kg, &mray, &t, ray->t, kernel_volume_majorant_tau(&lcg_state), &sigma_bar)) {
+      break;
+    }
+
+    const float3 P = ray->P + ray->D * t;
+    VolumeShaderCoefficients coeff ccl_optional_struct_init;
+
+    if (!volume_shader_sample(kg, sd, state, P, &coeff)) {
+      continue;
+    }
+
+    const int closure_flag = sd->flag;
+    const float inv_sigma_bar = 1.0f / sigma_bar;
+
+    /* emission, estimated at collisions with density sigma_bar */
+    if (L && (closure_flag & SD_EMISSION)) {
+      path_radiance_accum_emission(kg, L, state, tp, coeff.emission * inv_sigma_bar);
+    }
+
+    if (!(closure_flag & SD_EXTINCTION)) {
+      continue;
+    }
+
+    /* sigma_t is bounded by the majorant, up to round-off */
+    const float3 sigma_n = max(make_float3(sigma_bar, sigma_bar, sigma_bar) - coeff.sigma_t,
+                               make_float3(0.0f, 0.0f, 0.0f));
+    float null_probability = 1.0f;
+
+#  ifdef __VOLUME_SCATTER__
+    if (closure_flag & SD_SCATTER) {
+      const float p_scatter = max3(fabs(coeff.sigma_s * tp));
+      const float p_null = max3(fabs(sigma_n * tp));
+      const float scatter_probability = p_scatter / max(p_scatter + p_null, 1e-20f);
+
+      if (lcg_step_float(&lcg_state) < scatter_probability) {
+        /* scatter at this collision */
+        tp *= coeff.sigma_s * (inv_sigma_bar / scatter_probability);
+        sd->P = P;
+        *throughput = tp;
+        *result = VOLUME_PATH_SCATTERED;
+        return true;
+      }
+
+      null_probability = 1.0f - scatter_probability;
+    }
+#  endif
+
+    /* null collision, continue with throughput weighted by its coefficient */
+    tp *= sigma_n * (inv_sigma_bar / null_probability);
+
+    /* stop if nearly all light blocked */
+    if (max3(fabs(tp)) < tp_eps) {
+      tp = make_float3(0.0f, 0.0f, 0.0f);
+      break;
+    }
+  }
+
+  *throughput = tp;
+  return true;
+}
+
 /* get the volume attenuation and emission over line segment defined by
  * ray, with the assumption that there are no surfaces blocking light
  * between the endpoints. distance sampling is used to decide if we will
@@ -683,8 +1004,13 @@ kernel_volume_integrate(KernelGlobals *kg,
 {
   shader_setup_from_volume(kg, sd, ray);
 
-  if (heterogeneous)
+  if (heterogeneous) {
+    VolumeIntegrateResult result;
+    if (kernel_volume_integrate_majorant(kg, state, ray, sd, L, throughput, &result))
+      return result;
+
     return kernel_volume_integrate_heterogeneous_distance(kg, state, ray, sd, L, throughput);
+  }
   else
     return kernel_volume_integrate_homogeneous(kg, state, ray, sd, L, throughput, true);
 }
@@ -1110,6 +1436,7 @@ ccl_device VolumeIntegrateResult kernel_volume_decoupled_scatter(KernelGlobals *
 
 /* decide if we need to use decoupled or not */
 ccl_device bool kernel_volume_use_decoupled(KernelGlobals *kg,
+                                            ccl_addr_space VolumeStack *stack,
                                             bool heterogeneous,
                                             bool direct,
                                             int sampling_method)
@@ -1120,6 +1447,11 @@ ccl_device bool kernel_volume_use_decoupled(KernelGlobals *kg,
   if (!kernel_data.integrator.volume_decoupled)
     return false;
 
+  /* heterogeneous volumes are tracked with their majorant grid instead of
+   * recording steps, when available */
+  if (heterogeneous && kernel_volume_majorant_index(kg, stack) >= 0)
+    return false;
+
 #  ifdef __KERNEL_GPU__
   if (heterogeneous)
     return false;
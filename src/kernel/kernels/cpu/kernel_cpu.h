@@ -44,6 +44,41 @@ void KERNEL_FUNCTION_FULL_NAME(convert_to_float)(KernelGlobals *kg,
                                                       int fullw,
                                                       int fullh,
                                                       int pixelsize);
+void KERNEL_FUNCTION_FULL_NAME(convert_row_to_float)(KernelGlobals *kg,
+                                                     float *rgba,
+                                                     float *buffer,
+                                                     float sample_scale,
+                                                     int pass_type,
+                                                     int x,
+                                                     int y,
+                                                     int w,
+                                                     int height,
+                                                     int offset,
+                                                     int stride,
+                                                     int full_w,
+                                                     int full_h,
+                                                     int pixel_size);
+
+void KERNEL_FUNCTION_FULL_NAME(adaptive_stopping)(
+    KernelGlobals *kg, float *buffer, int sample, int x, int y, int offset, int stride);
+bool KERNEL_FUNCTION_FULL_NAME(adaptive_filter_x)(KernelGlobals *kg,
+                                                  float *buffer,
+                                                  int sample,
+                                                  int y,
+                                                  int tile_x,
+                                                  int tile_w,
+                                                  int offset,
+                                                  int stride);
+bool KERNEL_FUNCTION_FULL_NAME(adaptive_filter_y)(KernelGlobals *kg,
+                                                  float *buffer,
+                                                  int sample,
+                                                  int x,
+                                                  int tile_y,
+                                                  int tile_h,
+                                                  int offset,
+                                                  int stride);
+void KERNEL_FUNCTION_FULL_NAME(adaptive_adjust_samples)(
+    KernelGlobals *kg, float *buffer, int sample, int x, int y, int offset, int stride);
 
 void KERNEL_FUNCTION_FULL_NAME(shader)(KernelGlobals *kg,
                                        uint4 *input,
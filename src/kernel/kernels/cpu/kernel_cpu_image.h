@@ -17,6 +17,8 @@
 #ifndef __KERNEL_CPU_IMAGE_H__
 #define __KERNEL_CPU_IMAGE_H__
 
+#include "util/util_texture_cache.h"
+
 CCL_NAMESPACE_BEGIN
 
 /* Make template functions private so symbols don't conflict between kernels with different
@@ -238,6 +240,9 @@ template<typename T> struct TextureInterpolator {
 
   static ccl_always_inline float4 interp(const TextureInfo &info, float x, float y)
   {
+    if (info.cache) {
+      return interp_cache(info, x, y, 0.0f);
+    }
     if (UNLIKELY(!info.data)) {
       return make_float4(0.0f, 0.0f, 0.0f, 0.0f);
     }
@@ -251,6 +256,94 @@ template<typename T> struct TextureInterpolator {
     }
   }
 
+  /* ********  2D texture cache interpolation ******** */
+
+  static ccl_always_inline float4 interp_cache_level(
+      TextureCacheImage *image, const int level, float x, float y, const TextureInfo &info)
+  {
+    const TextureCacheImage::Level &l = image->level(level);
+    const int size = TEXTURE_CACHE_TILE_SIZE;
+    const int stride = TEXTURE_CACHE_TILE_STRIDE;
+    const bool closest = (info.interpolation == INTERPOLATION_CLOSEST);
+
+    if (closest && info.extension == EXTENSION_CLIP &&
+        (x < 0.0f || y < 0.0f || x > 1.0f || y > 1.0f)) {
+      return make_float4(0.0f, 0.0f, 0.0f, 0.0f);
+    }
+
+    int ix, iy;
+    const float offset = closest ? 0.0f : 0.5f;
+    const float tx = frac(x * (float)l.width - offset, &ix);
+    const float ty = frac(y * (float)l.height - offset, &iy);
+
+    /* The next texel for linear interpolation is always in the tile border,
+     * which already has the extension applied. */
+    const int min_texel = closest ? 0 : -1;
+    if (info.extension == EXTENSION_REPEAT) {
+      ix = wrap_periodic(ix, l.width);
+      iy = wrap_periodic(iy, l.height);
+    }
+    else if (info.extension == EXTENSION_CLIP &&
+             (ix < min_texel || iy < min_texel || ix >= l.width || iy >= l.height)) {
+      return make_float4(0.0f, 0.0f, 0.0f, 0.0f);
+    }
+    else {
+      ix = clamp(ix, min_texel, l.width - 1);
+      iy = clamp(iy, min_texel, l.height - 1);
+    }
+
+    const int tile_x = max(ix, 0) / size;
+    const int tile_y = max(iy, 0) / size;
+    TextureCacheTile *tile = image->acquire_tile(level, tile_x, tile_y);
+    if (UNLIKELY(!tile)) {
+      return make_float4(
+          TEX_IMAGE_MISSING_R, TEX_IMAGE_MISSING_G, TEX_IMAGE_MISSING_B, TEX_IMAGE_MISSING_A);
+    }
+
+    const T *data = tile->texels<T>() + (iy - tile_y * size) * stride + (ix - tile_x * size);
+    float4 r;
+    if (closest) {
+      r = read(data[0]);
+    }
+    else {
+      r = (1.0f - ty) * (1.0f - tx) * read(data[0]) + (1.0f - ty) * tx * read(data[1]) +
+          ty * (1.0f - tx) * read(data[stride]) + ty * tx * read(data[stride + 1]);
+    }
+
+    image->release_tile(tile);
+    return r;
+  }
+
+  /* Lookup in an image from the texture cache, with width the size of the
+   * filter footprint in texture coordinates. Mip levels are blended
+   * trilinearly, cubic interpolation falls back to linear within a level. */
+  static ccl_always_inline float4 interp_cache(const TextureInfo &info,
+                                               float x,
+                                               float y,
+                                               float width)
+  {
+    TextureCacheImage *image = (TextureCacheImage *)info.cache;
+    const TextureCacheImage::Level &base = image->level(0);
+    const int max_level = image->num_levels() - 1;
+
+    float lod = 0.0f;
+    if (width > 0.0f) {
+      lod = clamp(log2f(width * (float)max(base.width, base.height)), 0.0f, (float)max_level);
+    }
+
+    if (info.interpolation == INTERPOLATION_CLOSEST) {
+      return interp_cache_level(image, float_to_int(lod + 0.5f), x, y, info);
+    }
+
+    const int level = float_to_int(lod);
+    const float t = lod - (float)level;
+    float4 r = interp_cache_level(image, level, x, y, info);
+    if (t > 0.0f && level < max_level) {
+      r = (1.0f - t) * r + t * interp_cache_level(image, level + 1, x, y, info);
+    }
+    return r;
+  }
+
   /* ********  3D interpolation ******** */
 
   static ccl_always_inline float4 interp_3d_closest(const TextureInfo &info,
@@ -498,6 +591,41 @@ ccl_device float4 kernel_tex_image_interp(KernelGlobals *kg, int id, float x, fl
   }
 }
 
+/* Image lookup with a filter footprint, used to select a mip level for images
+ * in the texture cache. Fully loaded images ignore the footprint. */
+ccl_device float4
+kernel_tex_image_interp_lod(KernelGlobals *kg, int id, float x, float y, float width)
+{
+  const TextureInfo &info = kernel_tex_fetch(__texture_info, id);
+
+  if (!info.cache) {
+    return kernel_tex_image_interp(kg, id, x, y);
+  }
+
+  switch (kernel_tex_type(id)) {
+    case IMAGE_DATA_TYPE_HALF:
+      return TextureInterpolator<half>::interp_cache(info, x, y, width);
+    case IMAGE_DATA_TYPE_BYTE:
+      return TextureInterpolator<uchar>::interp_cache(info, x, y, width);
+    case IMAGE_DATA_TYPE_USHORT:
+      return TextureInterpolator<uint16_t>::interp_cache(info, x, y, width);
+    case IMAGE_DATA_TYPE_FLOAT:
+      return TextureInterpolator<float>::interp_cache(info, x, y, width);
+    case IMAGE_DATA_TYPE_HALF4:
+      return TextureInterpolator<half4>::interp_cache(info, x, y, width);
+    case IMAGE_DATA_TYPE_BYTE4:
+      return TextureInterpolator<uchar4>::interp_cache(info, x, y, width);
+    case IMAGE_DATA_TYPE_USHORT4:
+      return TextureInterpolator<ushort4>::interp_cache(info, x, y, width);
+    case IMAGE_DATA_TYPE_FLOAT4:
+      return TextureInterpolator<float4>::interp_cache(info, x, y, width);
+    default:
+      assert(0);
+      return make_float4(
+          TEX_IMAGE_MISSING_R, TEX_IMAGE_MISSING_G, TEX_IMAGE_MISSING_B, TEX_IMAGE_MISSING_A);
+  }
+}
+
 ccl_device float4 kernel_tex_image_interp_3d(
     KernelGlobals *kg, int id, float x, float y, float z, InterpolationType interp)
 {
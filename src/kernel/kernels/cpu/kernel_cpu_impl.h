@@ -92,6 +92,64 @@ void KERNEL_FUNCTION_FULL_NAME(path_trace)(
 #  endif /* KERNEL_STUB */
 }
 
+/* Adaptive Sampling */
+
+void KERNEL_FUNCTION_FULL_NAME(adaptive_stopping)(
+    KernelGlobals *kg, float *buffer, int sample, int x, int y, int offset, int stride)
+{
+#  ifdef KERNEL_STUB
+  STUB_ASSERT(KERNEL_ARCH, adaptive_stopping);
+#  else
+  int index = offset + x + y * stride;
+  kernel_do_adaptive_stopping(kg, buffer + index * kernel_data.film.pass_stride, sample);
+#  endif /* KERNEL_STUB */
+}
+
+bool KERNEL_FUNCTION_FULL_NAME(adaptive_filter_x)(KernelGlobals *kg,
+                                                  float *buffer,
+                                                  int sample,
+                                                  int y,
+                                                  int tile_x,
+                                                  int tile_w,
+                                                  int offset,
+                                                  int stride)
+{
+#  ifdef KERNEL_STUB
+  STUB_ASSERT(KERNEL_ARCH, adaptive_filter_x);
+  return false;
+#  else
+  return kernel_do_adaptive_filter_x(kg, buffer, y, tile_x, tile_w, offset, stride, sample);
+#  endif /* KERNEL_STUB */
+}
+
+bool KERNEL_FUNCTION_FULL_NAME(adaptive_filter_y)(KernelGlobals *kg,
+                                                  float *buffer,
+                                                  int sample,
+                                                  int x,
+                                                  int tile_y,
+                                                  int tile_h,
+                                                  int offset,
+                                                  int stride)
+{
+#  ifdef KERNEL_STUB
+  STUB_ASSERT(KERNEL_ARCH, adaptive_filter_y);
+  return false;
+#  else
+  return kernel_do_adaptive_filter_y(kg, buffer, x, tile_y, tile_h, offset, stride, sample);
+#  endif /* KERNEL_STUB */
+}
+
+void KERNEL_FUNCTION_FULL_NAME(adaptive_adjust_samples)(
+    KernelGlobals *kg, float *buffer, int sample, int x, int y, int offset, int stride)
+{
+#  ifdef KERNEL_STUB
+  STUB_ASSERT(KERNEL_ARCH, adaptive_adjust_samples);
+#  else
+  int index = offset + x + y * stride;
+  kernel_adaptive_post_adjust(kg, buffer + index * kernel_data.film.pass_stride, sample);
+#  endif /* KERNEL_STUB */
+}
+
 /* Film */
 
 #if 0
@@ -134,6 +192,41 @@ void KERNEL_FUNCTION_FULL_NAME(convert_to_float)(KernelGlobals *kg,
 #  endif /* KERNEL_STUB */
 }
 
+void KERNEL_FUNCTION_FULL_NAME(convert_row_to_float)(KernelGlobals *kg,
+                                                     float *rgba,
+                                                     float *buffer,
+                                                     float sample_scale,
+                                                     int pass_type,
+                                                     int x,
+                                                     int y,
+                                                     int w,
+                                                     int height,
+                                                     int offset,
+                                                     int stride,
+                                                     int full_w,
+                                                     int full_h,
+                                                     int pixel_size)
+{
+#  ifdef KERNEL_STUB
+  STUB_ASSERT(KERNEL_ARCH, convert_row_to_float);
+#  else
+  kernel_film_convert_row_to_float(kg,
+                                   rgba,
+                                   buffer,
+                                   sample_scale,
+                                   pass_type,
+                                   x,
+                                   y,
+                                   w,
+                                   height,
+                                   offset,
+                                   stride,
+                                   full_w,
+                                   full_h,
+                                   pixel_size);
+#  endif /* KERNEL_STUB */
+}
+
 /* Shader Evaluate */
 
 void KERNEL_FUNCTION_FULL_NAME(shader)(KernelGlobals *kg,
@@ -16,9 +16,66 @@
 
 CCL_NAMESPACE_BEGIN
 
+#ifdef __KERNEL_CPU__
+ccl_device_inline uint kernel_shader_sort_key(KernelGlobals *kg, int ray_index, uint empty_key)
+{
+  if (ray_index == QUEUE_EMPTY_SLOT ||
+      !IS_STATE(kernel_split_state.ray_state, ray_index, RAY_ACTIVE)) {
+    return empty_key;
+  }
+  return kernel_split_sd(sd, ray_index)->shader & SHADER_MASK;
+}
+
+/* Work items run one after the other on the CPU, so instead of sorting small
+ * blocks the whole queue is sorted at once. A counting sort by shader keeps
+ * the ray order within each shader, and moves empty slots to the end. */
+ccl_device_noinline void kernel_shader_sort_cpu(KernelGlobals *kg)
+{
+  uint qsize = kernel_split_params.queue_index[QUEUE_ACTIVE_AND_REGENERATED_RAYS];
+  kernel_split_params.queue_index[QUEUE_SHADER_SORTED_RAYS] = qsize;
+
+  ccl_global int *input = kernel_split_state.queue_data +
+                          QUEUE_ACTIVE_AND_REGENERATED_RAYS * kernel_split_params.queue_size;
+  ccl_global int *output = kernel_split_state.queue_data +
+                           QUEUE_SHADER_SORTED_RAYS * kernel_split_params.queue_size;
+
+  /* One bucket per shader, and a last one for empty slots. */
+  const uint empty_key = kg->__shaders.width;
+  const int num_buckets = empty_key + 1;
+  if (kg->shader_sort_buckets == NULL || kg->shader_sort_num_buckets < num_buckets) {
+    free(kg->shader_sort_buckets);
+    kg->shader_sort_buckets = (uint *)malloc(sizeof(uint) * num_buckets);
+    kg->shader_sort_num_buckets = num_buckets;
+  }
+  uint *buckets = kg->shader_sort_buckets;
+  memset(buckets, 0, sizeof(uint) * num_buckets);
+
+  for (uint i = 0; i < qsize; i++) {
+    buckets[kernel_shader_sort_key(kg, input[i], empty_key)]++;
+  }
+
+  uint offset = 0;
+  for (int i = 0; i < num_buckets; i++) {
+    const uint count = buckets[i];
+    buckets[i] = offset;
+    offset += count;
+  }
+
+  for (uint i = 0; i < qsize; i++) {
+    const uint key = kernel_shader_sort_key(kg, input[i], empty_key);
+    output[buckets[key]++] = (key == empty_key) ? QUEUE_EMPTY_SLOT : input[i];
+  }
+}
+#endif /* __KERNEL_CPU__ */
+
 ccl_device void kernel_shader_sort(KernelGlobals *kg, ccl_local_param ShaderSortLocals *locals)
 {
-#ifndef __KERNEL_CUDA__
+#if defined(__KERNEL_CPU__)
+  int tid = ccl_global_id(1) * ccl_global_size(0) + ccl_global_id(0);
+  if (tid == 0) {
+    kernel_shader_sort_cpu(kg);
+  }
+#elif !defined(__KERNEL_CUDA__)
   int tid = ccl_global_id(1) * ccl_global_size(0) + ccl_global_id(0);
   uint qsize = kernel_split_params.queue_index[QUEUE_ACTIVE_AND_REGENERATED_RAYS];
   if (tid == 0) {
@@ -54,9 +111,6 @@ ccl_device void kernel_shader_sort(KernelGlobals *kg, ccl_local_param ShaderSort
   }
   ccl_barrier(CCL_LOCAL_MEM_FENCE);
 
-  /* skip sorting for cpu split kernel */
-#  ifdef __KERNEL_OPENCL__
-
   /* bitonic sort */
   for (uint length = 1; length < SHADER_SORT_BLOCK_SIZE; length <<= 1) {
     for (uint inc = length; inc > 0; inc >>= 1) {
@@ -77,7 +131,6 @@ ccl_device void kernel_shader_sort(KernelGlobals *kg, ccl_local_param ShaderSort
       }
     }
   }
-#  endif /* __KERNEL_OPENCL__ */
 
   /* copy to destination */
   for (uint i = 0; i < SHADER_SORT_BLOCK_SIZE; i += SHADER_SORT_LOCAL_SIZE) {
@@ -91,7 +144,7 @@ ccl_device void kernel_shader_sort(KernelGlobals *kg, ccl_local_param ShaderSort
                                                               kernel_split_state.queue_data[ini];
     }
   }
-#endif /* __KERNEL_CUDA__ */
+#endif /* __KERNEL_CPU__ */
 }
 
 CCL_NAMESPACE_END
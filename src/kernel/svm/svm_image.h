@@ -18,14 +18,54 @@ CCL_NAMESPACE_BEGIN
 
 #ifdef __TEXTURES__
 
-ccl_device float4 svm_image_texture(KernelGlobals *kg, int id, float x, float y, uint flags)
+/* Estimate the size of the pixel footprint in texture space from the ray
+ * differentials of the default UV map, to pick a mip level for images in the
+ * CPU texture cache. Scaling of the coordinates by mapping nodes is not taken
+ * into account, which may select a sharper level than needed. */
+ccl_device float svm_image_texture_footprint(KernelGlobals *kg, ShaderData *sd)
+{
+#if defined(__KERNEL_CPU__) && defined(__RAY_DIFFERENTIALS__)
+  const AttributeDescriptor desc = find_attribute(kg, sd, ATTR_STD_UV);
+  if (desc.offset == ATTR_STD_NOT_FOUND) {
+    return 0.0f;
+  }
+
+  if (desc.type == NODE_ATTR_FLOAT2) {
+    float2 dx, dy;
+    primitive_attribute_float2(kg, sd, desc, &dx, &dy);
+    return max(len(dx), len(dy));
+  }
+  else {
+    float3 dx, dy;
+    primitive_attribute_float3(kg, sd, desc, &dx, &dy);
+    return max(len(dx), len(dy));
+  }
+#else
+  return 0.0f;
+#endif
+}
+
+/* Image lookup, with sd used to filter images in the CPU texture cache. Lookups
+ * that do not use the UV map pass NULL and sample the full resolution. */
+ccl_device float4
+svm_image_texture(KernelGlobals *kg, ShaderData *sd, int id, float x, float y, uint flags)
 {
   if (id == -1) {
     return make_float4(
         TEX_IMAGE_MISSING_R, TEX_IMAGE_MISSING_G, TEX_IMAGE_MISSING_B, TEX_IMAGE_MISSING_A);
   }
 
+#ifdef __KERNEL_CPU__
+  float4 r;
+  if (sd != NULL && kernel_tex_fetch(__texture_info, id).cache) {
+    r = kernel_tex_image_interp_lod(kg, id, x, y, svm_image_texture_footprint(kg, sd));
+  }
+  else {
+    r = kernel_tex_image_interp(kg, id, x, y);
+  }
+#else
   float4 r = kernel_tex_image_interp(kg, id, x, y);
+#endif
   const float alpha = r.w;
 
   if ((flags & NODE_IMAGE_ALPHA_UNASSOCIATE) && alpha != 1.0f && alpha != 0.0f) {
@@ -131,7 +171,7 @@ ccl_device void svm_node_tex_image(
   }
 
   float4 f;
-  f = svm_image_texture(kg, id, tex_co.x, tex_co.y, flags);
+  f = svm_image_texture(kg, sd, id, tex_co.x, tex_co.y, flags);
 
 
   if(decalusage > 0.0f && co.z < 0.0f)
@@ -234,15 +274,15 @@ ccl_device void svm_node_tex_image_box(KernelGlobals *kg, ShaderData *sd, float
   /* Map so that no textures are flipped, rotation is somewhat arbitrary. */
   if (weight.x > 0.0f) {
     float2 uv = make_float2((signed_N.x < 0.0f) ? 1.0f - co.y : co.y, co.z);
-    f += weight.x * svm_image_texture(kg, id, uv.x, uv.y, flags);
+    f += weight.x * svm_image_texture(kg, NULL, id, uv.x, uv.y, flags);
   }
   if (weight.y > 0.0f) {
     float2 uv = make_float2((signed_N.y > 0.0f) ? 1.0f - co.x : co.x, co.z);
-    f += weight.y * svm_image_texture(kg, id, uv.x, uv.y, flags);
+    f += weight.y * svm_image_texture(kg, NULL, id, uv.x, uv.y, flags);
   }
   if (weight.z > 0.0f) {
     float2 uv = make_float2((signed_N.z > 0.0f) ? 1.0f - co.y : co.y, co.x);
-    f += weight.z * svm_image_texture(kg, id, uv.x, uv.y, flags);
+    f += weight.z * svm_image_texture(kg, NULL, id, uv.x, uv.y, flags);
   }
 
   if (stack_valid(out_offset))
@@ -672,7 +712,7 @@ ccl_device void svm_node_tex_environment(KernelGlobals *kg,
     uv.y = co.y;
   }
 
-  float4 f = svm_image_texture(kg, id, uv.x, uv.y, flags);
+  float4 f = svm_image_texture(kg, NULL, id, uv.x, uv.y, flags);
 
   if (stack_valid(out_offset))
     stack_store_float3(stack, out_offset, make_float3(f.x, f.y, f.z));
@@ -121,6 +121,7 @@ RenderTile::RenderTile()
 
   offset = 0;
   stride = 0;
+  converged = false;
 
   buffer = 0;
 
@@ -145,6 +145,8 @@ class RenderTile {
   int offset;
   int stride;
   int tile_index;
+  /* Set by the device when adaptive sampling found all pixels of the tile converged. */
+  bool converged;
 
   device_ptr buffer;
   int device_size;
@@ -25,6 +25,10 @@
 
 CCL_NAMESPACE_BEGIN
 
+/* Number of slots above which the arena of a pass gets smaller tables per
+ * pixel, 32 MB of slots. */
+#define COVERAGE_ARENA_MAX_SLOTS (4 * 1024 * 1024)
+
 static bool crypomatte_comp(const pair<float, float> &i, const pair<float, float> j)
 {
   return i.first > j.first;
@@ -52,20 +56,42 @@ void Coverage::init_path_trace()
 
   if (kernel_data.film.cryptomatte_passes & CRYPT_ACCURATE) {
     if (kernel_data.film.cryptomatte_passes & CRYPT_OBJECT) {
-      coverage_object.clear();
-      coverage_object.resize(tile.w * tile.h);
+      init_buffer(coverage_object, slots_object);
     }
     if (kernel_data.film.cryptomatte_passes & CRYPT_MATERIAL) {
-      coverage_material.clear();
-      coverage_material.resize(tile.w * tile.h);
+      init_buffer(coverage_material, slots_material);
     }
     if (kernel_data.film.cryptomatte_passes & CRYPT_ASSET) {
-      coverage_asset.clear();
-      coverage_asset.resize(tile.w * tile.h);
+      init_buffer(coverage_asset, slots_asset);
     }
   }
 }
 
+void Coverage::init_buffer(vector<CoverageMap> &coverage, vector<CoverageMapSlot> &slots)
+{
+  /* The output keeps 2 * depth IDs per pixel. The table of each pixel gets at
+   * least twice that many slots, so those IDs rarely spill out of it. For
+   * large tiles the table shrinks to keep the arena within the budget, down
+   * to four slots per pixel, the rest of the IDs go to the spill maps. */
+  const int num_slots = 2 * kernel_data.film.cryptomatte_depth;
+  const int num_pixels = tile.w * tile.h;
+  int capacity = 8;
+  while (capacity < 2 * num_slots) {
+    capacity *= 2;
+  }
+  while (capacity > 4 && (size_t)num_pixels * capacity > COVERAGE_ARENA_MAX_SLOTS) {
+    capacity /= 2;
+  }
+
+  coverage.clear();
+  coverage.resize(num_pixels);
+  slots.resize((size_t)num_pixels * capacity);
+
+  for (int i = 0; i < num_pixels; i++) {
+    coverage[i].init(&slots[(size_t)i * capacity], capacity);
+  }
+}
+
 void Coverage::init_pixel(int x, int y)
 {
   if (kernel_data.film.cryptomatte_passes & CRYPT_ACCURATE) {
@@ -97,6 +123,7 @@ void Coverage::flatten_buffer(vector<CoverageMap> &coverage, const int pass_offs
   /* Sort the coverage map and write it to the output */
   int pixel_index = 0;
   int pass_stride = tile.buffers->params.get_passes_size();
+  vector<pair<float, float>> sorted_pixel;
   for (int y = 0; y < tile.h; ++y) {
     for (int x = 0; x < tile.w; ++x) {
       const CoverageMap &pixel = coverage[pixel_index];
@@ -106,9 +133,18 @@ void Coverage::flatten_buffer(vector<CoverageMap> &coverage, const int pass_offs
         float *buffer = (float *)tile.buffer + index * pass_stride;
 
         /* sort the cryptomatte pixel */
-        vector<pair<float, float>> sorted_pixel;
-        for (CoverageMap::const_iterator it = pixel.begin(); it != pixel.end(); ++it) {
-          sorted_pixel.push_back(std::make_pair(it->second, it->first));
+        sorted_pixel.clear();
+        for (int i = 0; i < pixel.capacity; ++i) {
+          if (pixel.slots[i].id != ID_NONE) {
+            sorted_pixel.push_back(std::make_pair(pixel.slots[i].weight, pixel.slots[i].id));
+          }
+        }
+        if (pixel.spill) {
+          for (unordered_map<float, float>::const_iterator it = pixel.spill->begin();
+               it != pixel.spill->end();
+               ++it) {
+            sorted_pixel.push_back(std::make_pair(it->second, it->first));
+          }
         }
         sort(sorted_pixel.begin(), sorted_pixel.end(), crypomatte_comp);
         int num_slots = 2 * (kernel_data.film.cryptomatte_depth);
@@ -39,8 +39,13 @@ class Coverage {
   vector<CoverageMap> coverage_object;
   vector<CoverageMap> coverage_material;
   vector<CoverageMap> coverage_asset;
+  /* Slots of all pixel maps of the tile, allocated once per tile. */
+  vector<CoverageMapSlot> slots_object;
+  vector<CoverageMapSlot> slots_material;
+  vector<CoverageMapSlot> slots_asset;
   KernelGlobals *kg;
   RenderTile &tile;
+  void init_buffer(vector<CoverageMap> &coverage, vector<CoverageMapSlot> &slots);
   void finalize_buffer(vector<CoverageMap> &coverage, const int pass_offset);
   void flatten_buffer(vector<CoverageMap> &coverage, const int pass_offset);
   void sort_buffer(const int pass_offset);
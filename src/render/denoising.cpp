@@ -429,17 +429,19 @@ void DenoiseTask::create_task(DeviceTask &task)
 
 /* Denoiser Operations */
 
-bool DenoiseTask::load_input_pixels(int layer)
+bool DenoiseTask::prepare_input_pixels(int layer)
 {
   int w = image.width;
   int h = image.height;
   int num_pixels = image.width * image.height;
   int frame_stride = num_pixels * INPUT_NUM_CHANNELS;
 
+  layer_pixels.resize((size_t)frame_stride * (image.in_neighbors.size() + 1));
+
   /* Load center image */
   DenoiseImageLayer &image_layer = image.layers[layer];
 
-  float *buffer_data = input_pixels.data();
+  float *buffer_data = layer_pixels.data();
   image.read_pixels(image_layer, buffer_data);
   buffer_data += frame_stride;
 
@@ -453,7 +455,7 @@ bool DenoiseTask::load_input_pixels(int layer)
   }
 
   /* Preprocess */
-  buffer_data = input_pixels.data();
+  buffer_data = layer_pixels.data();
   for (int neighbor = 0; neighbor < image.in_neighbors.size() + 1; neighbor++) {
     /* Clamp */
     if (denoiser->params.clamp_input) {
@@ -507,12 +509,14 @@ bool DenoiseTask::load_input_pixels(int layer)
     buffer_data += frame_stride;
   }
 
-  /* Copy to device */
-  input_pixels.copy_to_device();
-
   return true;
 }
 
+void DenoiseTask::prepare_input_pixels_task(int layer, bool *ok)
+{
+  *ok = prepare_input_pixels(layer);
+}
+
 /* Task stages */
 
 bool DenoiseTask::load()
@@ -531,28 +535,29 @@ bool DenoiseTask::load()
     return false;
   }
 
+  /* Prepare pixels for first layer. */
+  return prepare_input_pixels(0);
+}
+
+bool DenoiseTask::exec()
+{
   /* Allocate device buffer. */
   int num_frames = image.in_neighbors.size() + 1;
   input_pixels.alloc(image.width * INPUT_NUM_CHANNELS, image.height * num_frames);
-  input_pixels.zero_to_device();
-
-  /* Read pixels for first layer. */
-  current_layer = 0;
-  if (!load_input_pixels(current_layer)) {
-    return false;
-  }
 
-  return true;
-}
+  bool ok = true;
 
-bool DenoiseTask::exec()
-{
   for (current_layer = 0; current_layer < image.layers.size(); current_layer++) {
-    /* Read pixels for secondary layers, first was already loaded. */
-    if (current_layer > 0) {
-      if (!load_input_pixels(current_layer)) {
-        return false;
-      }
+    /* Copy prepared pixels to device, first layer was prepared while loading. */
+    memcpy(input_pixels.data(), layer_pixels.data(), sizeof(float) * layer_pixels.size());
+    input_pixels.copy_to_device();
+
+    /* Prepare the next layer on the host while this one is denoised. */
+    bool next_ok = true;
+    thread *next_thread = NULL;
+    if (current_layer + 1 < image.layers.size()) {
+      next_thread = new thread(function_bind(
+          &DenoiseTask::prepare_input_pixels_task, this, current_layer + 1, &next_ok));
     }
 
     /* Run task on device. */
@@ -562,15 +567,29 @@ bool DenoiseTask::exec()
     device->task_wait();
 
     printf("\n");
+
+    if (next_thread) {
+      next_thread->join();
+      delete next_thread;
+
+      if (!next_ok) {
+        ok = false;
+        break;
+      }
+    }
   }
 
-  return true;
+  /* Free device memory here, saving may happen on another thread. */
+  input_pixels.free();
+  layer_pixels.clear();
+
+  return ok;
 }
 
 bool DenoiseTask::save()
 {
   bool ok = image.save_output(denoiser->output[frame], error);
-  free();
+  image.free();
   return ok;
 }
 
@@ -605,6 +624,7 @@ void DenoiseImage::free()
 {
   close_input();
   pixels.clear();
+  neighbor_pixels.clear();
 }
 
 bool DenoiseImage::parse_channels(const ImageSpec &in_spec, string &error)
@@ -687,21 +707,21 @@ bool DenoiseImage::read_neighbor_pixels(int neighbor,
                                         const DenoiseImageLayer &layer,
                                         float *input_pixels)
 {
-  /* Load pixels from neighboring frames, and copy them into device buffer
-   * with channels reshuffled. */
-  size_t num_pixels = (size_t)width * (size_t)height;
-  array<float> neighbor_pixels(num_pixels * num_channels);
-  if (!in_neighbors[neighbor]->read_image(TypeDesc::FLOAT, neighbor_pixels.data())) {
+  /* Pixels from neighboring frames have already been loaded, copy them into
+   * device buffer with channels reshuffled. */
+  if (neighbor >= neighbor_pixels.size()) {
     return false;
   }
 
+  const float *pixels = neighbor_pixels[neighbor].data();
+  const int neighbor_num_channels = in_neighbors[neighbor]->spec().nchannels;
   const int *input_to_image_channel = layer.neighbor_input_to_image_channel[neighbor].data();
 
   for (int i = 0; i < width * height; i++) {
     for (int j = 0; j < INPUT_NUM_CHANNELS; j++) {
       int image_channel = input_to_image_channel[j];
       input_pixels[i * INPUT_NUM_CHANNELS + j] =
-          neighbor_pixels[((size_t)i) * num_channels + image_channel];
+          pixels[((size_t)i) * neighbor_num_channels + image_channel];
     }
   }
 
@@ -785,6 +805,16 @@ bool DenoiseImage::load_neighbors(const vector<string> &filepaths,
       }
     }
 
+    /* Read all channels once, they are shared by all layers. */
+    size_t num_pixels = (size_t)width * (size_t)height;
+    array<float> pixels(num_pixels * neighbor_spec.nchannels);
+    if (!in_neighbor->read_image(TypeDesc::FLOAT, pixels.data())) {
+      error = "Failed to read neighbor frame pixels: " + filepath;
+      return false;
+    }
+
+    neighbor_pixels.push_back(array<float>());
+    neighbor_pixels.back().steal_data(pixels);
     in_neighbors.push_back(std::move(in_neighbor));
   }
 
@@ -859,6 +889,7 @@ Denoiser::Denoiser(DeviceInfo &device_info)
 {
   samples_override = 0;
   tile_size = make_int2(64, 64);
+  prefetch_frames = 1;
 
   num_frames = 0;
 
@@ -879,44 +910,109 @@ Denoiser::~Denoiser()
   TaskScheduler::exit();
 }
 
+/* Frame in flight in the denoising pipeline, with the thread loading or
+ * saving it. */
+struct DenoisePipelineFrame {
+  unique_ptr<DenoiseTask> task;
+  thread *io_thread;
+  bool ok;
+
+  DenoisePipelineFrame() : io_thread(NULL), ok(true)
+  {
+  }
+
+  ~DenoisePipelineFrame()
+  {
+    join();
+  }
+
+  bool join()
+  {
+    if (io_thread) {
+      io_thread->join();
+      delete io_thread;
+      io_thread = NULL;
+    }
+    return ok;
+  }
+};
+
+static void denoise_pipeline_load(DenoisePipelineFrame *frame)
+{
+  frame->ok = frame->task->load();
+}
+
+static void denoise_pipeline_save(DenoisePipelineFrame *frame)
+{
+  frame->ok = frame->task->save();
+}
+
 bool Denoiser::run()
 {
   assert(input.size() == output.size());
 
   num_frames = output.size();
 
+  /* Skip empty output paths. */
+  vector<int> frames;
   for (int frame = 0; frame < num_frames; frame++) {
-    /* Skip empty output paths. */
-    if (output[frame].empty()) {
-      continue;
+    if (!output[frame].empty()) {
+      frames.push_back(frame);
     }
+  }
+
+  /* Frames are loaded ahead and saved behind on I/O threads, while the device
+   * denoises the current one. */
+  list<unique_ptr<DenoisePipelineFrame>> loading;
+  unique_ptr<DenoisePipelineFrame> saving;
+  size_t next_load = 0;
 
-    /* Determine neighbor frame numbers that should be used for filtering. */
-    vector<int> neighbor_frames;
-    for (int f = frame - params.neighbor_frames; f <= frame + params.neighbor_frames; f++) {
-      if (f >= 0 && f < num_frames && f != frame) {
-        neighbor_frames.push_back(f);
+  for (size_t i = 0; i < frames.size(); i++) {
+    while (next_load < frames.size() && next_load <= i + max(prefetch_frames, 0)) {
+      const int frame = frames[next_load++];
+
+      /* Determine neighbor frame numbers that should be used for filtering. */
+      vector<int> neighbor_frames;
+      for (int f = frame - params.neighbor_frames; f <= frame + params.neighbor_frames; f++) {
+        if (f >= 0 && f < num_frames && f != frame) {
+          neighbor_frames.push_back(f);
+        }
       }
+
+      DenoisePipelineFrame *pipeline_frame = new DenoisePipelineFrame();
+      pipeline_frame->task.reset(new DenoiseTask(device, this, frame, neighbor_frames));
+      pipeline_frame->io_thread = new thread(
+          function_bind(&denoise_pipeline_load, pipeline_frame));
+      loading.push_back(unique_ptr<DenoisePipelineFrame>(pipeline_frame));
     }
 
     /* Execute task. */
-    DenoiseTask task(device, this, frame, neighbor_frames);
-    if (!task.load()) {
-      error = task.error;
+    unique_ptr<DenoisePipelineFrame> current = std::move(loading.front());
+    loading.pop_front();
+
+    if (!current->join()) {
+      error = current->task->error;
       return false;
     }
 
-    if (!task.exec()) {
-      error = task.error;
+    if (!current->task->exec()) {
+      error = current->task->error;
       return false;
     }
 
-    if (!task.save()) {
-      error = task.error;
+    /* Wait for the previous frame to be written before writing this one. */
+    if (saving && !saving->join()) {
+      error = saving->task->error;
       return false;
     }
 
-    task.free();
+    saving = std::move(current);
+    saving->io_thread = new thread(function_bind(&denoise_pipeline_save, saving.get()));
+  }
+
+  if (saving && !saving->join()) {
+    error = saving->task->error;
+    return false;
   }
 
   return true;
@@ -55,6 +55,9 @@ class Denoiser {
   int samples_override;
   /* Tile size for processing on device. */
   int2 tile_size;
+  /* Number of frames to load ahead on I/O threads while the current frame is
+   * denoised. Outputs are written asynchronously as well. */
+  int prefetch_frames;
 
   /* Equivalent to the settings in the regular denoiser. */
   DenoiseParams params;
@@ -123,6 +126,9 @@ class DenoiseImage {
   ImageSpec in_spec;
   vector<unique_ptr<ImageInput>> in_neighbors;
 
+  /* Pixels of the neighbor frames, read once for all layers. */
+  vector<array<float>> neighbor_pixels;
+
   /* Render layers */
   vector<DenoiseImageLayer> layers;
 
@@ -132,7 +138,7 @@ class DenoiseImage {
    * buffer. */
   bool load(const string &in_filepath, string &error);
 
-  /* Load neighboring frames. */
+  /* Open and read neighboring frames. */
   bool load_neighbors(const vector<string> &filepaths, const vector<int> &frames, string &error);
 
   /* Load subset of pixels from file buffer into input buffer, as needed for denoising
@@ -158,7 +164,8 @@ class DenoiseTask {
   DenoiseTask(Device *device, Denoiser *denoiser, int frame, const vector<int> &neighbor_frames);
   ~DenoiseTask();
 
-  /* Task stages */
+  /* Task stages. Loading and saving only touch host memory and files, so they
+   * may run on other threads than exec(). */
   bool load();
   bool exec();
   bool save();
@@ -179,6 +186,10 @@ class DenoiseTask {
   DenoiseImage image;
   int current_layer;
 
+  /* Preprocessed input of the next layer, prepared on the host while the
+   * device denoises the current one. */
+  array<float> layer_pixels;
+
   /* Device input buffer */
   device_vector<float> input_pixels;
 
@@ -191,7 +202,8 @@ class DenoiseTask {
   map<int, device_vector<float> *> output_pixels;
 
   /* Task handling */
-  bool load_input_pixels(int layer);
+  bool prepare_input_pixels(int layer);
+  void prepare_input_pixels_task(int layer, bool *ok);
   void create_task(DeviceTask &task);
 
   /* Device task callbacks */
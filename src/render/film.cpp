@@ -20,6 +20,7 @@
 #include "render/integrator.h"
 #include "render/mesh.h"
 #include "render/scene.h"
+#include "render/shader.h"
 #include "render/tables.h"
 
 #include "util/util_algorithm.h"
@@ -196,6 +197,13 @@ void Pass::add(PassType type, vector<Pass> &passes, const char *name)
     case PASS_AOV_VALUE:
       pass.components = 1;
       break;
+    case PASS_ADAPTIVE_AUX_BUFFER:
+      pass.components = 4;
+      break;
+    case PASS_SAMPLE_COUNT:
+      pass.components = 1;
+      pass.filter = false;
+      break;
     default:
       assert(false);
       break;
@@ -360,6 +368,8 @@ void Film::device_update(Device *device, DeviceScene *dscene, Scene *scene)
   kfilm->light_pass_flag = 0;
   kfilm->pass_stride = 0;
   kfilm->use_light_pass = use_light_visibility;
+  kfilm->pass_adaptive_aux_buffer = 0;
+  kfilm->pass_sample_count = 0;
 
   bool have_cryptomatte = false, have_aov_color = false, have_aov_value = false;
 
@@ -510,6 +520,12 @@ void Film::device_update(Device *device, DeviceScene *dscene, Scene *scene)
           have_aov_value = true;
         }
         break;
+      case PASS_ADAPTIVE_AUX_BUFFER:
+        kfilm->pass_adaptive_aux_buffer = kfilm->pass_stride;
+        break;
+      case PASS_SAMPLE_COUNT:
+        kfilm->pass_sample_count = kfilm->pass_stride;
+        break;
       default:
         assert(false);
         break;
@@ -590,8 +606,24 @@ bool Film::modified(const Film &film)
   return !Node::equals(film) || !Pass::equals(passes, film.passes);
 }
 
+static vector<Pass> film_aov_passes(const vector<Pass> &passes)
+{
+  vector<Pass> aov_passes;
+  foreach (const Pass &pass, passes) {
+    if (pass.type == PASS_AOV_COLOR || pass.type == PASS_AOV_VALUE) {
+      aov_passes.push_back(pass);
+    }
+  }
+  return aov_passes;
+}
+
 void Film::tag_passes_update(Scene *scene, const vector<Pass> &passes_, bool update_passes)
 {
+  /* AOV output nodes are compiled with the offset of their pass. */
+  if (!Pass::equals(film_aov_passes(passes), film_aov_passes(passes_))) {
+    scene->shader_manager->need_update = true;
+  }
+
   if (Pass::contains(passes, PASS_UV) != Pass::contains(passes_, PASS_UV)) {
     scene->mesh_manager->tag_update(scene);
 
@@ -775,6 +775,35 @@ void ShaderGraph::compute_displacement_hash()
   displacement_hash = md5.get_hex();
 }
 
+string ShaderGraph::compute_hash()
+{
+  /* Hash of all nodes and links, used to detect if a shader needs to be
+   * compiled again. */
+  MD5Hash md5;
+  foreach (ShaderNode *node, nodes) {
+    node->hash(md5);
+    node->hash_runtime(md5);
+    foreach (ShaderInput *input, node->inputs) {
+      if (input->link) {
+        int link_id = input->link->parent->id;
+        md5.append((uint8_t *)&link_id, sizeof(link_id));
+        md5.append(input->link->name().string());
+      }
+      else {
+        int link_id = -1;
+        md5.append((uint8_t *)&link_id, sizeof(link_id));
+      }
+    }
+
+    if (node->special_type == SHADER_SPECIAL_TYPE_OSL) {
+      OSLNode *oslnode = static_cast<OSLNode *>(node);
+      md5.append(oslnode->bytecode_hash);
+    }
+  }
+
+  return md5.get_hex();
+}
+
 void ShaderGraph::clean(Scene *scene)
 {
   /* Graph simplification */
@@ -224,6 +224,13 @@ class ShaderNode : public Node {
   {
     return false;
   }
+
+  /* Append state that is set up when compiling the node and not stored in its
+   * sockets, like image slots, to the hash of the graph. */
+  virtual void hash_runtime(MD5Hash & /*md5*/)
+  {
+  }
+
   vector<ShaderInput *> inputs;
   vector<ShaderOutput *> outputs;
 
@@ -339,6 +346,7 @@ class ShaderGraph {
 
   void remove_proxy_nodes();
   void compute_displacement_hash();
+  string compute_hash();
   void simplify(Scene *scene);
   void finalize(Scene *scene,
                 bool do_bump = false,
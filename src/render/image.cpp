@@ -23,9 +23,11 @@
 #include "util/util_foreach.h"
 #include "util/util_image_impl.h"
 #include "util/util_logging.h"
+#include "util/util_md5.h"
 #include "util/util_path.h"
 #include "util/util_progress.h"
 #include "util/util_texture.h"
+#include "util/util_texture_cache.h"
 #include "util/util_unique_ptr.h"
 
 #ifdef WITH_OSL
@@ -92,6 +94,25 @@ const char *name_from_type(ImageDataType type)
   return "";
 }
 
+/* Images smaller than this are always fully loaded. */
+const int TEXTURE_CACHE_MIN_SIZE = 256;
+
+/* Cache files are keyed on everything that affects the converted pixels, so
+ * that a modified image or different color settings produce a new file. */
+string texture_cache_filepath(const ImageManager::Image *img, ImageDataType type)
+{
+  MD5Hash md5;
+  md5.append(img->filename);
+  md5.append(string_printf("%llu_%d_%d_%d_%d",
+                           (unsigned long long)path_modified_time(img->filename),
+                           (int)type,
+                           (int)img->extension,
+                           (int)img->alpha_type,
+                           (int)img->metadata.compress_as_srgb));
+  md5.append(img->colorspace.string());
+  return path_cache_get(path_join("textures", md5.get_hex() + ".ctc"));
+}
+
 }  // namespace
 
 ImageManager::ImageManager(const DeviceInfo &info)
@@ -788,6 +809,67 @@ bool ImageManager::file_load_image(Image *img,
   return true;
 }
 
+template<TypeDesc::BASETYPE FileFormat, typename StorageType, typename DeviceType>
+bool ImageManager::file_load_cached_image(Image *img,
+                                          ImageDataType type,
+                                          int texture_limit,
+                                          device_vector<DeviceType> &tex_img)
+{
+  if (!texture_cache || img->builtin_data || img->metadata.depth > 1 ||
+      max(img->metadata.width, img->metadata.height) <= TEXTURE_CACHE_MIN_SIZE) {
+    return file_load_image<FileFormat, StorageType, DeviceType>(
+        img, type, texture_limit, tex_img);
+  }
+
+  const string filepath = texture_cache_filepath(img, type);
+  unique_ptr<TextureCacheImage> cache_image(new TextureCacheImage(texture_cache.get()));
+
+  if (!cache_image->open(filepath, type, img->extension)) {
+    /* Convert the image at full resolution, the mip levels make the texture
+     * limit unnecessary. */
+    if (!file_load_image<FileFormat, StorageType, DeviceType>(img, type, 0, tex_img)) {
+      return false;
+    }
+
+    if (!TextureCacheImage::write(filepath,
+                                  type,
+                                  img->extension,
+                                  tex_img.data(),
+                                  tex_img.data_width,
+                                  tex_img.data_height) ||
+        !cache_image->open(filepath, type, img->extension)) {
+      VLOG(1) << "Failed to write texture cache file " << filepath << ", keeping "
+              << img->filename << " in memory.";
+      if (texture_limit > 0) {
+        return file_load_image<FileFormat, StorageType, DeviceType>(
+            img, type, texture_limit, tex_img);
+      }
+      return true;
+    }
+
+    VLOG(1) << "Wrote texture cache file " << filepath << " for " << img->filename << ".";
+  }
+
+  /* The kernel reads all texels through the cache, keep only a placeholder
+   * texel in the device texture. */
+  thread_scoped_lock device_lock(device_mutex);
+  DeviceType *pixels = tex_img.alloc(1, 1);
+  memset(pixels, 0, sizeof(DeviceType));
+  tex_img.cache_image = cache_image.release();
+
+  return true;
+}
+
+void ImageManager::device_free_image_memory(Image *img)
+{
+  thread_scoped_lock device_lock(device_mutex);
+  TextureCacheImage *cache_image = img->mem->cache_image;
+  delete img->mem;
+  img->mem = NULL;
+  /* Delete after the device texture, so the kernel can no longer use it. */
+  delete cache_image;
+}
+
 void ImageManager::device_load_image(
     Device *device, Scene *scene, ImageDataType type, int slot, Progress *progress)
 {
@@ -810,9 +892,7 @@ void ImageManager::device_load_image(
 
   /* Free previous texture in slot. */
   if (img->mem) {
-    thread_scoped_lock device_lock(device_mutex);
-    delete img->mem;
-    img->mem = NULL;
+    device_free_image_memory(img);
   }
 
   /* Create new texture. */
@@ -820,7 +900,7 @@ void ImageManager::device_load_image(
     device_vector<float4> *tex_img = new device_vector<float4>(
         device, img->mem_name.c_str(), MEM_TEXTURE);
 
-    if (!file_load_image<TypeDesc::FLOAT, float, float4>(img, type, texture_limit, *tex_img)) {
+    if (!file_load_cached_image<TypeDesc::FLOAT, float, float4>(img, type, texture_limit, *tex_img)) {
       /* on failure to load, we set a 1x1 pixels pink image */
       thread_scoped_lock device_lock(device_mutex);
       float *pixels = (float *)tex_img->alloc(1, 1);
@@ -842,7 +922,7 @@ void ImageManager::device_load_image(
     device_vector<float> *tex_img = new device_vector<float>(
         device, img->mem_name.c_str(), MEM_TEXTURE);
 
-    if (!file_load_image<TypeDesc::FLOAT, float>(img, type, texture_limit, *tex_img)) {
+    if (!file_load_cached_image<TypeDesc::FLOAT, float>(img, type, texture_limit, *tex_img)) {
       /* on failure to load, we set a 1x1 pixels pink image */
       thread_scoped_lock device_lock(device_mutex);
       float *pixels = (float *)tex_img->alloc(1, 1);
@@ -861,7 +941,7 @@ void ImageManager::device_load_image(
     device_vector<uchar4> *tex_img = new device_vector<uchar4>(
         device, img->mem_name.c_str(), MEM_TEXTURE);
 
-    if (!file_load_image<TypeDesc::UINT8, uchar>(img, type, texture_limit, *tex_img)) {
+    if (!file_load_cached_image<TypeDesc::UINT8, uchar>(img, type, texture_limit, *tex_img)) {
       /* on failure to load, we set a 1x1 pixels pink image */
       thread_scoped_lock device_lock(device_mutex);
       uchar *pixels = (uchar *)tex_img->alloc(1, 1);
@@ -883,7 +963,7 @@ void ImageManager::device_load_image(
     device_vector<uchar> *tex_img = new device_vector<uchar>(
         device, img->mem_name.c_str(), MEM_TEXTURE);
 
-    if (!file_load_image<TypeDesc::UINT8, uchar>(img, type, texture_limit, *tex_img)) {
+    if (!file_load_cached_image<TypeDesc::UINT8, uchar>(img, type, texture_limit, *tex_img)) {
       /* on failure to load, we set a 1x1 pixels pink image */
       thread_scoped_lock device_lock(device_mutex);
       uchar *pixels = (uchar *)tex_img->alloc(1, 1);
@@ -902,7 +982,7 @@ void ImageManager::device_load_image(
     device_vector<half4> *tex_img = new device_vector<half4>(
         device, img->mem_name.c_str(), MEM_TEXTURE);
 
-    if (!file_load_image<TypeDesc::HALF, half>(img, type, texture_limit, *tex_img)) {
+    if (!file_load_cached_image<TypeDesc::HALF, half>(img, type, texture_limit, *tex_img)) {
       /* on failure to load, we set a 1x1 pixels pink image */
       thread_scoped_lock device_lock(device_mutex);
       half *pixels = (half *)tex_img->alloc(1, 1);
@@ -924,7 +1004,7 @@ void ImageManager::device_load_image(
     device_vector<uint16_t> *tex_img = new device_vector<uint16_t>(
         device, img->mem_name.c_str(), MEM_TEXTURE);
 
-    if (!file_load_image<TypeDesc::USHORT, uint16_t>(img, type, texture_limit, *tex_img)) {
+    if (!file_load_cached_image<TypeDesc::USHORT, uint16_t>(img, type, texture_limit, *tex_img)) {
       /* on failure to load, we set a 1x1 pixels pink image */
       thread_scoped_lock device_lock(device_mutex);
       uint16_t *pixels = (uint16_t *)tex_img->alloc(1, 1);
@@ -943,7 +1023,7 @@ void ImageManager::device_load_image(
     device_vector<ushort4> *tex_img = new device_vector<ushort4>(
         device, img->mem_name.c_str(), MEM_TEXTURE);
 
-    if (!file_load_image<TypeDesc::USHORT, uint16_t>(img, type, texture_limit, *tex_img)) {
+    if (!file_load_cached_image<TypeDesc::USHORT, uint16_t>(img, type, texture_limit, *tex_img)) {
       /* on failure to load, we set a 1x1 pixels pink image */
       thread_scoped_lock device_lock(device_mutex);
       uint16_t *pixels = (uint16_t *)tex_img->alloc(1, 1);
@@ -965,7 +1045,7 @@ void ImageManager::device_load_image(
     device_vector<half> *tex_img = new device_vector<half>(
         device, img->mem_name.c_str(), MEM_TEXTURE);
 
-    if (!file_load_image<TypeDesc::HALF, half>(img, type, texture_limit, *tex_img)) {
+    if (!file_load_cached_image<TypeDesc::HALF, half>(img, type, texture_limit, *tex_img)) {
       /* on failure to load, we set a 1x1 pixels pink image */
       thread_scoped_lock device_lock(device_mutex);
       half *pixels = (half *)tex_img->alloc(1, 1);
@@ -996,8 +1076,7 @@ void ImageManager::device_free_image(Device *, ImageDataType type, int slot)
     }
 
     if (img->mem) {
-      thread_scoped_lock device_lock(device_mutex);
-      delete img->mem;
+      device_free_image_memory(img);
     }
 
     delete img;
@@ -1012,6 +1091,13 @@ void ImageManager::device_update(Device *device, Scene *scene, Progress &progres
     return;
   }
 
+  if (scene->params.texture_cache_size > 0 && device->info.type == DEVICE_CPU) {
+    if (!texture_cache) {
+      texture_cache.reset(new TextureCache());
+    }
+    texture_cache->set_memory_limit((size_t)scene->params.texture_cache_size * 1024 * 1024);
+  }
+
   TaskPool pool;
   for (int type = 0; type < IMAGE_DATA_NUM_TYPES; type++) {
     for (size_t slot = 0; slot < images[type].size(); slot++) {
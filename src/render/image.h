@@ -35,6 +35,7 @@ class Progress;
 class RenderStats;
 class Scene;
 class ColorSpaceProcessor;
+class TextureCache;
 
 class ImageMetaData {
  public:
@@ -176,6 +177,9 @@ class ImageManager {
   vector<Image *> images[IMAGE_DATA_NUM_TYPES];
   void *osl_texture_system;
 
+  /* Tiles of large file images read on demand, CPU rendering only. */
+  unique_ptr<TextureCache> texture_cache;
+
   bool file_load_image_generic(Image *img, unique_ptr<ImageInput> *in);
 
   template<TypeDesc::BASETYPE FileFormat, typename StorageType, typename DeviceType>
@@ -184,6 +188,14 @@ class ImageManager {
                        int texture_limit,
                        device_vector<DeviceType> &tex_img);
 
+  template<TypeDesc::BASETYPE FileFormat, typename StorageType, typename DeviceType>
+  bool file_load_cached_image(Image *img,
+                              ImageDataType type,
+                              int texture_limit,
+                              device_vector<DeviceType> &tex_img);
+
+  void device_free_image_memory(Image *img);
+
   void metadata_detect_colorspace(ImageMetaData &metadata, const char *file_format);
 
   void device_load_image(
@@ -18,6 +18,7 @@
 #include "render/background.h"
 #include "render/integrator.h"
 #include "render/film.h"
+#include "render/jitter.h"
 #include "render/light.h"
 #include "render/scene.h"
 #include "render/shader.h"
@@ -25,6 +26,8 @@
 
 #include "util/util_foreach.h"
 #include "util/util_hash.h"
+#include "util/util_logging.h"
+#include "util/util_task.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -47,11 +50,13 @@ NODE_DEFINE(Integrator)
 
   SOCKET_INT(volume_max_steps, "Volume Max Steps", 1024);
   SOCKET_FLOAT(volume_step_size, "Volume Step Size", 0.1f);
+  SOCKET_BOOLEAN(volume_majorant_tracking, "Volume Majorant Tracking", false);
 
   SOCKET_BOOLEAN(caustics_reflective, "Reflective Caustics", true);
   SOCKET_BOOLEAN(caustics_refractive, "Refractive Caustics", true);
   SOCKET_FLOAT(filter_glossy, "Filter Glossy", 0.0f);
   SOCKET_INT(seed, "Seed", 0);
+  SOCKET_BOOLEAN(blue_noise_seed, "Blue Noise Seed", false);
   SOCKET_FLOAT(sample_clamp_direct, "Sample Clamp Direct", 0.0f);
   SOCKET_FLOAT(sample_clamp_indirect, "Sample Clamp Indirect", 0.0f);
   SOCKET_BOOLEAN(motion_blur, "Motion Blur", false);
@@ -66,9 +71,14 @@ NODE_DEFINE(Integrator)
   SOCKET_INT(volume_samples, "Volume Samples", 1);
   SOCKET_INT(start_sample, "Start Sample", 0);
 
+  SOCKET_BOOLEAN(use_adaptive_sampling, "Use Adaptive Sampling", false);
+  SOCKET_FLOAT(adaptive_threshold, "Adaptive Threshold", 0.0f);
+  SOCKET_INT(adaptive_min_samples, "Adaptive Min Samples", 0);
+
   SOCKET_BOOLEAN(sample_all_lights_direct, "Sample All Lights Direct", true);
   SOCKET_BOOLEAN(sample_all_lights_indirect, "Sample All Lights Indirect", true);
   SOCKET_FLOAT(light_sampling_threshold, "Light Sampling Threshold", 0.05f);
+  SOCKET_BOOLEAN(use_light_tree, "Use Light Tree", false);
 
   static NodeEnum method_enum;
   method_enum.insert("path", PATH);
@@ -78,6 +88,8 @@ NODE_DEFINE(Integrator)
   static NodeEnum sampling_pattern_enum;
   sampling_pattern_enum.insert("sobol", SAMPLING_PATTERN_SOBOL);
   sampling_pattern_enum.insert("cmj", SAMPLING_PATTERN_CMJ);
+  sampling_pattern_enum.insert("sobol_owen", SAMPLING_PATTERN_SOBOL_OWEN);
+  sampling_pattern_enum.insert("pmj", SAMPLING_PATTERN_PMJ);
   SOCKET_ENUM(sampling_pattern, "Sampling Pattern", sampling_pattern_enum, SAMPLING_PATTERN_SOBOL);
 
   return type;
@@ -136,12 +148,14 @@ void Integrator::device_update(Device *device, DeviceScene *dscene, Scene *scene
 
   kintegrator->volume_max_steps = volume_max_steps;
   kintegrator->volume_step_size = volume_step_size;
+  kintegrator->volume_majorant_tracking = volume_majorant_tracking;
 
   kintegrator->caustics_reflective = caustics_reflective;
   kintegrator->caustics_refractive = caustics_refractive;
   kintegrator->filter_glossy = (filter_glossy == 0.0f) ? FLT_MAX : 1.0f / filter_glossy;
 
   kintegrator->seed = hash_uint2(seed, 0);
+  kintegrator->blue_noise_seed = blue_noise_seed;
 
   kintegrator->use_ambient_occlusion = ((Pass::contains(scene->film->passes, PASS_AO)) ||
                                         dscene->data.background.ao_factor != 0.0f);
@@ -175,6 +189,28 @@ void Integrator::device_update(Device *device, DeviceScene *dscene, Scene *scene
   kintegrator->sampling_pattern = sampling_pattern;
   kintegrator->aa_samples = aa_samples;
 
+  /* Convergence is only checked every few samples, the minimum number of
+   * samples is rounded up so that the first check happens right after it. */
+  kintegrator->adaptive_step = 4;
+  if (aa_samples > 0 && adaptive_min_samples == 0) {
+    kintegrator->adaptive_min_samples = max(4, (int)sqrtf(aa_samples));
+    VLOG(1) << "Cycles adaptive sampling: automatic min samples = "
+            << kintegrator->adaptive_min_samples;
+  }
+  else {
+    kintegrator->adaptive_min_samples = max(4, adaptive_min_samples);
+  }
+  kintegrator->adaptive_min_samples = align_up(kintegrator->adaptive_min_samples,
+                                               kintegrator->adaptive_step);
+  if (aa_samples > 0 && adaptive_threshold == 0.0f) {
+    kintegrator->adaptive_threshold = max(0.001f, 1.0f / (float)aa_samples);
+    VLOG(1) << "Cycles adaptive sampling: automatic threshold = "
+            << kintegrator->adaptive_threshold;
+  }
+  else {
+    kintegrator->adaptive_threshold = adaptive_threshold;
+  }
+
   if (light_sampling_threshold > 0.0f) {
     kintegrator->light_inv_rr_threshold = 1.0f / light_sampling_threshold;
   }
@@ -209,12 +245,48 @@ void Integrator::device_update(Device *device, DeviceScene *dscene, Scene *scene
 
   dscene->sobol_directions.copy_to_device();
 
+  /* progressive multi-jittered tables, generated once as they only depend
+   * on the pattern index */
+  if (sampling_pattern == SAMPLING_PATTERN_PMJ) {
+    if (dscene->pmj_samples.size() == 0) {
+      uint *samples = dscene->pmj_samples.alloc(NUM_PMJ_PATTERNS * NUM_PMJ_SAMPLES * 2);
+
+      TaskPool pool;
+      for (int pattern = 0; pattern < NUM_PMJ_PATTERNS; pattern++) {
+        pool.push(function_bind(&progressive_multi_jitter_02_generate_2D,
+                                samples + pattern * NUM_PMJ_SAMPLES * 2,
+                                NUM_PMJ_SAMPLES,
+                                hash_uint(pattern)));
+      }
+      pool.wait_work();
+
+      dscene->pmj_samples.copy_to_device();
+    }
+  }
+  else {
+    dscene->pmj_samples.free();
+  }
+
+  /* blue noise mask, also independent of the scene */
+  if (blue_noise_seed) {
+    if (dscene->blue_noise.size() == 0) {
+      float *mask = dscene->blue_noise.alloc(BLUE_NOISE_SIZE * BLUE_NOISE_SIZE);
+      blue_noise_mask_generate(mask, BLUE_NOISE_SIZE, 0);
+      dscene->blue_noise.copy_to_device();
+    }
+  }
+  else {
+    dscene->blue_noise.free();
+  }
+
   need_update = false;
 }
 
 void Integrator::device_free(Device *, DeviceScene *dscene)
 {
   dscene->sobol_directions.free();
+  dscene->pmj_samples.free();
+  dscene->blue_noise.free();
 }
 
 bool Integrator::modified(const Integrator &integrator)
@@ -46,12 +46,18 @@ class Integrator : public Node {
 
   int volume_max_steps;
   float volume_step_size;
+  /* Delta and ratio tracking through volume objects with voxel data, using a
+   * coarse grid of their density as majorant instead of fixed steps. */
+  bool volume_majorant_tracking;
 
   bool caustics_reflective;
   bool caustics_refractive;
   float filter_glossy;
 
   int seed;
+  /* Rotate the samples of each pixel by a tiled blue noise mask instead of a
+   * random value, so error at low sample counts is distributed as blue noise. */
+  bool blue_noise_seed;
 
   float sample_clamp_direct;
   float sample_clamp_indirect;
@@ -71,9 +77,19 @@ class Integrator : public Node {
   int volume_samples;
   int start_sample;
 
+  bool use_adaptive_sampling;
+  /* Noise threshold below which a pixel is considered converged, 0 picks one
+   * automatically from the number of AA samples. */
+  float adaptive_threshold;
+  /* Minimum number of samples per pixel, 0 picks one automatically. */
+  int adaptive_min_samples;
+
   bool sample_all_lights_direct;
   bool sample_all_lights_indirect;
   float light_sampling_threshold;
+  /* Pick lights by their estimated contribution at the shading point instead
+   * of proportional to their area. */
+  bool use_light_tree;
 
   enum Method {
     BRANCHED_PATH = 0,
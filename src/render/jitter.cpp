@@ -0,0 +1,385 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* "Progressive Multi-Jittered Sample Sequences"
+ * Per Christensen, Andrew Kensler and Charlie Kilpatrick, EGSR 2018.
+ *
+ * Every prefix of 2^k points is stratified in all elementary intervals of
+ * area 2^-k, like a (0,2) sequence. Points are generated four at a time per
+ * previous point, first in the diagonally opposite sub-square and then in the
+ * two remaining ones, choosing positions that do not fall in an elementary
+ * interval that is already occupied. */
+
+#include "render/jitter.h"
+
+#include "util/util_math.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+class PMJ02Generator {
+ public:
+  explicit PMJ02Generator(uint seed) : rng_state(seed), num_strata(0), num_shapes(0)
+  {
+    rnd_uint();
+  }
+
+  void generate(uint points[], int size)
+  {
+    x.resize(size);
+    y.resize(size);
+
+    x[0] = rnd_uint();
+    y[0] = rnd_uint();
+
+    for (int N = 1; N < size; N *= 4) {
+      extend_sequence_even(N);
+      if (2 * N < size) {
+        extend_sequence_odd(2 * N);
+      }
+    }
+
+    for (int i = 0; i < size; i++) {
+      points[2 * i + 0] = x[i];
+      points[2 * i + 1] = y[i];
+    }
+  }
+
+ protected:
+  /* Coordinates as 32 bit fixed point, so strata are found with shifts. */
+  vector<uint> x, y;
+
+  /* Occupied elementary intervals for each shape, from num_strata columns
+   * and one row, to one column and num_strata rows. */
+  vector<vector<uchar>> occupied;
+
+  uint rng_state;
+  int num_strata;
+  int num_shapes;
+
+  uint rnd_uint()
+  {
+    /* PCG hash of a LCG state. */
+    rng_state = rng_state * 747796405u + 2891336453u;
+    const uint word = ((rng_state >> ((rng_state >> 28u) + 4u)) ^ rng_state) * 277803737u;
+    return (word >> 22u) ^ word;
+  }
+
+  int rnd_int(int range)
+  {
+    return (int)(((uint64_t)rnd_uint() * (uint64_t)range) >> 32);
+  }
+
+  /* Fine stratum of a coordinate when there are num_strata of them. */
+  int stratum(uint v) const
+  {
+    return (int)(((uint64_t)v * (uint64_t)num_strata) >> 32);
+  }
+
+  bool is_occupied(int xs, int ys) const
+  {
+    for (int shape = 0; shape < num_shapes; shape++) {
+      const int xdivs = num_strata >> shape;
+      const int index = (ys >> (num_shapes - 1 - shape)) * xdivs + (xs >> shape);
+      if (occupied[shape][index]) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void mark_occupied(int xs, int ys)
+  {
+    for (int shape = 0; shape < num_shapes; shape++) {
+      const int xdivs = num_strata >> shape;
+      const int index = (ys >> (num_shapes - 1 - shape)) * xdivs + (xs >> shape);
+      occupied[shape][index] = 1;
+    }
+  }
+
+  /* Reset occupancy for a sequence growing to NN points, and mark the
+   * existing N points. */
+  void mark_occupied_strata(int N, int NN)
+  {
+    num_strata = NN;
+    num_shapes = 1;
+    while ((1 << (num_shapes - 1)) < NN) {
+      num_shapes++;
+    }
+
+    occupied.resize(num_shapes);
+    for (int shape = 0; shape < num_shapes; shape++) {
+      occupied[shape].assign(NN, 0);
+    }
+
+    for (int s = 0; s < N; s++) {
+      mark_occupied(stratum(x[s]), stratum(y[s]));
+    }
+  }
+
+  /* Sub-square of an existing point in a grid of 2n x 2n sub-squares. */
+  void sub_square(int s, int n, int *xsub, int *ysub) const
+  {
+    *xsub = (int)(((uint64_t)x[s] * (uint64_t)(2 * n)) >> 32);
+    *ysub = (int)(((uint64_t)y[s] * (uint64_t)(2 * n)) >> 32);
+  }
+
+  /* Place a new point in the given sub-square. The fine strata are narrower
+   * than every elementary interval, so candidates are pairs of free fine x
+   * and y strata, picked at random first and then searched exhaustively. */
+  void generate_sample_point(int index, int xsub, int ysub, int n)
+  {
+    const int strata_per_sub = num_strata / (2 * n);
+
+    xfree.clear();
+    yfree.clear();
+    for (int i = 0; i < strata_per_sub; i++) {
+      const int xs = xsub * strata_per_sub + i;
+      const int ys = ysub * strata_per_sub + i;
+      if (!occupied[0][xs]) {
+        xfree.push_back(xs);
+      }
+      if (!occupied[num_shapes - 1][ys]) {
+        yfree.push_back(ys);
+      }
+    }
+
+    int xs = xsub * strata_per_sub + rnd_int(strata_per_sub);
+    int ys = ysub * strata_per_sub + rnd_int(strata_per_sub);
+    bool found = false;
+
+    if (!xfree.empty() && !yfree.empty()) {
+      const int num_candidates = (int)(xfree.size() * yfree.size());
+
+      for (int attempt = 0; attempt < 4 * num_candidates && !found; attempt++) {
+        const int xc = xfree[rnd_int((int)xfree.size())];
+        const int yc = yfree[rnd_int((int)yfree.size())];
+        if (!is_occupied(xc, yc)) {
+          xs = xc;
+          ys = yc;
+          found = true;
+        }
+      }
+
+      for (int c = 0; c < num_candidates && !found; c++) {
+        const int xc = xfree[c % xfree.size()];
+        const int yc = yfree[c / xfree.size()];
+        if (!is_occupied(xc, yc)) {
+          xs = xc;
+          ys = yc;
+          found = true;
+        }
+      }
+    }
+
+    /* Jitter within the fine strata. */
+    const int shift = 32 - (num_shapes - 1);
+    x[index] = ((uint)xs << shift) | (rnd_uint() >> (32 - shift));
+    y[index] = ((uint)ys << shift) | (rnd_uint() >> (32 - shift));
+
+    mark_occupied(xs, ys);
+  }
+
+  /* Extend N = 4^k points to 2N, with a point in the diagonally opposite
+   * sub-square of every existing point. */
+  void extend_sequence_even(int N)
+  {
+    const int n = (int)sqrtf((float)N + 0.5f);
+    mark_occupied_strata(N, 2 * N);
+
+    for (int s = 0; s < N; s++) {
+      int xsub, ysub;
+      sub_square(s, n, &xsub, &ysub);
+      generate_sample_point(N + s, xsub ^ 1, ysub ^ 1, n);
+    }
+  }
+
+  /* Extend N = 2 * 4^k points to 2N, filling the two remaining sub-squares
+   * in each cell in random order. */
+  void extend_sequence_odd(int N)
+  {
+    const int n = (int)sqrtf((float)(N / 2) + 0.5f);
+    mark_occupied_strata(N, 2 * N);
+
+    flip_x.resize(N / 2);
+
+    for (int s = 0; s < N / 2; s++) {
+      int xsub, ysub;
+      sub_square(s, n, &xsub, &ysub);
+      flip_x[s] = (rnd_uint() & 1) != 0;
+      if (flip_x[s]) {
+        generate_sample_point(N + s, xsub ^ 1, ysub, n);
+      }
+      else {
+        generate_sample_point(N + s, xsub, ysub ^ 1, n);
+      }
+    }
+
+    for (int s = 0; s < N / 2; s++) {
+      int xsub, ysub;
+      sub_square(s, n, &xsub, &ysub);
+      if (flip_x[s]) {
+        generate_sample_point(N + N / 2 + s, xsub, ysub ^ 1, n);
+      }
+      else {
+        generate_sample_point(N + N / 2 + s, xsub ^ 1, ysub, n);
+      }
+    }
+  }
+
+  /* Scratch storage. */
+  vector<int> xfree, yfree;
+  vector<bool> flip_x;
+};
+
+void progressive_multi_jitter_02_generate_2D(uint points[], int size, uint seed)
+{
+  PMJ02Generator generator(seed);
+  generator.generate(points, size);
+}
+
+/* "The void-and-cluster method for dither array generation"
+ * Robert Ulichney, 1993.
+ *
+ * Pixels are ranked by repeatedly adding a pixel to the largest void of the
+ * pattern (or removing one from its tightest cluster), where voids and
+ * clusters are found from a Gaussian filtered energy on the torus. */
+
+class VoidAndClusterGenerator {
+ public:
+  VoidAndClusterGenerator(int size_, uint seed)
+      : size(size_), num_pixels(size_ * size_), rng_state(seed)
+  {
+    /* Gaussian kernel over toroidal offsets, sigma 1.5 as in the paper. */
+    const float sigma = 1.5f;
+    filter.resize(num_pixels);
+    for (int y = 0; y < size; y++) {
+      for (int x = 0; x < size; x++) {
+        const int dx = min(x, size - x);
+        const int dy = min(y, size - y);
+        filter[y * size + x] = expf(-(dx * dx + dy * dy) / (2.0f * sigma * sigma));
+      }
+    }
+  }
+
+  void generate(float mask[])
+  {
+    vector<int> rank(num_pixels, 0);
+
+    /* Initial pattern of randomly placed pixels, relaxed until the tightest
+     * cluster and largest void coincide. */
+    const int num_initial = max(num_pixels / 10, 1);
+    pattern.assign(num_pixels, 0);
+    energy.assign(num_pixels, 0.0f);
+    for (int placed = 0; placed < num_initial;) {
+      const int i = (int)(((uint64_t)rnd_uint() * (uint64_t)num_pixels) >> 32);
+      if (!pattern[i]) {
+        toggle(i);
+        placed++;
+      }
+    }
+
+    for (int iteration = 0; iteration < num_pixels; iteration++) {
+      const int cluster = find_extreme(1, true);
+      toggle(cluster);
+      const int void_index = find_extreme(0, false);
+      toggle(void_index);
+      if (void_index == cluster) {
+        break;
+      }
+    }
+
+    const vector<uchar> initial_pattern = pattern;
+    const vector<float> initial_energy = energy;
+
+    /* Rank the initial pixels by removing tightest clusters. */
+    for (int ones = num_initial; ones > 0; ones--) {
+      const int cluster = find_extreme(1, true);
+      toggle(cluster);
+      rank[cluster] = ones - 1;
+    }
+
+    /* Rank the remaining pixels by filling largest voids. */
+    pattern = initial_pattern;
+    energy = initial_energy;
+    for (int ones = num_initial; ones < num_pixels; ones++) {
+      const int void_index = find_extreme(0, false);
+      toggle(void_index);
+      rank[void_index] = ones;
+    }
+
+    for (int i = 0; i < num_pixels; i++) {
+      mask[i] = (rank[i] + 0.5f) / num_pixels;
+    }
+  }
+
+ protected:
+  int size;
+  int num_pixels;
+  uint rng_state;
+
+  vector<float> filter;
+  vector<uchar> pattern;
+  vector<float> energy;
+
+  uint rnd_uint()
+  {
+    rng_state = rng_state * 747796405u + 2891336453u;
+    const uint word = ((rng_state >> ((rng_state >> 28u) + 4u)) ^ rng_state) * 277803737u;
+    return (word >> 22u) ^ word;
+  }
+
+  /* Flip a pixel and update the filtered energy of all pixels. */
+  void toggle(int i)
+  {
+    const float sign = pattern[i] ? -1.0f : 1.0f;
+    pattern[i] = !pattern[i];
+
+    const int x = i % size;
+    const int y = i / size;
+    for (int py = 0; py < size; py++) {
+      const int fy = (py - y + size) % size;
+      for (int px = 0; px < size; px++) {
+        const int fx = (px - x + size) % size;
+        energy[py * size + px] += sign * filter[fy * size + fx];
+      }
+    }
+  }
+
+  /* Pixel with the highest (tightest cluster) or lowest (largest void)
+   * energy among pixels with the given value. */
+  int find_extreme(uchar value, bool highest) const
+  {
+    int best = -1;
+    for (int i = 0; i < num_pixels; i++) {
+      if (pattern[i] != value) {
+        continue;
+      }
+      if (best == -1 || (highest ? energy[i] > energy[best] : energy[i] < energy[best])) {
+        best = i;
+      }
+    }
+    return best;
+  }
+};
+
+void blue_noise_mask_generate(float mask[], int size, uint seed)
+{
+  VoidAndClusterGenerator generator(size, seed);
+  generator.generate(mask);
+}
+
+CCL_NAMESPACE_END
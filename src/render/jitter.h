@@ -0,0 +1,35 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __JITTER_H__
+#define __JITTER_H__
+
+#include "util/util_types.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Generate a progressive multi-jittered (0,2) sequence of size points, which
+ * must be a power of four. Coordinates are stored as 32 bit fixed point in
+ * interleaved x and y order, so size * 2 values are written. */
+void progressive_multi_jitter_02_generate_2D(uint points[], int size, uint seed);
+
+/* Generate a tileable size x size blue noise mask with the void and cluster
+ * method, with every value in [0, 1) used exactly once. */
+void blue_noise_mask_generate(float mask[], int size, uint seed);
+
+CCL_NAMESPACE_END
+
+#endif /* __JITTER_H__ */
@@ -20,6 +20,7 @@
 #include "render/film.h"
 #include "render/graph.h"
 #include "render/light.h"
+#include "render/light_tree.h"
 #include "render/mesh.h"
 #include "render/nodes.h"
 #include "render/object.h"
@@ -182,6 +183,7 @@ LightManager::LightManager()
 {
   need_update = true;
   use_light_visibility = false;
+  use_light_tree = false;
 }
 
 LightManager::~LightManager()
@@ -537,6 +539,200 @@ static void background_cdf(
   }
 }
 
+void LightManager::device_update_tree(Device *,
+                                      DeviceScene *dscene,
+                                      Scene *scene,
+                                      Progress &progress)
+{
+  KernelIntegrator *kintegrator = &dscene->data.integrator;
+
+  kintegrator->use_light_tree = false;
+  kintegrator->light_tree_triangle_root = -1;
+  kintegrator->light_tree_lamp_root = -1;
+  kintegrator->light_tree_infinite_offset = 0;
+  kintegrator->light_tree_num_infinite = 0;
+  kintegrator->light_tree_pdf_triangles = 0.0f;
+  kintegrator->light_tree_pdf_lamps = 0.0f;
+
+  use_light_tree = scene->integrator->use_light_tree;
+
+  if (!use_light_tree || !kintegrator->use_direct_light) {
+    return;
+  }
+
+  progress.set_status("Updating Lights", "Building light tree");
+
+  const int num_distribution = kintegrator->num_distribution;
+  const int num_triangles = num_distribution - kintegrator->num_all_lights;
+  const KernelLightDistribution *distribution = dscene->light_distribution.data();
+
+  /* Lamps in the same order as in the distribution. */
+  vector<Light *> lights;
+  foreach (Light *light, scene->lights) {
+    if (light->is_enabled) {
+      lights.push_back(light);
+    }
+  }
+
+  KernelLightTreeEmitter *emitters = dscene->light_tree_emitters.alloc(num_distribution);
+  uint2 *objects = dscene->light_tree_objects.alloc(max(scene->objects.size(), (size_t)1));
+  for (size_t i = 0; i < dscene->light_tree_objects.size(); i++) {
+    objects[i] = make_uint2(~0u, 0);
+  }
+
+  vector<LightTreePrimitive> triangle_prims;
+  vector<LightTreePrimitive> lamp_prims;
+  vector<uint> infinite_lights;
+  float trianglearea = 0.0f;
+
+  /* Emissive triangles, which emit light from both sides. */
+  for (int i = 0; i < num_triangles; i++) {
+    const int object_id = distribution[i].mesh_light.object_id;
+    Object *object = scene->objects[object_id];
+    Mesh *mesh = object->mesh;
+
+    if (objects[object_id].x == ~0u) {
+      objects[object_id] = make_uint2(i, mesh->tri_offset);
+    }
+
+    LightTreePrimitive prim;
+    prim.bbox = object->bounds;
+    prim.axis = make_float3(0.0f, 0.0f, 1.0f);
+    prim.theta_o = M_PI_F;
+    prim.theta_e = M_PI_2_F;
+    prim.energy = 0.0f;
+    prim.index = i;
+
+    Mesh::Triangle t = mesh->get_triangle(distribution[i].prim - mesh->tri_offset);
+    if (t.valid(&mesh->verts[0])) {
+      float3 p1 = mesh->verts[t.v[0]];
+      float3 p2 = mesh->verts[t.v[1]];
+      float3 p3 = mesh->verts[t.v[2]];
+
+      if (!mesh->transform_applied) {
+        p1 = transform_point(&object->tfm, p1);
+        p2 = transform_point(&object->tfm, p2);
+        p3 = transform_point(&object->tfm, p3);
+      }
+
+      prim.bbox = BoundBox(p1);
+      prim.bbox.grow(p2);
+      prim.bbox.grow(p3);
+      prim.axis = safe_normalize(cross(p2 - p1, p3 - p1));
+      prim.energy = triangle_area(p1, p2, p3);
+    }
+
+    emitters[i].energy = prim.energy;
+    emitters[i].leaf = -1;
+    emitters[i].pad = 0;
+    trianglearea += prim.energy;
+
+    triangle_prims.push_back(prim);
+  }
+
+  if (progress.get_cancel())
+    return;
+
+  /* Lamps, using their radiant intensity as energy. Distant and background
+   * lights have no position and are picked outside of the tree. */
+  for (int i = num_triangles; i < num_distribution; i++) {
+    Light *light = lights[i - num_triangles];
+
+    emitters[i].energy = 0.0f;
+    emitters[i].pdf_scale = 1.0f;
+    emitters[i].leaf = -1;
+    emitters[i].pad = 0;
+
+    if (light->type == LIGHT_DISTANT || light->type == LIGHT_BACKGROUND) {
+      infinite_lights.push_back(i);
+      continue;
+    }
+
+    const float strength = max(average(light->strength), 0.0f);
+
+    LightTreePrimitive prim;
+    prim.index = i;
+
+    if (light->type == LIGHT_AREA) {
+      const float3 axisu = light->axisu * (light->sizeu * light->size);
+      const float3 axisv = light->axisv * (light->sizev * light->size);
+      prim.bbox = BoundBox(light->co - 0.5f * axisu - 0.5f * axisv);
+      prim.bbox.grow(light->co + 0.5f * axisu - 0.5f * axisv);
+      prim.bbox.grow(light->co - 0.5f * axisu + 0.5f * axisv);
+      prim.bbox.grow(light->co + 0.5f * axisu + 0.5f * axisv);
+      prim.axis = safe_normalize(light->dir);
+      prim.theta_o = 0.0f;
+      prim.theta_e = M_PI_2_F;
+      prim.energy = strength * M_1_PI_F;
+    }
+    else {
+      prim.bbox = BoundBox(light->co);
+      prim.bbox.grow(light->co, light->size);
+      prim.energy = strength * 0.25f * M_1_PI_F;
+
+      if (light->type == LIGHT_SPOT) {
+        prim.axis = safe_normalize(light->dir);
+        prim.theta_o = min(0.5f * light->spot_angle, M_PI_F);
+        prim.theta_e = 0.0f;
+      }
+      else {
+        prim.axis = make_float3(0.0f, 0.0f, 1.0f);
+        prim.theta_o = M_PI_F;
+        prim.theta_e = M_PI_2_F;
+      }
+    }
+
+    emitters[i].energy = prim.energy;
+    lamp_prims.push_back(prim);
+  }
+
+  /* Probability of picking an emitter relative to the flat distribution, see
+   * light_tree_sample(). */
+  for (int i = 0; i < num_triangles; i++) {
+    emitters[i].pdf_scale = (emitters[i].energy > 0.0f) ? trianglearea / emitters[i].energy :
+                                                          0.0f;
+  }
+  foreach (const LightTreePrimitive &prim, lamp_prims) {
+    emitters[prim.index].pdf_scale = (float)lamp_prims.size();
+  }
+
+  vector<KernelLightTreeNode> nodes;
+  vector<uint> leaf_emitters;
+  LightTree tree(nodes, leaf_emitters);
+
+  kintegrator->light_tree_triangle_root = tree.build(triangle_prims);
+  kintegrator->light_tree_lamp_root = tree.build(lamp_prims);
+  kintegrator->light_tree_infinite_offset = leaf_emitters.size();
+  kintegrator->light_tree_num_infinite = infinite_lights.size();
+  leaf_emitters.insert(leaf_emitters.end(), infinite_lights.begin(), infinite_lights.end());
+
+  for (size_t i = 0; i < nodes.size(); i++) {
+    const KernelLightTreeNode &knode = nodes[i];
+    for (int j = 0; j < knode.num_emitters; j++) {
+      emitters[leaf_emitters[knode.child_index + j]].leaf = i;
+    }
+  }
+
+  kintegrator->use_light_tree = true;
+  kintegrator->light_tree_pdf_triangles = kintegrator->pdf_triangles * trianglearea;
+  kintegrator->light_tree_pdf_lamps = kintegrator->pdf_lights * lamp_prims.size();
+
+  VLOG(1) << "Light tree built with " << nodes.size() << " nodes.";
+
+  if (!nodes.empty()) {
+    KernelLightTreeNode *knodes = dscene->light_tree_nodes.alloc(nodes.size());
+    memcpy(knodes, &nodes[0], sizeof(KernelLightTreeNode) * nodes.size());
+    dscene->light_tree_nodes.copy_to_device();
+  }
+  if (!leaf_emitters.empty()) {
+    uint *kleaf_emitters = dscene->light_tree_leaf_emitters.alloc(leaf_emitters.size());
+    memcpy(kleaf_emitters, &leaf_emitters[0], sizeof(uint) * leaf_emitters.size());
+    dscene->light_tree_leaf_emitters.copy_to_device();
+  }
+  dscene->light_tree_emitters.copy_to_device();
+  dscene->light_tree_objects.copy_to_device();
+}
+
 void LightManager::device_update_background(Device *device,
                                             DeviceScene *dscene,
                                             Scene *scene,
@@ -892,7 +1088,7 @@ void LightManager::device_update(Device *device,
                                  Scene *scene,
                                  Progress &progress)
 {
-  if (!need_update)
+  if (!need_update && use_light_tree == scene->integrator->use_light_tree)
     return;
 
   VLOG(1) << "Total " << scene->lights.size() << " lights.";
@@ -911,6 +1107,10 @@ void LightManager::device_update(Device *device,
   if (progress.get_cancel())
     return;
 
+  device_update_tree(device, dscene, scene, progress);
+  if (progress.get_cancel())
+    return;
+
   device_update_background(device, dscene, scene, progress);
   if (progress.get_cancel())
     return;
@@ -933,6 +1133,10 @@ void LightManager::device_free(Device *, DeviceScene *dscene)
   dscene->lights.free();
   dscene->light_background_marginal_cdf.free();
   dscene->light_background_conditional_cdf.free();
+  dscene->light_tree_nodes.free();
+  dscene->light_tree_emitters.free();
+  dscene->light_tree_leaf_emitters.free();
+  dscene->light_tree_objects.free();
   dscene->ies_lights.free();
 }
 
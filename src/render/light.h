@@ -86,6 +86,8 @@ class Light : public Node {
 class LightManager {
  public:
   bool use_light_visibility;
+  /* Whether the light tree was built in the last update. */
+  bool use_light_tree;
   bool need_update;
 
   LightManager();
@@ -116,6 +118,10 @@ class LightManager {
                                   DeviceScene *dscene,
                                   Scene *scene,
                                   Progress &progress);
+  void device_update_tree(Device *device,
+                          DeviceScene *dscene,
+                          Scene *scene,
+                          Progress &progress);
   void device_update_background(Device *device,
                                 DeviceScene *dscene,
                                 Scene *scene,
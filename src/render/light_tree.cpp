@@ -0,0 +1,285 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include "render/light_tree.h"
+
+#include "util/util_math.h"
+
+CCL_NAMESPACE_BEGIN
+
+#define LIGHT_TREE_NUM_BINS 12
+#define LIGHT_TREE_MAX_LEAF_SIZE 4
+
+namespace {
+
+struct LightTreeCone {
+  float3 axis;
+  float theta_o;
+  float theta_e;
+  bool empty;
+
+  LightTreeCone() : axis(make_float3(0.0f, 0.0f, 1.0f)), theta_o(0.0f), theta_e(0.0f), empty(true)
+  {
+  }
+
+  explicit LightTreeCone(const LightTreePrimitive &prim)
+      : axis(prim.axis), theta_o(prim.theta_o), theta_e(prim.theta_e), empty(false)
+  {
+  }
+
+  /* Smallest cone containing both cones. */
+  void grow(const LightTreeCone &other)
+  {
+    if (other.empty) {
+      return;
+    }
+    if (empty) {
+      *this = other;
+      return;
+    }
+
+    LightTreeCone a = *this, b = other;
+    if (b.theta_o > a.theta_o) {
+      std::swap(a, b);
+    }
+
+    const float theta_d = safe_acosf(dot(a.axis, b.axis));
+    const float new_theta_e = max(a.theta_e, b.theta_e);
+
+    if (min(theta_d + b.theta_o, M_PI_F) <= a.theta_o) {
+      /* Cone a already contains b. */
+      *this = a;
+      theta_e = new_theta_e;
+      return;
+    }
+
+    const float new_theta_o = 0.5f * (a.theta_o + theta_d + b.theta_o);
+    if (new_theta_o >= M_PI_F) {
+      axis = a.axis;
+      theta_o = M_PI_F;
+      theta_e = new_theta_e;
+      return;
+    }
+
+    /* Rotate the axis of a towards b. */
+    const float theta_r = new_theta_o - a.theta_o;
+    float3 ortho = b.axis - dot(a.axis, b.axis) * a.axis;
+    if (len_squared(ortho) < 1e-12f) {
+      float3 dummy;
+      make_orthonormals(a.axis, &ortho, &dummy);
+    }
+    axis = normalize(cosf(theta_r) * a.axis + sinf(theta_r) * normalize(ortho));
+    theta_o = new_theta_o;
+    theta_e = new_theta_e;
+  }
+
+  /* Measure of the solid angle of the emission directions. */
+  float measure() const
+  {
+    const float theta_w = min(theta_o + theta_e, M_PI_F);
+    const float cos_o = cosf(theta_o);
+    const float sin_o = sinf(theta_o);
+    return M_2PI_F * (1.0f - cos_o) +
+           M_PI_2_F * (2.0f * theta_w * sin_o - cosf(theta_o - 2.0f * theta_w) -
+                       2.0f * theta_o * sin_o + cos_o);
+  }
+};
+
+struct LightTreeBounds {
+  BoundBox bbox;
+  LightTreeCone cone;
+  float energy;
+  int num_prims;
+
+  LightTreeBounds() : bbox(BoundBox::empty), energy(0.0f), num_prims(0)
+  {
+  }
+
+  void grow(const LightTreePrimitive &prim)
+  {
+    bbox.grow(prim.bbox);
+    cone.grow(LightTreeCone(prim));
+    energy += prim.energy;
+    num_prims++;
+  }
+
+  void grow(const LightTreeBounds &other)
+  {
+    bbox.grow(other.bbox);
+    cone.grow(other.cone);
+    energy += other.energy;
+    num_prims += other.num_prims;
+  }
+
+  float cost() const
+  {
+    if (num_prims == 0) {
+      return 0.0f;
+    }
+    return energy * bbox.safe_area() * cone.measure();
+  }
+};
+
+struct LightTreeBuildTask {
+  int start, end;
+  int parent;
+  bool is_right;
+};
+
+}  // namespace
+
+LightTree::LightTree(vector<KernelLightTreeNode> &nodes, vector<uint> &leaf_emitters)
+    : nodes(nodes), leaf_emitters(leaf_emitters)
+{
+}
+
+int LightTree::build(vector<LightTreePrimitive> &prims)
+{
+  if (prims.empty()) {
+    return -1;
+  }
+
+  const int root = nodes.size();
+
+  /* Build depth first, so that the first child of a node always directly
+   * follows it. */
+  vector<LightTreeBuildTask> stack;
+  LightTreeBuildTask root_task = {0, (int)prims.size(), -1, false};
+  stack.push_back(root_task);
+
+  while (!stack.empty()) {
+    const LightTreeBuildTask task = stack.back();
+    stack.pop_back();
+
+    LightTreeBounds bounds;
+    BoundBox centroid_bbox = BoundBox::empty;
+    for (int i = task.start; i < task.end; i++) {
+      bounds.grow(prims[i]);
+      centroid_bbox.grow(prims[i].bbox.center());
+    }
+
+    const int index = nodes.size();
+    nodes.push_back(KernelLightTreeNode());
+    KernelLightTreeNode &knode = nodes[index];
+    knode.bbox_min[0] = bounds.bbox.min.x;
+    knode.bbox_min[1] = bounds.bbox.min.y;
+    knode.bbox_min[2] = bounds.bbox.min.z;
+    knode.bbox_max[0] = bounds.bbox.max.x;
+    knode.bbox_max[1] = bounds.bbox.max.y;
+    knode.bbox_max[2] = bounds.bbox.max.z;
+    knode.energy = bounds.energy;
+    knode.axis[0] = bounds.cone.axis.x;
+    knode.axis[1] = bounds.cone.axis.y;
+    knode.axis[2] = bounds.cone.axis.z;
+    knode.theta_o = bounds.cone.theta_o;
+    knode.theta_e = bounds.cone.theta_e;
+    knode.parent = task.parent;
+    knode.pad = 0;
+
+    if (task.is_right) {
+      nodes[task.parent].child_index = index;
+    }
+
+    const int num_prims = task.end - task.start;
+    if (num_prims <= LIGHT_TREE_MAX_LEAF_SIZE) {
+      knode.child_index = leaf_emitters.size();
+      knode.num_emitters = num_prims;
+      for (int i = task.start; i < task.end; i++) {
+        leaf_emitters.push_back(prims[i].index);
+      }
+      continue;
+    }
+
+    /* Find the split with the lowest cost over bins of all axes. */
+    const float3 bbox_size = bounds.bbox.size();
+    const float max_size = max3(bbox_size);
+    const float3 centroid_size = centroid_bbox.size();
+
+    float best_cost = FLT_MAX;
+    int best_dim = -1, best_bin = 0;
+
+    for (int dim = 0; dim < 3; dim++) {
+      if (!(centroid_size[dim] > 0.0f)) {
+        continue;
+      }
+
+      LightTreeBounds bins[LIGHT_TREE_NUM_BINS];
+      const float scale = LIGHT_TREE_NUM_BINS / centroid_size[dim];
+      for (int i = task.start; i < task.end; i++) {
+        const float centroid = prims[i].bbox.center()[dim];
+        const int bin = clamp(
+            (int)((centroid - centroid_bbox.min[dim]) * scale), 0, LIGHT_TREE_NUM_BINS - 1);
+        bins[bin].grow(prims[i]);
+      }
+
+      LightTreeBounds right_bounds[LIGHT_TREE_NUM_BINS];
+      right_bounds[LIGHT_TREE_NUM_BINS - 1] = bins[LIGHT_TREE_NUM_BINS - 1];
+      for (int bin = LIGHT_TREE_NUM_BINS - 2; bin > 0; bin--) {
+        right_bounds[bin] = right_bounds[bin + 1];
+        right_bounds[bin].grow(bins[bin]);
+      }
+
+      /* Penalize splitting thin boxes along their short sides. */
+      const float regularization = max_size / bbox_size[dim];
+
+      LightTreeBounds left_bounds;
+      for (int bin = 1; bin < LIGHT_TREE_NUM_BINS; bin++) {
+        left_bounds.grow(bins[bin - 1]);
+        if (left_bounds.num_prims == 0 || right_bounds[bin].num_prims == 0) {
+          continue;
+        }
+
+        const float cost = regularization * (left_bounds.cost() + right_bounds[bin].cost());
+        if (cost < best_cost) {
+          best_cost = cost;
+          best_dim = dim;
+          best_bin = bin;
+        }
+      }
+    }
+
+    int middle;
+    if (best_dim != -1) {
+      const float scale = LIGHT_TREE_NUM_BINS / centroid_size[best_dim];
+      const float centroid_min = centroid_bbox.min[best_dim];
+      LightTreePrimitive *split = std::partition(
+          &prims[task.start], &prims[0] + task.end, [=](const LightTreePrimitive &prim) {
+            const float centroid = prim.bbox.center()[best_dim];
+            return clamp((int)((centroid - centroid_min) * scale), 0, LIGHT_TREE_NUM_BINS - 1) <
+                   best_bin;
+          });
+      middle = split - &prims[0];
+    }
+    else {
+      /* All centroids coincide, split in the middle. */
+      middle = (task.start + task.end) / 2;
+    }
+
+    knode.child_index = -1;
+    knode.num_emitters = 0;
+
+    LightTreeBuildTask right_task = {middle, task.end, index, true};
+    LightTreeBuildTask left_task = {task.start, middle, index, false};
+    stack.push_back(right_task);
+    stack.push_back(left_task);
+  }
+
+  return root;
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LIGHT_TREE_H__
+#define __LIGHT_TREE_H__
+
+#include "kernel/kernel_types.h"
+
+#include "util/util_boundbox.h"
+#include "util/util_types.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Light Tree Builder
+ *
+ * Builds the light tree used for sampling lights in the kernel, see
+ * kernel_light_tree.h. Nodes are split with the surface area orientation
+ * heuristic, binning primitives by their centroid. */
+
+struct LightTreePrimitive {
+  BoundBox bbox;
+  /* Bounds of the emission directions, normals are within theta_o of the
+   * axis and light is emitted within theta_e of the normals. */
+  float3 axis;
+  float theta_o;
+  float theta_e;
+  float energy;
+  /* Index into the light distribution. */
+  int index;
+};
+
+class LightTree {
+ public:
+  LightTree(vector<KernelLightTreeNode> &nodes, vector<uint> &leaf_emitters);
+
+  /* Build tree over the primitives and append it to the nodes, returns the
+   * index of the root node or -1 if there are no primitives. The order of
+   * the primitives is changed. */
+  int build(vector<LightTreePrimitive> &prims);
+
+ protected:
+  vector<KernelLightTreeNode> &nodes;
+  vector<uint> &leaf_emitters;
+};
+
+CCL_NAMESPACE_END
+
+#endif /* __LIGHT_TREE_H__ */
@@ -16,6 +16,7 @@
 
 #include "bvh/bvh.h"
 #include "bvh/bvh_build.h"
+#include "bvh/bvh_cache.h"
 
 #include "render/camera.h"
 #include "render/curves.h"
@@ -444,6 +445,9 @@ Mesh::Mesh() : Node(node_type)
   geometry_flags = GEOMETRY_NONE;
 
   volume_isovalue = 0.001f;
+  volume_majorant_resolution = make_int3(0, 0, 0);
+  volume_majorant_tfm = transform_identity();
+  volume_majorant_offset = -1;
   has_volume = false;
   has_surface_bssrdf = false;
 
@@ -565,6 +569,8 @@ void Mesh::clear(bool preserve_voxel_data)
 
   if (!preserve_voxel_data) {
     geometry_flags = GEOMETRY_NONE;
+    volume_majorant.clear();
+    volume_majorant_resolution = make_int3(0, 0, 0);
   }
 
   transform_applied = false;
@@ -1088,8 +1094,6 @@ void Mesh::compute_bvh(
       bvh->refit(*progress);
     }
     else {
-      progress->set_status(msg, "Building BVH");
-
       BVHParams bparams;
       bparams.use_spatial_split = params->use_bvh_spatial_split;
       bparams.bvh_layout = bvh_layout;
@@ -1103,7 +1107,24 @@ void Mesh::compute_bvh(
 
       delete bvh;
       bvh = BVH::create(bparams, meshes, objects);
-      MEM_GUARDED_CALL(progress, bvh->build, *progress);
+
+      string cache_filepath;
+      if (!params->bvh_cache_path.empty() && bvh_cache_supported(bparams)) {
+        cache_filepath = bvh_cache_filepath(params->bvh_cache_path, bparams, this);
+      }
+
+      if (!cache_filepath.empty() && bvh_cache_read(cache_filepath, bparams, this, bvh->pack)) {
+        progress->set_status(msg, "Loading BVH from cache");
+        VLOG(1) << "Loaded BVH from cache file " << cache_filepath;
+      }
+      else {
+        progress->set_status(msg, "Building BVH");
+        MEM_GUARDED_CALL(progress, bvh->build, *progress);
+
+        if (!cache_filepath.empty() && !progress->get_cancel()) {
+          bvh_cache_write(cache_filepath, bparams, bvh->pack);
+        }
+      }
     }
   }
 
@@ -1204,6 +1225,7 @@ MeshManager::MeshManager()
 {
   need_update = true;
   need_flags_update = true;
+  bvh_pack_time = 0.0;
 }
 
 MeshManager::~MeshManager()
@@ -2001,6 +2023,7 @@ void MeshManager::device_update_bvh(Device *device,
 
   BVH *bvh = BVH::create(bparams, scene->meshes, scene->objects);
   bvh->build(progress, &device->stats);
+  bvh_pack_time = bvh->pack_time;
 
   if (progress.get_cancel()) {
 #ifdef WITH_EMBREE
@@ -2177,6 +2200,16 @@ void MeshManager::device_update_volume_images(Device *device, Scene *scene, Prog
   pool.wait_work();
 }
 
+void MeshManager::tessellate_mesh(Mesh *mesh, Progress *progress)
+{
+  if (progress->get_cancel()) {
+    return;
+  }
+
+  DiagSplit dsplit(*mesh->subd_params);
+  mesh->tessellate(&dsplit);
+}
+
 void MeshManager::device_update(Device *device,
                                 DeviceScene *dscene,
                                 Scene *scene,
@@ -2226,29 +2259,22 @@ void MeshManager::device_update(Device *device,
     Camera *dicing_camera = scene->dicing_camera;
     dicing_camera->update(scene);
 
-    size_t i = 0;
+    progress.set_status("Updating Mesh",
+                        string_printf("Tessellating %u meshes", (uint)total_tess_needed));
+
+    /* Meshes are independent, tessellate them in parallel. */
+    TaskPool pool;
     foreach (Mesh *mesh, scene->meshes) {
       if (mesh->need_update && mesh->subdivision_type != Mesh::SUBDIVISION_NONE &&
           mesh->num_subd_verts == 0 && mesh->subd_params) {
-        string msg = "Tessellating ";
-        if (mesh->name == "")
-          msg += string_printf("%u/%u", (uint)(i + 1), (uint)total_tess_needed);
-        else
-          msg += string_printf(
-              "%s %u/%u", mesh->name.c_str(), (uint)(i + 1), (uint)total_tess_needed);
-
-        progress.set_status("Updating Mesh", msg);
-
         mesh->subd_params->camera = dicing_camera;
-        DiagSplit dsplit(*mesh->subd_params);
-        mesh->tessellate(&dsplit);
-
-        i++;
-
-        if (progress.get_cancel())
-          return;
+        pool.push(function_bind(&MeshManager::tessellate_mesh, this, mesh, &progress));
       }
     }
+    pool.wait_work();
+
+    if (progress.get_cancel())
+      return;
   }
 
   /* Update images needed for true displacement. */
@@ -2270,6 +2296,7 @@ void MeshManager::device_update(Device *device,
   if (progress.get_cancel())
     return;
 
+  device_update_volume_majorants(device, dscene, scene, progress);
   device_update_attributes(device, dscene, scene, progress);
   if (progress.get_cancel())
     return;
@@ -2280,25 +2307,29 @@ void MeshManager::device_update(Device *device,
   BVHLayout bvh_layout = BVHParams::best_bvh_layout(scene->params.bvh_layout,
                                                     device->get_bvh_layout_mask());
 
+  vector<Mesh *> update_meshes;
   foreach (Mesh *mesh, scene->meshes) {
     if (mesh->need_update) {
-      if (displace(device, dscene, scene, mesh, progress)) {
-        displacement_done = true;
-      }
+      update_meshes.push_back(mesh);
 
       if (mesh->need_build_bvh(bvh_layout)) {
         num_bvh++;
       }
     }
+  }
 
-    if (progress.get_cancel())
-      return;
+  if (displace(device, dscene, scene, update_meshes, progress)) {
+    displacement_done = true;
   }
 
+  if (progress.get_cancel())
+    return;
+
   /* Device re-update after displacement. */
   if (displacement_done) {
     device_free(device, dscene);
 
+    device_update_volume_majorants(device, dscene, scene, progress);
     device_update_attributes(device, dscene, scene, progress);
     if (progress.get_cancel())
       return;
@@ -2383,6 +2414,8 @@ void MeshManager::device_free(Device *device, DeviceScene *dscene)
   dscene->attributes_float2.free();
   dscene->attributes_float3.free();
   dscene->attributes_uchar4.free();
+  dscene->volume_majorant_grids.free();
+  dscene->volume_majorant.free();
 
   /* Signal for shaders like displacement not to do ray tracing. */
   dscene->data.bvh.bvh_layout = BVH_LAYOUT_NONE;
@@ -2408,9 +2441,16 @@ void MeshManager::tag_update(Scene *scene)
 
 void MeshManager::collect_statistics(const Scene *scene, RenderStats *stats)
 {
+  stats->mesh.bvh_pack_time = bvh_pack_time;
+
   foreach (Mesh *mesh, scene->meshes) {
     stats->mesh.geometry.add_entry(
         NamedSizeEntry(string(mesh->name.c_str()), mesh->get_total_size_in_bytes()));
+
+    if (mesh->bvh) {
+      stats->mesh.bvh_pack_time += mesh->bvh->pack_time;
+      stats->mesh.bvh_refit_time += mesh->bvh->refit_time;
+    }
   }
 }
 
@@ -230,6 +230,12 @@ class Mesh : public Node {
   array<float2> vert_patch_uv;
 
   float volume_isovalue;
+  /* Largest density in coarse cells of the voxel data, -1 for empty cells, with
+   * the transform from object space to cell coordinates. Computed with the
+   * volume mesh. */
+  array<float> volume_majorant;
+  int3 volume_majorant_resolution;
+  Transform volume_majorant_tfm;
   bool has_volume;         /* Set in the device_update_flags(). */
   bool has_surface_bssrdf; /* Set in the device_update_flags(). */
 
@@ -279,11 +285,19 @@ class Mesh : public Node {
   size_t corner_offset;
 
   size_t attr_map_offset;
+  int volume_majorant_offset;
 
   size_t prim_offset;
 
   size_t num_subd_verts;
 
+  /* Stitching index of a vertex on the side of a diced patch, or -1. */
+  int get_vert_stitching_key(int vert) const
+  {
+    unordered_map<int, int>::const_iterator it = vert_to_stitching_key_map.find(vert);
+    return (it != vert_to_stitching_key_map.end()) ? it->second : -1;
+  }
+
  private:
   unordered_map<int, int> vert_to_stitching_key_map; /* real vert index -> stitching index */
   unordered_multimap<int, int>
@@ -373,10 +387,17 @@ class MeshManager {
   bool need_update;
   bool need_flags_update;
 
+  /* Seconds spent packing the top level BVH in the last update. */
+  double bvh_pack_time;
+
   MeshManager();
   ~MeshManager();
 
-  bool displace(Device *device, DeviceScene *dscene, Scene *scene, Mesh *mesh, Progress &progress);
+  bool displace(Device *device,
+                DeviceScene *dscene,
+                Scene *scene,
+                const vector<Mesh *> &meshes,
+                Progress &progress);
 
   /* attributes */
   void update_osl_attributes(Device *device,
@@ -417,9 +438,17 @@ class MeshManager {
 
   void device_update_bvh(Device *device, DeviceScene *dscene, Scene *scene, Progress &progress);
 
+  void displace_apply(Scene *scene, Mesh *mesh, const float4 *offset);
+
   void device_update_displacement_images(Device *device, Scene *scene, Progress &progress);
 
   void device_update_volume_images(Device *device, Scene *scene, Progress &progress);
+  void device_update_volume_majorants(Device *device,
+                                      DeviceScene *dscene,
+                                      Scene *scene,
+                                      Progress &progress);
+
+  void tessellate_mesh(Mesh *mesh, Progress *progress);
 };
 
 CCL_NAMESPACE_END
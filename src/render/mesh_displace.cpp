@@ -25,6 +25,7 @@
 #include "util/util_map.h"
 #include "util/util_progress.h"
 #include "util/util_set.h"
+#include "util/util_task.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -43,33 +44,12 @@ static float3 compute_face_normal(const Mesh::Triangle &t, float3 *verts)
   return norm / normlen;
 }
 
-bool MeshManager::displace(
-    Device *device, DeviceScene *dscene, Scene *scene, Mesh *mesh, Progress &progress)
+/* Gather the points to evaluate for true displacement of the mesh. */
+static void displace_gather(Scene *scene, Mesh *mesh, int object_index, vector<uint4> *input)
 {
-  /* verify if we have a displacement shader */
-  if (!mesh->has_true_displacement()) {
-    return false;
-  }
-
-  string msg = string_printf("Computing Displacement %s", mesh->name.c_str());
-  progress.set_status("Updating Mesh", msg);
-
-  /* find object index. todo: is arbitrary */
-  size_t object_index = OBJECT_NONE;
-
-  for (size_t i = 0; i < scene->objects.size(); i++) {
-    if (scene->objects[i]->mesh == mesh) {
-      object_index = i;
-      break;
-    }
-  }
-
-  /* setup input for device task */
   const size_t num_verts = mesh->verts.size();
   vector<bool> done(num_verts, false);
-  device_vector<uint4> d_input(device, "displace_input", MEM_READ_ONLY);
-  uint4 *d_input_data = d_input.alloc(num_verts);
-  size_t d_input_size = 0;
+  input->clear();
 
   size_t num_triangles = mesh->num_triangles();
   for (size_t i = 0; i < num_triangles; i++) {
@@ -111,50 +91,22 @@ bool MeshManager::displace(
 
       /* back */
       uint4 in = make_uint4(object, prim, __float_as_int(u), __float_as_int(v));
-      d_input_data[d_input_size++] = in;
+      input->push_back(in);
     }
   }
+}
 
-  if (d_input_size == 0)
-    return false;
-
-  /* run device task */
-  device_vector<float4> d_output(device, "displace_output", MEM_READ_WRITE);
-  d_output.alloc(d_input_size);
-  d_output.zero_to_device();
-  d_input.copy_to_device();
-
-  /* needs to be up to data for attribute access */
-  device->const_copy_to("__data", &dscene->data, sizeof(dscene->data));
-
-  DeviceTask task(DeviceTask::SHADER);
-  task.shader_input = d_input.device_pointer;
-  task.shader_output = d_output.device_pointer;
-  task.shader_eval_type = SHADER_EVAL_DISPLACE;
-  task.shader_x = 0;
-  task.shader_w = d_output.size();
-  task.num_samples = 1;
-  task.get_cancel = function_bind(&Progress::get_cancel, &progress);
-
-  device->task_add(task);
-  device->task_wait();
-
-  if (progress.get_cancel()) {
-    d_input.free();
-    d_output.free();
-    return false;
-  }
-
-  d_output.copy_from_device(0, 1, d_output.size());
-  d_input.free();
+/* Apply the evaluated displacement offsets to the mesh, and recompute its
+ * normals. */
+void MeshManager::displace_apply(Scene *scene, Mesh *mesh, const float4 *offset)
+{
+  const size_t num_verts = mesh->verts.size();
+  const size_t num_triangles = mesh->num_triangles();
 
   /* read result */
-  done.clear();
-  done.resize(num_verts, false);
+  vector<bool> done(num_verts, false);
   int k = 0;
 
-  float4 *offset = d_output.data();
-
   Attribute *attr_mP = mesh->attributes.find(ATTR_STD_MOTION_VERTEX_POSITION);
   for (size_t i = 0; i < num_triangles; i++) {
     Mesh::Triangle t = mesh->get_triangle(i);
@@ -184,8 +136,6 @@ bool MeshManager::displace(
     }
   }
 
-  d_output.free();
-
   /* stitch */
   unordered_set<int> stitch_keys;
   for (pair<int, int> i : mesh->vert_to_stitching_key_map) {
@@ -390,6 +340,116 @@ bool MeshManager::displace(
       }
     }
   }
+}
+
+bool MeshManager::displace(Device *device,
+                           DeviceScene *dscene,
+                           Scene *scene,
+                           const vector<Mesh *> &meshes,
+                           Progress &progress)
+{
+  /* All meshes are evaluated in a single shader task, so that small meshes
+   * don't leave threads idle waiting for each task to finish. */
+  vector<Mesh *> displace_meshes;
+  foreach (Mesh *mesh, meshes) {
+    /* verify if we have a displacement shader */
+    if (mesh->has_true_displacement()) {
+      displace_meshes.push_back(mesh);
+    }
+  }
+
+  if (displace_meshes.empty()) {
+    return false;
+  }
+
+  string msg = string_printf("Computing Displacement (%d meshes)", (int)displace_meshes.size());
+  progress.set_status("Updating Mesh", msg);
+
+  /* find object index. todo: is arbitrary */
+  map<Mesh *, int> object_index;
+  for (size_t i = 0; i < scene->objects.size(); i++) {
+    object_index.insert(std::make_pair(scene->objects[i]->mesh, (int)i));
+  }
+
+  /* setup input for device task */
+  const size_t num_meshes = displace_meshes.size();
+  vector<vector<uint4>> inputs(num_meshes);
+  {
+    TaskPool pool;
+    for (size_t i = 0; i < num_meshes; i++) {
+      Mesh *mesh = displace_meshes[i];
+      map<Mesh *, int>::iterator it = object_index.find(mesh);
+      pool.push(function_bind(&displace_gather,
+                              scene,
+                              mesh,
+                              (it != object_index.end()) ? it->second : OBJECT_NONE,
+                              &inputs[i]));
+    }
+    pool.wait_work();
+  }
+
+  vector<size_t> input_offset(num_meshes + 1, 0);
+  for (size_t i = 0; i < num_meshes; i++) {
+    input_offset[i + 1] = input_offset[i] + inputs[i].size();
+  }
+
+  const size_t d_input_size = input_offset[num_meshes];
+  if (d_input_size == 0)
+    return false;
+
+  device_vector<uint4> d_input(device, "displace_input", MEM_READ_ONLY);
+  uint4 *d_input_data = d_input.alloc(d_input_size);
+  for (size_t i = 0; i < num_meshes; i++) {
+    if (inputs[i].size()) {
+      memcpy(d_input_data + input_offset[i], &inputs[i][0], sizeof(uint4) * inputs[i].size());
+    }
+    vector<uint4>().swap(inputs[i]);
+  }
+
+  /* run device task */
+  device_vector<float4> d_output(device, "displace_output", MEM_READ_WRITE);
+  d_output.alloc(d_input_size);
+  d_output.zero_to_device();
+  d_input.copy_to_device();
+
+  /* needs to be up to data for attribute access */
+  device->const_copy_to("__data", &dscene->data, sizeof(dscene->data));
+
+  DeviceTask task(DeviceTask::SHADER);
+  task.shader_input = d_input.device_pointer;
+  task.shader_output = d_output.device_pointer;
+  task.shader_eval_type = SHADER_EVAL_DISPLACE;
+  task.shader_x = 0;
+  task.shader_w = d_output.size();
+  task.num_samples = 1;
+  task.get_cancel = function_bind(&Progress::get_cancel, &progress);
+
+  device->task_add(task);
+  device->task_wait();
+
+  if (progress.get_cancel()) {
+    d_input.free();
+    d_output.free();
+    return false;
+  }
+
+  d_output.copy_from_device(0, 1, d_output.size());
+  d_input.free();
+
+  /* Scatter the results back into the meshes. */
+  {
+    TaskPool pool;
+    for (size_t i = 0; i < num_meshes; i++) {
+      pool.push(function_bind(&MeshManager::displace_apply,
+                              this,
+                              scene,
+                              displace_meshes[i],
+                              d_output.data() + input_offset[i]));
+    }
+    pool.wait_work();
+  }
+
+  d_output.free();
 
   return true;
 }
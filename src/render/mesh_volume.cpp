@@ -360,8 +360,115 @@ void VolumeMeshBuilder::convert_quads_to_tris(const vector<QuadData> &quads,
 struct VoxelAttributeGrid {
   float *data;
   int channels;
+  AttributeStandard std;
 };
 
+/* Compute the largest density attribute value in every CUBE_SIZE cell,
+ * dilated by the interpolation padding so that interpolated lookups never
+ * exceed it. Without a density grid the shader finds no density attribute and
+ * uses 1. Cells outside the volume mesh are set to -1, the shader is not
+ * evaluated there. A border of one cell covers the padding of the volume mesh
+ * outside the voxel grid. */
+static void compute_volume_majorant(Mesh *mesh,
+                                    const vector<VoxelAttributeGrid> &voxel_grids,
+                                    const VolumeParams &volume_params,
+                                    const Transform *generated_tfm)
+{
+  bool has_density = false;
+  foreach (const VoxelAttributeGrid &voxel_grid, voxel_grids) {
+    has_density |= (voxel_grid.std == ATTR_STD_VOLUME_DENSITY);
+  }
+
+  const int3 resolution = volume_params.resolution;
+  const int pad = volume_params.pad_size;
+  const int3 cells = make_int3(divide_up(resolution.x, CUBE_SIZE) + 2,
+                               divide_up(resolution.y, CUBE_SIZE) + 2,
+                               divide_up(resolution.z, CUBE_SIZE) + 2);
+
+  array<float> &majorant = mesh->volume_majorant;
+  majorant.resize((size_t)cells.x * cells.y * cells.z);
+  for (size_t i = 0; i < majorant.size(); i++) {
+    majorant[i] = -1.0f;
+  }
+
+  for (int z = 0; z < resolution.z; ++z) {
+    for (int y = 0; y < resolution.y; ++y) {
+      for (int x = 0; x < resolution.x; ++x) {
+        const size_t voxel_index = compute_voxel_index(resolution, x, y, z);
+        float density = (has_density) ? 0.0f : 1.0f;
+        bool active = false;
+
+        foreach (const VoxelAttributeGrid &voxel_grid, voxel_grids) {
+          const int channels = voxel_grid.channels;
+          for (int c = 0; c < channels; c++) {
+            const float value = voxel_grid.data[voxel_index * channels + c];
+            active |= (value != 0.0f);
+
+            if (voxel_grid.std == ATTR_STD_VOLUME_DENSITY) {
+              density = max(density, value);
+            }
+          }
+        }
+
+        if (!active) {
+          continue;
+        }
+
+        /* Cell coordinates are offset by the border cell, padding is always
+         * smaller than a cell. */
+        const int cx0 = (x - pad + CUBE_SIZE) / CUBE_SIZE;
+        const int cx1 = min((x + pad + CUBE_SIZE) / CUBE_SIZE, cells.x - 1);
+        const int cy0 = (y - pad + CUBE_SIZE) / CUBE_SIZE;
+        const int cy1 = min((y + pad + CUBE_SIZE) / CUBE_SIZE, cells.y - 1);
+        const int cz0 = (z - pad + CUBE_SIZE) / CUBE_SIZE;
+        const int cz1 = min((z + pad + CUBE_SIZE) / CUBE_SIZE, cells.z - 1);
+
+        for (int cz = cz0; cz <= cz1; ++cz) {
+          for (int cy = cy0; cy <= cy1; ++cy) {
+            for (int cx = cx0; cx <= cx1; ++cx) {
+              float &cell = majorant[compute_voxel_index(cells, cx, cy, cz)];
+              cell = max(cell, density);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  /* The volume mesh is built from whole cubes around the padded voxels, which
+   * reach at most one cell further. Include those cells with zero density. */
+  const array<float> non_empty = majorant;
+
+  for (int z = 0; z < cells.z; ++z) {
+    for (int y = 0; y < cells.y; ++y) {
+      for (int x = 0; x < cells.x; ++x) {
+        if (non_empty[compute_voxel_index(cells, x, y, z)] < 0.0f) {
+          continue;
+        }
+
+        for (int cz = max(z - 1, 0); cz <= min(z + 1, cells.z - 1); ++cz) {
+          for (int cy = max(y - 1, 0); cy <= min(y + 1, cells.y - 1); ++cy) {
+            for (int cx = max(x - 1, 0); cx <= min(x + 1, cells.x - 1); ++cx) {
+              float &cell = majorant[compute_voxel_index(cells, cx, cy, cz)];
+              cell = max(cell, 0.0f);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  /* Object space to normalized voxel coordinates, then to cells. */
+  mesh->volume_majorant_resolution = cells;
+  mesh->volume_majorant_tfm = transform_translate(1.0f, 1.0f, 1.0f) *
+                              transform_scale((float)resolution.x / CUBE_SIZE,
+                                              (float)resolution.y / CUBE_SIZE,
+                                              (float)resolution.z / CUBE_SIZE);
+  if (generated_tfm) {
+    mesh->volume_majorant_tfm = mesh->volume_majorant_tfm * (*generated_tfm);
+  }
+}
+
 void MeshManager::create_volume_mesh(Scene *scene, Mesh *mesh, Progress &progress)
 {
   string msg = string_printf("Computing Volume Mesh %s", mesh->name.c_str());
@@ -394,6 +501,7 @@ void MeshManager::create_volume_mesh(Scene *scene, Mesh *mesh, Progress &progres
     VoxelAttributeGrid voxel_grid;
     voxel_grid.data = static_cast<float *>(image_memory->host_pointer);
     voxel_grid.channels = image_memory->data_elements;
+    voxel_grid.std = attr.std;
     voxel_grids.push_back(voxel_grid);
   }
 
@@ -468,6 +576,8 @@ void MeshManager::create_volume_mesh(Scene *scene, Mesh *mesh, Progress &progres
   }
 
   /* Create mesh. */
+  compute_volume_majorant(mesh, voxel_grids, volume_params, attr ? attr->data_transform() : NULL);
+
   vector<float3> vertices;
   vector<int> indices;
   vector<float3> face_normals;
@@ -504,4 +614,56 @@ void MeshManager::create_volume_mesh(Scene *scene, Mesh *mesh, Progress &progres
           << "Mb.";
 }
 
+void MeshManager::device_update_volume_majorants(Device *,
+                                                 DeviceScene *dscene,
+                                                 Scene *scene,
+                                                 Progress &progress)
+{
+  size_t num_grids = 0;
+  size_t num_cells = 0;
+
+  foreach (Mesh *mesh, scene->meshes) {
+    mesh->volume_majorant_offset = -1;
+
+    if (mesh->has_volume && mesh->volume_majorant.size()) {
+      num_grids++;
+      num_cells += mesh->volume_majorant.size();
+    }
+  }
+
+  if (num_grids == 0) {
+    return;
+  }
+
+  progress.set_status("Updating Mesh", "Copying Volume Majorants to device");
+
+  KernelVolumeMajorant *kgrids = dscene->volume_majorant_grids.alloc(num_grids);
+  float *kcells = dscene->volume_majorant.alloc(num_cells);
+  size_t grid_index = 0;
+  size_t cell_offset = 0;
+
+  foreach (Mesh *mesh, scene->meshes) {
+    if (!(mesh->has_volume && mesh->volume_majorant.size())) {
+      continue;
+    }
+
+    KernelVolumeMajorant &kgrid = kgrids[grid_index];
+    kgrid.tfm = mesh->volume_majorant_tfm;
+    kgrid.offset = cell_offset;
+    kgrid.resolution_x = mesh->volume_majorant_resolution.x;
+    kgrid.resolution_y = mesh->volume_majorant_resolution.y;
+    kgrid.resolution_z = mesh->volume_majorant_resolution.z;
+
+    memcpy(kcells + cell_offset,
+           mesh->volume_majorant.data(),
+           sizeof(float) * mesh->volume_majorant.size());
+
+    mesh->volume_majorant_offset = grid_index++;
+    cell_offset += mesh->volume_majorant.size();
+  }
+
+  dscene->volume_majorant_grids.copy_to_device();
+  dscene->volume_majorant.copy_to_device();
+}
+
 CCL_NAMESPACE_END
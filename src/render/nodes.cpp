@@ -33,6 +33,7 @@
 #include "util/util_sky_model.h"
 #include "util/util_foreach.h"
 #include "util/util_logging.h"
+#include "util/util_md5.h"
 #include "util/util_transform.h"
 
 CCL_NAMESPACE_BEGIN
@@ -226,6 +227,17 @@ void ImageSlotTextureNode::add_image_user() const
   }
 }
 
+void ImageSlotTextureNode::hash_runtime(MD5Hash &md5)
+{
+  /* Slots are only assigned on first compile, so a new node never reuses the
+   * compiled nodes of one it replaces. */
+  int num_slots = slots.size();
+  md5.append((uint8_t *)&num_slots, sizeof(num_slots));
+  if (num_slots) {
+    md5.append((uint8_t *)&slots[0], sizeof(int) * num_slots);
+  }
+}
+
 NODE_DEFINE(ImageTextureNode)
 {
   NodeType *type = NodeType::add("image_texture", create, NodeType::SHADER);
@@ -1247,6 +1259,11 @@ IESLightNode::~IESLightNode()
   }
 }
 
+void IESLightNode::hash_runtime(MD5Hash &md5)
+{
+  md5.append((uint8_t *)&slot, sizeof(slot));
+}
+
 void IESLightNode::get_slot()
 {
   assert(light_manager);
@@ -1778,6 +1795,11 @@ void PointDensityTextureNode::attributes(Shader *shader, AttributeRequestSet *at
   ShaderNode::attributes(shader, attributes);
 }
 
+void PointDensityTextureNode::hash_runtime(MD5Hash &md5)
+{
+  md5.append((uint8_t *)&slot, sizeof(slot));
+}
+
 void PointDensityTextureNode::add_image()
 {
   if (slot == -1) {
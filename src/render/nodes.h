@@ -81,6 +81,7 @@ class ImageSlotTextureNode : public TextureNode {
   }
   ~ImageSlotTextureNode();
   void add_image_user() const;
+  void hash_runtime(MD5Hash &md5);
   ImageManager *image_manager;
   vector<int> slots;
 };
@@ -370,6 +371,7 @@ class PointDensityTextureNode : public ShaderNode {
   }
 
   void add_image();
+  void hash_runtime(MD5Hash &md5);
 
   /* Parameters. */
   ustring filename;
@@ -396,6 +398,7 @@ class IESLightNode : public TextureNode {
 
   ~IESLightNode();
   ShaderNode *clone() const;
+  void hash_runtime(MD5Hash &md5);
   virtual int get_group()
   {
     return NODE_GROUP_LEVEL_2;
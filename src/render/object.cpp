@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include "bvh/bvh2.h"
+
 #include "render/camera.h"
 #include "device/device.h"
 #include "render/light.h"
@@ -22,7 +24,9 @@
 #include "render/object.h"
 #include "render/particles.h"
 #include "render/scene.h"
+#include "render/stats.h"
 
+#include "util/util_algorithm.h"
 #include "util/util_foreach.h"
 #include "util/util_logging.h"
 #include "util/util_map.h"
@@ -357,6 +361,10 @@ ObjectManager::ObjectManager()
 {
   need_update = true;
   need_flags_update = true;
+  num_baked_objects = 0;
+  num_instanced_objects = 0;
+  baked_bytes_saved = 0;
+  instanced_bytes = 0;
 }
 
 ObjectManager::~ObjectManager()
@@ -812,6 +820,11 @@ void ObjectManager::device_update_mesh_offsets(Device *, DeviceScene *dscene, Sc
       kobjects[object->index].attribute_map_offset = mesh->attr_map_offset;
       update = true;
     }
+
+    if (kobjects[object->index].volume_majorant != mesh->volume_majorant_offset) {
+      kobjects[object->index].volume_majorant = mesh->volume_majorant_offset;
+      update = true;
+    }
   }
 
   if (update) {
@@ -827,6 +840,33 @@ void ObjectManager::device_free(Device *, DeviceScene *dscene)
   dscene->object_flag.free();
 }
 
+/* Rough size of the separate BVH that is built for an instanced mesh, and
+ * copied into the top level BVH: primitive arrays plus about one inner and one
+ * leaf node for every few primitives. */
+static size_t object_mesh_bvh_size_estimate(const Mesh *mesh)
+{
+  const size_t num_triangles = mesh->num_triangles();
+  const size_t num_primitives = mesh->num_primitives();
+  const size_t num_nodes = num_primitives / 2 + 1;
+
+  return num_triangles * 3 * sizeof(float4) +
+         num_primitives * (sizeof(uint) * 2 + sizeof(int) * 3 + sizeof(float2)) +
+         num_nodes * (BVH_NODE_SIZE + BVH_NODE_LEAF_SIZE) * sizeof(int4);
+}
+
+static bool object_can_apply_transform(Object *object, int mesh_users, bool motion_blur)
+{
+  /* Annoying feedback loop here: we can't use is_instanced() because
+   * it'll use uninitialized transform_applied flag.
+   *
+   * Could be solved by moving reference counter to Mesh.
+   */
+  return !object->is_block_instance && mesh_users == 1 && !object->mesh->has_surface_bssrdf &&
+         !object->mesh->has_true_displacement() &&
+         object->mesh->subdivision_type == Mesh::SUBDIVISION_NONE &&
+         !(motion_blur && object->use_motion());
+}
+
 void ObjectManager::apply_static_transforms(DeviceScene *dscene, Scene *scene, Progress &progress)
 {
   /* todo: normals and displacement should be done before applying transform! */
@@ -852,46 +892,94 @@ void ObjectManager::apply_static_transforms(DeviceScene *dscene, Scene *scene, P
   if (progress.get_cancel())
     return;
 
+  /* Keep the largest single user meshes instanced within the memory budget.
+   * Their BVH can then be reused when only the object transform changes, at
+   * the cost of keeping a separate copy of it. Meshes which already had their
+   * transform applied can't be restored and stay baked. */
+  set<Mesh *> keep_instanced;
+  const size_t instance_budget = (size_t)max(scene->params.instance_memory_budget, 0) * 1024 *
+                                 1024;
+
+  if (instance_budget > 0) {
+    vector<pair<size_t, Mesh *>> candidates;
+
+    foreach (Object *object, scene->objects) {
+      Mesh *mesh = object->mesh;
+      if (object_can_apply_transform(object, mesh_users[mesh], motion_blur) &&
+          !mesh->transform_applied &&
+          mesh->num_primitives() >= (size_t)scene->params.instance_min_primitives) {
+        candidates.push_back(std::make_pair(mesh->num_primitives(), mesh));
+      }
+    }
+
+    sort(candidates.rbegin(), candidates.rend());
+
+    size_t used = 0;
+    for (size_t j = 0; j < candidates.size(); j++) {
+      const size_t size = object_mesh_bvh_size_estimate(candidates[j].second);
+      if (used + size <= instance_budget) {
+        keep_instanced.insert(candidates[j].second);
+        used += size;
+      }
+    }
+  }
+
+  num_baked_objects = 0;
+  num_instanced_objects = 0;
+  baked_bytes_saved = 0;
+  instanced_bytes = 0;
+
+  set<Mesh *> counted_meshes;
   uint *object_flag = dscene->object_flag.data();
 
   /* apply transforms for objects with single user meshes */
   foreach (Object *object, scene->objects) {
-    /* Annoying feedback loop here: we can't use is_instanced() because
-     * it'll use uninitialized transform_applied flag.
-     *
-     * Could be solved by moving reference counter to Mesh.
-     */
-    if (!object->is_block_instance)
-      if ((mesh_users[object->mesh] == 1 && !object->mesh->has_surface_bssrdf) &&
-          !object->mesh->has_true_displacement() &&
-          object->mesh->subdivision_type == Mesh::SUBDIVISION_NONE) {
-        if (!(motion_blur && object->use_motion())) {
-          if (!object->mesh->transform_applied) {
-            object->apply_transform(apply_to_motion);
-            object->mesh->transform_applied = true;
-
-            if (progress.get_cancel())
-              return;
-          }
-
-          object_flag[i] |= SD_OBJECT_TRANSFORM_APPLIED;
-          if (object->mesh->transform_negative_scaled)
-            object_flag[i] |= SD_OBJECT_NEGATIVE_SCALE_APPLIED;
-        }
-        else
-          have_instancing = true;
+    Mesh *mesh = object->mesh;
+
+    if (object_can_apply_transform(object, mesh_users[mesh], motion_blur) &&
+        !keep_instanced.count(mesh)) {
+      if (!mesh->transform_applied) {
+        object->apply_transform(apply_to_motion);
+        mesh->transform_applied = true;
+
+        if (progress.get_cancel())
+          return;
       }
-      else
-        have_instancing = true;
-    else
+
+      object_flag[i] |= SD_OBJECT_TRANSFORM_APPLIED;
+      if (mesh->transform_negative_scaled)
+        object_flag[i] |= SD_OBJECT_NEGATIVE_SCALE_APPLIED;
+
+      num_baked_objects++;
+      baked_bytes_saved += object_mesh_bvh_size_estimate(mesh);
+    }
+    else {
       have_instancing = true;
 
+      num_instanced_objects++;
+      if (counted_meshes.insert(mesh).second)
+        instanced_bytes += object_mesh_bvh_size_estimate(mesh);
+    }
+
     i++;
   }
 
+  if (!keep_instanced.empty()) {
+    VLOG(1) << "Kept " << keep_instanced.size() << " single user meshes instanced, "
+            << string_human_readable_size(instanced_bytes) << " of estimated BVH memory.";
+  }
+
   dscene->data.bvh.have_instancing = have_instancing;
 }
 
+void ObjectManager::collect_statistics(RenderStats *stats)
+{
+  stats->mesh.num_baked_objects = num_baked_objects;
+  stats->mesh.num_instanced_objects = num_instanced_objects;
+  stats->mesh.baked_bytes_saved = baked_bytes_saved;
+  stats->mesh.instanced_bytes = instanced_bytes;
+}
+
 void ObjectManager::tag_update(Scene *scene)
 {
   need_update = true;
@@ -35,6 +35,7 @@ class DeviceScene;
 class Mesh;
 class ParticleSystem;
 class Progress;
+class RenderStats;
 class Scene;
 struct Transform;
 struct UpdateObjectTransformState;
@@ -139,10 +140,18 @@ class ObjectManager {
 
   void apply_static_transforms(DeviceScene *dscene, Scene *scene, Progress &progress);
 
+  void collect_statistics(RenderStats *stats);
+
   string get_cryptomatte_objects(Scene *scene);
   string get_cryptomatte_assets(Scene *scene);
 
  protected:
+  /* Statistics of the last apply_static_transforms(). */
+  size_t num_baked_objects;
+  size_t num_instanced_objects;
+  size_t baked_bytes_saved;
+  size_t instanced_bytes;
+
   void device_update_object_transform(UpdateObjectTransformState *state, Object *ob);
   void device_update_object_transform_task(UpdateObjectTransformState *state);
   bool device_update_object_transform_pop_work(UpdateObjectTransformState *state,
@@ -64,6 +64,8 @@ DeviceScene::DeviceScene(Device *device)
       object_motion_pass(device, "__object_motion_pass", MEM_TEXTURE),
       object_motion(device, "__object_motion", MEM_TEXTURE),
       object_flag(device, "__object_flag", MEM_TEXTURE),
+      volume_majorant_grids(device, "__volume_majorant_grids", MEM_TEXTURE),
+      volume_majorant(device, "__volume_majorant", MEM_TEXTURE),
       camera_motion(device, "__camera_motion", MEM_TEXTURE),
       attributes_map(device, "__attributes_map", MEM_TEXTURE),
       attributes_float(device, "__attributes_float", MEM_TEXTURE),
@@ -74,11 +76,17 @@ DeviceScene::DeviceScene(Device *device)
       lights(device, "__lights", MEM_TEXTURE),
       light_background_marginal_cdf(device, "__light_background_marginal_cdf", MEM_TEXTURE),
       light_background_conditional_cdf(device, "__light_background_conditional_cdf", MEM_TEXTURE),
+      light_tree_nodes(device, "__light_tree_nodes", MEM_TEXTURE),
+      light_tree_emitters(device, "__light_tree_emitters", MEM_TEXTURE),
+      light_tree_leaf_emitters(device, "__light_tree_leaf_emitters", MEM_TEXTURE),
+      light_tree_objects(device, "__light_tree_objects", MEM_TEXTURE),
       particles(device, "__particles", MEM_TEXTURE),
       svm_nodes(device, "__svm_nodes", MEM_TEXTURE),
       shaders(device, "__shaders", MEM_TEXTURE),
       lookup_table(device, "__lookup_table", MEM_TEXTURE),
       sobol_directions(device, "__sobol_directions", MEM_TEXTURE),
+      pmj_samples(device, "__pmj_samples", MEM_TEXTURE),
+      blue_noise(device, "__blue_noise", MEM_TEXTURE),
       ies_lights(device, "__ies", MEM_TEXTURE)
 {
   memset((void *)&data, 0, sizeof(data));
@@ -195,104 +203,123 @@ void Scene::device_update(Device *device_, Progress &progress)
    * - Lookup tables are done a second time to handle film tables
    */
 
+  ProfilingPhaseHelper phase(device->profiler, "scene_update");
+  phase.set_phase("Shaders");
   progress.set_status("Updating Shaders");
   shader_manager->device_update(device, dscene, this, progress);
 
   if (progress.get_cancel() || device->have_error())
     return;
 
+  phase.set_phase("Background");
   progress.set_status("Updating Background");
   background->device_update(device, dscene, this);
 
   if (progress.get_cancel() || device->have_error())
     return;
 
+  phase.set_phase("Camera");
   progress.set_status("Updating Camera");
   camera->device_update(device, dscene, this);
 
   if (progress.get_cancel() || device->have_error())
     return;
 
+  phase.set_phase("Mesh Preprocess");
   mesh_manager->device_update_preprocess(device, this, progress);
 
   if (progress.get_cancel() || device->have_error())
     return;
 
+  phase.set_phase("Clipping Planes");
   progress.set_status("Updating Clipping Planes");
   object_manager->device_update_clipping_planes(device, dscene, this, progress);
 
+  phase.set_phase("Objects");
   progress.set_status("Updating Objects");
   object_manager->device_update(device, dscene, this, progress);
 
   if (progress.get_cancel() || device->have_error())
     return;
 
+  phase.set_phase("Hair Systems");
   progress.set_status("Updating Hair Systems");
   curve_system_manager->device_update(device, dscene, this, progress);
 
   if (progress.get_cancel() || device->have_error())
     return;
 
+  phase.set_phase("Particle Systems");
   progress.set_status("Updating Particle Systems");
   particle_system_manager->device_update(device, dscene, this, progress);
 
   if (progress.get_cancel() || device->have_error())
     return;
 
+  phase.set_phase("Meshes");
   progress.set_status("Updating Meshes");
   mesh_manager->device_update(device, dscene, this, progress);
 
   if (progress.get_cancel() || device->have_error())
     return;
 
+  phase.set_phase("Objects Flags");
   progress.set_status("Updating Objects Flags");
   object_manager->device_update_flags(device, dscene, this, progress);
 
   if (progress.get_cancel() || device->have_error())
     return;
 
+  phase.set_phase("Images");
   progress.set_status("Updating Images");
   image_manager->device_update(device, this, progress);
 
   if (progress.get_cancel() || device->have_error())
     return;
 
+  phase.set_phase("Camera Volume");
   progress.set_status("Updating Camera Volume");
   camera->device_update_volume(device, dscene, this);
 
   if (progress.get_cancel() || device->have_error())
     return;
 
+  phase.set_phase("Lookup Tables");
   progress.set_status("Updating Lookup Tables");
   lookup_tables->device_update(device, dscene);
 
   if (progress.get_cancel() || device->have_error())
     return;
 
+  phase.set_phase("Lights");
   progress.set_status("Updating Lights");
   light_manager->device_update(device, dscene, this, progress);
 
   if (progress.get_cancel() || device->have_error())
     return;
 
+  phase.set_phase("Integrator");
   progress.set_status("Updating Integrator");
   integrator->device_update(device, dscene, this);
 
   if (progress.get_cancel() || device->have_error())
     return;
 
+  phase.set_phase("Film");
   progress.set_status("Updating Film");
   film->device_update(device, dscene, this);
 
   if (progress.get_cancel() || device->have_error())
     return;
 
+  phase.set_phase("Lookup Tables");
   progress.set_status("Updating Lookup Tables");
   lookup_tables->device_update(device, dscene);
 
   if (progress.get_cancel() || device->have_error())
     return;
 
+  phase.set_phase("Baking");
   progress.set_status("Updating Baking");
   bake_manager->device_update(device, dscene, this, progress);
 
@@ -300,6 +327,7 @@ void Scene::device_update(Device *device_, Progress &progress)
     return;
 
   if (device->have_error() == false) {
+    phase.set_phase("Device");
     progress.set_status("Updating Device", "Writing constant memory");
     device->const_copy_to("__data", &(dscene->data), sizeof(dscene->data));
   }
@@ -399,6 +427,7 @@ void Scene::device_free()
 void Scene::collect_statistics(RenderStats *stats)
 {
   mesh_manager->collect_statistics(this, stats);
+  object_manager->collect_statistics(stats);
   image_manager->collect_statistics(stats);
 }
 
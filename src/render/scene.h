@@ -95,6 +95,10 @@ class DeviceScene {
   device_vector<DecomposedTransform> object_motion;
   device_vector<uint> object_flag;
 
+  /* volumes */
+  device_vector<KernelVolumeMajorant> volume_majorant_grids;
+  device_vector<float> volume_majorant;
+
   /* cameras */
   device_vector<DecomposedTransform> camera_motion;
 
@@ -110,6 +114,10 @@ class DeviceScene {
   device_vector<KernelLight> lights;
   device_vector<float2> light_background_marginal_cdf;
   device_vector<float2> light_background_conditional_cdf;
+  device_vector<KernelLightTreeNode> light_tree_nodes;
+  device_vector<KernelLightTreeEmitter> light_tree_emitters;
+  device_vector<uint> light_tree_leaf_emitters;
+  device_vector<uint2> light_tree_objects;
 
   /* particles */
   device_vector<KernelParticle> particles;
@@ -123,6 +131,8 @@ class DeviceScene {
 
   /* integrator */
   device_vector<uint> sobol_directions;
+  device_vector<uint> pmj_samples;
+  device_vector<float> blue_noise;
 
   /* ies lights */
   device_vector<float> ies_lights;
@@ -172,6 +182,20 @@ class SceneParams {
   int num_bvh_time_steps;
   bool persistent_data;
   int texture_limit;
+  /* Memory budget in megabytes of the CPU texture cache, which reads tiles of
+   * large images from disk as needed. Zero loads all images fully. */
+  int texture_cache_size;
+  /* Directory where packed mesh BVHs are stored and looked up by a hash of
+   * the mesh geometry. Empty disables the cache. */
+  string bvh_cache_path;
+  /* Memory budget in megabytes for the separate BVHs of single user meshes
+   * that are kept instanced instead of having the object transform baked into
+   * their vertices, for static BVH builds. Meshes with at least
+   * instance_min_primitives are instanced largest first until the budget is
+   * used, smaller ones are baked since instancing overhead would dominate
+   * their traversal. Zero bakes all of them. */
+  int instance_memory_budget;
+  int instance_min_primitives;
 
   bool background;
 
@@ -185,6 +209,9 @@ class SceneParams {
     num_bvh_time_steps = 0;
     persistent_data = false;
     texture_limit = 0;
+    texture_cache_size = 0;
+    instance_memory_budget = 0;
+    instance_min_primitives = 100000;
     background = true;
   }
 
@@ -195,7 +222,11 @@ class SceneParams {
              use_bvh_spatial_split == params.use_bvh_spatial_split &&
              use_bvh_unaligned_nodes == params.use_bvh_unaligned_nodes &&
              num_bvh_time_steps == params.num_bvh_time_steps &&
-             persistent_data == params.persistent_data && texture_limit == params.texture_limit);
+             persistent_data == params.persistent_data && texture_limit == params.texture_limit &&
+             texture_cache_size == params.texture_cache_size &&
+             instance_memory_budget == params.instance_memory_budget &&
+             instance_min_primitives == params.instance_min_primitives);
+    /* bvh_cache_path only changes where BVHs are loaded from, not the result. */
   }
 };
 
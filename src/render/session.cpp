@@ -28,6 +28,7 @@
 #include "render/scene.h"
 #include "render/session.h"
 #include "render/bake.h"
+#include "render/tile_output.h"
 
 #include "util/util_foreach.h"
 #include "util/util_function.h"
@@ -61,9 +62,15 @@ Session::Session(const SessionParams &params_)
 
   TaskScheduler::init(params.threads);
 
+  if (!params.profiling_trace_path.empty()) {
+    profiler.set_timeline_interval(params.profiling_trace_interval);
+  }
+
   device = Device::create(params.device, stats, profiler, params.background);
 
-  if (params.background && !params.write_render_cb) {
+  tile_output = NULL;
+
+  if (params.background && (!params.write_render_cb || use_tile_output())) {
     buffers = NULL;
     display_buffers[ccl::PassType::PASS_COMBINED] = nullptr;
   }
@@ -128,6 +135,8 @@ Session::~Session()
   #endif
 
   /* clean up */
+  close_tile_output();
+
   tile_manager.device_free();
 
   delete buffers;
@@ -533,13 +542,24 @@ void Session::release_tile(RenderTile &rtile)
 
   progress.add_finished_tile(rtile.task == RenderTile::DENOISE);
 
+  if (rtile.task == RenderTile::PATH_TRACE && rtile.converged) {
+    tile_manager.set_tile_converged(rtile.tile_index);
+  }
+
   bool delete_tile;
+  bool write_output = false;
+  int2 output_position;
+  vector<float> output_pixels;
 
   if (tile_manager.finish_tile(rtile.tile_index, delete_tile)) {
     if (write_render_tile_cb && params.progressive_refine == false) {
       write_render_tile_cb(rtile);
     }
 
+    if (use_tile_output()) {
+      write_output = read_tile_output(rtile, output_position, output_pixels);
+    }
+
     if (delete_tile) {
       delete rtile.buffers;
       tile_manager.state.tiles[rtile.tile_index].buffers = NULL;
@@ -552,6 +572,13 @@ void Session::release_tile(RenderTile &rtile)
   }
 
   update_status_time();
+
+  /* Compress and write the copied pixels without blocking other render threads. */
+  tile_lock.unlock();
+
+  if (write_output) {
+    write_tile_output(output_position, output_pixels);
+  }
 }
 
 void Session::map_neighbor_tiles(RenderTile *tiles, Device *tile_device)
@@ -945,8 +972,14 @@ void Session::run()
       run_cpu();
   }
 
+  close_tile_output();
+
   profiler.stop();
 
+  if (!params.profiling_trace_path.empty()) {
+    write_profiling_trace();
+  }
+
   /* progress update */
   if (progress.get_cancel())
     progress.set_status("Cancel", progress.get_cancel_message());
@@ -979,6 +1012,8 @@ int Session::sample() {
 }
 
 void Session::end_run() {
+  close_tile_output();
+
   /* progress update */
   if(progress.get_cancel())
     progress.set_status("Cancel", progress.get_cancel_message());
@@ -997,6 +1032,9 @@ bool Session::draw(BufferParams &buffer_params, DeviceDrawParams &draw_params)
 
 void Session::reset_(BufferParams &buffer_params, int samples)
 {
+  /* A new render starts a new file. */
+  close_tile_output();
+
   if (buffers && buffer_params.modified(tile_manager.params)) {
     gpu_draw_ready = false;
     buffers->reset(buffer_params);
@@ -1225,6 +1263,13 @@ void Session::render()
   task.requested_tile_size = params.tile_size;
   task.passes_size = tile_manager.params.get_passes_size();
 
+  if (scene->integrator->use_adaptive_sampling &&
+      scene->dscene->data.film.pass_adaptive_aux_buffer) {
+    task.adaptive_sampling.use = true;
+    task.adaptive_sampling.min_samples = scene->dscene->data.integrator.adaptive_min_samples;
+    task.adaptive_sampling.adaptive_step = scene->dscene->data.integrator.adaptive_step;
+  }
+
   if (params.run_denoising) {
     task.denoising = params.denoising;
 
@@ -1247,46 +1292,60 @@ void Session::copy_to_display_buffer(int sample)
 {
   if (sample < 0)
     return;
-  /* add film conversion task */
+
+  /* Convert all display passes in a single film conversion task, so that the
+   * render buffer is read once and only one wait is needed. */
+  DeviceTask task(DeviceTask::FILM_CONVERT);
+
+  task.pixel_size = tile_manager.state.buffer.resolution_divider;
+  bool onepixel = task.pixel_size == 1;
+  task.x = onepixel ? 0 : tile_manager.state.buffer.full_x;
+  task.y = onepixel ? 0 : tile_manager.state.buffer.full_y;
+  task.w = tile_manager.state.buffer.width;
+  task.h = task.fh = tile_manager.state.buffer.height;
+  task.full_w = onepixel ? tile_manager.state.buffer.width : tile_manager.state.buffer.original_full_width;
+  task.full_h = onepixel ? tile_manager.state.buffer.height : tile_manager.state.buffer.original_full_height;
+  task.rgba_float = 0;
+  task.buffer = buffers->buffer.device_pointer;
+  task.sample = sample;
+  tile_manager.state.buffer.get_offset_stride(task.offset, task.stride);
+  task.offset = 0;
+
+  vector<DisplayBuffer *> converted_buffers;
+
   for (auto &n : display_buffers) {
-    if (n.second != nullptr) {
-      DeviceTask task(DeviceTask::FILM_CONVERT);
-
-      task.pixel_size = tile_manager.state.buffer.resolution_divider;
-      bool onepixel = task.pixel_size == 1;
-      task.x = onepixel ? 0 : tile_manager.state.buffer.full_x;
-      task.y = onepixel ? 0 : tile_manager.state.buffer.full_y;
-      task.w = tile_manager.state.buffer.width;
-      task.h = task.fh = tile_manager.state.buffer.height;
-      task.full_w = onepixel ? tile_manager.state.buffer.width : tile_manager.state.buffer.original_full_width;
-      task.full_h = onepixel ? tile_manager.state.buffer.height : tile_manager.state.buffer.original_full_height;
-      task.pass_type = n.first;
-
-      task.rgba_float = 0;
-
-      for (const ccl::Pass &pass : tile_manager.params.passes) {
-        if (pass.type == n.first) {
-          if (pass.components == 4) {
-            task.rgba_float = n.second->rgba_float.device_pointer;
-          }
-          else if (pass.components == 3) {
-            task.rgba_float = n.second->three_float.device_pointer;
-          }
-          else if (pass.components == 1) {
-            task.rgba_float = n.second->one_float.device_pointer;
-          }
-          break;
+    if (n.second == nullptr) {
+      continue;
+    }
+
+    device_ptr rgba_float = 0;
+    for (const ccl::Pass &pass : tile_manager.params.passes) {
+      if (pass.type == n.first) {
+        if (pass.components == 4) {
+          rgba_float = n.second->rgba_float.device_pointer;
         }
+        else if (pass.components == 3) {
+          rgba_float = n.second->three_float.device_pointer;
+        }
+        else if (pass.components == 1) {
+          rgba_float = n.second->one_float.device_pointer;
+        }
+        break;
       }
-      task.buffer = buffers->buffer.device_pointer;
-      task.sample = sample;
-      tile_manager.state.buffer.get_offset_stride(task.offset, task.stride);
-      task.offset = 0;
-      if (task.rgba_float != 0 && task.w > 0 && task.h > 0) {
-        device->task_add(task);
-        device->task_wait();
-        n.second->draw_set(task.w, task.h);
-      }
+    }
+
+    if (rgba_float != 0) {
+      task.film_passes.push_back(DeviceFilmPass(n.first, rgba_float));
+      converted_buffers.push_back(n.second);
+    }
+  }
+
+  if (!task.film_passes.empty() && task.w > 0 && task.h > 0) {
+    device->task_add(task);
+    device->task_wait();
+
+    foreach (DisplayBuffer *display_buffer, converted_buffers) {
+      display_buffer->draw_set(task.w, task.h);
     }
   }
 
@@ -1355,6 +1414,85 @@ void Session::collect_statistics(RenderStats *render_stats)
   }
 }
 
+void Session::write_profiling_trace()
+{
+  vector<string> shader_names(scene->shaders.size());
+  foreach (Shader *shader, scene->shaders) {
+    if (shader->id >= 0 && shader->id < shader_names.size()) {
+      shader_names[shader->id] = shader->name.string();
+    }
+  }
+
+  vector<string> object_names(scene->objects.size());
+  foreach (Object *object, scene->objects) {
+    const int index = object->get_device_index();
+    if (index >= 0 && index < object_names.size()) {
+      object_names[index] = object->name.string();
+    }
+  }
+
+  if (!profiler.write_trace(params.profiling_trace_path,
+                            RenderStats::profiling_event_names(),
+                            shader_names,
+                            object_names)) {
+    LOG(ERROR) << "Failed to write profiling trace to " << params.profiling_trace_path;
+  }
+}
+
+bool Session::use_tile_output() const
+{
+  /* Progressive rendering finishes every tile once per sample. */
+  return params.background && !params.progressive && !params.progressive_refine &&
+         !params.tile_output_path.empty();
+}
+
+bool Session::read_tile_output(RenderTile &rtile, int2 &position, vector<float> &pixels)
+{
+  if (!tile_output) {
+    tile_output = new TileOutput(params.tile_output_path);
+  }
+
+  if (!tile_output->is_open()) {
+    if (!tile_output->error.empty() ||
+        !tile_output->open(tile_manager.params, params.tile_size)) {
+      progress.set_error(tile_output->error);
+      return false;
+    }
+  }
+
+  /* Adjust absolute sample number to the range. */
+  int sample = rtile.sample;
+  if (tile_manager.range_start_sample != -1) {
+    sample -= tile_manager.range_start_sample;
+  }
+
+  if (!tile_output->read_tile(rtile, scene->film->exposure, sample, position, pixels)) {
+    progress.set_error(tile_output->error);
+    return false;
+  }
+
+  return true;
+}
+
+void Session::write_tile_output(int2 position, const vector<float> &pixels)
+{
+  if (!tile_output->write_tile(position, pixels)) {
+    progress.set_error(tile_output->error);
+  }
+}
+
+void Session::close_tile_output()
+{
+  if (tile_output) {
+    if (tile_output->is_open() && !tile_output->close()) {
+      LOG(ERROR) << tile_output->error;
+    }
+
+    delete tile_output;
+    tile_output = NULL;
+  }
+}
+
 int Session::get_max_closure_count()
 {
   if (scene->shader_manager->use_osl()) {
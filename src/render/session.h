@@ -38,6 +38,7 @@ class DisplayBuffer;
 class Progress;
 class RenderBuffers;
 class Scene;
+class TileOutput;
 
 /* Session Parameters */
 
@@ -57,6 +58,14 @@ class SessionParams {
   int threads;
 
   bool use_profiling;
+  /* Write a Chrome trace of the session timeline to this file, with kernel
+   * profiling samples bucketed in intervals of the given length in seconds. */
+  string profiling_trace_path;
+  double profiling_trace_interval;
+
+  /* Stream finished tiles of a background render to this tiled OpenEXR file
+   * and free their buffers, instead of keeping the full image in memory. */
+  string tile_output_path;
 
   bool display_buffer_linear;
 
@@ -89,6 +98,7 @@ class SessionParams {
     threads = 0;
 
     use_profiling = false;
+    profiling_trace_interval = 0.1;
 
     run_denoising = false;
     write_denoising_passes = false;
@@ -115,6 +125,9 @@ class SessionParams {
              tile_size == params.tile_size && start_resolution == params.start_resolution &&
              pixel_size == params.pixel_size && threads == params.threads &&
              use_profiling == params.use_profiling &&
+             profiling_trace_path == params.profiling_trace_path &&
+             profiling_trace_interval == params.profiling_trace_interval &&
+             tile_output_path == params.tile_output_path &&
              display_buffer_linear == params.display_buffer_linear &&
              cancel_timeout == params.cancel_timeout && reset_timeout == params.reset_timeout &&
              text_timeout == params.text_timeout &&
@@ -180,6 +193,12 @@ class Session {
   void run();
 
   void update_status_time(bool show_pause = false, bool show_done = false);
+  void write_profiling_trace();
+
+  bool use_tile_output() const;
+  bool read_tile_output(RenderTile &rtile, int2 &position, vector<float> &pixels);
+  void write_tile_output(int2 position, const vector<float> &pixels);
+  void close_tile_output();
 
   void copy_to_display_buffer(int sample);
   void render();
@@ -224,6 +243,9 @@ class Session {
 
   double reset_time;
 
+  /* Streaming output of finished tiles, opened with the first one. */
+  TileOutput *tile_output;
+
   /* progressive refine */
   double last_update_time;
   bool update_progressive_refine(bool cancel);
@@ -269,6 +269,45 @@ bool Shader::is_constant_emission(float3 *emission)
   return true;
 }
 
+bool Shader::get_volume_majorant(float *density_scale, float *density_constant, bool *emission)
+{
+  ShaderInput *volume = graph->output()->input("Volume");
+
+  if (volume->link == NULL || volume->link->parent->type != PrincipledVolumeNode::node_type) {
+    return false;
+  }
+
+  PrincipledVolumeNode *node = (PrincipledVolumeNode *)volume->link->parent;
+
+  /* Density and color scale the extinction, they must be known here. */
+  if (node->input("Density")->link || node->input("Color")->link ||
+      !node->color_attribute.empty()) {
+    return false;
+  }
+
+  /* Scattering plus absorption is at most density per channel, unless the
+   * color is brighter than one. */
+  const float density = max(node->density, 0.0f) * max(max3(node->color), 1.0f);
+
+  if (node->density_attribute.empty()) {
+    /* Density attribute lookup fails, the density is used as is. */
+    *density_scale = 0.0f;
+    *density_constant = density;
+  }
+  else if (node->density_attribute == Attribute::standard_name(ATTR_STD_VOLUME_DENSITY)) {
+    *density_scale = density;
+    *density_constant = 0.0f;
+  }
+  else {
+    return false;
+  }
+
+  *emission = node->input("Emission Strength")->link || node->emission_strength > 0.0f ||
+              node->input("Blackbody Intensity")->link || node->blackbody_intensity > 0.0f;
+
+  return true;
+}
+
 void Shader::set_graph(ShaderGraph *graph_)
 {
   /* do this here already so that we can detect if mesh or object attributes
@@ -559,6 +598,17 @@ void ShaderManager::device_update_common(Device *device,
     if (shader->is_constant_emission(&constant_emission))
       flag |= SD_HAS_CONSTANT_EMISSION;
 
+    /* volume majorant tracking bound */
+    float volume_majorant_density = 0.0f, volume_majorant_constant = 0.0f;
+    bool volume_emission = false;
+    if (shader->has_volume && shader->get_volume_majorant(&volume_majorant_density,
+                                                          &volume_majorant_constant,
+                                                          &volume_emission)) {
+      flag |= SD_VOLUME_MAJORANT;
+      if (volume_emission)
+        flag |= SD_VOLUME_MAJORANT_EMISSION;
+    }
+
     uint32_t cryptomatte_id = util_murmur_hash3(shader->name.c_str(), shader->name.length(), 0);
 
     /* regular shader */
@@ -568,6 +618,8 @@ void ShaderManager::device_update_common(Device *device,
     kshader->constant_emission[1] = constant_emission.y;
     kshader->constant_emission[2] = constant_emission.z;
     kshader->cryptomatte_id = util_hash_to_float(cryptomatte_id);
+    kshader->volume_majorant_density = volume_majorant_density;
+    kshader->volume_majorant_constant = volume_majorant_constant;
     kshader++;
 
     has_transparent_shadow |= (flag & SD_HAS_TRANSPARENT_SHADOW) != 0;
@@ -132,6 +132,11 @@ class Shader : public Node {
   uint id;
   bool used;
 
+  /* SVM nodes of the last compile, starting with a local jump node, and the
+   * hash they were compiled from. Reused as long as the hash is unchanged. */
+  array<int4> svm_nodes;
+  string svm_hash;
+
 #ifdef WITH_OSL
   /* osl shading state references */
   OSL::ShaderGroupRef osl_surface_ref;
@@ -149,6 +154,12 @@ class Shader : public Node {
    * then used for speeding up light evaluation. */
   bool is_constant_emission(float3 *emission);
 
+  /* Checks if the volume extinction of the shader is bounded by the density
+   * attribute times density_scale plus density_constant, which is the case for
+   * a Principled Volume with constant density and color connected directly to
+   * the output. Emission is set if the volume may emit light. */
+  bool get_volume_majorant(float *density_scale, float *density_constant, bool *emission);
+
   void set_graph(ShaderGraph *graph);
   void tag_update(Scene *scene);
   void tag_used(Scene *scene);
@@ -199,6 +199,12 @@ string NamedSampleCountStats::full_report(int indent_level)
 /* Mesh statistics. */
 
 MeshStats::MeshStats()
+    : num_baked_objects(0),
+      num_instanced_objects(0),
+      baked_bytes_saved(0),
+      instanced_bytes(0),
+      bvh_pack_time(0.0),
+      bvh_refit_time(0.0)
 {
 }
 
@@ -207,6 +213,24 @@ string MeshStats::full_report(int indent_level)
   const string indent(indent_level * kIndentNumSpaces, ' ');
   string result = "";
   result += indent + "Geometry:\n" + geometry.full_report(indent_level + 1);
+  if (num_baked_objects || num_instanced_objects) {
+    const string double_indent = indent + string(kIndentNumSpaces, ' ');
+    result += indent + "Transforms:\n";
+    result += string_printf("%sBaked objects: %s (BVH memory saved: %s)\n",
+                            double_indent.c_str(),
+                            string_human_readable_number(num_baked_objects).c_str(),
+                            string_human_readable_size(baked_bytes_saved).c_str());
+    result += string_printf("%sInstanced objects: %s (BVH memory used: %s)\n",
+                            double_indent.c_str(),
+                            string_human_readable_number(num_instanced_objects).c_str(),
+                            string_human_readable_size(instanced_bytes).c_str());
+  }
+  if (bvh_pack_time > 0.0 || bvh_refit_time > 0.0) {
+    const string double_indent = indent + string(kIndentNumSpaces, ' ');
+    result += indent + "BVH:\n";
+    result += string_printf("%sPacking: %.3f seconds\n", double_indent.c_str(), bvh_pack_time);
+    result += string_printf("%sRefitting: %.3f seconds\n", double_indent.c_str(), bvh_refit_time);
+  }
   return result;
 }
 
@@ -231,58 +255,141 @@ RenderStats::RenderStats()
   has_profiling = false;
 }
 
+/* Names of the kernel events, used for the statistics report and the profiling trace. */
+static const char *profiling_event_name(ProfilingEvent event)
+{
+  switch (event) {
+    case PROFILING_UNKNOWN:
+      return "Unknown";
+    case PROFILING_RAY_SETUP:
+      return "Ray setup";
+    case PROFILING_PATH_INTEGRATE:
+      return "Path integration";
+    case PROFILING_SCENE_INTERSECT:
+      return "Scene intersection";
+    case PROFILING_INDIRECT_EMISSION:
+      return "Indirect emission";
+    case PROFILING_VOLUME:
+      return "Volumes";
+    case PROFILING_SHADER_SETUP:
+      return "Shader Setup";
+    case PROFILING_SHADER_EVAL:
+      return "Shader Eval";
+    case PROFILING_SHADER_APPLY:
+      return "Shader Apply";
+    case PROFILING_AO:
+      return "Ambient Occlusion";
+    case PROFILING_SUBSURFACE:
+      return "Subsurface";
+    case PROFILING_CONNECT_LIGHT:
+      return "Connect Light";
+    case PROFILING_SURFACE_BOUNCE:
+      return "Surface Bounce";
+    case PROFILING_WRITE_RESULT:
+      return "Result writing";
+    case PROFILING_INTERSECT:
+      return "Full Intersection";
+    case PROFILING_INTERSECT_LOCAL:
+      return "Local Intersection";
+    case PROFILING_INTERSECT_SHADOW_ALL:
+      return "Shadow All Intersection";
+    case PROFILING_INTERSECT_VOLUME:
+      return "Volume Intersection";
+    case PROFILING_INTERSECT_VOLUME_ALL:
+      return "Volume All Intersection";
+    case PROFILING_CLOSURE_EVAL:
+      return "Surface Closure Evaluation";
+    case PROFILING_CLOSURE_SAMPLE:
+      return "Surface Closure Sampling";
+    case PROFILING_CLOSURE_VOLUME_EVAL:
+      return "Volume Closure Evaluation";
+    case PROFILING_CLOSURE_VOLUME_SAMPLE:
+      return "Volume Closure Sampling";
+    case PROFILING_DENOISING:
+      return "Denoising";
+    case PROFILING_DENOISING_CONSTRUCT_TRANSFORM:
+      return "Construct Transform";
+    case PROFILING_DENOISING_RECONSTRUCT:
+      return "Reconstruct";
+    case PROFILING_DENOISING_DIVIDE_SHADOW:
+      return "Divide Shadow";
+    case PROFILING_DENOISING_NON_LOCAL_MEANS:
+      return "Non-Local means";
+    case PROFILING_DENOISING_COMBINE_HALVES:
+      return "Combine Halves";
+    case PROFILING_DENOISING_GET_FEATURE:
+      return "Get Feature";
+    case PROFILING_DENOISING_DETECT_OUTLIERS:
+      return "Detect Outliers";
+    case PROFILING_NUM_EVENTS:
+      break;
+  }
+  return "";
+}
+
+static NamedNestedSampleStats &add_event_entry(NamedNestedSampleStats &parent,
+                                               Profiler &prof,
+                                               ProfilingEvent event)
+{
+  return parent.add_entry(profiling_event_name(event), prof.get_event(event));
+}
+
+vector<string> RenderStats::profiling_event_names()
+{
+  vector<string> names;
+  for (int i = 0; i < PROFILING_NUM_EVENTS; i++) {
+    names.push_back(profiling_event_name((ProfilingEvent)i));
+  }
+  return names;
+}
+
 void RenderStats::collect_profiling(Scene *scene, Profiler &prof)
 {
   has_profiling = true;
 
   kernel = NamedNestedSampleStats("Total render time", prof.get_event(PROFILING_UNKNOWN));
 
-  kernel.add_entry("Ray setup", prof.get_event(PROFILING_RAY_SETUP));
-  kernel.add_entry("Result writing", prof.get_event(PROFILING_WRITE_RESULT));
+  add_event_entry(kernel, prof, PROFILING_RAY_SETUP);
+  add_event_entry(kernel, prof, PROFILING_WRITE_RESULT);
 
-  NamedNestedSampleStats &integrator = kernel.add_entry("Path integration",
-                                                        prof.get_event(PROFILING_PATH_INTEGRATE));
-  integrator.add_entry("Scene intersection", prof.get_event(PROFILING_SCENE_INTERSECT));
-  integrator.add_entry("Indirect emission", prof.get_event(PROFILING_INDIRECT_EMISSION));
-  integrator.add_entry("Volumes", prof.get_event(PROFILING_VOLUME));
+  NamedNestedSampleStats &integrator = add_event_entry(kernel, prof, PROFILING_PATH_INTEGRATE);
+  add_event_entry(integrator, prof, PROFILING_SCENE_INTERSECT);
+  add_event_entry(integrator, prof, PROFILING_INDIRECT_EMISSION);
+  add_event_entry(integrator, prof, PROFILING_VOLUME);
 
   NamedNestedSampleStats &shading = integrator.add_entry("Shading", 0);
-  shading.add_entry("Shader Setup", prof.get_event(PROFILING_SHADER_SETUP));
-  shading.add_entry("Shader Eval", prof.get_event(PROFILING_SHADER_EVAL));
-  shading.add_entry("Shader Apply", prof.get_event(PROFILING_SHADER_APPLY));
-  shading.add_entry("Ambient Occlusion", prof.get_event(PROFILING_AO));
-  shading.add_entry("Subsurface", prof.get_event(PROFILING_SUBSURFACE));
+  add_event_entry(shading, prof, PROFILING_SHADER_SETUP);
+  add_event_entry(shading, prof, PROFILING_SHADER_EVAL);
+  add_event_entry(shading, prof, PROFILING_SHADER_APPLY);
+  add_event_entry(shading, prof, PROFILING_AO);
+  add_event_entry(shading, prof, PROFILING_SUBSURFACE);
 
-  integrator.add_entry("Connect Light", prof.get_event(PROFILING_CONNECT_LIGHT));
-  integrator.add_entry("Surface Bounce", prof.get_event(PROFILING_SURFACE_BOUNCE));
+  add_event_entry(integrator, prof, PROFILING_CONNECT_LIGHT);
+  add_event_entry(integrator, prof, PROFILING_SURFACE_BOUNCE);
 
   NamedNestedSampleStats &intersection = kernel.add_entry("Intersection", 0);
-  intersection.add_entry("Full Intersection", prof.get_event(PROFILING_INTERSECT));
-  intersection.add_entry("Local Intersection", prof.get_event(PROFILING_INTERSECT_LOCAL));
-  intersection.add_entry("Shadow All Intersection",
-                         prof.get_event(PROFILING_INTERSECT_SHADOW_ALL));
-  intersection.add_entry("Volume Intersection", prof.get_event(PROFILING_INTERSECT_VOLUME));
-  intersection.add_entry("Volume All Intersection",
-                         prof.get_event(PROFILING_INTERSECT_VOLUME_ALL));
+  add_event_entry(intersection, prof, PROFILING_INTERSECT);
+  add_event_entry(intersection, prof, PROFILING_INTERSECT_LOCAL);
+  add_event_entry(intersection, prof, PROFILING_INTERSECT_SHADOW_ALL);
+  add_event_entry(intersection, prof, PROFILING_INTERSECT_VOLUME);
+  add_event_entry(intersection, prof, PROFILING_INTERSECT_VOLUME_ALL);
 
   NamedNestedSampleStats &closure = kernel.add_entry("Closures", 0);
-  closure.add_entry("Surface Closure Evaluation", prof.get_event(PROFILING_CLOSURE_EVAL));
-  closure.add_entry("Surface Closure Sampling", prof.get_event(PROFILING_CLOSURE_SAMPLE));
-  closure.add_entry("Volume Closure Evaluation", prof.get_event(PROFILING_CLOSURE_VOLUME_EVAL));
-  closure.add_entry("Volume Closure Sampling", prof.get_event(PROFILING_CLOSURE_VOLUME_SAMPLE));
+  add_event_entry(closure, prof, PROFILING_CLOSURE_EVAL);
+  add_event_entry(closure, prof, PROFILING_CLOSURE_SAMPLE);
+  add_event_entry(closure, prof, PROFILING_CLOSURE_VOLUME_EVAL);
+  add_event_entry(closure, prof, PROFILING_CLOSURE_VOLUME_SAMPLE);
 
-  NamedNestedSampleStats &denoising = kernel.add_entry("Denoising",
-                                                       prof.get_event(PROFILING_DENOISING));
-  denoising.add_entry("Construct Transform",
-                      prof.get_event(PROFILING_DENOISING_CONSTRUCT_TRANSFORM));
-  denoising.add_entry("Reconstruct", prof.get_event(PROFILING_DENOISING_RECONSTRUCT));
+  NamedNestedSampleStats &denoising = add_event_entry(kernel, prof, PROFILING_DENOISING);
+  add_event_entry(denoising, prof, PROFILING_DENOISING_CONSTRUCT_TRANSFORM);
+  add_event_entry(denoising, prof, PROFILING_DENOISING_RECONSTRUCT);
 
   NamedNestedSampleStats &prefilter = denoising.add_entry("Prefiltering", 0);
-  prefilter.add_entry("Divide Shadow", prof.get_event(PROFILING_DENOISING_DIVIDE_SHADOW));
-  prefilter.add_entry("Non-Local means", prof.get_event(PROFILING_DENOISING_NON_LOCAL_MEANS));
-  prefilter.add_entry("Get Feature", prof.get_event(PROFILING_DENOISING_GET_FEATURE));
-  prefilter.add_entry("Detect Outliers", prof.get_event(PROFILING_DENOISING_DETECT_OUTLIERS));
-  prefilter.add_entry("Combine Halves", prof.get_event(PROFILING_DENOISING_COMBINE_HALVES));
+  add_event_entry(prefilter, prof, PROFILING_DENOISING_DIVIDE_SHADOW);
+  add_event_entry(prefilter, prof, PROFILING_DENOISING_NON_LOCAL_MEANS);
+  add_event_entry(prefilter, prof, PROFILING_DENOISING_GET_FEATURE);
+  add_event_entry(prefilter, prof, PROFILING_DENOISING_DETECT_OUTLIERS);
+  add_event_entry(prefilter, prof, PROFILING_DENOISING_COMBINE_HALVES);
 
   shaders.entries.clear();
   foreach (Shader *shader, scene->shaders) {
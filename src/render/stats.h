@@ -122,6 +122,18 @@ class MeshStats {
    * memory like BVH.
    */
   NamedSizeStats geometry;
+
+  /* Objects with static transform baked into the mesh vertices versus kept as
+   * instances of a separately built mesh BVH, with estimated BVH memory saved
+   * by baking and spent on instancing. */
+  size_t num_baked_objects;
+  size_t num_instanced_objects;
+  size_t baked_bytes_saved;
+  size_t instanced_bytes;
+
+  /* Seconds spent packing and refitting the BVHs of all meshes and the scene. */
+  double bvh_pack_time;
+  double bvh_refit_time;
 };
 
 /* Statistics about images held in memory. */
@@ -146,6 +158,9 @@ class RenderStats {
   /* Collect kernel sampling information from Stats. */
   void collect_profiling(Scene *scene, Profiler &prof);
 
+  /* Names of the kernel profiling events, indexed by ProfilingEvent. */
+  static vector<string> profiling_event_names();
+
   bool has_profiling;
 
   MeshStats mesh;
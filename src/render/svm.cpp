@@ -17,7 +17,9 @@
 #include "device/device.h"
 
 #include "render/background.h"
+#include "render/film.h"
 #include "render/graph.h"
+#include "render/integrator.h"
 #include "render/light.h"
 #include "render/mesh.h"
 #include "render/nodes.h"
@@ -27,6 +29,7 @@
 
 #include "util/util_logging.h"
 #include "util/util_foreach.h"
+#include "util/util_md5.h"
 #include "util/util_progress.h"
 #include "util/util_task.h"
 
@@ -46,22 +49,65 @@ void SVMShaderManager::reset(Scene * /*scene*/)
 {
 }
 
+static string svm_shader_hash(Scene *scene, Shader *shader, bool background)
+{
+  MD5Hash md5;
+  shader->hash(md5);
+  md5.append(shader->graph->compute_hash());
+  md5.append((uint8_t *)&shader->used, sizeof(shader->used));
+  md5.append((uint8_t *)&background, sizeof(background));
+
+  /* Scene settings read by nodes in simplify_settings() when compiling. */
+  if (shader->has_integrator_dependency) {
+    const bool filter_glossy = (scene->integrator->filter_glossy != 0.0f);
+    md5.append((uint8_t *)&filter_glossy, sizeof(filter_glossy));
+  }
+  foreach (ShaderNode *node, shader->graph->nodes) {
+    if (node->special_type == SHADER_SPECIAL_TYPE_OUTPUT_AOV) {
+      OutputAOVNode *aov_node = static_cast<OutputAOVNode *>(node);
+      bool is_color = false;
+      const int slot = scene->film->get_aov_offset(aov_node->name.string(), is_color);
+      md5.append((uint8_t *)&slot, sizeof(slot));
+      md5.append((uint8_t *)&is_color, sizeof(is_color));
+    }
+  }
+
+  return md5.get_hex();
+}
+
 void SVMShaderManager::device_update_shader(Scene *scene,
                                             Shader *shader,
                                             Progress *progress,
-                                            array<int4> *svm_nodes)
+                                            bool *compiled)
 {
   if (progress->get_cancel()) {
     return;
   }
   assert(shader->graph);
 
-  svm_nodes->push_back_slow(make_int4(NODE_SHADER_JUMP, 0, 0, 0));
+  const bool background = (shader == scene->background->get_shader(scene));
+
+  /* Reuse the nodes from the previous compile if nothing changed. Compiling
+   * updates the graph, so the hash stored is the one computed afterwards. */
+  if (!shader->svm_hash.empty() &&
+      shader->svm_hash == svm_shader_hash(scene, shader, background)) {
+    *compiled = false;
+    return;
+  }
+
+  shader->svm_hash = "";
+  shader->svm_nodes.clear();
+  shader->svm_nodes.push_back_slow(make_int4(NODE_SHADER_JUMP, 0, 0, 0));
 
   SVMCompiler::Summary summary;
   SVMCompiler compiler(scene);
-  compiler.background = (shader == scene->background->get_shader(scene));
-  compiler.compile(shader, *svm_nodes, 0, &summary);
+  compiler.background = background;
+  compiler.compile(shader, shader->svm_nodes, 0, &summary);
+
+  if (!progress->get_cancel()) {
+    shader->svm_hash = svm_shader_hash(scene, shader, background);
+  }
+  *compiled = true;
 
   VLOG(2) << "Compilation summary:\n"
           << "Shader name: " << shader->name << "\n"
@@ -82,22 +128,24 @@ void SVMShaderManager::device_update(Device *device,
 
   double start_time = time_dt();
 
-  /* test if we need to update */
-  device_free(device, dscene, scene);
+  /* The node array is kept, so it can be updated in place. */
+  device_free_common(device, dscene, scene);
 
   /* determine which shaders are in use */
   device_update_shaders_used(scene);
 
-  /* Build all shaders. */
+  /* Build shaders that changed since the last update. */
   TaskPool task_pool;
-  vector<array<int4>> shader_svm_nodes(num_shaders);
+  /* Not a vector<bool>, which is not safe to write from multiple threads. */
+  array<bool> compiled(num_shaders);
   for (int i = 0; i < num_shaders; i++) {
+    compiled[i] = false;
     task_pool.push(function_bind(&SVMShaderManager::device_update_shader,
                                  this,
                                  scene,
                                  scene->shaders[i],
                                  &progress,
-                                 &shader_svm_nodes[i]),
+                                 &compiled[i]),
                    false);
   }
   task_pool.wait_work();
@@ -108,15 +156,26 @@ void SVMShaderManager::device_update(Device *device,
 
   /* The global node list contains a jump table (one node per shader)
    * followed by the nodes of all shaders. */
+  vector<int> node_offsets(num_shaders);
+  vector<string> node_hashes(num_shaders);
   int svm_nodes_size = num_shaders;
+  int num_compiled = 0;
   for (int i = 0; i < num_shaders; i++) {
+    Shader *shader = scene->shaders[i];
+    node_offsets[i] = svm_nodes_size;
+    node_hashes[i] = shader->svm_hash;
     /* Since we're not copying the local jump node, the size ends up being one node lower. */
-    svm_nodes_size += shader_svm_nodes[i].size() - 1;
+    svm_nodes_size += shader->svm_nodes.size() - 1;
+    num_compiled += (compiled[i]) ? 1 : 0;
   }
 
-  int4 *svm_nodes = dscene->svm_nodes.alloc(svm_nodes_size);
+  /* If all shaders keep their place in the node array, only the jump table
+   * and the nodes of changed shaders need to be written. */
+  const bool update_in_place = ((int)dscene->svm_nodes.size() == svm_nodes_size &&
+                                shader_node_offsets == node_offsets);
+  int4 *svm_nodes = (update_in_place) ? dscene->svm_nodes.data() :
+                                        dscene->svm_nodes.alloc(svm_nodes_size);
 
-  int node_offset = num_shaders;
   for (int i = 0; i < num_shaders; i++) {
     Shader *shader = scene->shaders[i];
 
@@ -129,24 +188,24 @@ void SVMShaderManager::device_update(Device *device,
      * Each compiled shader starts with a jump node that has offsets local
      * to the shader, so copy those and add the offset into the global node list. */
     int4 &global_jump_node = svm_nodes[shader->id];
-    int4 &local_jump_node = shader_svm_nodes[i][0];
+    const int4 &local_jump_node = shader->svm_nodes[0];
+    const int node_offset = node_offsets[i];
 
     global_jump_node.x = NODE_SHADER_JUMP;
     global_jump_node.y = local_jump_node.y - 1 + node_offset;
     global_jump_node.z = local_jump_node.z - 1 + node_offset;
     global_jump_node.w = local_jump_node.w - 1 + node_offset;
 
-    node_offset += shader_svm_nodes[i].size() - 1;
+    /* Copy the nodes of the shader into the correct location. */
+    if (!update_in_place || shader_node_hashes[i] != node_hashes[i]) {
+      memcpy(svm_nodes + node_offset,
+             &shader->svm_nodes[1],
+             sizeof(int4) * (shader->svm_nodes.size() - 1));
+    }
   }
 
-  /* Copy the nodes of each shader into the correct location. */
-  svm_nodes += num_shaders;
-  for (int i = 0; i < num_shaders; i++) {
-    int shader_size = shader_svm_nodes[i].size() - 1;
-
-    memcpy(svm_nodes, &shader_svm_nodes[i][1], sizeof(int4) * shader_size);
-    svm_nodes += shader_size;
-  }
+  shader_node_offsets.swap(node_offsets);
+  shader_node_hashes.swap(node_hashes);
 
   if (progress.get_cancel()) {
     return;
@@ -158,8 +217,9 @@ void SVMShaderManager::device_update(Device *device,
 
   need_update = false;
 
-  VLOG(1) << "Shader manager updated " << num_shaders << " shaders in " << time_dt() - start_time
-          << " seconds.";
+  VLOG(1) << "Shader manager updated " << num_shaders << " shaders (" << num_compiled
+          << " compiled" << ((update_in_place) ? ", in place" : "") << ") in "
+          << time_dt() - start_time << " seconds.";
 }
 
 void SVMShaderManager::device_free(Device *device, DeviceScene *dscene, Scene *scene)
@@ -50,10 +50,12 @@ class SVMShaderManager : public ShaderManager {
   void device_free(Device *device, DeviceScene *dscene, Scene *scene);
 
  protected:
-  void device_update_shader(Scene *scene,
-                            Shader *shader,
-                            Progress *progress,
-                            array<int4> *svm_nodes);
+  void device_update_shader(Scene *scene, Shader *shader, Progress *progress, bool *compiled);
+
+  /* Layout of the global node array from the last update, to copy only the
+   * nodes of shaders that changed when the layout stays the same. */
+  vector<int> shader_node_offsets;
+  vector<string> shader_node_hashes;
 };
 
 /* Graph Compiler */
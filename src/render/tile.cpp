@@ -153,6 +153,7 @@ void TileManager::reset(BufferParams &params_, int num_samples_)
   state.buffer = BufferParams();
   state.sample = range_start_sample - 1;
   state.num_tiles = 0;
+  state.num_converged_tiles = 0;
   state.num_samples = 0;
   state.resolution_divider = get_divider(params.width, params.height, start_resolution);
   state.render_tiles.clear();
@@ -212,6 +213,7 @@ int TileManager::gen_tiles(bool sliced)
   state.render_tiles.resize(num);
   state.denoising_tiles.resize(num);
   state.tile_stride = tile_w;
+  state.num_converged_tiles = 0;
   vector<list<int>>::iterator tile_list;
   tile_list = state.render_tiles.begin();
 
@@ -503,12 +505,24 @@ bool TileManager::next_tile(Tile *&tile, int device)
   return true;
 }
 
+void TileManager::set_tile_converged(int index)
+{
+  if (!state.tiles[index].converged) {
+    state.tiles[index].converged = true;
+    state.num_converged_tiles++;
+  }
+}
+
 bool TileManager::done()
 {
   int end_sample = (range_num_samples == -1) ? num_samples :
                                                range_start_sample + range_num_samples;
+  /* With adaptive sampling, progressive rendering can stop early once every
+   * tile has converged. */
+  bool all_converged = progressive && state.num_tiles > 0 &&
+                       state.num_converged_tiles == state.num_tiles;
   return (state.resolution_divider == pixel_size) &&
-         (state.sample + state.num_samples >= end_sample);
+         (state.sample + state.num_samples >= end_sample || all_converged);
 }
 
 bool TileManager::next()
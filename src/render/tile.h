@@ -39,13 +39,23 @@ class Tile {
   typedef enum { RENDER = 0, RENDERED, DENOISE, DENOISED, DONE } State;
   State state;
   RenderBuffers *buffers;
+  /* All pixels of the tile have converged with adaptive sampling. */
+  bool converged;
 
   Tile()
   {
   }
 
   Tile(int index_, int x_, int y_, int w_, int h_, int device_, State state_ = RENDER)
-      : index(index_), x(x_), y(y_), w(w_), h(h_), device(device_), state(state_), buffers(NULL)
+      : index(index_),
+        x(x_),
+        y(y_),
+        w(w_),
+        h(h_),
+        device(device_),
+        state(state_),
+        buffers(NULL),
+        converged(false)
   {
   }
 };
@@ -76,6 +86,8 @@ class TileManager {
     int num_samples;
     int resolution_divider;
     int num_tiles;
+    /* Number of tiles that have converged with adaptive sampling. */
+    int num_converged_tiles;
 
     /* Total samples over all pixels: Generally num_samples*num_pixels,
      * but can be higher due to the initial resolution division for previews. */
@@ -107,6 +119,7 @@ class TileManager {
   bool next();
   bool next_tile(Tile *&tile, int device = 0);
   bool finish_tile(int index, bool &delete_tile);
+  void set_tile_converged(int index);
   bool done();
 
   void set_tile_order(TileOrder tile_order_)
@@ -0,0 +1,203 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "render/tile_output.h"
+#include "render/film.h"
+
+#include "util/util_foreach.h"
+#include "util/util_logging.h"
+
+CCL_NAMESPACE_BEGIN
+
+static void tile_output_channel_names(const string &prefix,
+                                      int components,
+                                      std::vector<string> &channelnames)
+{
+  const char *suffixes = (components == 1) ? "X" : "RGBA";
+  for (int i = 0; i < components; i++) {
+    channelnames.push_back(prefix + suffixes[i]);
+  }
+}
+
+TileOutput::TileOutput(const string &filepath)
+    : filepath(filepath), tile_size(make_int2(0, 0)), num_channels(0)
+{
+}
+
+TileOutput::~TileOutput()
+{
+  close();
+}
+
+bool TileOutput::open(const BufferParams &params_, int2 tile_size_)
+{
+  thread_scoped_lock lock(mutex);
+
+  params = params_;
+  tile_size = tile_size_;
+
+  /* Combined pass as plain RGBA so viewers show it, other named passes with
+   * their name as layer. Unnamed passes are only placeholders for dividing
+   * other passes. */
+  std::vector<string> channelnames;
+  passes.clear();
+  num_channels = 0;
+
+  for (size_t i = 0; i < params.passes.size(); i++) {
+    const Pass &pass = params.passes[i];
+    if (i > 0 && pass.name.empty()) {
+      continue;
+    }
+
+    OutputPass output_pass;
+    output_pass.name = pass.name;
+    output_pass.components = pass.components;
+    output_pass.channel_offset = num_channels;
+    passes.push_back(output_pass);
+
+    tile_output_channel_names(
+        (pass.type == PASS_COMBINED) ? "" : pass.name + ".", pass.components, channelnames);
+    num_channels += pass.components;
+  }
+
+  /* Pad the data window up to a multiple of the tile height. */
+  const int pad_y = (tile_size.y - params.height % tile_size.y) % tile_size.y;
+  const int top = params.full_height - (params.full_y + params.height);
+
+  ImageSpec spec(params.width, params.height + pad_y, num_channels, TypeDesc::FLOAT);
+  spec.x = params.full_x;
+  spec.y = top - pad_y;
+  spec.full_x = 0;
+  spec.full_y = 0;
+  spec.full_width = params.full_width;
+  spec.full_height = params.full_height;
+  spec.tile_width = tile_size.x;
+  spec.tile_height = tile_size.y;
+  spec.channelnames = channelnames;
+  spec.attribute("compression", "zip");
+  /* Tiles finish in any order. */
+  spec.attribute("openexr:lineOrder", "randomY");
+
+  out = unique_ptr<ImageOutput>(ImageOutput::create(filepath));
+  if (!out) {
+    error = "Failed to create image output for " + filepath;
+    return false;
+  }
+
+  if (!out->supports("tiles") || !out->supports("random_access")) {
+    error = "Image format of " + filepath + " does not support writing tiles in any order";
+    out.reset();
+    return false;
+  }
+
+  if (!out->open(filepath, spec)) {
+    error = "Failed to open " + filepath + " for writing: " + out->geterror();
+    out.reset();
+    return false;
+  }
+
+  VLOG(1) << "Streaming " << params.width << "x" << params.height << " image with "
+          << num_channels << " channels in " << tile_size.x << "x" << tile_size.y
+          << " tiles to " << filepath;
+
+  return true;
+}
+
+bool TileOutput::is_open() const
+{
+  return (bool)out;
+}
+
+bool TileOutput::read_tile(
+    RenderTile &rtile, float exposure, int sample, int2 &position, vector<float> &pixels)
+{
+  if (!out) {
+    return false;
+  }
+
+  RenderBuffers *buffers = rtile.buffers;
+  if (!buffers->copy_from_device()) {
+    error = "Failed to copy tile from device";
+    return false;
+  }
+
+  /* Partial tiles at the right and top of the image are padded with zeros. */
+  pixels.clear();
+  pixels.resize((size_t)tile_size.x * tile_size.y * num_channels, 0.0f);
+  vector<float> pass_pixels;
+
+  foreach (const OutputPass &pass, passes) {
+    pass_pixels.resize((size_t)rtile.w * rtile.h * pass.components);
+
+    if (!buffers->get_pass_rect(pass.name, exposure, sample, pass.components, &pass_pixels[0])) {
+      continue;
+    }
+
+    /* Flip rows from bottom-up to top-down, bottom aligned in the file tile. */
+    for (int y = 0; y < rtile.h; y++) {
+      const float *in = &pass_pixels[(size_t)y * rtile.w * pass.components];
+      float *out_row = &pixels[((size_t)(tile_size.y - 1 - y) * tile_size.x) * num_channels +
+                               pass.channel_offset];
+
+      for (int x = 0; x < rtile.w; x++) {
+        for (int c = 0; c < pass.components; c++) {
+          out_row[c] = in[c];
+        }
+        in += pass.components;
+        out_row += num_channels;
+      }
+    }
+  }
+
+  position = make_int2(rtile.x, params.full_height - rtile.y - tile_size.y);
+  return true;
+}
+
+bool TileOutput::write_tile(int2 position, const vector<float> &pixels)
+{
+  thread_scoped_lock lock(mutex);
+
+  if (!out) {
+    return false;
+  }
+
+  if (!out->write_tile(position.x, position.y, 0, TypeDesc::FLOAT, pixels.data())) {
+    error = "Failed to write tile to " + filepath + ": " + out->geterror();
+    return false;
+  }
+
+  return true;
+}
+
+bool TileOutput::close()
+{
+  thread_scoped_lock lock(mutex);
+
+  if (!out) {
+    return true;
+  }
+
+  bool ok = out->close();
+  if (!ok) {
+    error = "Failed to save " + filepath + ": " + out->geterror();
+  }
+
+  out.reset();
+
+  return ok;
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TILE_OUTPUT_H__
+#define __TILE_OUTPUT_H__
+
+#include "render/buffers.h"
+
+#include "util/util_image.h"
+#include "util/util_string.h"
+#include "util/util_thread.h"
+#include "util/util_unique_ptr.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Tile Output
+ *
+ * Writes finished render tiles straight into a tiled OpenEXR file, so that a
+ * background render never needs buffers for the full image. File tiles match
+ * the render tile size; the data window is padded at the top so that tiles,
+ * which start at the bottom of the image in Cycles, stay aligned with the file
+ * tiles once flipped. */
+
+class TileOutput {
+ public:
+  explicit TileOutput(const string &filepath);
+  ~TileOutput();
+
+  bool open(const BufferParams &params, int2 tile_size);
+  bool is_open() const;
+
+  /* Reading the render buffers is not thread safe and has to be done while
+   * the tile is still locked, compression and writing of the pixels are
+   * serialized here and can run while other tiles render. */
+  bool read_tile(
+      RenderTile &rtile, float exposure, int sample, int2 &position, vector<float> &pixels);
+  bool write_tile(int2 position, const vector<float> &pixels);
+  bool close();
+
+  string error;
+
+ protected:
+  struct OutputPass {
+    string name;
+    int components;
+    int channel_offset;
+  };
+
+  string filepath;
+  unique_ptr<ImageOutput> out;
+  BufferParams params;
+  int2 tile_size;
+  int num_channels;
+  vector<OutputPass> passes;
+
+  thread_mutex mutex;
+};
+
+CCL_NAMESPACE_END
+
+#endif /* __TILE_OUTPUT_H__ */
@@ -25,6 +25,7 @@
 #include "util/util_foreach.h"
 #include "util/util_hash.h"
 #include "util/util_math.h"
+#include "util/util_task.h"
 #include "util/util_types.h"
 
 CCL_NAMESPACE_BEGIN
@@ -32,10 +33,15 @@ CCL_NAMESPACE_BEGIN
 /* DiagSplit */
 
 #define DSPLIT_NON_UNIFORM -1
+/* Number of subpatches diced by a single task, and the default minimum number
+ * of vertices for a mesh to be diced with the task pool. */
+#define DICE_TASK_NUM_SUBPATCHES 64
+#define DICE_TASK_MIN_VERTS 16384
 #define STITCH_NGON_CENTER_VERT_INDEX_OFFSET 0x60000000
 #define STITCH_NGON_SPLIT_EDGE_CENTER_VERT_TAG (0x60000000 - 1)
 
-DiagSplit::DiagSplit(const SubdParams &params_) : params(params_)
+DiagSplit::DiagSplit(const SubdParams &params_)
+    : params(params_), dice_task_min_verts(DICE_TASK_MIN_VERTS)
 {
 }
 
@@ -601,6 +607,20 @@ void DiagSplit::split_ngon(const Mesh::SubdFace &face, Patch *patches, size_t pa
   }
 }
 
+void DiagSplit::dice_grids(QuadDice *dice, size_t start, size_t end)
+{
+  for (size_t i = start; i < end; i++) {
+    dice->dice_grid(subpatches[i]);
+  }
+}
+
+void DiagSplit::dice_triangles(QuadDice *dice, size_t start, size_t end)
+{
+  for (size_t i = start; i < end; i++) {
+    dice->dice_triangles(subpatches[i]);
+  }
+}
+
 void DiagSplit::post_split()
 {
   int num_stitch_verts = 0;
@@ -721,14 +741,6 @@ void DiagSplit::post_split()
   int num_verts = num_alloced_verts;
   int num_triangles = 0;
 
-  for (size_t i = 0; i < subpatches.size(); i++) {
-    subpatches[i].inner_grid_vert_offset = num_verts;
-    num_verts += subpatches[i].calc_num_inner_verts();
-    num_triangles += subpatches[i].calc_num_triangles();
-  }
-
-  dice.reserve(num_verts, num_triangles);
-
   for (size_t i = 0; i < subpatches.size(); i++) {
     Subpatch &sub = subpatches[i];
 
@@ -737,7 +749,47 @@ void DiagSplit::post_split()
     sub.edge_v0.T = max(sub.edge_v0.T, 1);
     sub.edge_v1.T = max(sub.edge_v1.T, 1);
 
-    dice.dice(sub);
+    sub.inner_grid_vert_offset = num_verts;
+    sub.triangle_offset = num_triangles;
+    num_verts += sub.calc_num_inner_verts();
+    num_triangles += sub.calc_num_triangles();
+  }
+
+  dice.reserve(num_verts, num_triangles);
+
+  /* Every subpatch writes its inner vertices and triangles at the offsets
+   * computed above, so dicing in parallel gives the same result as dicing
+   * serially. Vertices on the sides of subpatches are shared and set in
+   * order in between. */
+  const size_t num_subpatches = subpatches.size();
+  const bool use_pool = (num_subpatches > DICE_TASK_NUM_SUBPATCHES &&
+                         num_verts >= dice_task_min_verts);
+  TaskPool pool;
+
+  if (use_pool) {
+    for (size_t start = 0; start < num_subpatches; start += DICE_TASK_NUM_SUBPATCHES) {
+      const size_t end = min(start + DICE_TASK_NUM_SUBPATCHES, num_subpatches);
+      pool.push(function_bind(&DiagSplit::dice_grids, this, &dice, start, end));
+    }
+    pool.wait_work();
+  }
+  else {
+    dice_grids(&dice, 0, num_subpatches);
+  }
+
+  for (size_t i = 0; i < num_subpatches; i++) {
+    dice.dice_sides(subpatches[i]);
+  }
+
+  if (use_pool) {
+    for (size_t start = 0; start < num_subpatches; start += DICE_TASK_NUM_SUBPATCHES) {
+      const size_t end = min(start + DICE_TASK_NUM_SUBPATCHES, num_subpatches);
+      pool.push(function_bind(&DiagSplit::dice_triangles, this, &dice, start, end));
+    }
+    pool.wait_work();
+  }
+  else {
+    dice_triangles(&dice, 0, num_subpatches);
   }
 
   /* Cleanup */
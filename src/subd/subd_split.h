@@ -57,11 +57,17 @@ class DiagSplit {
   int num_alloced_verts = 0;
   int alloc_verts(int n); /* Returns start index of new verts. */
 
+  void dice_grids(QuadDice *dice, size_t start, size_t end);
+  void dice_triangles(QuadDice *dice, size_t start, size_t end);
+
  public:
   Edge *alloc_edge();
 
   explicit DiagSplit(const SubdParams &params);
 
+  /* Meshes diced into fewer vertices are diced without the task pool. */
+  int dice_task_min_verts;
+
   void split_patches(Patch *patches, size_t patches_byte_stride);
 
   void split_quad(const Mesh::SubdFace &face, Patch *patch);
@@ -0,0 +1,91 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "bvh/bvh.h"
+#include "render/mesh.h"
+#include "render/object.h"
+#include "util/util_progress.h"
+
+#include "test/mesh_test_util.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+void build_and_refit(BVH *bvh, vector<int4> *built_nodes)
+{
+  Progress progress;
+  bvh->build(progress);
+
+  const array<int4> &nodes = bvh->pack.nodes;
+  built_nodes->assign(nodes.data(), nodes.data() + nodes.size());
+
+  bvh->refit(progress);
+}
+
+}  // namespace
+
+TEST(bvh_build, multiple_meshes_single_thread)
+{
+  /* Mesh BVHs are built from tasks of one pool like in Mesh::compute_bvh(),
+   * packing and refitting wait on pools nested inside those tasks. The grid
+   * is large enough for packing and refitting to use the task pool. */
+  const int num_meshes = 3;
+  const int resolution = 185;
+
+  BVHParams params;
+  params.bvh_layout = BVH_LAYOUT_BVH2;
+  params.top_level = false;
+
+  vector<Mesh *> meshes;
+  vector<Object *> objects;
+  vector<BVH *> bvhs;
+  vector<vector<int4>> built_nodes(num_meshes);
+
+  vector<TaskRunFunction> tasks;
+  for (int i = 0; i < num_meshes; i++) {
+    Mesh *mesh = test_create_grid_mesh(resolution, (float)i);
+    Object *object = new Object();
+    object->mesh = mesh;
+
+    BVH *bvh = BVH::create(params, vector<Mesh *>(1, mesh), vector<Object *>(1, object));
+    tasks.push_back(function_bind(&build_and_refit, bvh, &built_nodes[i]));
+
+    meshes.push_back(mesh);
+    objects.push_back(object);
+    bvhs.push_back(bvh);
+  }
+  test_run_tasks_single_thread(tasks);
+
+  for (int i = 0; i < num_meshes; i++) {
+    const PackedBVH &pack = bvhs[i]->pack;
+    EXPECT_EQ(pack.prim_index.size(), resolution * resolution * 2);
+    EXPECT_EQ(pack.prim_tri_verts.size(), resolution * resolution * 2 * 3);
+
+    /* Refitting unchanged geometry gives the bounds of the build. */
+    ASSERT_EQ(pack.nodes.size(), built_nodes[i].size());
+    EXPECT_EQ(memcmp(pack.nodes.data(), built_nodes[i].data(), sizeof(int4) * pack.nodes.size()),
+              0);
+
+    delete bvhs[i];
+    delete objects[i];
+    delete meshes[i];
+  }
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "bvh/bvh.h"
+#include "bvh/bvh_cache.h"
+#include "render/mesh.h"
+#include "render/object.h"
+#include "util/util_path.h"
+#include "util/util_progress.h"
+
+#include "test/mesh_test_util.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+const string test_filepath = "bvh_cache_test.bvh";
+
+BVHParams test_params()
+{
+  BVHParams params;
+  params.bvh_layout = BVH_LAYOUT_BVH2;
+  params.top_level = false;
+  return params;
+}
+
+}  // namespace
+
+TEST(bvh_cache, read_write)
+{
+  const BVHParams params = test_params();
+  Mesh *mesh = test_create_grid_mesh(16);
+  Object *object = new Object();
+  object->mesh = mesh;
+
+  BVH *bvh = BVH::create(params, vector<Mesh *>(1, mesh), vector<Object *>(1, object));
+  Progress progress;
+  bvh->build(progress);
+  ASSERT_TRUE(bvh_cache_write(test_filepath, params, bvh->pack));
+
+  PackedBVH pack;
+  ASSERT_TRUE(bvh_cache_read(test_filepath, params, mesh, pack));
+  EXPECT_EQ(pack.root_index, bvh->pack.root_index);
+  ASSERT_EQ(pack.nodes.size(), bvh->pack.nodes.size());
+  EXPECT_EQ(memcmp(pack.nodes.data(), bvh->pack.nodes.data(), sizeof(int4) * pack.nodes.size()),
+            0);
+  EXPECT_EQ(pack.prim_index.size(), bvh->pack.prim_index.size());
+
+  /* A mesh with fewer triangles than referenced by the file is a miss. */
+  Mesh *small_mesh = test_create_grid_mesh(4);
+  EXPECT_FALSE(bvh_cache_read(test_filepath, params, small_mesh, pack));
+  EXPECT_EQ(pack.nodes.size(), 0);
+
+  /* A different layout is a miss. */
+  BVHParams other_params = params;
+  other_params.bvh_layout = BVH_LAYOUT_BVH4;
+  EXPECT_FALSE(bvh_cache_read(test_filepath, other_params, mesh, pack));
+
+  delete small_mesh;
+  delete bvh;
+  delete object;
+  delete mesh;
+  path_remove(test_filepath);
+}
+
+TEST(bvh_cache, damaged_file)
+{
+  const BVHParams params = test_params();
+  Mesh *mesh = test_create_grid_mesh(16);
+  Object *object = new Object();
+  object->mesh = mesh;
+
+  BVH *bvh = BVH::create(params, vector<Mesh *>(1, mesh), vector<Object *>(1, object));
+  Progress progress;
+  bvh->build(progress);
+  ASSERT_TRUE(bvh_cache_write(test_filepath, params, bvh->pack));
+
+  vector<uint8_t> binary;
+  ASSERT_TRUE(path_read_binary(test_filepath, binary));
+
+  PackedBVH pack;
+
+  /* Truncated file. */
+  vector<uint8_t> truncated(binary.begin(), binary.end() - 16);
+  ASSERT_TRUE(path_write_binary(test_filepath, truncated));
+  EXPECT_FALSE(bvh_cache_read(test_filepath, params, mesh, pack));
+
+  /* Trailing data. */
+  vector<uint8_t> extended = binary;
+  extended.resize(binary.size() + 16, 0);
+  ASSERT_TRUE(path_write_binary(test_filepath, extended));
+  EXPECT_FALSE(bvh_cache_read(test_filepath, params, mesh, pack));
+
+  /* Size of the first array far beyond the file length, right after the
+   * 20 byte header. */
+  vector<uint8_t> huge = binary;
+  memset(&huge[20], 0xff, sizeof(uint64_t));
+  ASSERT_TRUE(path_write_binary(test_filepath, huge));
+  EXPECT_FALSE(bvh_cache_read(test_filepath, params, mesh, pack));
+
+  /* The original file still reads. */
+  ASSERT_TRUE(path_write_binary(test_filepath, binary));
+  EXPECT_TRUE(bvh_cache_read(test_filepath, params, mesh, pack));
+
+  delete bvh;
+  delete object;
+  delete mesh;
+  path_remove(test_filepath);
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,285 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "device/device.h"
+#include "device/device_intern.h"
+#include "render/buffers.h"
+#include "util/util_profiling.h"
+#include "util/util_stats.h"
+#include "util/util_task.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+/* Device run by the server, which like the CPU device uses host memory as
+ * device memory. Rendering a tile writes the sample and pass type into the
+ * buffer, plus a value read through the device pointer of the film pass. */
+class TestDevice : public Device {
+ public:
+  TestDevice(DeviceInfo &info, Stats &stats, Profiler &profiler)
+      : Device(info, stats, profiler, true)
+  {
+  }
+
+  BVHLayoutMask get_bvh_layout_mask() const
+  {
+    return BVH_LAYOUT_BVH2;
+  }
+
+  void mem_alloc(device_memory &mem)
+  {
+    mem.device_pointer = (device_ptr)mem.host_pointer;
+    mem.device_size = mem.memory_size();
+  }
+
+  void mem_copy_to(device_memory &mem)
+  {
+    if (!mem.device_pointer) {
+      mem_alloc(mem);
+    }
+  }
+
+  void mem_copy_from(device_memory & /*mem*/, int /*y*/, int /*w*/, int /*h*/, int /*elem*/)
+  {
+  }
+
+  void mem_zero(device_memory &mem)
+  {
+    if (!mem.device_pointer) {
+      mem_alloc(mem);
+    }
+    memset(mem.host_pointer, 0, mem.memory_size());
+  }
+
+  void mem_free(device_memory &mem)
+  {
+    mem.device_pointer = 0;
+    mem.device_size = 0;
+  }
+
+  void const_copy_to(const char * /*name*/, void * /*host*/, size_t /*size*/)
+  {
+  }
+
+  bool load_kernels(const DeviceRequestedFeatures &requested_features)
+  {
+    return requested_features.use_volume && requested_features.max_nodes_group == 7;
+  }
+
+  void task_add(DeviceTask &task)
+  {
+    tasks.push_back(task);
+  }
+
+  void task_wait()
+  {
+    for (size_t i = 0; i < tasks.size(); i++) {
+      DeviceTask &task = tasks[i];
+      RenderTile tile;
+      while (task.acquire_tile(this, tile)) {
+        float value = tile.sample + 1000.0f * task.pass_type;
+        if (!task.film_passes.empty()) {
+          value += ((float *)task.film_passes[0].rgba_float)[tile.sample];
+        }
+        ((float *)tile.buffer)[tile.x] = value;
+        task.release_tile(tile);
+      }
+    }
+    tasks.clear();
+  }
+
+  void task_cancel()
+  {
+  }
+
+ protected:
+  vector<DeviceTask> tasks;
+};
+
+/* Tiles handed out by the client, task_id tiles for each task. */
+int num_acquired[4], num_released[4];
+device_ptr tile_buffer;
+RenderBuffers *tile_buffers;
+
+bool acquire_tile(Device * /*device*/, RenderTile &tile, int task_id)
+{
+  if (num_acquired[task_id] == task_id) {
+    return false;
+  }
+  tile.x = task_id * 10 + num_acquired[task_id];
+  tile.y = 0;
+  tile.w = 1;
+  tile.h = 1;
+  tile.sample = num_acquired[task_id] + 1;
+  tile.buffer = tile_buffer;
+  tile.buffers = tile_buffers;
+  num_acquired[task_id]++;
+  return true;
+}
+
+void release_tile(RenderTile &tile, int task_id)
+{
+  EXPECT_EQ(tile.buffers, tile_buffers);
+  num_released[task_id]++;
+}
+
+DeviceTask render_task(int task_id, int pass_type)
+{
+  DeviceTask task(DeviceTask::RENDER);
+  task.pass_type = pass_type;
+  task.buffer = tile_buffer;
+  task.acquire_tile = function_bind(&acquire_tile, _1, _2, task_id);
+  task.release_tile = function_bind(&release_tile, _1, task_id);
+  return task;
+}
+
+}  // namespace
+
+TEST(device_network, round_trip)
+{
+  TaskScheduler::init(2);
+
+  DeviceInfo info;
+  info.type = DEVICE_CPU;
+  Stats stats;
+  Profiler profiler;
+
+  pid_t server_pid = fork();
+  ASSERT_GE(server_pid, 0);
+  if (server_pid == 0) {
+    TestDevice server_device(info, stats, profiler);
+    server_device.server_run();
+    _exit(0);
+  }
+  /* Give the server time to start listening. */
+  sleep(1);
+
+  DeviceInfo network_info;
+  network_info.type = DEVICE_NETWORK;
+  Device *device = device_network_create(network_info, stats, profiler, "127.0.0.1");
+
+  DeviceRequestedFeatures requested_features;
+  requested_features.use_volume = true;
+  requested_features.max_nodes_group = 7;
+  EXPECT_TRUE(device->load_kernels(requested_features));
+
+  /* Large compressible buffers with the same content, the second one is
+   * copied from the first on the server. */
+  const size_t size = 4 << 20;
+  device_vector<float> a(device, "a", MEM_READ_ONLY);
+  device_vector<float> b(device, "b", MEM_READ_ONLY);
+  float *a_data = a.alloc(size);
+  float *b_data = b.alloc(size);
+  for (size_t i = 0; i < size; i++) {
+    a_data[i] = b_data[i] = (float)(i % 1000);
+  }
+  a.copy_to_device();
+  b.copy_to_device();
+
+  /* Round trip through a read-write buffer. */
+  device_vector<float> c(device, "c", MEM_READ_WRITE);
+  float *c_data = c.alloc(size);
+  for (size_t i = 0; i < size; i++) {
+    c_data[i] = (float)(i % 977);
+  }
+  c.copy_to_device();
+  memset(c_data, 0, sizeof(float) * size);
+  c.copy_from_device(0, size, 1);
+  bool c_equal = true;
+  for (size_t i = 0; i < size; i++) {
+    c_equal = c_equal && (c_data[i] == (float)(i % 977));
+  }
+  EXPECT_TRUE(c_equal);
+
+  device_vector<float> tiles(device, "tiles", MEM_READ_WRITE);
+  tiles.alloc(64);
+  tiles.zero_to_device();
+  tile_buffer = tiles.device_pointer;
+  tile_buffers = new RenderBuffers(device);
+
+  /* Two tasks added before one wait, the second with a film pass. */
+  DeviceTask task1 = render_task(1, 1);
+  DeviceTask task2 = render_task(2, 2);
+  task2.film_passes.push_back(DeviceFilmPass(3, c.device_pointer));
+  device->task_add(task1);
+  device->task_add(task2);
+  device->task_wait();
+  EXPECT_EQ(num_acquired[1], 1);
+  EXPECT_EQ(num_released[1], 1);
+  EXPECT_EQ(num_acquired[2], 2);
+  EXPECT_EQ(num_released[2], 2);
+
+  /* A task that gets no tiles. */
+  DeviceTask task0 = render_task(0, 0);
+  device->task_add(task0);
+  device->task_wait();
+  EXPECT_EQ(num_acquired[0], 0);
+  EXPECT_EQ(num_released[0], 0);
+
+  /* Content of freed buffers is cached on the server, a new buffer with the
+   * same content must be readable through its device pointer. */
+  device_vector<float> d(device, "d", MEM_READ_ONLY);
+  float *d_data = d.alloc(size);
+  for (size_t i = 0; i < size; i++) {
+    d_data[i] = (float)(i % 991) + 0.5f;
+  }
+  d.copy_to_device();
+  d.free();
+
+  device_vector<float> e(device, "e", MEM_READ_ONLY);
+  float *e_data = e.alloc(size);
+  for (size_t i = 0; i < size; i++) {
+    e_data[i] = (float)(i % 991) + 0.5f;
+  }
+  e.copy_to_device();
+
+  DeviceTask task3 = render_task(3, 4);
+  task3.film_passes.push_back(DeviceFilmPass(3, e.device_pointer));
+  device->task_add(task3);
+  device->task_wait();
+  EXPECT_EQ(num_released[3], 3);
+
+  tiles.copy_from_device(0, 64, 1);
+  EXPECT_EQ(tiles.data()[10], 1001.0f);
+  EXPECT_EQ(tiles.data()[20], 2001.0f + 1.0f);
+  EXPECT_EQ(tiles.data()[21], 2002.0f + 2.0f);
+  EXPECT_EQ(tiles.data()[30], 4001.0f + 1.5f);
+  EXPECT_EQ(tiles.data()[32], 4003.0f + 3.5f);
+
+  EXPECT_EQ(device->error_message(), "");
+
+  a.free();
+  b.free();
+  c.free();
+  e.free();
+  tiles.free();
+  delete tile_buffers;
+  delete device;
+
+  kill(server_pid, SIGTERM);
+  waitpid(server_pid, NULL, 0);
+
+  TaskScheduler::exit();
+}
+
+CCL_NAMESPACE_END
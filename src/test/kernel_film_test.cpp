@@ -0,0 +1,160 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "kernel/kernel_compat_cpu.h"
+#include "kernel/kernel_math.h"
+#include "kernel/kernel_types.h"
+#include "kernel/split/kernel_split_data.h"
+#include "kernel/kernel_globals.h"
+#include "kernel/kernel_color.h"
+#include "kernel/kernel_film.h"
+
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+/* Render buffer with combined, normal, diffuse color and depth passes. */
+const int width = 7;
+const int height = 3;
+const int pass_stride = 16;
+const int pass_combined = 0;
+const int pass_normal = 4;
+const int pass_diffuse_color = 8;
+const int pass_depth = 12;
+
+void film_test_init(KernelGlobals *kg, vector<float> &buffer)
+{
+  memset(&kg->__data, 0, sizeof(kg->__data));
+  KernelFilm &film = kg->__data.film;
+  film.exposure = 0.8f;
+  film.pass_flag = (1 << PASS_COMBINED) | (1 << PASS_NORMAL) | (1 << PASS_DEPTH);
+  film.light_pass_flag = (1 << (PASS_DIFFUSE_COLOR % 32));
+  film.pass_stride = pass_stride;
+  film.pass_combined = pass_combined;
+  film.pass_normal = pass_normal;
+  film.pass_diffuse_color = pass_diffuse_color;
+  film.pass_depth = pass_depth;
+  film.display_pass_stride = pass_combined;
+  film.display_pass_components = 4;
+  film.display_divide_pass_stride = -1;
+
+  buffer.resize(width * height * pass_stride);
+  for (size_t i = 0; i < buffer.size(); i++) {
+    buffer[i] = 0.25f + (i * 37 % 101) * 0.13f;
+  }
+}
+
+int film_test_components(int pass_type)
+{
+  switch (pass_type) {
+    case PASS_COMBINED:
+      return 4;
+    case PASS_NORMAL:
+    case PASS_DIFFUSE_COLOR:
+      return 3;
+    default:
+      return 1;
+  }
+}
+
+/* Convert the buffer one row at a time and one pixel at a time, and check
+ * that both give the same result up to rounding. */
+void expect_equal_conversion(KernelGlobals *kg,
+                             vector<float> &buffer,
+                             int pass_type,
+                             int pixel_size)
+{
+  const int components = film_test_components(pass_type);
+  const int full_width = width * pixel_size;
+  const int full_height = height * pixel_size;
+  const float sample_scale = 1.0f / 3.0f;
+
+  vector<float> row_result(full_width * full_height * components, -1.0f);
+  vector<float> pixel_result(full_width * full_height * components, -1.0f);
+
+  for (int y = 0; y < height; y++) {
+    kernel_film_convert_row_to_float(kg,
+                                     &row_result[0],
+                                     &buffer[0],
+                                     sample_scale,
+                                     pass_type,
+                                     0,
+                                     y,
+                                     width,
+                                     height,
+                                     0,
+                                     width,
+                                     full_width,
+                                     full_height,
+                                     pixel_size);
+
+    for (int x = 0; x < width; x++) {
+      kernel_film_convert_to_float(kg,
+                                   &pixel_result[0],
+                                   &buffer[0],
+                                   sample_scale,
+                                   pass_type,
+                                   x,
+                                   y,
+                                   height,
+                                   0,
+                                   width,
+                                   full_width,
+                                   full_height,
+                                   pixel_size);
+    }
+  }
+
+  for (size_t i = 0; i < row_result.size(); i++) {
+    EXPECT_FLOAT_EQ(row_result[i], pixel_result[i])
+        << "pass " << pass_type << ", pixel size " << pixel_size << ", index " << i;
+  }
+}
+
+}  // namespace
+
+TEST(kernel_film, convert_row_matches_convert_pixel)
+{
+  KernelGlobals *kg = new KernelGlobals();
+  vector<float> buffer;
+  film_test_init(kg, buffer);
+
+  const int pass_types[] = {PASS_COMBINED, PASS_NORMAL, PASS_DIFFUSE_COLOR, PASS_DEPTH};
+  const int divide_pass_strides[] = {-1, pass_diffuse_color};
+
+  for (int exposure = 0; exposure < 2; exposure++) {
+    for (int pass_alpha = 0; pass_alpha < 2; pass_alpha++) {
+      for (int divide = 0; divide < 2; divide++) {
+        kg->__data.film.use_display_exposure = exposure;
+        kg->__data.film.use_display_pass_alpha = pass_alpha;
+        kg->__data.film.display_divide_pass_stride = divide_pass_strides[divide];
+
+        for (size_t i = 0; i < sizeof(pass_types) / sizeof(*pass_types); i++) {
+          expect_equal_conversion(kg, buffer, pass_types[i], 1);
+          expect_equal_conversion(kg, buffer, pass_types[i], 2);
+        }
+      }
+    }
+  }
+
+  delete kg;
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MESH_TEST_UTIL_H__
+#define __MESH_TEST_UTIL_H__
+
+/* Meshes and task setup shared by the BVH and subdivision tests. */
+
+#include "render/mesh.h"
+#include "subd/subd_dice.h"
+#include "util/util_foreach.h"
+#include "util/util_task.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Vertices of a grid of resolution x resolution quads with unit size. The
+ * height varies per vertex by up to four times height_variation. */
+inline void test_add_grid_verts(Mesh *mesh, int resolution, float offset, float height_variation)
+{
+  for (int y = 0; y <= resolution; y++) {
+    for (int x = 0; x <= resolution; x++) {
+      const float height = height_variation * ((x * 7 + y * 13) % 5);
+      mesh->add_vertex(make_float3(x, y, offset + height));
+    }
+  }
+}
+
+/* Triangulated grid of resolution x resolution quads. */
+inline Mesh *test_create_grid_mesh(int resolution, float offset = 0.0f)
+{
+  Mesh *mesh = new Mesh();
+  mesh->reserve_mesh((resolution + 1) * (resolution + 1), resolution * resolution * 2);
+  test_add_grid_verts(mesh, resolution, offset, 0.1f);
+
+  const int stride = resolution + 1;
+  for (int y = 0; y < resolution; y++) {
+    for (int x = 0; x < resolution; x++) {
+      const int v = y * stride + x;
+      mesh->add_triangle(v, v + 1, v + stride + 1, 0, false);
+      mesh->add_triangle(v, v + stride + 1, v + stride, 0, false);
+    }
+  }
+
+  return mesh;
+}
+
+/* Flat linear subdivision grid of resolution x resolution quads, so that
+ * every patch is diced uniformly. */
+inline Mesh *test_create_subd_grid_mesh(int resolution, float dicing_rate)
+{
+  Mesh *mesh = new Mesh();
+  mesh->subdivision_type = Mesh::SUBDIVISION_LINEAR;
+
+  const int stride = resolution + 1;
+  mesh->reserve_mesh(stride * stride, 0);
+  mesh->reserve_subd_faces(resolution * resolution, 0, resolution * resolution * 4);
+  test_add_grid_verts(mesh, resolution, 0.0f, 0.0f);
+
+  for (int y = 0; y < resolution; y++) {
+    for (int x = 0; x < resolution; x++) {
+      const int v = y * stride + x;
+      int corners[4] = {v, v + 1, v + stride + 1, v + stride};
+      mesh->add_subd_face(corners, 4, 0, false);
+    }
+  }
+
+  mesh->subd_params = new SubdParams(mesh);
+  mesh->subd_params->dicing_rate = dicing_rate;
+
+  return mesh;
+}
+
+/* Run the tasks from one pool with a single worker thread, like the mesh
+ * manager does for BVH builds and tessellation, so that any pool used inside
+ * the tasks is nested in it. */
+inline void test_run_tasks_single_thread(const vector<TaskRunFunction> &tasks)
+{
+  TaskScheduler::init(1);
+
+  TaskPool pool;
+  foreach (const TaskRunFunction &task, tasks) {
+    pool.push(task);
+  }
+  pool.wait_work();
+
+  TaskScheduler::exit();
+}
+
+CCL_NAMESPACE_END
+
+#endif /* __MESH_TEST_UTIL_H__ */
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "render/jitter.h"
+
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+/* Check that the first num_points points have exactly one point in every
+ * elementary interval of area 1 / num_points. */
+bool is_stratified_02(const vector<uint> &points, int num_points)
+{
+  for (int xdivs = num_points; xdivs >= 1; xdivs /= 2) {
+    const int ydivs = num_points / xdivs;
+    vector<int> count(num_points, 0);
+
+    for (int i = 0; i < num_points; i++) {
+      const int xs = (int)(((uint64_t)points[2 * i + 0] * xdivs) >> 32);
+      const int ys = (int)(((uint64_t)points[2 * i + 1] * ydivs) >> 32);
+      if (++count[ys * xdivs + xs] > 1) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+TEST(progressive_multi_jitter_02, Stratified)
+{
+  const int size = 1024;
+  vector<uint> points(size * 2);
+
+  for (uint seed = 0; seed < 4; seed++) {
+    progressive_multi_jitter_02_generate_2D(points.data(), size, seed);
+
+    for (int num_points = 1; num_points <= size; num_points *= 2) {
+      EXPECT_TRUE(is_stratified_02(points, num_points))
+          << "seed " << seed << ", " << num_points << " points";
+    }
+  }
+}
+
+TEST(progressive_multi_jitter_02, Deterministic)
+{
+  const int size = 256;
+  vector<uint> a(size * 2), b(size * 2);
+
+  progressive_multi_jitter_02_generate_2D(a.data(), size, 17);
+  progressive_multi_jitter_02_generate_2D(b.data(), size, 17);
+
+  EXPECT_TRUE(a == b);
+}
+
+TEST(blue_noise_mask, Permutation)
+{
+  const int size = 32;
+  const int num_pixels = size * size;
+  vector<float> mask(num_pixels);
+  blue_noise_mask_generate(mask.data(), size, 0);
+
+  vector<int> count(num_pixels, 0);
+  for (int i = 0; i < num_pixels; i++) {
+    ASSERT_GE(mask[i], 0.0f);
+    ASSERT_LT(mask[i], 1.0f);
+    count[(int)(mask[i] * num_pixels)]++;
+  }
+  for (int i = 0; i < num_pixels; i++) {
+    EXPECT_EQ(count[i], 1);
+  }
+}
+
+TEST(blue_noise_mask, LowFrequencies)
+{
+  /* Averages over small blocks vary much less than for white noise. */
+  const int size = 32;
+  const int block = 4;
+  vector<float> mask(size * size);
+  blue_noise_mask_generate(mask.data(), size, 0);
+
+  double variance = 0.0;
+  for (int by = 0; by < size; by += block) {
+    for (int bx = 0; bx < size; bx += block) {
+      double mean = 0.0;
+      for (int y = 0; y < block; y++) {
+        for (int x = 0; x < block; x++) {
+          mean += mask[(by + y) * size + bx + x];
+        }
+      }
+      mean /= block * block;
+      variance += (mean - 0.5) * (mean - 0.5);
+    }
+  }
+  variance /= (size / block) * (size / block);
+
+  const double white_noise_variance = 1.0 / (12.0 * block * block);
+  EXPECT_LT(variance, 0.5 * white_noise_variance);
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include <limits.h>
+
+#include "render/mesh.h"
+#include "subd/subd_dice.h"
+#include "subd/subd_split.h"
+#include "util/util_foreach.h"
+
+#include "test/mesh_test_util.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+void tessellate(Mesh *mesh, int dice_task_min_verts)
+{
+  DiagSplit dsplit(*mesh->subd_params);
+  dsplit.dice_task_min_verts = dice_task_min_verts;
+  mesh->tessellate(&dsplit);
+}
+
+void expect_equal_tessellation(const Mesh *mesh, const Mesh *other)
+{
+  ASSERT_EQ(mesh->verts.size(), other->verts.size());
+  EXPECT_EQ(memcmp(mesh->verts.data(), other->verts.data(), sizeof(float3) * mesh->verts.size()),
+            0);
+  ASSERT_EQ(mesh->vert_patch_uv.size(), other->vert_patch_uv.size());
+  EXPECT_EQ(memcmp(mesh->vert_patch_uv.data(),
+                   other->vert_patch_uv.data(),
+                   sizeof(float2) * mesh->vert_patch_uv.size()),
+            0);
+  ASSERT_EQ(mesh->triangles.size(), other->triangles.size());
+  EXPECT_EQ(memcmp(mesh->triangles.data(),
+                   other->triangles.data(),
+                   sizeof(int) * mesh->triangles.size()),
+            0);
+  ASSERT_EQ(mesh->triangle_patch.size(), other->triangle_patch.size());
+  EXPECT_EQ(memcmp(mesh->triangle_patch.data(),
+                   other->triangle_patch.data(),
+                   sizeof(int) * mesh->triangle_patch.size()),
+            0);
+
+  int num_stitched_verts = 0;
+  for (int i = 0; i < mesh->verts.size(); i++) {
+    EXPECT_EQ(mesh->get_vert_stitching_key(i), other->get_vert_stitching_key(i));
+    num_stitched_verts += (mesh->get_vert_stitching_key(i) != -1);
+  }
+  EXPECT_GT(num_stitched_verts, 0);
+}
+
+}  // namespace
+
+TEST(subd_split, parallel_dicing_matches_serial)
+{
+  TaskScheduler::init(4);
+
+  const int resolution = 32;
+  const int num_segments = 8;
+
+  /* Dice the same mesh with and without the task pool. */
+  Mesh *serial = test_create_subd_grid_mesh(resolution, 1.0f / num_segments);
+  Mesh *parallel = test_create_subd_grid_mesh(resolution, 1.0f / num_segments);
+  tessellate(serial, INT_MAX);
+  tessellate(parallel, 0);
+
+  TaskScheduler::exit();
+
+  EXPECT_EQ(serial->num_triangles(), resolution * resolution * num_segments * num_segments * 2);
+  expect_equal_tessellation(serial, parallel);
+
+  delete serial;
+  delete parallel;
+}
+
+TEST(subd_split, multiple_meshes_single_thread)
+{
+  /* Meshes are tessellated from tasks of one pool like in the mesh manager,
+   * dicing waits on a pool nested inside those tasks. */
+  const int num_meshes = 3;
+  const int resolution = 32;
+  const int num_segments = 8;
+
+  vector<Mesh *> meshes;
+  vector<TaskRunFunction> tasks;
+  for (int i = 0; i < num_meshes; i++) {
+    Mesh *mesh = test_create_subd_grid_mesh(resolution, 1.0f / num_segments);
+    tasks.push_back(function_bind(&tessellate, mesh, 0));
+    meshes.push_back(mesh);
+  }
+  test_run_tasks_single_thread(tasks);
+
+  /* A mesh diced without the task pool gives the same result. */
+  Mesh *serial = test_create_subd_grid_mesh(resolution, 1.0f / num_segments);
+  tessellate(serial, INT_MAX);
+
+  foreach (Mesh *mesh, meshes) {
+    expect_equal_tessellation(serial, mesh);
+    delete mesh;
+  }
+  delete serial;
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "util/util_foreach.h"
+#include "util/util_system.h"
+#include "util/util_task.h"
+#include "util/util_time.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Micro-benchmark of the task scheduler: the same amount of work is split in
+ * many small tasks and handled with an increasing number of threads, both for
+ * tasks pushed from the main thread and for tasks pushed from worker threads.
+ * Timings are only printed, the tests check that all work was done. */
+
+namespace {
+
+const int num_tasks = 20000;
+const int task_iterations = 2000;
+
+void task_work(int *result)
+{
+  /* Some arithmetic the compiler can not optimize away. */
+  uint state = (uint)(size_t)result;
+  for (int i = 0; i < task_iterations; i++) {
+    state = state * 1664525u + 1013904223u;
+  }
+  *result = (int)(state & 1) + 1;
+}
+
+void task_split(TaskPool *pool, int *results, int begin, int end)
+{
+  while (end - begin > 1) {
+    const int middle = (begin + end) / 2;
+    pool->push(function_bind(task_split, pool, results, middle, end), true);
+    end = middle;
+  }
+  task_work(&results[begin]);
+}
+
+int count_results(const vector<int> &results)
+{
+  int num_done = 0;
+  for (size_t i = 0; i < results.size(); i++) {
+    num_done += (results[i] != 0) ? 1 : 0;
+  }
+  return num_done;
+}
+
+vector<int> benchmark_num_threads()
+{
+  vector<int> num_threads;
+  const int max_threads = system_cpu_thread_count();
+  for (int threads = 1; threads < max_threads; threads *= 2) {
+    num_threads.push_back(threads);
+  }
+  num_threads.push_back(max_threads);
+  return num_threads;
+}
+
+}  // namespace
+
+TEST(util_task_benchmark, flat)
+{
+  foreach (int threads, benchmark_num_threads()) {
+    vector<int> results(num_tasks, 0);
+
+    TaskScheduler::init(threads);
+    const double start_time = time_dt();
+    TaskPool pool;
+    for (int i = 0; i < num_tasks; ++i) {
+      pool.push(function_bind(task_work, &results[i]));
+    }
+    pool.wait_work();
+    const double time_total = time_dt() - start_time;
+    TaskScheduler::exit();
+
+    printf("flat:   %3d threads, %8.3f ms\n", threads, time_total * 1000.0);
+    EXPECT_EQ(count_results(results), num_tasks);
+  }
+}
+
+TEST(util_task_benchmark, nested)
+{
+  foreach (int threads, benchmark_num_threads()) {
+    vector<int> results(num_tasks, 0);
+
+    TaskScheduler::init(threads);
+    const double start_time = time_dt();
+    TaskPool pool;
+    pool.push(function_bind(task_split, &pool, &results[0], 0, num_tasks));
+    pool.wait_work();
+    const double time_total = time_dt() - start_time;
+    TaskScheduler::exit();
+
+    printf("nested: %3d threads, %8.3f ms\n", threads, time_total * 1000.0);
+    EXPECT_EQ(count_results(results), num_tasks);
+  }
+}
+
+CCL_NAMESPACE_END
@@ -16,7 +16,9 @@
 
 #include "testing/testing.h"
 
+#include "util/util_atomic.h"
 #include "util/util_task.h"
+#include "util/util_time.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -26,6 +28,36 @@ void task_run()
 {
 }
 
+void task_run_nested(TaskPool *pool, int depth)
+{
+  if (depth > 0) {
+    pool->push(function_bind(task_run_nested, pool, depth - 1));
+    pool->push(function_bind(task_run_nested, pool, depth - 1), true);
+  }
+}
+
+void task_run_inner_pool(int *num_handled)
+{
+  /* Pool waiting from inside a task of another pool, its entries are queued
+   * behind the remaining entries of the outer pool. */
+  TaskPool pool;
+  for (int i = 0; i < 10; ++i) {
+    pool.push(function_bind(task_run));
+  }
+  TaskPool::Summary summary;
+  pool.wait_work(&summary);
+  atomic_add_and_fetch_int32(num_handled, summary.num_tasks_handled);
+}
+
+void task_run_outer_pool(int *num_handled)
+{
+  TaskPool pool;
+  for (int i = 0; i < 4; ++i) {
+    pool.push(function_bind(task_run_inner_pool, num_handled));
+  }
+  pool.wait_work();
+}
+
 }  // namespace
 
 TEST(util_task, basic)
@@ -56,4 +88,33 @@ TEST(util_task, multiple_times)
   }
 }
 
+TEST(util_task, nested)
+{
+  /* Tasks pushed from worker threads go to their own queue and are stolen by
+   * the other threads, all of them still have to be handled by the pool. */
+  TaskScheduler::init(0);
+  TaskPool pool;
+  pool.push(function_bind(task_run_nested, &pool, 10));
+  TaskPool::Summary summary;
+  pool.wait_work(&summary);
+  TaskScheduler::exit();
+  EXPECT_EQ(summary.num_tasks_handled, (1 << 11) - 1);
+}
+
+TEST(util_task, nested_pools)
+{
+  /* Outer pool is waited on by the single worker thread, like the BVH builds
+   * of multiple meshes, so the worker has to find the entries of the inner
+   * pools behind the entries of the outer pool in its own queue. */
+  TaskScheduler::init(1);
+  TaskPool pool;
+  int num_handled = 0;
+  pool.push(function_bind(task_run_outer_pool, &num_handled));
+  while (!pool.finished()) {
+    time_sleep(0.001);
+  }
+  TaskScheduler::exit();
+  EXPECT_EQ(num_handled, 40);
+}
+
 CCL_NAMESPACE_END
@@ -0,0 +1,156 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "util/util_path.h"
+#include "util/util_texture_cache.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+const string test_filepath = "util_texture_cache_test.ctc";
+
+/* Image where every pixel stores its own coordinates. */
+vector<float> test_image(int width, int height)
+{
+  vector<float> pixels(width * height);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      pixels[y * width + x] = x + y * 1000.0f;
+    }
+  }
+  return pixels;
+}
+
+float tile_texel(TextureCacheTile *tile, int x, int y)
+{
+  return tile->texels<float>()[y * TEXTURE_CACHE_TILE_STRIDE + x];
+}
+
+}  // namespace
+
+TEST(util_texture_cache, levels)
+{
+  vector<float> pixels = test_image(200, 70);
+  ASSERT_TRUE(TextureCacheImage::write(
+      test_filepath, IMAGE_DATA_TYPE_FLOAT, EXTENSION_REPEAT, &pixels[0], 200, 70));
+
+  TextureCache cache;
+  TextureCacheImage image(&cache);
+  ASSERT_TRUE(image.open(test_filepath, IMAGE_DATA_TYPE_FLOAT, EXTENSION_REPEAT));
+  /* Opening with different settings must fail. */
+  TextureCacheImage other_image(&cache);
+  EXPECT_FALSE(other_image.open(test_filepath, IMAGE_DATA_TYPE_BYTE, EXTENSION_REPEAT));
+
+  /* 200x70 halved down to 1x1. */
+  ASSERT_EQ(image.num_levels(), 8);
+  EXPECT_EQ(image.level(0).tiles_x, 4);
+  EXPECT_EQ(image.level(0).tiles_y, 2);
+  EXPECT_EQ(image.level(1).width, 100);
+  EXPECT_EQ(image.level(1).height, 35);
+  EXPECT_EQ(image.level(7).width, 1);
+  EXPECT_EQ(image.level(7).height, 1);
+
+  path_remove(test_filepath);
+}
+
+TEST(util_texture_cache, borders)
+{
+  vector<float> pixels = test_image(100, 100);
+
+  ASSERT_TRUE(TextureCacheImage::write(
+      test_filepath, IMAGE_DATA_TYPE_FLOAT, EXTENSION_REPEAT, &pixels[0], 100, 100));
+  {
+    TextureCache cache;
+    TextureCacheImage image(&cache);
+    ASSERT_TRUE(image.open(test_filepath, IMAGE_DATA_TYPE_FLOAT, EXTENSION_REPEAT));
+
+    TextureCacheTile *tile = image.acquire_tile(0, 1, 0);
+    ASSERT_TRUE(tile != NULL);
+    EXPECT_EQ(tile_texel(tile, 0, 0), 64.0f);
+    EXPECT_EQ(tile_texel(tile, -1, 0), 63.0f);
+    /* Past the right edge of the image wraps around. */
+    EXPECT_EQ(tile_texel(tile, 36, 0), 0.0f);
+    EXPECT_EQ(tile_texel(tile, 0, -1), 64.0f + 99000.0f);
+    image.release_tile(tile);
+  }
+
+  ASSERT_TRUE(TextureCacheImage::write(
+      test_filepath, IMAGE_DATA_TYPE_FLOAT, EXTENSION_CLIP, &pixels[0], 100, 100));
+  {
+    TextureCache cache;
+    TextureCacheImage image(&cache);
+    ASSERT_TRUE(image.open(test_filepath, IMAGE_DATA_TYPE_FLOAT, EXTENSION_CLIP));
+
+    TextureCacheTile *tile = image.acquire_tile(0, 0, 0);
+    ASSERT_TRUE(tile != NULL);
+    EXPECT_EQ(tile_texel(tile, -1, 5), 0.0f);
+    EXPECT_EQ(tile_texel(tile, 64, 5), 5064.0f);
+    image.release_tile(tile);
+  }
+
+  ASSERT_TRUE(TextureCacheImage::write(
+      test_filepath, IMAGE_DATA_TYPE_FLOAT, EXTENSION_EXTEND, &pixels[0], 100, 100));
+  {
+    TextureCache cache;
+    TextureCacheImage image(&cache);
+    ASSERT_TRUE(image.open(test_filepath, IMAGE_DATA_TYPE_FLOAT, EXTENSION_EXTEND));
+
+    TextureCacheTile *tile = image.acquire_tile(0, 1, 1);
+    ASSERT_TRUE(tile != NULL);
+    EXPECT_EQ(tile_texel(tile, 36, 35), 99099.0f);
+    image.release_tile(tile);
+  }
+
+  path_remove(test_filepath);
+}
+
+TEST(util_texture_cache, eviction)
+{
+  vector<float> pixels = test_image(512, 512);
+  ASSERT_TRUE(TextureCacheImage::write(
+      test_filepath, IMAGE_DATA_TYPE_FLOAT, EXTENSION_REPEAT, &pixels[0], 512, 512));
+
+  const size_t tile_size = TEXTURE_CACHE_TILE_STRIDE * TEXTURE_CACHE_TILE_STRIDE * sizeof(float);
+
+  TextureCache cache;
+  cache.set_memory_limit(tile_size * 4);
+  TextureCacheImage image(&cache);
+  ASSERT_TRUE(image.open(test_filepath, IMAGE_DATA_TYPE_FLOAT, EXTENSION_REPEAT));
+
+  /* A tile in use is never evicted. */
+  TextureCacheTile *pinned = image.acquire_tile(0, 0, 0);
+  ASSERT_TRUE(pinned != NULL);
+
+  for (int y = 0; y < 8; y++) {
+    for (int x = 0; x < 8; x++) {
+      TextureCacheTile *tile = image.acquire_tile(0, x, y);
+      ASSERT_TRUE(tile != NULL);
+      EXPECT_EQ(tile_texel(tile, 0, 0), x * 64.0f + y * 64000.0f);
+      image.release_tile(tile);
+      EXPECT_LE(cache.memory_used(), tile_size * 4);
+    }
+  }
+
+  EXPECT_EQ(tile_texel(pinned, 1, 1), 1001.0f);
+  image.release_tile(pinned);
+
+  path_remove(test_filepath);
+}
+
+CCL_NAMESPACE_END
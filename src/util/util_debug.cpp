@@ -32,7 +32,9 @@ DebugFlags::CPU::CPU()
       sse3(true),
       sse2(true),
       bvh_layout(BVH_LAYOUT_DEFAULT),
-      split_kernel(false)
+      split_kernel(false),
+      split_kernel_size(64),
+      interleave_samples(false)
 {
   reset();
 }
@@ -70,7 +72,13 @@ void DebugFlags::CPU::reset()
     bvh_layout = BVH_LAYOUT_DEFAULT;
   }
 
-  split_kernel = false;
+  split_kernel = (getenv("CYCLES_CPU_SPLIT_KERNEL") != NULL);
+  split_kernel_size = 64;
+  char *size = getenv("CYCLES_CPU_SPLIT_KERNEL_SIZE");
+  if (size != NULL && atoi(size) > 0) {
+    split_kernel_size = atoi(size);
+  }
+  interleave_samples = (getenv("CYCLES_CPU_INTERLEAVE_SAMPLES") != NULL);
 }
 
 DebugFlags::CUDA::CUDA() : adaptive_compile(false), split_kernel(false)
@@ -153,7 +161,9 @@ std::ostream &operator<<(std::ostream &os, DebugFlagsConstRef debug_flags)
      << "  SSE3       : " << string_from_bool(debug_flags.cpu.sse3) << "\n"
      << "  SSE2       : " << string_from_bool(debug_flags.cpu.sse2) << "\n"
      << "  BVH layout : " << bvh_layout_name(debug_flags.cpu.bvh_layout) << "\n"
-     << "  Split      : " << string_from_bool(debug_flags.cpu.split_kernel) << "\n";
+     << "  Split      : " << string_from_bool(debug_flags.cpu.split_kernel) << "\n"
+     << "  Split size : " << debug_flags.cpu.split_kernel_size << "\n"
+     << "  Interleave : " << string_from_bool(debug_flags.cpu.interleave_samples) << "\n";
 
   os << "CUDA flags:\n"
      << "  Adaptive Compile : " << string_from_bool(debug_flags.cuda.adaptive_compile) << "\n";
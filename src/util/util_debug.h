@@ -80,8 +80,18 @@ class DebugFlags {
      */
     BVHLayout bvh_layout;
 
-    /* Whether split kernel is used */
+    /* Whether split kernel is used, in addition to DeviceInfo::use_split_kernel */
     bool split_kernel;
+
+    /* Number of path states each render thread keeps in flight with the
+     * split kernel. Every state carries its own ShaderData, so larger batches
+     * trade memory per thread for more coherent shader evaluation after
+     * sorting. */
+    int split_kernel_size;
+
+    /* Whether path tracing renders small blocks of pixels for multiple samples
+     * at a time, instead of one sample of the whole tile at a time. */
+    bool interleave_samples;
   };
 
   /* Descriptor of CUDA feature-set to be used. */
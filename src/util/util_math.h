@@ -738,6 +738,20 @@ ccl_device_inline uint find_first_set(uint x)
 #endif
 }
 
+ccl_device_inline uint reverse_integer_bits(uint x)
+{
+#if defined(__KERNEL_CUDA__) || defined(__KERNEL_OPTIX__)
+  return __brev(x);
+#else
+  /* Swap adjacent bits, pairs, nibbles, bytes and half words. */
+  x = ((x & 0xaaaaaaaau) >> 1) | ((x & 0x55555555u) << 1);
+  x = ((x & 0xccccccccu) >> 2) | ((x & 0x33333333u) << 2);
+  x = ((x & 0xf0f0f0f0u) >> 4) | ((x & 0x0f0f0f0fu) << 4);
+  x = ((x & 0xff00ff00u) >> 8) | ((x & 0x00ff00ffu) << 8);
+  return (x >> 16) | (x << 16);
+#endif
+}
+
 /* projections */
 ccl_device_inline float2 map_to_tube(const float3 co)
 {
@@ -15,13 +15,23 @@
  */
 
 #include "util/util_algorithm.h"
+#include "util/util_path.h"
 #include "util/util_profiling.h"
 #include "util/util_set.h"
 
 CCL_NAMESPACE_BEGIN
 
-Profiler::Profiler() : do_stop_worker(true), worker(NULL)
+Profiler::Profiler()
+    : do_stop_worker(true),
+      worker(NULL),
+      timeline_interval(0.0),
+      timeline_start(time_dt()),
+      bucket_start(0.0)
 {
+  /* Event counters have a fixed size, so the timeline buckets can be added
+   * before the first reset(). */
+  event_samples.assign(PROFILING_NUM_EVENTS, 0);
+  bucket_event_samples.assign(PROFILING_NUM_EVENTS, 0);
 }
 
 Profiler::~Profiler()
@@ -60,6 +70,10 @@ void Profiler::run()
         object_samples[cur_object]++;
       }
     }
+
+    if (use_timeline() && time_dt() - bucket_start >= timeline_interval) {
+      add_timeline_bucket();
+    }
     lock.unlock();
 
     /* Relative waits always overshoot a bit, so just waiting 1ms every
@@ -75,10 +89,20 @@ void Profiler::reset(int num_shaders, int num_objects)
 {
   bool running = (worker != NULL);
   if (running) {
-    stop();
+    stop_worker();
+
+    /* Flush the samples taken since the last bucket while the vectors still
+     * have the sizes they were accumulated with. */
+    if (use_timeline()) {
+      add_timeline_bucket();
+    }
   }
 
   /* Resize and clear the accumulation vectors. */
+  bucket_event_samples.assign(PROFILING_NUM_EVENTS, 0);
+  bucket_shader_samples.assign(num_shaders, 0);
+  bucket_object_samples.assign(num_objects, 0);
+
   shader_hits.assign(num_shaders, 0);
   object_hits.assign(num_objects, 0);
 
@@ -95,20 +119,30 @@ void Profiler::start()
 {
   assert(worker == NULL);
   do_stop_worker = false;
+  bucket_start = time_dt();
   worker = new thread(function_bind(&Profiler::run, this));
 }
 
 void Profiler::stop()
 {
   if (worker != NULL) {
-    do_stop_worker = true;
+    stop_worker();
 
-    worker->join();
-    delete worker;
-    worker = NULL;
+    if (use_timeline()) {
+      add_timeline_bucket();
+    }
   }
 }
 
+void Profiler::stop_worker()
+{
+  do_stop_worker = true;
+
+  worker->join();
+  delete worker;
+  worker = NULL;
+}
+
 void Profiler::add_state(ProfilingState *state)
 {
   thread_scoped_lock lock(mutex);
@@ -176,4 +210,187 @@ bool Profiler::get_object(int object, uint64_t &samples, uint64_t &hits)
   return true;
 }
 
+void Profiler::set_timeline_interval(double interval)
+{
+  timeline_interval = interval;
+}
+
+void Profiler::add_timeline_bucket()
+{
+  assert(event_samples.size() == PROFILING_NUM_EVENTS);
+  assert(bucket_shader_samples.size() == shader_samples.size());
+  assert(bucket_object_samples.size() == object_samples.size());
+
+  TimelineBucket bucket;
+  bucket.start = bucket_start - timeline_start;
+  bucket.end = time_dt() - timeline_start;
+  bucket_start = time_dt();
+
+  bool empty = true;
+  for (int i = 0; i < PROFILING_NUM_EVENTS; i++) {
+    bucket.event_samples[i] = event_samples[i] - bucket_event_samples[i];
+    bucket_event_samples[i] = event_samples[i];
+    empty &= (bucket.event_samples[i] == 0);
+  }
+  for (int i = 0; i < shader_samples.size(); i++) {
+    if (shader_samples[i] != bucket_shader_samples[i]) {
+      bucket.shader_samples.push_back(
+          std::make_pair(i, shader_samples[i] - bucket_shader_samples[i]));
+      bucket_shader_samples[i] = shader_samples[i];
+    }
+  }
+  for (int i = 0; i < object_samples.size(); i++) {
+    if (object_samples[i] != bucket_object_samples[i]) {
+      bucket.object_samples.push_back(
+          std::make_pair(i, object_samples[i] - bucket_object_samples[i]));
+      bucket_object_samples[i] = object_samples[i];
+    }
+  }
+
+  if (!empty) {
+    buckets.push_back(bucket);
+  }
+}
+
+void Profiler::add_interval(const string &name, const char *category, double start, double end)
+{
+  if (!use_timeline()) {
+    return;
+  }
+
+  thread_scoped_lock lock(timeline_mutex);
+
+  /* Map threads to small indices, used as thread IDs in the trace. */
+  const std::thread::id id = std::this_thread::get_id();
+  vector<std::thread::id>::iterator it = std::find(
+      timeline_threads.begin(), timeline_threads.end(), id);
+  const int thread_index = it - timeline_threads.begin();
+  if (it == timeline_threads.end()) {
+    timeline_threads.push_back(id);
+  }
+
+  TimelineInterval interval;
+  interval.name = name;
+  interval.category = category;
+  interval.start = start - timeline_start;
+  interval.end = end - timeline_start;
+  interval.thread_index = thread_index;
+  intervals.push_back(interval);
+}
+
+static string trace_escape(const string &str)
+{
+  string result;
+  foreach (char c, str) {
+    if (c == '"' || c == '\\') {
+      result += '\\';
+      result += c;
+    }
+    else if ((unsigned char)c < 0x20) {
+      result += string_printf("\\u%04x", c);
+    }
+    else {
+      result += c;
+    }
+  }
+  return result;
+}
+
+/* Counters are step functions, so every series of the previous bucket that no
+ * longer has samples is reset to zero. */
+static vector<pair<int, uint64_t>> trace_counter_samples(
+    const vector<pair<int, uint64_t>> &samples, const vector<pair<int, uint64_t>> &prev_samples)
+{
+  vector<pair<int, uint64_t>> result = samples;
+  set<int> indices;
+  for (size_t i = 0; i < samples.size(); i++) {
+    indices.insert(samples[i].first);
+  }
+  for (size_t i = 0; i < prev_samples.size(); i++) {
+    if (indices.find(prev_samples[i].first) == indices.end()) {
+      result.push_back(std::make_pair(prev_samples[i].first, (uint64_t)0));
+    }
+  }
+  return result;
+}
+
+/* Samples are taken every millisecond for every thread, so counts are
+ * written as milliseconds of thread time spent in each bucket. */
+static void trace_write_counter(FILE *f,
+                                const char *name,
+                                double time,
+                                const vector<pair<int, uint64_t>> &samples,
+                                const vector<string> &names)
+{
+  fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"ts\":%.0f,\"args\":{", name, time * 1e6);
+  bool first = true;
+  for (size_t i = 0; i < samples.size(); i++) {
+    const int index = samples[i].first;
+    const string label = (index < names.size()) ? names[index] : string_printf("%d", index);
+    fprintf(f,
+            "%s\"%s\":%llu",
+            first ? "" : ",",
+            trace_escape(label).c_str(),
+            (unsigned long long)samples[i].second);
+    first = false;
+  }
+  fprintf(f, "}}");
+}
+
+bool Profiler::write_trace(const string &filepath,
+                           const vector<string> &event_names,
+                           const vector<string> &shader_names,
+                           const vector<string> &object_names)
+{
+  assert(worker == NULL);
+
+  FILE *f = path_fopen(filepath, "w");
+  if (!f) {
+    return false;
+  }
+
+  fprintf(f, "{\"traceEvents\":[\n");
+  fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Cycles\"}}");
+
+  thread_scoped_lock lock(timeline_mutex);
+  foreach (const TimelineInterval &interval, intervals) {
+    fprintf(f,
+            ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+            "\"ts\":%.0f,\"dur\":%.0f}",
+            trace_escape(interval.name).c_str(),
+            interval.category,
+            interval.thread_index,
+            interval.start * 1e6,
+            (interval.end - interval.start) * 1e6);
+  }
+  lock.unlock();
+
+  vector<pair<int, uint64_t>> prev_shaders, prev_objects;
+  foreach (const TimelineBucket &bucket, buckets) {
+    vector<pair<int, uint64_t>> events;
+    for (int i = 0; i < PROFILING_NUM_EVENTS; i++) {
+      events.push_back(std::make_pair(i, bucket.event_samples[i]));
+    }
+    trace_write_counter(f, "Kernel events", bucket.start, events, event_names);
+
+    trace_write_counter(f,
+                        "Shaders",
+                        bucket.start,
+                        trace_counter_samples(bucket.shader_samples, prev_shaders),
+                        shader_names);
+    trace_write_counter(f,
+                        "Objects",
+                        bucket.start,
+                        trace_counter_samples(bucket.object_samples, prev_objects),
+                        object_names);
+
+    prev_shaders = bucket.shader_samples;
+    prev_objects = bucket.object_samples;
+  }
+
+  fprintf(f, "\n]}\n");
+  fclose(f);
+  return true;
+}
+
 CCL_NAMESPACE_END
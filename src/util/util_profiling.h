@@ -21,7 +21,9 @@
 
 #include "util/util_foreach.h"
 #include "util/util_map.h"
+#include "util/util_string.h"
 #include "util/util_thread.h"
+#include "util/util_time.h"
 #include "util/util_vector.h"
 
 CCL_NAMESPACE_BEGIN
@@ -105,8 +107,46 @@ class Profiler {
   bool get_shader(int shader, uint64_t &samples, uint64_t &hits);
   bool get_object(int object, uint64_t &samples, uint64_t &hits);
 
+  /* Timeline recording, for exporting a trace of the whole session.
+   * Sample counts are additionally stored in buckets of the given interval
+   * in seconds, and intervals such as tiles or scene update phases can be
+   * recorded from any thread. Disabled when the interval is zero. */
+  void set_timeline_interval(double interval);
+  bool use_timeline() const
+  {
+    return timeline_interval > 0.0;
+  }
+  void add_interval(const string &name, const char *category, double start, double end);
+
+  /* Write the timeline as a Chrome trace JSON file, viewable in
+   * chrome://tracing or Perfetto. Event, shader and object names are indexed
+   * by the same IDs as the samples. */
+  bool write_trace(const string &filepath,
+                   const vector<string> &event_names,
+                   const vector<string> &shader_names,
+                   const vector<string> &object_names);
+
  protected:
   void run();
+  void stop_worker();
+
+  /* Samples taken since the previous bucket, only non-zero counts of
+   * shaders and objects are stored. */
+  struct TimelineBucket {
+    double start, end;
+    uint64_t event_samples[PROFILING_NUM_EVENTS];
+    vector<pair<int, uint64_t>> shader_samples;
+    vector<pair<int, uint64_t>> object_samples;
+  };
+
+  struct TimelineInterval {
+    string name;
+    const char *category;
+    double start, end;
+    int thread_index;
+  };
+
+  void add_timeline_bucket();
 
   /* Tracks how often the worker was in each ProfilingEvent while sampling,
    * so multiplying the values by the sample frequency (currently 1ms)
@@ -127,6 +167,57 @@ class Profiler {
 
   thread_mutex mutex;
   vector<ProfilingState *> states;
+
+  double timeline_interval;
+  double timeline_start;
+  double bucket_start;
+  /* Sample counts at the start of the current bucket. */
+  vector<uint64_t> bucket_event_samples;
+  vector<uint64_t> bucket_shader_samples;
+  vector<uint64_t> bucket_object_samples;
+  vector<TimelineBucket> buckets;
+
+  thread_mutex timeline_mutex;
+  vector<TimelineInterval> intervals;
+  vector<std::thread::id> timeline_threads;
+};
+
+/* Records the phase of the scope as interval in the profiler timeline, the
+ * phase can be changed to record consecutive phases. */
+class ProfilingPhaseHelper {
+ public:
+  ProfilingPhaseHelper(Profiler &profiler, const char *category)
+      : profiler(profiler), category(category), start(0.0)
+  {
+  }
+
+  void set_phase(const char *phase)
+  {
+    end_phase();
+    if (profiler.use_timeline()) {
+      name = phase;
+      start = time_dt();
+    }
+  }
+
+  ~ProfilingPhaseHelper()
+  {
+    end_phase();
+  }
+
+ private:
+  void end_phase()
+  {
+    if (!name.empty()) {
+      profiler.add_interval(name, category, start, time_dt());
+      name.clear();
+    }
+  }
+
+  Profiler &profiler;
+  const char *category;
+  string name;
+  double start;
 };
 
 class ProfilingHelper {
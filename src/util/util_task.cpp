@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include "util/util_atomic.h"
 #include "util/util_foreach.h"
 #include "util/util_logging.h"
 #include "util/util_system.h"
@@ -71,26 +72,10 @@ void TaskPool::wait_work(Summary *stats)
   while (num != 0) {
     num_lock.unlock();
 
-    thread_scoped_lock queue_lock(TaskScheduler::queue_mutex);
-
     /* find task from this pool. if we get a task from another pool,
      * we can get into deadlock */
     TaskScheduler::Entry work_entry;
-    bool found_entry = false;
-    list<TaskScheduler::Entry>::iterator it;
-
-    for (it = TaskScheduler::queue.begin(); it != TaskScheduler::queue.end(); it++) {
-      TaskScheduler::Entry &entry = *it;
-
-      if (entry.pool == this) {
-        work_entry = entry;
-        found_entry = true;
-        TaskScheduler::queue.erase(it);
-        break;
-      }
-    }
-
-    queue_lock.unlock();
+    bool found_entry = TaskScheduler::pop_pool(this, work_entry);
 
     /* if found task, do it, otherwise wait until other tasks are done */
     if (found_entry) {
@@ -191,12 +176,19 @@ int TaskScheduler::users = 0;
 vector<thread *> TaskScheduler::threads;
 bool TaskScheduler::do_exit = false;
 
-list<TaskScheduler::Entry> TaskScheduler::queue;
-thread_mutex TaskScheduler::queue_mutex;
-thread_condition_variable TaskScheduler::queue_cond;
+vector<TaskScheduler::ThreadQueue *> TaskScheduler::queues;
+int TaskScheduler::num_queued = 0;
+int TaskScheduler::num_sleeping = 0;
+uint TaskScheduler::next_queue = 0;
+thread_mutex TaskScheduler::sleep_mutex;
+thread_condition_variable TaskScheduler::sleep_cond;
 
 namespace {
 
+/* Index of the queue owned by the current thread, -1 for threads which are
+ * not part of the scheduler. */
+thread_local int thread_queue_index = -1;
+
 /* Get number of processors on each of the available nodes. The result is sized
  * by the highest node index, and element corresponds to number of processors on
  * that node.
@@ -309,6 +301,25 @@ vector<int> distribute_threads_on_nodes(const int num_threads)
   return thread_nodes;
 }
 
+/* Order in which a thread steals from the other queues: first the threads on
+ * the same NUMA node, then all others. Both groups start right after the
+ * thread itself, so that not all threads hammer the same queue. */
+vector<int> compute_steal_order(const vector<int> &thread_nodes, const int thread_index)
+{
+  const int num_threads = thread_nodes.size();
+  vector<int> steal_order;
+  steal_order.reserve(num_threads - 1);
+  for (int same_node = 1; same_node >= 0; same_node--) {
+    for (int i = 1; i < num_threads; i++) {
+      const int other_index = (thread_index + i) % num_threads;
+      if ((thread_nodes[other_index] == thread_nodes[thread_index]) == (same_node == 1)) {
+        steal_order.push_back(other_index);
+      }
+    }
+  }
+  return steal_order;
+}
+
 }  // namespace
 
 void TaskScheduler::init(int num_threads)
@@ -331,6 +342,13 @@ void TaskScheduler::init(int num_threads)
   /* Compute distribution on NUMA nodes. */
   vector<int> thread_nodes = distribute_threads_on_nodes(num_threads);
 
+  /* Create queues of all threads before launching any of them. */
+  queues.resize(num_threads);
+  for (int thread_index = 0; thread_index < num_threads; ++thread_index) {
+    queues[thread_index] = new ThreadQueue();
+    queues[thread_index]->steal_order = compute_steal_order(thread_nodes, thread_index);
+  }
+
   /* Launch threads that will be waiting for work. */
   threads.resize(num_threads);
   for (int thread_index = 0; thread_index < num_threads; ++thread_index) {
@@ -346,10 +364,10 @@ void TaskScheduler::exit()
   if (users == 0) {
     VLOG(1) << "De-initializing thread pool of task scheduler.";
     /* stop all waiting threads */
-    TaskScheduler::queue_mutex.lock();
+    sleep_mutex.lock();
     do_exit = true;
-    TaskScheduler::queue_cond.notify_all();
-    TaskScheduler::queue_mutex.unlock();
+    sleep_cond.notify_all();
+    sleep_mutex.unlock();
 
     /* delete threads */
     foreach (thread *t, threads) {
@@ -357,6 +375,13 @@ void TaskScheduler::exit()
       delete t;
     }
     threads.clear();
+
+    /* delete queues, threads only exit once all of them are empty */
+    foreach (ThreadQueue *queue, queues) {
+      assert(queue->entries.empty());
+      delete queue;
+    }
+    queues.clear();
   }
 }
 
@@ -364,30 +389,111 @@ void TaskScheduler::free_memory()
 {
   assert(users == 0);
   threads.free_memory();
+  queues.free_memory();
 }
 
-bool TaskScheduler::thread_wait_pop(Entry &entry)
+bool TaskScheduler::pop(int queue_index, Entry &entry)
 {
-  thread_scoped_lock queue_lock(queue_mutex);
+  /* Own queue first. */
+  ThreadQueue *own_queue = queues[queue_index];
+  own_queue->lock.lock();
+  if (!own_queue->entries.empty()) {
+    entry = own_queue->entries.front();
+    own_queue->entries.pop_front();
+    own_queue->lock.unlock();
+    atomic_sub_and_fetch_int32(&num_queued, 1);
+    return true;
+  }
+  own_queue->lock.unlock();
+
+  /* Steal from other threads. */
+  foreach (int other_index, own_queue->steal_order) {
+    ThreadQueue *queue = queues[other_index];
+    queue->lock.lock();
+    if (!queue->entries.empty()) {
+      entry = queue->entries.back();
+      queue->entries.pop_back();
+      queue->lock.unlock();
+      atomic_sub_and_fetch_int32(&num_queued, 1);
+      return true;
+    }
+    queue->lock.unlock();
+  }
 
-  while (queue.empty() && !do_exit)
-    queue_cond.wait(queue_lock);
+  return false;
+}
 
-  if (queue.empty()) {
-    assert(do_exit);
-    return false;
+bool TaskScheduler::pop_pool(TaskPool *pool, Entry &entry)
+{
+  /* Scan the whole queues, a pool waiting from inside another task may have its
+   * entries queued behind entries of the outer pool. Own queue is scanned from
+   * the front like the worker pops it, other queues from the back. */
+  const int own_index = thread_queue_index;
+  const int num_queues = queues.size();
+
+  for (int i = 0; i < num_queues; i++) {
+    ThreadQueue *queue = queues[(own_index == -1) ? i : (own_index + i) % num_queues];
+    const bool is_own_queue = (own_index != -1 && i == 0);
+
+    thread_scoped_spin_lock queue_lock(queue->lock);
+    deque<Entry> &entries = queue->entries;
+
+    if (is_own_queue) {
+      for (deque<Entry>::iterator it = entries.begin(); it != entries.end(); it++) {
+        if (it->pool == pool) {
+          entry = *it;
+          entries.erase(it);
+          atomic_sub_and_fetch_int32(&num_queued, 1);
+          return true;
+        }
+      }
+    }
+    else {
+      for (deque<Entry>::reverse_iterator it = entries.rbegin(); it != entries.rend(); it++) {
+        if (it->pool == pool) {
+          entry = *it;
+          entries.erase(std::next(it).base());
+          atomic_sub_and_fetch_int32(&num_queued, 1);
+          return true;
+        }
+      }
+    }
   }
 
-  entry = queue.front();
-  queue.pop_front();
+  return false;
+}
 
-  return true;
+bool TaskScheduler::thread_wait_pop(Entry &entry)
+{
+  const int queue_index = thread_queue_index;
+
+  while (true) {
+    if (pop(queue_index, entry)) {
+      return true;
+    }
+
+    /* Nothing to do, sleep until new tasks are pushed. The counter of sleeping
+     * threads is updated before checking for queued entries, so that push()
+     * either sees this thread sleeping or this thread sees the new entry. */
+    thread_scoped_lock sleep_lock(sleep_mutex);
+    atomic_add_and_fetch_int32(&num_sleeping, 1);
+    while (atomic_add_and_fetch_int32(&num_queued, 0) == 0 && !do_exit) {
+      sleep_cond.wait(sleep_lock);
+    }
+    atomic_sub_and_fetch_int32(&num_sleeping, 1);
+
+    if (do_exit && atomic_add_and_fetch_int32(&num_queued, 0) == 0) {
+      return false;
+    }
+  }
 }
 
 void TaskScheduler::thread_run(int thread_id)
 {
   Entry entry;
 
+  thread_queue_index = thread_id - 1;
+
   /* todo: test affinity/denormal mask */
 
 #ifdef _WIN32
@@ -411,39 +517,56 @@ void TaskScheduler::push(Entry &entry, bool front)
 {
   entry.pool->num_increase();
 
+  /* Worker threads push to their own queue, so that nested tasks stay local.
+   * Other threads distribute their tasks over all queues. */
+  assert(!queues.empty());
+  int queue_index = thread_queue_index;
+  if (queue_index == -1) {
+    queue_index = atomic_fetch_and_add_uint32(&next_queue, 1) % queues.size();
+  }
+
   /* add entry to queue */
-  TaskScheduler::queue_mutex.lock();
+  ThreadQueue *queue = queues[queue_index];
+  queue->lock.lock();
   if (front)
-    TaskScheduler::queue.push_front(entry);
+    queue->entries.push_front(entry);
   else
-    TaskScheduler::queue.push_back(entry);
+    queue->entries.push_back(entry);
+  queue->lock.unlock();
 
-  TaskScheduler::queue_cond.notify_one();
-  TaskScheduler::queue_mutex.unlock();
+  atomic_add_and_fetch_int32(&num_queued, 1);
+
+  /* wake up a sleeping thread */
+  if (atomic_add_and_fetch_int32(&num_sleeping, 0) != 0) {
+    thread_scoped_lock sleep_lock(sleep_mutex);
+    sleep_cond.notify_one();
+  }
 }
 
 void TaskScheduler::clear(TaskPool *pool)
 {
-  thread_scoped_lock queue_lock(TaskScheduler::queue_mutex);
-
-  /* erase all tasks from this pool from the queue */
-  list<Entry>::iterator it = queue.begin();
   int done = 0;
 
-  while (it != queue.end()) {
-    Entry &entry = *it;
+  /* erase all tasks from this pool from the queues */
+  foreach (ThreadQueue *queue, queues) {
+    thread_scoped_spin_lock queue_lock(queue->lock);
 
-    if (entry.pool == pool) {
-      done++;
-      delete entry.task;
+    deque<Entry>::iterator it = queue->entries.begin();
+    while (it != queue->entries.end()) {
+      Entry &entry = *it;
 
-      it = queue.erase(it);
+      if (entry.pool == pool) {
+        done++;
+        delete entry.task;
+
+        it = queue->entries.erase(it);
+      }
+      else
+        it++;
     }
-    else
-      it++;
   }
 
-  queue_lock.unlock();
+  atomic_sub_and_fetch_int32(&num_queued, done);
 
   /* notify done */
   pool->num_decrease(done);
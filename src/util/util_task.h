@@ -17,6 +17,7 @@
 #ifndef __UTIL_TASK_H__
 #define __UTIL_TASK_H__
 
+#include "util/util_deque.h"
 #include "util/util_list.h"
 #include "util/util_string.h"
 #include "util/util_thread.h"
@@ -122,8 +123,11 @@ class TaskPool {
 
 /* Task Scheduler
  *
- * Central scheduler that holds running threads ready to execute tasks. A singe
- * queue holds the task from all pools. */
+ * Central scheduler that holds running threads ready to execute tasks. Every
+ * worker thread has its own queue of tasks, tasks pushed from a worker thread
+ * go to its own queue and tasks pushed from other threads are distributed
+ * over the queues. Threads that run out of work steal from the other queues,
+ * preferring threads on the same NUMA node. */
 
 class TaskScheduler {
  public:
@@ -151,18 +155,36 @@ class TaskScheduler {
     TaskPool *pool;
   };
 
+  /* Queue owned by one worker thread. The owner pops entries from the front,
+   * other threads steal from the back. */
+  struct ThreadQueue {
+    thread_spin_lock lock;
+    deque<Entry> entries;
+
+    /* Indices of the other queues, in the order to steal from them. Queues of
+     * threads on the same NUMA node come first. */
+    vector<int> steal_order;
+  };
+
   static thread_mutex mutex;
   static int users;
   static vector<thread *> threads;
+  static vector<ThreadQueue *> queues;
   static bool do_exit;
 
-  static list<Entry> queue;
-  static thread_mutex queue_mutex;
-  static thread_condition_variable queue_cond;
+  /* Total number of entries in all queues, and number of threads waiting for
+   * new entries to be pushed. */
+  static int num_queued;
+  static int num_sleeping;
+  static uint next_queue;
+  static thread_mutex sleep_mutex;
+  static thread_condition_variable sleep_cond;
 
   static void thread_run(int thread_id);
   static bool thread_wait_pop(Entry &entry);
 
+  static bool pop(int queue_index, Entry &entry);
+  static bool pop_pool(TaskPool *pool, Entry &entry);
   static void push(Entry &entry, bool front);
   static void clear(TaskPool *pool);
 };
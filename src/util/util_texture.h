@@ -97,6 +97,9 @@ typedef struct TextureInfo {
   uint interpolation, extension;
   /* Dimensions. */
   uint width, height, depth;
+  /* Tiled mip-mapped image in the CPU texture cache, 0 if the image is
+   * fully loaded in data. */
+  uint64_t cache;
 } TextureInfo;
 
 CCL_NAMESPACE_END
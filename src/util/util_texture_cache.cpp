@@ -0,0 +1,530 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <utility>
+
+#include "util/util_algorithm.h"
+#include "util/util_aligned_malloc.h"
+#include "util/util_atomic.h"
+#include "util/util_foreach.h"
+#include "util/util_image.h"
+#include "util/util_logging.h"
+#include "util/util_path.h"
+#include "util/util_texture_cache.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+const char texture_cache_magic[4] = {'C', 'T', 'C', '1'};
+
+struct TextureCacheFileHeader {
+  char magic[4];
+  uint type;
+  uint extension;
+  uint width;
+  uint height;
+  uint tile_size;
+  uint tile_border;
+  uint texel_size;
+};
+
+size_t texture_cache_texel_size(ImageDataType type)
+{
+  switch (type) {
+    case IMAGE_DATA_TYPE_FLOAT4:
+      return sizeof(float) * 4;
+    case IMAGE_DATA_TYPE_BYTE4:
+      return sizeof(uchar) * 4;
+    case IMAGE_DATA_TYPE_HALF4:
+      return sizeof(half) * 4;
+    case IMAGE_DATA_TYPE_FLOAT:
+      return sizeof(float);
+    case IMAGE_DATA_TYPE_BYTE:
+      return sizeof(uchar);
+    case IMAGE_DATA_TYPE_HALF:
+      return sizeof(half);
+    case IMAGE_DATA_TYPE_USHORT4:
+      return sizeof(uint16_t) * 4;
+    case IMAGE_DATA_TYPE_USHORT:
+      return sizeof(uint16_t);
+    default:
+      return 0;
+  }
+}
+
+void texture_cache_compute_levels(int width, int height, vector<TextureCacheImage::Level> &levels)
+{
+  int first_tile = 0;
+  levels.clear();
+  while (true) {
+    TextureCacheImage::Level level;
+    level.width = width;
+    level.height = height;
+    level.tiles_x = divide_up(width, TEXTURE_CACHE_TILE_SIZE);
+    level.tiles_y = divide_up(height, TEXTURE_CACHE_TILE_SIZE);
+    level.first_tile = first_tile;
+    levels.push_back(level);
+
+    first_tile += level.tiles_x * level.tiles_y;
+    if (width == 1 && height == 1) {
+      break;
+    }
+    width = max(1, width / 2);
+    height = max(1, height / 2);
+  }
+}
+
+bool texture_cache_seek(FILE *file, size_t offset)
+{
+#ifdef _WIN32
+  return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+#else
+  return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+/* Write all tiles of one mip level, filling the borders according to the
+ * extension type. */
+template<typename T>
+bool texture_cache_write_level(FILE *file,
+                               const T *pixels,
+                               const int components,
+                               const TextureCacheImage::Level &level,
+                               const ExtensionType extension)
+{
+  const int stride = TEXTURE_CACHE_TILE_STRIDE;
+  vector<T> tile(stride * stride * components);
+
+  for (int tile_y = 0; tile_y < level.tiles_y; tile_y++) {
+    for (int tile_x = 0; tile_x < level.tiles_x; tile_x++) {
+      for (int y = 0; y < stride; y++) {
+        for (int x = 0; x < stride; x++) {
+          int px = tile_x * TEXTURE_CACHE_TILE_SIZE + x - TEXTURE_CACHE_TILE_BORDER;
+          int py = tile_y * TEXTURE_CACHE_TILE_SIZE + y - TEXTURE_CACHE_TILE_BORDER;
+          T *texel = &tile[(y * stride + x) * components];
+
+          if (extension == EXTENSION_REPEAT) {
+            px = (px % level.width + level.width) % level.width;
+            py = (py % level.height + level.height) % level.height;
+          }
+          else if (extension == EXTENSION_CLIP &&
+                   (px < 0 || py < 0 || px >= level.width || py >= level.height)) {
+            memset(texel, 0, sizeof(T) * components);
+            continue;
+          }
+          else {
+            px = clamp(px, 0, level.width - 1);
+            py = clamp(py, 0, level.height - 1);
+          }
+
+          memcpy(texel,
+                 &pixels[((size_t)py * level.width + px) * components],
+                 sizeof(T) * components);
+        }
+      }
+
+      if (fwrite(&tile[0], sizeof(T), tile.size(), file) != tile.size()) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+/* Box filter a level down to the next one. */
+template<typename T>
+void texture_cache_downsample(const T *pixels,
+                              const int components,
+                              const TextureCacheImage::Level &level,
+                              const TextureCacheImage::Level &next_level,
+                              vector<T> &next_pixels)
+{
+  next_pixels.resize((size_t)next_level.width * next_level.height * components);
+
+  for (int y = 0; y < next_level.height; y++) {
+    for (int x = 0; x < next_level.width; x++) {
+      const int x0 = min(x * 2, level.width - 1), x1 = min(x * 2 + 1, level.width - 1);
+      const int y0 = min(y * 2, level.height - 1), y1 = min(y * 2 + 1, level.height - 1);
+
+      for (int c = 0; c < components; c++) {
+        const float sum =
+            util_image_cast_to_float(pixels[((size_t)y0 * level.width + x0) * components + c]) +
+            util_image_cast_to_float(pixels[((size_t)y0 * level.width + x1) * components + c]) +
+            util_image_cast_to_float(pixels[((size_t)y1 * level.width + x0) * components + c]) +
+            util_image_cast_to_float(pixels[((size_t)y1 * level.width + x1) * components + c]);
+        next_pixels[((size_t)y * next_level.width + x) * components + c] =
+            util_image_cast_from_float<T>(sum * 0.25f);
+      }
+    }
+  }
+}
+
+template<typename T>
+bool texture_cache_write_levels(FILE *file,
+                                const T *pixels,
+                                const int components,
+                                const vector<TextureCacheImage::Level> &levels,
+                                const ExtensionType extension)
+{
+  vector<T> level_pixels, next_pixels;
+
+  for (size_t i = 0; i < levels.size(); i++) {
+    if (!texture_cache_write_level(file, pixels, components, levels[i], extension)) {
+      return false;
+    }
+
+    if (i + 1 < levels.size()) {
+      texture_cache_downsample(pixels, components, levels[i], levels[i + 1], next_pixels);
+      level_pixels.swap(next_pixels);
+      pixels = &level_pixels[0];
+    }
+  }
+
+  return true;
+}
+
+}  // namespace
+
+/* Texture Cache Image */
+
+TextureCacheImage::TextureCacheImage(TextureCache *cache)
+    : cache(cache), texel_size(0), file(NULL), data_offset(0)
+{
+}
+
+TextureCacheImage::~TextureCacheImage()
+{
+  cache->remove_image(this);
+
+  if (file) {
+    fclose(file);
+  }
+}
+
+bool TextureCacheImage::write(const string &filepath,
+                              ImageDataType type,
+                              ExtensionType extension,
+                              const void *pixels,
+                              int width,
+                              int height)
+{
+  TextureCacheFileHeader header;
+  memcpy(header.magic, texture_cache_magic, sizeof(header.magic));
+  header.type = type;
+  header.extension = extension;
+  header.width = width;
+  header.height = height;
+  header.tile_size = TEXTURE_CACHE_TILE_SIZE;
+  header.tile_border = TEXTURE_CACHE_TILE_BORDER;
+  header.texel_size = texture_cache_texel_size(type);
+
+  if (header.texel_size == 0 || width <= 0 || height <= 0) {
+    return false;
+  }
+
+  vector<Level> levels;
+  texture_cache_compute_levels(width, height, levels);
+
+  /* Write to a temporary file first, so that an interrupted conversion never
+   * leaves a broken cache file behind. */
+  path_create_directories(filepath);
+  const string temp_filepath = filepath + ".tmp";
+  FILE *f = path_fopen(temp_filepath, "wb");
+  if (!f) {
+    return false;
+  }
+
+  bool success = fwrite(&header, sizeof(header), 1, f) == 1;
+
+  if (success) {
+    switch (type) {
+      case IMAGE_DATA_TYPE_FLOAT4:
+      case IMAGE_DATA_TYPE_FLOAT:
+        success = texture_cache_write_levels(
+            f, (const float *)pixels, header.texel_size / sizeof(float), levels, extension);
+        break;
+      case IMAGE_DATA_TYPE_BYTE4:
+      case IMAGE_DATA_TYPE_BYTE:
+        success = texture_cache_write_levels(
+            f, (const uchar *)pixels, header.texel_size / sizeof(uchar), levels, extension);
+        break;
+      case IMAGE_DATA_TYPE_HALF4:
+      case IMAGE_DATA_TYPE_HALF:
+        success = texture_cache_write_levels(
+            f, (const half *)pixels, header.texel_size / sizeof(half), levels, extension);
+        break;
+      case IMAGE_DATA_TYPE_USHORT4:
+      case IMAGE_DATA_TYPE_USHORT:
+        success = texture_cache_write_levels(
+            f, (const uint16_t *)pixels, header.texel_size / sizeof(uint16_t), levels, extension);
+        break;
+      default:
+        success = false;
+        break;
+    }
+  }
+
+  success = (fclose(f) == 0) && success;
+
+  if (!success) {
+    path_remove(temp_filepath);
+    return false;
+  }
+
+  path_remove(filepath);
+  if (rename(temp_filepath.c_str(), filepath.c_str()) != 0) {
+    path_remove(temp_filepath);
+    return false;
+  }
+
+  return true;
+}
+
+bool TextureCacheImage::open(const string &filepath, ImageDataType type, ExtensionType extension)
+{
+  assert(file == NULL);
+
+  FILE *f = path_fopen(filepath, "rb");
+  if (!f) {
+    return false;
+  }
+
+  TextureCacheFileHeader header;
+  if (fread(&header, sizeof(header), 1, f) != 1 ||
+      memcmp(header.magic, texture_cache_magic, sizeof(header.magic)) != 0 ||
+      header.type != (uint)type || header.extension != (uint)extension ||
+      header.tile_size != TEXTURE_CACHE_TILE_SIZE ||
+      header.tile_border != TEXTURE_CACHE_TILE_BORDER ||
+      header.texel_size != texture_cache_texel_size(type)) {
+    fclose(f);
+    return false;
+  }
+
+  texture_cache_compute_levels(header.width, header.height, levels);
+
+  /* Check that the file is complete. */
+  const Level &last_level = levels.back();
+  const size_t num_tiles = last_level.first_tile + last_level.tiles_x * last_level.tiles_y;
+  const size_t tile_size = TEXTURE_CACHE_TILE_STRIDE * TEXTURE_CACHE_TILE_STRIDE *
+                           header.texel_size;
+  if (path_file_size(filepath) != sizeof(header) + num_tiles * tile_size) {
+    fclose(f);
+    levels.clear();
+    return false;
+  }
+
+  file = f;
+  data_offset = sizeof(header);
+  texel_size = header.texel_size;
+  tiles.resize(num_tiles, NULL);
+
+  return true;
+}
+
+TextureCacheTile *TextureCacheImage::read_tile(int index)
+{
+  const size_t size = TEXTURE_CACHE_TILE_STRIDE * TEXTURE_CACHE_TILE_STRIDE * texel_size;
+  void *data = util_aligned_malloc(size, 16);
+
+  bool success;
+  {
+    thread_scoped_lock file_lock(file_mutex);
+    success = texture_cache_seek(file, data_offset + index * size) &&
+              fread(data, size, 1, file) == 1;
+  }
+
+  if (!success) {
+    VLOG(1) << "Failed to read tile " << index << " from texture cache file.";
+    util_aligned_free(data);
+    return NULL;
+  }
+
+  TextureCacheTile *tile = new TextureCacheTile();
+  tile->data = data;
+  tile->size = size;
+  tile->users = 0;
+  tile->last_used = 0;
+  tile->image = this;
+  tile->index = index;
+  return tile;
+}
+
+TextureCacheTile *TextureCacheImage::acquire_tile(int level, int tile_x, int tile_y)
+{
+  const int index = levels[level].first_tile + tile_y * levels[level].tiles_x + tile_x;
+  thread_spin_lock &lock = tile_locks[index % num_tile_locks];
+  const uint now = cache->clock.load(std::memory_order_relaxed);
+
+  lock.lock();
+  TextureCacheTile *tile = tiles[index];
+  if (tile) {
+    atomic_add_and_fetch_int32(&tile->users, 1);
+    tile->last_used.store(now, std::memory_order_relaxed);
+    lock.unlock();
+    return tile;
+  }
+  lock.unlock();
+
+  /* Read outside of the lock, another thread might read the same tile in the
+   * meantime in which case the first one wins. */
+  TextureCacheTile *new_tile = read_tile(index);
+  if (new_tile == NULL) {
+    return NULL;
+  }
+
+  lock.lock();
+  tile = tiles[index];
+  if (tile == NULL) {
+    tile = tiles[index] = new_tile;
+  }
+  atomic_add_and_fetch_int32(&tile->users, 1);
+  tile->last_used.store(now, std::memory_order_relaxed);
+  lock.unlock();
+
+  if (tile == new_tile) {
+    cache->add_tile(tile);
+  }
+  else {
+    util_aligned_free(new_tile->data);
+    delete new_tile;
+  }
+
+  return tile;
+}
+
+void TextureCacheImage::release_tile(TextureCacheTile *tile)
+{
+  atomic_sub_and_fetch_int32(&tile->users, 1);
+}
+
+/* Texture Cache */
+
+TextureCache::TextureCache() : memory_limit(0), memory_size(0), clock(0)
+{
+}
+
+TextureCache::~TextureCache()
+{
+  /* All images must have been removed already. */
+  assert(resident_tiles.empty());
+}
+
+void TextureCache::set_memory_limit(size_t limit)
+{
+  thread_scoped_lock lock(mutex);
+  memory_limit = limit;
+  evict();
+}
+
+size_t TextureCache::memory_used()
+{
+  thread_scoped_lock lock(mutex);
+  return memory_size;
+}
+
+void TextureCache::add_tile(TextureCacheTile *tile)
+{
+  thread_scoped_lock lock(mutex);
+  resident_tiles.push_back(tile);
+  memory_size += tile->size;
+  clock++;
+  evict();
+}
+
+typedef std::pair<uint, TextureCacheTile *> TextureCacheTileUse;
+
+static bool texture_cache_tile_used_before(const TextureCacheTileUse &a,
+                                           const TextureCacheTileUse &b)
+{
+  return a.first < b.first;
+}
+
+void TextureCache::evict()
+{
+  if (memory_limit == 0 || memory_size <= memory_limit) {
+    return;
+  }
+
+  /* Evict more than needed, so that sorting the tiles is not repeated for
+   * every tile read once the cache is full. */
+  const size_t target_size = memory_limit - memory_limit / 8;
+
+  /* Lookups keep updating the last use while we sort, so sort a snapshot. */
+  vector<TextureCacheTileUse> tiles_by_use;
+  tiles_by_use.reserve(resident_tiles.size());
+  foreach (TextureCacheTile *tile, resident_tiles) {
+    tiles_by_use.push_back(
+        TextureCacheTileUse(tile->last_used.load(std::memory_order_relaxed), tile));
+  }
+  sort(tiles_by_use.begin(), tiles_by_use.end(), texture_cache_tile_used_before);
+
+  size_t num_kept = 0;
+  for (size_t i = 0; i < tiles_by_use.size(); i++) {
+    TextureCacheTile *tile = tiles_by_use[i].second;
+
+    if (memory_size > target_size) {
+      TextureCacheImage *image = tile->image;
+      thread_spin_lock &tile_lock = image->tile_locks[tile->index % image->num_tile_locks];
+
+      tile_lock.lock();
+      const bool in_use = (tile->users != 0);
+      if (!in_use) {
+        image->tiles[tile->index] = NULL;
+      }
+      tile_lock.unlock();
+
+      if (!in_use) {
+        memory_size -= tile->size;
+        util_aligned_free(tile->data);
+        delete tile;
+        continue;
+      }
+    }
+
+    resident_tiles[num_kept++] = tile;
+  }
+  resident_tiles.resize(num_kept);
+
+  VLOG(2) << "Texture cache evicted tiles, " << string_human_readable_size(memory_size)
+          << " in use.";
+}
+
+void TextureCache::remove_image(TextureCacheImage *image)
+{
+  thread_scoped_lock lock(mutex);
+
+  size_t num_kept = 0;
+  for (size_t i = 0; i < resident_tiles.size(); i++) {
+    TextureCacheTile *tile = resident_tiles[i];
+
+    if (tile->image == image) {
+      assert(tile->users == 0);
+      image->tiles[tile->index] = NULL;
+      memory_size -= tile->size;
+      util_aligned_free(tile->data);
+      delete tile;
+      continue;
+    }
+
+    resident_tiles[num_kept++] = tile;
+  }
+  resident_tiles.resize(num_kept);
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2011-2020 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __UTIL_TEXTURE_CACHE_H__
+#define __UTIL_TEXTURE_CACHE_H__
+
+#include <atomic>
+#include <stdio.h>
+
+#include "util/util_string.h"
+#include "util/util_texture.h"
+#include "util/util_thread.h"
+#include "util/util_types.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Texture Cache
+ *
+ * Images are converted once to a file holding their mip pyramid split in
+ * square tiles. When rendering on the CPU, tiles are read from that file
+ * the first time the kernel needs them and kept in memory until the cache
+ * runs over its memory budget, at which point the least recently used tiles
+ * are dropped again.
+ *
+ * Every tile is stored with a border of one texel on each side, filled
+ * according to the extension type of the image, so that bilinear lookups
+ * never need more than one tile. */
+
+#define TEXTURE_CACHE_TILE_SIZE 64
+#define TEXTURE_CACHE_TILE_BORDER 1
+#define TEXTURE_CACHE_TILE_STRIDE (TEXTURE_CACHE_TILE_SIZE + 2 * TEXTURE_CACHE_TILE_BORDER)
+
+class TextureCache;
+class TextureCacheImage;
+
+class TextureCacheTile {
+ public:
+  /* Texels of the tile including the border, TEXTURE_CACHE_TILE_STRIDE
+   * texels per row. */
+  void *data;
+  size_t size;
+
+  /* Number of lookups currently reading from the tile, it can only be freed
+   * when zero. */
+  int users;
+  /* Cache clock at the last lookup, for least recently used eviction.
+   * Written by lookups without holding the cache mutex. */
+  std::atomic<uint> last_used;
+
+  TextureCacheImage *image;
+  int index;
+
+  /* Texel (0, 0) of the tile, border texels are at negative offsets. */
+  template<typename T> const T *texels() const
+  {
+    return (const T *)data + TEXTURE_CACHE_TILE_BORDER * TEXTURE_CACHE_TILE_STRIDE +
+           TEXTURE_CACHE_TILE_BORDER;
+  }
+};
+
+class TextureCacheImage {
+ public:
+  struct Level {
+    int width, height;
+    int tiles_x, tiles_y;
+    /* Index of the first tile of this level. */
+    int first_tile;
+  };
+
+  TextureCacheImage(TextureCache *cache);
+  ~TextureCacheImage();
+
+  /* Convert pixels in the kernel storage format of the given type to a cache
+   * file. Pixel rows are stored bottom to top like in the device textures. */
+  static bool write(const string &filepath,
+                    ImageDataType type,
+                    ExtensionType extension,
+                    const void *pixels,
+                    int width,
+                    int height);
+
+  bool open(const string &filepath, ImageDataType type, ExtensionType extension);
+
+  int num_levels() const
+  {
+    return levels.size();
+  }
+
+  const Level &level(int index) const
+  {
+    return levels[index];
+  }
+
+  /* Get tile of a mip level, reading it from disk if it is not in memory. The
+   * tile has to be released after use. Returns NULL if reading failed. */
+  TextureCacheTile *acquire_tile(int level, int tile_x, int tile_y);
+  void release_tile(TextureCacheTile *tile);
+
+ protected:
+  friend class TextureCache;
+
+  TextureCacheTile *read_tile(int index);
+
+  TextureCache *cache;
+  vector<Level> levels;
+  size_t texel_size;
+
+  /* Resident tiles of all levels, NULL if not loaded. */
+  vector<TextureCacheTile *> tiles;
+  static const int num_tile_locks = 16;
+  thread_spin_lock tile_locks[num_tile_locks];
+
+  FILE *file;
+  size_t data_offset;
+  thread_mutex file_mutex;
+};
+
+class TextureCache {
+ public:
+  TextureCache();
+  ~TextureCache();
+
+  void set_memory_limit(size_t limit);
+  size_t memory_used();
+
+  /* Drop all tiles of an image from the cache, before deleting it. */
+  void remove_image(TextureCacheImage *image);
+
+ protected:
+  friend class TextureCacheImage;
+
+  void add_tile(TextureCacheTile *tile);
+  void evict();
+
+  thread_mutex mutex;
+  vector<TextureCacheTile *> resident_tiles;
+  size_t memory_limit;
+  size_t memory_size;
+
+  /* Advanced whenever a tile is read, tiles that have not been used since
+   * many reads are evicted first. Read by lookups without holding the mutex. */
+  std::atomic<uint> clock;
+};
+
+CCL_NAMESPACE_END
+
+#endif /* __UTIL_TEXTURE_CACHE_H__ */